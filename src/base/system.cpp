@@ -8,6 +8,7 @@
 
 #include <sys/types.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cctype>
 #include <charconv>
@@ -19,15 +20,18 @@
 #include <cstring>
 #include <iomanip> // std::get_time
 #include <iterator> // std::size
+#include <limits>
 #include <mutex>
 #include <sstream> // std::istringstream
 #include <string_view>
+#include <vector>
 
 #if defined(CONF_WEBSOCKETS)
 #include <engine/shared/websockets.h>
 #endif
 
 #if defined(CONF_FAMILY_UNIX)
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/utsname.h>
@@ -87,6 +91,11 @@
 #include <sys/filio.h>
 #endif
 
+#if defined(CONF_PLATFORM_LINUX)
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
+
 #if defined(CONF_PLATFORM_EMSCRIPTEN)
 #include <emscripten/emscripten.h>
 #endif
@@ -113,6 +122,20 @@ void net_buffer_init(NETSOCKET_BUFFER *buffer);
 void net_buffer_reinit(NETSOCKET_BUFFER *buffer);
 void net_buffer_simple(NETSOCKET_BUFFER *buffer, char **buf, int *size);
 
+#ifdef CONF_PLATFORM_LINUX
+#define SEND_VLEN 64
+typedef struct
+{
+	int size;
+	struct mmsghdr msgs[SEND_VLEN];
+	struct iovec iovecs[SEND_VLEN];
+	char bufs[SEND_VLEN][PACKETSIZE];
+	sockaddr_storage sockaddrs[SEND_VLEN];
+} NETSOCKET_SEND_QUEUE;
+
+static void net_send_queue_init(NETSOCKET_SEND_QUEUE *queue);
+#endif
+
 struct NETSOCKET_INTERNAL
 {
 	int type;
@@ -122,6 +145,12 @@ struct NETSOCKET_INTERNAL
 	int web_ipv6sock;
 
 	NETSOCKET_BUFFER buffer;
+
+#ifdef CONF_PLATFORM_LINUX
+	bool send_batching;
+	NETSOCKET_SEND_QUEUE send_queue_ipv4;
+	NETSOCKET_SEND_QUEUE send_queue_ipv6;
+#endif
 };
 static NETSOCKET_INTERNAL invalid_socket = {NETTYPE_INVALID, -1, -1, -1, -1};
 
@@ -439,6 +468,53 @@ int io_error(IOHANDLE io)
 	return ferror((FILE *)io);
 }
 
+void *io_map(IOHANDLE io, int64_t *size)
+{
+	*size = 0;
+	const int64_t length = io_length(io);
+	// mapping an empty file fails on all platforms
+	if(length <= 0 || (uint64_t)length > std::numeric_limits<size_t>::max())
+	{
+		return nullptr;
+	}
+#if defined(CONF_FAMILY_WINDOWS)
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno((FILE *)io));
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if(mapping == nullptr)
+	{
+		return nullptr;
+	}
+	void *data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	// the view keeps the mapping alive
+	CloseHandle(mapping);
+	if(data == nullptr)
+	{
+		return nullptr;
+	}
+	*size = length;
+	return data;
+#elif defined(CONF_PLATFORM_EMSCRIPTEN)
+	return nullptr;
+#else
+	void *data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno((FILE *)io), 0);
+	if(data == MAP_FAILED)
+	{
+		return nullptr;
+	}
+	*size = length;
+	return data;
+#endif
+}
+
+void io_unmap(void *data, int64_t size)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	UnmapViewOfFile(data);
+#elif !defined(CONF_PLATFORM_EMSCRIPTEN)
+	munmap(data, size);
+#endif
+}
+
 IOHANDLE io_stdin()
 {
 	return stdin;
@@ -1533,8 +1609,12 @@ int net_addr_from_str(NETADDR *addr, const char *string)
 	return 0;
 }
 
+// incremented whenever a socket is closed, so reactors notice that file descriptors may have been reused
+static std::atomic<unsigned> net_socket_close_generation = 0;
+
 static void priv_net_close_socket(int sock)
 {
+	net_socket_close_generation++;
 #if defined(CONF_FAMILY_WINDOWS)
 	dbg_assert(closesocket(sock) == 0, "closesocket failure (%s)", net_error_message().c_str());
 #else
@@ -1759,11 +1839,73 @@ NETSOCKET net_udp_create(NETADDR bindaddr)
 	{
 		net_set_non_blocking(sock);
 		net_buffer_init(&sock->buffer);
+#if defined(CONF_PLATFORM_LINUX)
+		net_send_queue_init(&sock->send_queue_ipv4);
+		net_send_queue_init(&sock->send_queue_ipv6);
+#endif
 	}
 
 	return sock;
 }
 
+#if defined(CONF_PLATFORM_LINUX)
+static void net_send_queue_init(NETSOCKET_SEND_QUEUE *queue)
+{
+	queue->size = 0;
+	mem_zero(queue->msgs, sizeof(queue->msgs));
+	mem_zero(queue->iovecs, sizeof(queue->iovecs));
+	for(int i = 0; i < SEND_VLEN; ++i)
+	{
+		queue->iovecs[i].iov_base = queue->bufs[i];
+		queue->msgs[i].msg_hdr.msg_iov = &(queue->iovecs[i]);
+		queue->msgs[i].msg_hdr.msg_iovlen = 1;
+		queue->msgs[i].msg_hdr.msg_name = &(queue->sockaddrs[i]);
+	}
+}
+
+static int net_send_queue_flush(NETSOCKET_SEND_QUEUE *queue, int socket)
+{
+	int sent = 0;
+	int pos = 0;
+	while(pos < queue->size)
+	{
+		const int result = sendmmsg(socket, &queue->msgs[pos], queue->size - pos, 0);
+		network_stats.send_syscalls++;
+		if(result > 0)
+		{
+			sent += result;
+			pos += result;
+		}
+		else if(errno == EWOULDBLOCK)
+		{
+			// the socket buffer is full, drop the remaining packets like sendto would
+			break;
+		}
+		else
+		{
+			// drop the packet that could not be sent and continue with the next one
+			pos++;
+		}
+	}
+	queue->size = 0;
+	return sent;
+}
+
+static int net_send_queue_add(NETSOCKET_SEND_QUEUE *queue, int socket, const void *data, int size, const void *addr, socklen_t addrlen)
+{
+	if(queue->size == SEND_VLEN)
+	{
+		net_send_queue_flush(queue, socket);
+	}
+	const int i = queue->size++;
+	mem_copy(queue->bufs[i], data, size);
+	queue->iovecs[i].iov_len = size;
+	mem_copy(&queue->sockaddrs[i], addr, addrlen);
+	queue->msgs[i].msg_hdr.msg_namelen = addrlen;
+	return size;
+}
+#endif
+
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
 {
 	int d = -1;
@@ -1785,7 +1927,17 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 				netaddr_to_sockaddr_in(addr, &sa);
 			}
 
-			d = sendto(sock->ipv4sock, (const char *)data, size, 0, (sockaddr *)&sa, sizeof(sa));
+#if defined(CONF_PLATFORM_LINUX)
+			if(sock->send_batching && !(addr->type & NETTYPE_LINK_BROADCAST) && size <= PACKETSIZE)
+			{
+				d = net_send_queue_add(&sock->send_queue_ipv4, sock->ipv4sock, data, size, &sa, sizeof(sa));
+			}
+			else
+#endif
+			{
+				d = sendto(sock->ipv4sock, (const char *)data, size, 0, (sockaddr *)&sa, sizeof(sa));
+				network_stats.send_syscalls++;
+			}
 		}
 		else
 		{
@@ -1833,7 +1985,17 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 				netaddr_to_sockaddr_in6(addr, &sa);
 			}
 
-			d = sendto(sock->ipv6sock, (const char *)data, size, 0, (sockaddr *)&sa, sizeof(sa));
+#if defined(CONF_PLATFORM_LINUX)
+			if(sock->send_batching && !(addr->type & NETTYPE_LINK_BROADCAST) && size <= PACKETSIZE)
+			{
+				d = net_send_queue_add(&sock->send_queue_ipv6, sock->ipv6sock, data, size, &sa, sizeof(sa));
+			}
+			else
+#endif
+			{
+				d = sendto(sock->ipv6sock, (const char *)data, size, 0, (sockaddr *)&sa, sizeof(sa));
+				network_stats.send_syscalls++;
+			}
 		}
 		else
 		{
@@ -1867,6 +2029,33 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 	return d;
 }
 
+void net_udp_set_send_batching(NETSOCKET sock, bool batching)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	if(!batching)
+	{
+		net_udp_flush(sock);
+	}
+	sock->send_batching = batching;
+#endif
+}
+
+int net_udp_flush(NETSOCKET sock)
+{
+	int sent = 0;
+#if defined(CONF_PLATFORM_LINUX)
+	if(sock->ipv4sock >= 0)
+	{
+		sent += net_send_queue_flush(&sock->send_queue_ipv4, sock->ipv4sock);
+	}
+	if(sock->ipv6sock >= 0)
+	{
+		sent += net_send_queue_flush(&sock->send_queue_ipv6, sock->ipv6sock);
+	}
+#endif
+	return sent;
+}
+
 void net_buffer_init(NETSOCKET_BUFFER *buffer)
 {
 #if defined(CONF_PLATFORM_LINUX)
@@ -1924,6 +2113,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 			net_buffer_reinit(&sock->buffer);
 			sock->buffer.size = recvmmsg(sock->ipv4sock, sock->buffer.msgs, VLEN, 0, NULL);
 			sock->buffer.pos = 0;
+			network_stats.recv_syscalls++;
 		}
 	}
 
@@ -1934,6 +2124,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 			net_buffer_reinit(&sock->buffer);
 			sock->buffer.size = recvmmsg(sock->ipv6sock, sock->buffer.msgs, VLEN, 0, NULL);
 			sock->buffer.pos = 0;
+			network_stats.recv_syscalls++;
 		}
 	}
 
@@ -1952,6 +2143,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 		sockaddr_storage recv_addr;
 		socklen_t fromlen = sizeof(recv_addr);
 		bytes = recvfrom(sock->ipv4sock, sock->buffer.buf, sizeof(sock->buffer.buf), 0, (sockaddr *)&recv_addr, &fromlen);
+		network_stats.recv_syscalls++;
 		*data = (unsigned char *)sock->buffer.buf;
 		if(bytes > 0)
 		{
@@ -1966,6 +2158,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 		sockaddr_storage recv_addr;
 		socklen_t fromlen = sizeof(recv_addr);
 		bytes = recvfrom(sock->ipv6sock, sock->buffer.buf, sizeof(sock->buffer.buf), 0, (sockaddr *)&recv_addr, &fromlen);
+		network_stats.recv_syscalls++;
 		*data = (unsigned char *)sock->buffer.buf;
 		if(bytes > 0)
 		{
@@ -2011,6 +2204,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 
 void net_udp_close(NETSOCKET sock)
 {
+	net_udp_flush(sock);
 	priv_net_close_all_sockets(sock);
 }
 
@@ -2784,35 +2978,67 @@ void swap_endian(void *data, unsigned elem_size, unsigned num)
 	}
 }
 
-int net_socket_read_wait(NETSOCKET sock, std::chrono::nanoseconds nanoseconds)
+static int priv_net_socket_fd_set(NETSOCKET sock, fd_set *readfds, int maxfd)
 {
-	const int64_t microseconds = std::chrono::duration_cast<std::chrono::microseconds>(nanoseconds).count();
-	dbg_assert(microseconds >= 0, "Negative wait duration %" PRId64 " not allowed", microseconds);
-
-	fd_set readfds;
-	FD_ZERO(&readfds);
-
-	int maxfd = -1;
 	if(sock->ipv4sock >= 0)
 	{
-		FD_SET(sock->ipv4sock, &readfds);
-		maxfd = sock->ipv4sock;
+		FD_SET(sock->ipv4sock, readfds);
+		maxfd = std::max(maxfd, sock->ipv4sock);
 	}
 	if(sock->ipv6sock >= 0)
 	{
-		FD_SET(sock->ipv6sock, &readfds);
+		FD_SET(sock->ipv6sock, readfds);
 		maxfd = std::max(maxfd, sock->ipv6sock);
 	}
 #if defined(CONF_WEBSOCKETS)
 	if(sock->web_ipv4sock >= 0)
 	{
-		maxfd = std::max(maxfd, websocket_fd_set(sock->web_ipv4sock, &readfds));
+		maxfd = std::max(maxfd, websocket_fd_set(sock->web_ipv4sock, readfds));
 	}
 	if(sock->web_ipv6sock >= 0)
 	{
-		maxfd = std::max(maxfd, websocket_fd_set(sock->web_ipv6sock, &readfds));
+		maxfd = std::max(maxfd, websocket_fd_set(sock->web_ipv6sock, readfds));
 	}
 #endif
+	return maxfd;
+}
+
+static bool priv_net_socket_fd_isset(NETSOCKET sock, fd_set *readfds)
+{
+	if(sock->ipv4sock >= 0 && FD_ISSET(sock->ipv4sock, readfds))
+	{
+		return true;
+	}
+	if(sock->ipv6sock >= 0 && FD_ISSET(sock->ipv6sock, readfds))
+	{
+		return true;
+	}
+#if defined(CONF_WEBSOCKETS)
+	if(sock->web_ipv4sock >= 0 && websocket_fd_get(sock->web_ipv4sock, readfds))
+	{
+		return true;
+	}
+	if(sock->web_ipv6sock >= 0 && websocket_fd_get(sock->web_ipv6sock, readfds))
+	{
+		return true;
+	}
+#endif
+	return false;
+}
+
+static int priv_net_select(const NETSOCKET *socks, int num_socks, std::chrono::nanoseconds nanoseconds)
+{
+	const int64_t microseconds = std::chrono::duration_cast<std::chrono::microseconds>(nanoseconds).count();
+	dbg_assert(microseconds >= 0, "Negative wait duration %" PRId64 " not allowed", microseconds);
+
+	fd_set readfds;
+	FD_ZERO(&readfds);
+
+	int maxfd = -1;
+	for(int i = 0; i < num_socks; i++)
+	{
+		maxfd = priv_net_socket_fd_set(socks[i], &readfds, maxfd);
+	}
 	if(maxfd < 0)
 	{
 		return 0;
@@ -2824,25 +3050,197 @@ int net_socket_read_wait(NETSOCKET sock, std::chrono::nanoseconds nanoseconds)
 	// don't care about writefds and exceptfds
 	select(maxfd + 1, &readfds, nullptr, nullptr, &tv);
 
-	if(sock->ipv4sock >= 0 && FD_ISSET(sock->ipv4sock, &readfds))
+	for(int i = 0; i < num_socks; i++)
 	{
-		return 1;
+		if(priv_net_socket_fd_isset(socks[i], &readfds))
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int net_socket_read_wait(NETSOCKET sock, std::chrono::nanoseconds nanoseconds)
+{
+	return priv_net_select(&sock, 1, nanoseconds);
+}
+
+struct NETREACTOR_INTERNAL
+{
+	std::vector<NETSOCKET> sockets;
+#if defined(CONF_PLATFORM_LINUX)
+	int epoll_fd;
+	int timer_fd;
+	unsigned close_generation;
+	std::vector<int> wanted_fds;
+	std::vector<int> registered_fds;
+#endif
+};
+
+NETREACTOR net_reactor_create()
+{
+	NETREACTOR reactor = new NETREACTOR_INTERNAL;
+#if defined(CONF_PLATFORM_LINUX)
+	reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	reactor->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	reactor->close_generation = net_socket_close_generation;
+	if(reactor->epoll_fd >= 0 && reactor->timer_fd >= 0)
+	{
+		epoll_event event = {};
+		event.events = EPOLLIN;
+		event.data.fd = reactor->timer_fd;
+		if(epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, reactor->timer_fd, &event) != 0)
+		{
+			log_error("net", "Adding timerfd to epoll failed (%s)", net_error_message().c_str());
+		}
 	}
-	if(sock->ipv6sock >= 0 && FD_ISSET(sock->ipv6sock, &readfds))
+	else
 	{
-		return 1;
+		log_error("net", "Creating epoll reactor failed, falling back to select (%s)", net_error_message().c_str());
 	}
-#if defined(CONF_WEBSOCKETS)
-	if(sock->web_ipv4sock >= 0 && websocket_fd_get(sock->web_ipv4sock, &readfds))
+#endif
+	return reactor;
+}
+
+void net_reactor_add(NETREACTOR reactor, NETSOCKET sock)
+{
+	if(sock)
 	{
-		return 1;
+		reactor->sockets.push_back(sock);
 	}
-	if(sock->web_ipv6sock >= 0 && websocket_fd_get(sock->web_ipv6sock, &readfds))
+}
+
+#if defined(CONF_PLATFORM_LINUX)
+static bool priv_net_reactor_epoll_usable(NETREACTOR reactor)
+{
+	if(reactor->epoll_fd < 0 || reactor->timer_fd < 0)
 	{
-		return 1;
+		return false;
+	}
+	// libwebsockets manages its own file descriptors
+	for(NETSOCKET sock : reactor->sockets)
+	{
+		if(sock->web_ipv4sock >= 0 || sock->web_ipv6sock >= 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static int priv_net_reactor_epoll_wait(NETREACTOR reactor, std::chrono::nanoseconds deadline)
+{
+	// update the registered file descriptors, closed ones are removed by the kernel automatically
+	reactor->wanted_fds.clear();
+	for(NETSOCKET sock : reactor->sockets)
+	{
+		if(sock->ipv4sock >= 0)
+			reactor->wanted_fds.push_back(sock->ipv4sock);
+		if(sock->ipv6sock >= 0)
+			reactor->wanted_fds.push_back(sock->ipv6sock);
+	}
+	std::sort(reactor->wanted_fds.begin(), reactor->wanted_fds.end());
+	reactor->wanted_fds.erase(std::unique(reactor->wanted_fds.begin(), reactor->wanted_fds.end()), reactor->wanted_fds.end());
+
+	const unsigned close_generation = net_socket_close_generation;
+	if(reactor->close_generation != close_generation)
+	{
+		// a closed file descriptor may have been reused for a different socket, register all again
+		for(int fd : reactor->registered_fds)
+		{
+			epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+		}
+		reactor->registered_fds.clear();
+		reactor->close_generation = close_generation;
+	}
+	for(int fd : reactor->registered_fds)
+	{
+		if(!std::binary_search(reactor->wanted_fds.begin(), reactor->wanted_fds.end(), fd))
+		{
+			epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+		}
+	}
+	for(int fd : reactor->wanted_fds)
+	{
+		if(!std::binary_search(reactor->registered_fds.begin(), reactor->registered_fds.end(), fd))
+		{
+			epoll_event event = {};
+			event.events = EPOLLIN;
+			event.data.fd = fd;
+			epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+		}
+	}
+	std::swap(reactor->registered_fds, reactor->wanted_fds);
+
+	int timeout = -1;
+	if(deadline > time_get_nanoseconds())
+	{
+		// steady_clock is CLOCK_MONOTONIC on Linux
+		const int64_t deadline_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(tw_start_time.time_since_epoch() + deadline).count();
+		itimerspec timer = {};
+		timer.it_value.tv_sec = deadline_ns / 1000000000;
+		timer.it_value.tv_nsec = deadline_ns % 1000000000;
+		timerfd_settime(reactor->timer_fd, TFD_TIMER_ABSTIME, &timer, nullptr);
+	}
+	else
+	{
+		// only poll if the deadline has already passed
+		timeout = 0;
+	}
+
+	epoll_event events[16];
+	const int num_events = epoll_wait(reactor->epoll_fd, events, std::size(events), timeout);
+	int result = 0;
+	for(int i = 0; i < num_events; i++)
+	{
+		if(events[i].data.fd == reactor->timer_fd)
+		{
+			uint64_t expirations;
+			if(read(reactor->timer_fd, &expirations, sizeof(expirations)) < 0)
+			{
+				// nothing to do, the timer is armed again before the next wait
+			}
+		}
+		else
+		{
+			result = 1;
+		}
 	}
+	return result;
+}
 #endif
-	return 0;
+
+int net_reactor_wait(NETREACTOR reactor, std::chrono::nanoseconds deadline)
+{
+	int result;
+#if defined(CONF_PLATFORM_LINUX)
+	if(priv_net_reactor_epoll_usable(reactor))
+	{
+		result = priv_net_reactor_epoll_wait(reactor, deadline);
+	}
+	else
+#endif
+	{
+		const std::chrono::nanoseconds nanoseconds = std::max(deadline - time_get_nanoseconds(), std::chrono::nanoseconds(0));
+		result = priv_net_select(reactor->sockets.data(), reactor->sockets.size(), nanoseconds);
+	}
+	reactor->sockets.clear();
+	return result;
+}
+
+void net_reactor_destroy(NETREACTOR reactor)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	if(reactor->epoll_fd >= 0)
+	{
+		close(reactor->epoll_fd);
+	}
+	if(reactor->timer_fd >= 0)
+	{
+		close(reactor->timer_fd);
+	}
+#endif
+	delete reactor;
 }
 
 int64_t time_timestamp()
@@ -444,6 +444,36 @@ int io_sync(IOHANDLE io);
  */
 int io_error(IOHANDLE io);
 
+/**
+ * Maps the whole file into memory.
+ *
+ * @ingroup File-IO
+ *
+ * @param io Handle to the file, must have been opened for reading.
+ * @param size Receives the size of the mapping, which is the length of
+ *        the file.
+ *
+ * @return Pointer to the start of the file's contents, or `nullptr` on
+ *         failure or for empty files.
+ *
+ * @remark The mapping is copy-on-write: it can be written to, but the
+ *         changes are private and never written back to the file.
+ * @remark The mapping stays valid after the file was closed.
+ * @remark The mapping must be released with @link io_unmap @endlink.
+ * @remark Resets the cursor to the beginning.
+ */
+void *io_map(IOHANDLE io, int64_t *size);
+
+/**
+ * Releases a mapping created by @link io_map @endlink.
+ *
+ * @ingroup File-IO
+ *
+ * @param data Pointer returned by @link io_map @endlink.
+ * @param size Size returned by @link io_map @endlink.
+ */
+void io_unmap(void *data, int64_t size);
+
 /**
  * Returns a handle for the standard input.
  *
@@ -997,6 +1027,52 @@ int net_would_block();
  */
 int net_socket_read_wait(NETSOCKET sock, std::chrono::nanoseconds nanoseconds);
 
+/**
+ * Creates a reactor that waits for multiple sockets and a deadline at once.
+ * On Linux, it uses epoll and a timerfd, so the wait ends at the deadline with
+ * nanosecond precision. On other platforms and for websockets, it falls back
+ * to `select`.
+ *
+ * @ingroup Network-General
+ *
+ * @return Handle to the reactor, must be freed with @link net_reactor_destroy @endlink.
+ */
+NETREACTOR net_reactor_create();
+
+/**
+ * Adds a socket to the set of sockets the next @link net_reactor_wait @endlink
+ * waits on. The set is cleared by every wait, so the sockets must be added again
+ * before each wait.
+ *
+ * @ingroup Network-General
+ *
+ * @param reactor Reactor to use.
+ * @param sock UDP or TCP socket to wait on, ignored if `nullptr`.
+ */
+void net_reactor_add(NETREACTOR reactor, NETSOCKET sock);
+
+/**
+ * Waits until one of the added sockets has data available to receive or the
+ * deadline is reached.
+ *
+ * @ingroup Network-General
+ *
+ * @param reactor Reactor to use.
+ * @param deadline Point in time to stop waiting, on the same clock as @link time_get_nanoseconds @endlink.
+ *
+ * @return `1` if one of the sockets has data available, `0` otherwise.
+ */
+int net_reactor_wait(NETREACTOR reactor, std::chrono::nanoseconds deadline);
+
+/**
+ * Frees a reactor created with @link net_reactor_create @endlink.
+ *
+ * @ingroup Network-General
+ *
+ * @param reactor Reactor to free.
+ */
+void net_reactor_destroy(NETREACTOR reactor);
+
 /**
  * @defgroup Network-UDP UDP Networking
  *
@@ -1037,9 +1113,39 @@ NETSOCKET net_udp_create(NETADDR bindaddr);
  * @param size Size of the packet.
  *
  * @return On success it returns the number of bytes sent. Returns `-1` on error.
+ *
+ * @remark If send batching is enabled for the socket, the packet may only be queued
+ * and is not sent before @link net_udp_flush @endlink is called.
  */
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size);
 
+/**
+ * Enables or disables send batching for an UDP socket. While enabled, packets
+ * passed to @link net_udp_send @endlink are queued and sent with as few system
+ * calls as possible when @link net_udp_flush @endlink is called or the queue
+ * is full. Only supported on Linux, on other platforms packets are always sent
+ * immediately.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to use.
+ * @param batching Whether packets should be queued.
+ *
+ * @remark Disabling send batching flushes the queued packets.
+ */
+void net_udp_set_send_batching(NETSOCKET sock, bool batching);
+
+/**
+ * Sends all packets queued on an UDP socket.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to use.
+ *
+ * @return The number of packets that were sent.
+ */
+int net_udp_flush(NETSOCKET sock);
+
 /**
  * Receives a packet over an UDP socket.
  *
@@ -1054,7 +1160,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data);
 
 /**
- * Closes an UDP socket.
+ * Closes an UDP socket. Packets that are still queued are sent first.
  *
  * @ingroup Network-UDP
  *
@@ -41,6 +41,11 @@ typedef int (*FS_LISTDIR_CALLBACK_FILEINFO)(const CFsFileInfo *info, int is_dir,
  */
 typedef struct NETSOCKET_INTERNAL *NETSOCKET;
 
+/**
+ * @ingroup Network-General
+ */
+typedef struct NETREACTOR_INTERNAL *NETREACTOR;
+
 /**
  * The maximum bytes necessary to encode one Unicode codepoint with UTF-8.
  */
@@ -94,6 +99,14 @@ typedef struct NETSTATS
 	uint64_t sent_bytes;
 	uint64_t recv_packets;
 	uint64_t recv_bytes;
+	/**
+	 * Number of system calls used to send packets.
+	 */
+	uint64_t send_syscalls;
+	/**
+	 * Number of system calls used to receive packets.
+	 */
+	uint64_t recv_syscalls;
 } NETSTATS;
 
 #if defined(CONF_FAMILY_WINDOWS)
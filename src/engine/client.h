@@ -400,6 +400,16 @@ public:
 	virtual void InitializeLanguage() = 0;
 
 	virtual void ForceUpdateConsoleRemoteCompletionSuggestions() = 0;
+
+	/**
+	 * Starts or stops measuring the CPU time each component spends rendering,
+	 * starting discards the previous measurements.
+	 */
+	virtual void SetComponentProfiling(bool Profiling) = 0;
+	/**
+	 * Writes the average and maximum CPU time per frame of each component.
+	 */
+	virtual void WriteComponentProfile(IOHANDLE File, int NumFrames) const = 0;
 };
 
 extern IGameClient *CreateGameClient();
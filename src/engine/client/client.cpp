@@ -876,10 +876,11 @@ void CClient::LoadDebugFont()
 IClient::CSnapItem CClient::SnapGetItem(int SnapId, int Index) const
 {
 	dbg_assert(SnapId >= 0 && SnapId < NUM_SNAPSHOT_TYPES, "invalid SnapId");
-	const CSnapshot *pSnapshot = m_aapSnapshots[g_Config.m_ClDummy][SnapId]->m_pAltSnap;
+	const CSnapshotStorage::CHolder *pHolder = m_aapSnapshots[g_Config.m_ClDummy][SnapId];
+	const CSnapshot *pSnapshot = pHolder->m_pAltSnap;
 	const CSnapshotItem *pSnapshotItem = pSnapshot->GetItem(Index);
 	CSnapItem Item;
-	Item.m_Type = pSnapshot->GetItemType(Index);
+	Item.m_Type = pHolder->m_pAltIndex ? pHolder->m_pAltIndex->GetItemType(Index) : pSnapshot->GetItemType(Index);
 	Item.m_Id = pSnapshotItem->Id();
 	Item.m_pData = pSnapshotItem->Data();
 	Item.m_DataSize = pSnapshot->GetItemSize(Index);
@@ -888,10 +889,13 @@ IClient::CSnapItem CClient::SnapGetItem(int SnapId, int Index) const
 
 const void *CClient::SnapFindItem(int SnapId, int Type, int Id) const
 {
-	if(!m_aapSnapshots[g_Config.m_ClDummy][SnapId])
+	const CSnapshotStorage::CHolder *pHolder = m_aapSnapshots[g_Config.m_ClDummy][SnapId];
+	if(!pHolder)
 		return nullptr;
 
-	return m_aapSnapshots[g_Config.m_ClDummy][SnapId]->m_pAltSnap->FindItem(Type, Id);
+	if(pHolder->m_pAltIndex)
+		return pHolder->m_pAltIndex->FindItem(Type, Id);
+	return pHolder->m_pAltSnap->FindItem(Type, Id);
 }
 
 int CClient::SnapNumItems(int SnapId) const
@@ -1003,7 +1007,8 @@ void CClient::RenderDebug()
 		{
 			if(m_SnapshotDelta.GetDataRate(i) && m_aapSnapshots[g_Config.m_ClDummy][IClient::SNAP_CURRENT])
 			{
-				const int Type = m_aapSnapshots[g_Config.m_ClDummy][IClient::SNAP_CURRENT]->m_pAltSnap->GetExternalItemType(i);
+				const CSnapshotStorage::CHolder *pHolder = m_aapSnapshots[g_Config.m_ClDummy][IClient::SNAP_CURRENT];
+				const int Type = pHolder->m_pAltIndex ? pHolder->m_pAltIndex->GetExternalItemType(i) : pHolder->m_pAltSnap->GetExternalItemType(i);
 				if(Type == UUID_INVALID)
 				{
 					str_format(
@@ -1157,7 +1162,7 @@ const char *CClient::LoadMap(const char *pName, const char *pFilename, SHA256_DI
 	if((bool)m_LoadingCallback)
 		m_LoadingCallback(IClient::LOADING_CALLBACK_DETAIL_MAP);
 
-	if(!m_pMap->Load(pFilename))
+	if(!m_pMap->Load(pFilename, false, g_Config.m_ClMapPreload))
 	{
 		str_format(s_aErrorMsg, sizeof(s_aErrorMsg), "map '%s' not found", pFilename);
 		return s_aErrorMsg;
@@ -2660,8 +2665,15 @@ void CClient::OnDemoPlayerSnapshot(void *pData, int Size)
 	std::swap(m_aapSnapshots[0][SNAP_PREV], m_aapSnapshots[0][SNAP_CURRENT]);
 	mem_copy(m_aapSnapshots[0][SNAP_CURRENT]->m_pSnap, pData, Size);
 	mem_copy(m_aapSnapshots[0][SNAP_CURRENT]->m_pAltSnap, pAltSnapBuffer, AltSnapSize);
+	m_aapSnapshots[0][SNAP_CURRENT]->m_pAltIndex->Build(m_aapSnapshots[0][SNAP_CURRENT]->m_pAltSnap);
 
+	const int64_t SnapshotStart = time_get();
 	GameClient()->OnNewSnapshot();
+	if(m_DemoBenchmark.m_File)
+	{
+		m_DemoBenchmark.m_NumSnapshots++;
+		m_DemoBenchmark.m_SnapshotTime += time_get() - SnapshotStart;
+	}
 }
 
 void CClient::OnDemoPlayerMessage(void *pData, int Size)
@@ -2725,6 +2737,9 @@ void CClient::Update()
 		}
 		else
 		{
+			if(m_DemoBenchmark.m_File)
+				FinishDemoBenchmark();
+
 			// Disconnect when demo playback stopped, either due to playback error
 			// or because the end of the demo was reached when rendering it.
 			DisconnectWithReason(m_DemoPlayer.ErrorMessage());
@@ -3216,6 +3231,10 @@ void CClient::Run()
 			m_aCmdPlayDemo[0] = 0;
 		}
 
+		// handle pending demo benchmark
+		if(m_DemoBenchmark.m_aDemo[0])
+			StartDemoBenchmark();
+
 		// handle pending map edits
 		if(m_aCmdEditMap[0])
 		{
@@ -3284,8 +3303,10 @@ void CClient::Run()
 				m_EditorActive = false;
 			}
 
+			const int64_t UpdateStart = time_get();
 			Update();
 			int64_t Now = time_get();
+			const int64_t UpdateTime = Now - UpdateStart;
 
 			bool IsRenderActive = (g_Config.m_GfxBackgroundRender || m_pGraphics->WindowOpen());
 
@@ -3302,9 +3323,11 @@ void CClient::Run()
 			}
 #endif
 
-			if(IsRenderActive &&
-				(!AsyncRenderOld || m_pGraphics->IsIdle()) &&
-				(!GfxRefreshRate || (time_freq() / (int64_t)g_Config.m_GfxRefreshRate) <= Now - LastRenderTime))
+			// the demo benchmark renders every frame as fast as possible
+			if(m_DemoBenchmark.m_File ||
+				(IsRenderActive &&
+					(!AsyncRenderOld || m_pGraphics->IsIdle()) &&
+					(!GfxRefreshRate || (time_freq() / (int64_t)g_Config.m_GfxRefreshRate) <= Now - LastRenderTime)))
 			{
 				// update frametime
 				m_RenderFrameTime = (Now - m_LastRenderTime) / (float)time_freq();
@@ -3333,8 +3356,13 @@ void CClient::Run()
 				LastRenderTime = Now - AdditionalTime;
 				m_LastRenderTime = Now;
 
+				const int64_t RenderStart = time_get();
 				Render();
+				const int64_t RenderTime = time_get() - RenderStart;
 				m_pGraphics->Swap();
+
+				if(m_DemoBenchmark.m_File)
+					AddDemoBenchmarkFrame(UpdateTime, RenderTime);
 			}
 			else if(!IsRenderActive)
 			{
@@ -3356,7 +3384,11 @@ void CClient::Run()
 		auto Now = time_get_nanoseconds();
 		decltype(Now) SleepTimeInNanoSeconds{0};
 		bool Slept = false;
-		if(g_Config.m_ClRefreshRateInactive && !m_pGraphics->WindowActive())
+		if(m_DemoBenchmark.m_File)
+		{
+			// don't sleep during the demo benchmark
+		}
+		else if(g_Config.m_ClRefreshRateInactive && !m_pGraphics->WindowActive())
 		{
 			SleepTimeInNanoSeconds = (std::chrono::nanoseconds(1s) / (int64_t)g_Config.m_ClRefreshRateInactive) - (Now - LastTime);
 			std::this_thread::sleep_for(SleepTimeInNanoSeconds);
@@ -3994,6 +4026,8 @@ const char *CClient::DemoPlayer_Play(const char *pFilename, int StorageType)
 		m_aapSnapshots[0][SnapshotType] = &m_aDemorecSnapshotHolders[SnapshotType];
 		m_aapSnapshots[0][SnapshotType]->m_pSnap = (CSnapshot *)&m_aaaDemorecSnapshotData[SnapshotType][0];
 		m_aapSnapshots[0][SnapshotType]->m_pAltSnap = (CSnapshot *)&m_aaaDemorecSnapshotData[SnapshotType][1];
+		m_aapSnapshots[0][SnapshotType]->m_pAltIndex = &m_aDemorecSnapshotIndices[SnapshotType];
+		m_aapSnapshots[0][SnapshotType]->m_pAltIndex->Build(m_aapSnapshots[0][SnapshotType]->m_pAltSnap);
 		m_aapSnapshots[0][SnapshotType]->m_SnapSize = 0;
 		m_aapSnapshots[0][SnapshotType]->m_AltSnapSize = 0;
 		m_aapSnapshots[0][SnapshotType]->m_Tick = -1;
@@ -4179,6 +4213,127 @@ void CClient::BenchmarkQuit(int Seconds, const char *pFilename)
 	m_BenchmarkStopTime = time_get() + time_freq() * Seconds;
 }
 
+void CClient::Con_BenchmarkDemo(IConsole::IResult *pResult, void *pUserData)
+{
+	CClient *pSelf = (CClient *)pUserData;
+	pSelf->BenchmarkDemo(pResult->GetString(0), pResult->GetInteger(1), pResult->GetString(2));
+}
+
+void CClient::BenchmarkDemo(const char *pDemo, int Fps, const char *pFilename)
+{
+	if(m_DemoBenchmark.m_File)
+	{
+		log_error("benchmark", "a demo benchmark is already running");
+		return;
+	}
+	// started by the main loop, the client might not be initialized yet
+	str_copy(m_DemoBenchmark.m_aDemo, pDemo);
+	str_copy(m_DemoBenchmark.m_aFilename, pFilename);
+	m_DemoBenchmark.m_Fps = std::clamp(Fps, 1, 1000);
+}
+
+void CClient::StartDemoBenchmark()
+{
+	char aDemo[IO_MAX_PATH_LENGTH];
+	str_copy(aDemo, m_DemoBenchmark.m_aDemo);
+	m_DemoBenchmark.m_aDemo[0] = '\0';
+
+	const char *pError = DemoPlayer_Play(aDemo, IStorage::TYPE_ALL_OR_ABSOLUTE);
+	if(pError)
+	{
+		log_error("benchmark", "playing demo '%s' failed: %s", aDemo, pError);
+		Quit();
+		return;
+	}
+	m_DemoBenchmark.m_File = Storage()->OpenFile(m_DemoBenchmark.m_aFilename, IOFLAG_WRITE, IStorage::TYPE_ABSOLUTE);
+	if(!m_DemoBenchmark.m_File)
+	{
+		log_error("benchmark", "failed to open '%s' for writing", m_DemoBenchmark.m_aFilename);
+		Quit();
+		return;
+	}
+
+	char aBuf[IO_MAX_PATH_LENGTH + 32];
+	str_format(aBuf, sizeof(aBuf), "demo: %s\nfps: %d\n", aDemo, m_DemoBenchmark.m_Fps);
+	io_write(m_DemoBenchmark.m_File, aBuf, str_length(aBuf));
+
+	// the same frames are rendered on every run, independent of how fast the client is
+	m_DemoPlayer.SetFixedTimeStep(time_freq() / m_DemoBenchmark.m_Fps);
+	m_DemoBenchmark.m_StartTime = time_get();
+	m_DemoBenchmark.m_StartTick = m_DemoPlayer.Info()->m_Info.m_CurrentTick;
+	m_DemoBenchmark.m_NumFrames = 0;
+	m_DemoBenchmark.m_NumSnapshots = 0;
+	m_DemoBenchmark.m_UpdateTime = 0;
+	m_DemoBenchmark.m_MaxUpdateTime = 0;
+	m_DemoBenchmark.m_SnapshotTime = 0;
+	m_DemoBenchmark.m_RenderTime = 0;
+	m_DemoBenchmark.m_MaxRenderTime = 0;
+	m_DemoBenchmark.m_TotalCommandBuffer = {};
+	m_DemoBenchmark.m_MaxCommandBuffer = {};
+	GameClient()->SetComponentProfiling(true);
+}
+
+void CClient::AddDemoBenchmarkFrame(int64_t UpdateTime, int64_t RenderTime)
+{
+	m_DemoBenchmark.m_NumFrames++;
+	m_DemoBenchmark.m_UpdateTime += UpdateTime;
+	m_DemoBenchmark.m_MaxUpdateTime = maximum(m_DemoBenchmark.m_MaxUpdateTime, UpdateTime);
+	m_DemoBenchmark.m_RenderTime += RenderTime;
+	m_DemoBenchmark.m_MaxRenderTime = maximum(m_DemoBenchmark.m_MaxRenderTime, RenderTime);
+
+	const IGraphics::SCommandBufferStats Stats = m_pGraphics->LastFrameCommandBufferStats();
+	IGraphics::SCommandBufferStats &Total = m_DemoBenchmark.m_TotalCommandBuffer;
+	IGraphics::SCommandBufferStats &Max = m_DemoBenchmark.m_MaxCommandBuffer;
+	Total.m_NumCommands += Stats.m_NumCommands;
+	Total.m_NumRenderCalls += Stats.m_NumRenderCalls;
+	Total.m_CommandSize += Stats.m_CommandSize;
+	Total.m_DataSize += Stats.m_DataSize;
+	Max.m_NumCommands = maximum(Max.m_NumCommands, Stats.m_NumCommands);
+	Max.m_NumRenderCalls = maximum(Max.m_NumRenderCalls, Stats.m_NumRenderCalls);
+	Max.m_CommandSize = maximum(Max.m_CommandSize, Stats.m_CommandSize);
+	Max.m_DataSize = maximum(Max.m_DataSize, Stats.m_DataSize);
+}
+
+void CClient::FinishDemoBenchmark()
+{
+	const SDemoBenchmark &Benchmark = m_DemoBenchmark;
+	const int NumFrames = maximum(Benchmark.m_NumFrames, 1);
+	const double Us = 1000000.0 / time_freq();
+	const IGraphics::SCommandBufferStats &Total = Benchmark.m_TotalCommandBuffer;
+	const IGraphics::SCommandBufferStats &Max = Benchmark.m_MaxCommandBuffer;
+
+	char aBuf[1024];
+	str_format(aBuf, sizeof(aBuf),
+		"frames: %d\n"
+		"ticks: %d\n"
+		"wall time: %.3f s\n"
+		"update: avg %.1f us, max %.1f us\n"
+		"snapshots: %d, avg %.1f us\n"
+		"render: avg %.1f us, max %.1f us\n"
+		"commands: avg %.1f, max %" PRIzu "\n"
+		"render calls: avg %.1f, max %" PRIzu "\n"
+		"command buffer: avg %.0f bytes, max %" PRIzu " bytes\n"
+		"data buffer: avg %.0f bytes, max %" PRIzu " bytes\n",
+		Benchmark.m_NumFrames,
+		m_DemoPlayer.Info()->m_Info.m_CurrentTick - Benchmark.m_StartTick,
+		(time_get() - Benchmark.m_StartTime) / (double)time_freq(),
+		Benchmark.m_UpdateTime * Us / NumFrames, Benchmark.m_MaxUpdateTime * Us,
+		Benchmark.m_NumSnapshots, Benchmark.m_NumSnapshots > 0 ? Benchmark.m_SnapshotTime * Us / Benchmark.m_NumSnapshots : 0.0,
+		Benchmark.m_RenderTime * Us / NumFrames, Benchmark.m_MaxRenderTime * Us,
+		Total.m_NumCommands / (double)NumFrames, Max.m_NumCommands,
+		Total.m_NumRenderCalls / (double)NumFrames, Max.m_NumRenderCalls,
+		Total.m_CommandSize / (double)NumFrames, Max.m_CommandSize,
+		Total.m_DataSize / (double)NumFrames, Max.m_DataSize);
+	io_write(Benchmark.m_File, aBuf, str_length(aBuf));
+	GameClient()->WriteComponentProfile(Benchmark.m_File, Benchmark.m_NumFrames);
+	GameClient()->SetComponentProfiling(false);
+
+	io_close(m_DemoBenchmark.m_File);
+	m_DemoBenchmark.m_File = nullptr;
+	m_DemoPlayer.SetFixedTimeStep(0);
+	Quit();
+}
+
 void CClient::UpdateAndSwap()
 {
 	Input()->Update();
@@ -4503,6 +4658,7 @@ void CClient::RegisterCommands()
 
 	m_pConsole->Register("save_replay", "?i[length] ?r[filename]", CFGFLAG_CLIENT, Con_SaveReplay, this, "Save a replay of the last defined amount of seconds");
 	m_pConsole->Register("benchmark_quit", "i[seconds] r[file]", CFGFLAG_CLIENT | CFGFLAG_STORE, Con_BenchmarkQuit, this, "Benchmark frame times for number of seconds to file, then quit");
+	m_pConsole->Register("benchmark_demo", "s[demo] i[fps] r[file]", CFGFLAG_CLIENT | CFGFLAG_STORE, Con_BenchmarkDemo, this, "Play a demo as fast as possible rendering fps frames per demo second, write the CPU time per frame to file, then quit");
 
 	RustVersionRegister(*m_pConsole);
 
@@ -204,6 +204,7 @@ class CClient : public IClient, public CDemoPlayer::IListener
 
 	CSnapshotStorage::CHolder m_aDemorecSnapshotHolders[NUM_SNAPSHOT_TYPES];
 	char m_aaaDemorecSnapshotData[NUM_SNAPSHOT_TYPES][2][CSnapshot::MAX_SIZE];
+	CSnapshotIndex m_aDemorecSnapshotIndices[NUM_SNAPSHOT_TYPES];
 
 	CSnapshotDelta m_SnapshotDelta;
 
@@ -248,6 +249,29 @@ class CClient : public IClient, public CDemoPlayer::IListener
 	IOHANDLE m_BenchmarkFile = nullptr;
 	int64_t m_BenchmarkStopTime = 0;
 
+	// benchmark_demo, plays a demo as fast as possible and measures the CPU time of every frame
+	struct SDemoBenchmark
+	{
+		char m_aDemo[IO_MAX_PATH_LENGTH] = "";
+		char m_aFilename[IO_MAX_PATH_LENGTH];
+		int m_Fps;
+		IOHANDLE m_File = nullptr;
+		int64_t m_StartTime;
+		int m_StartTick;
+		int m_NumFrames;
+		int m_NumSnapshots;
+		int64_t m_UpdateTime;
+		int64_t m_MaxUpdateTime;
+		int64_t m_SnapshotTime;
+		int64_t m_RenderTime;
+		int64_t m_MaxRenderTime;
+		IGraphics::SCommandBufferStats m_TotalCommandBuffer;
+		IGraphics::SCommandBufferStats m_MaxCommandBuffer;
+	} m_DemoBenchmark;
+	void StartDemoBenchmark();
+	void AddDemoBenchmarkFrame(int64_t UpdateTime, int64_t RenderTime);
+	void FinishDemoBenchmark();
+
 	CChecksum m_Checksum;
 	int64_t m_OwnExecutableSize = 0;
 	IOHANDLE m_OwnExecutable = nullptr;
@@ -450,6 +474,7 @@ public:
 	static void Con_StopRecord(IConsole::IResult *pResult, void *pUserData);
 	static void Con_AddDemoMarker(IConsole::IResult *pResult, void *pUserData);
 	static void Con_BenchmarkQuit(IConsole::IResult *pResult, void *pUserData);
+	static void Con_BenchmarkDemo(IConsole::IResult *pResult, void *pUserData);
 	static void ConchainServerBrowserUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainFullscreen(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainWindowBordered(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
@@ -500,6 +525,7 @@ public:
 	void Notify(const char *pTitle, const char *pMessage) override;
 	void OnWindowResize() override;
 	void BenchmarkQuit(int Seconds, const char *pFilename);
+	void BenchmarkDemo(const char *pDemo, int Fps, const char *pFilename);
 
 	void UpdateAndSwap() override;
 
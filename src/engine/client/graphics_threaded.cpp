@@ -650,6 +650,11 @@ bool CGraphics_Threaded::IsImageFormatRgba(const char *pContextName, const CImag
 
 void CGraphics_Threaded::KickCommandBuffer()
 {
+	m_CurrentFrameCommandBufferStats.m_NumCommands += m_pCommandBuffer->m_CommandCount;
+	m_CurrentFrameCommandBufferStats.m_NumRenderCalls += m_pCommandBuffer->m_RenderCallCount;
+	m_CurrentFrameCommandBufferStats.m_CommandSize += m_pCommandBuffer->m_CmdBuffer.DataUsed();
+	m_CurrentFrameCommandBufferStats.m_DataSize += m_pCommandBuffer->m_DataBuffer.DataUsed();
+
 	m_pBackend->RunBuffer(m_pCommandBuffer);
 
 	std::vector<std::string> WarningStrings;
@@ -2814,6 +2819,8 @@ void CGraphics_Threaded::Swap()
 	}
 
 	KickCommandBuffer();
+	m_LastFrameCommandBufferStats = m_CurrentFrameCommandBufferStats;
+	m_CurrentFrameCommandBufferStats = {};
 	// TODO: Remove when https://github.com/libsdl-org/SDL/issues/5203 is fixed
 #ifdef CONF_PLATFORM_MACOS
 	if(str_find(GetVersionString(), "Metal"))
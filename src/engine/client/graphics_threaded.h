@@ -760,6 +760,8 @@ class CGraphics_Threaded : public IEngineGraphics
 	CCommandBuffer *m_apCommandBuffers[2];
 	CCommandBuffer *m_pCommandBuffer;
 	unsigned m_CurrentCommandBuffer;
+	SCommandBufferStats m_CurrentFrameCommandBufferStats;
+	SCommandBufferStats m_LastFrameCommandBufferStats;
 
 	//
 	class IStorage *m_pStorage;
@@ -913,6 +915,8 @@ public:
 	uint64_t StreamedMemoryUsage() const override;
 	uint64_t StagingMemoryUsage() const override;
 
+	SCommandBufferStats LastFrameCommandBufferStats() const override { return m_LastFrameCommandBufferStats; }
+
 	const TTwGraphicsGpuList &GetGpus() const override;
 
 	void MapScreen(float TopLeftX, float TopLeftY, float BottomRightX, float BottomRightY) override;
@@ -944,6 +948,7 @@ public:
 
 	// simple uncompressed RGBA loaders
 	IGraphics::CTextureHandle LoadTexture(const char *pFilename, int StorageType, int Flags = 0) override;
+	IGraphics::CTextureHandle NullTexture() const override { return m_NullTexture; }
 	bool LoadPng(CImageInfo &Image, const char *pFilename, int StorageType) override;
 	bool LoadPng(CImageInfo &Image, const uint8_t *pData, size_t DataSize, const char *pContextName) override;
 
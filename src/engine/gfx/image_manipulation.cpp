@@ -3,6 +3,9 @@
 #include <base/math.h>
 #include <base/system.h>
 
+#include <utility>
+#include <vector>
+
 bool ConvertToRgba(uint8_t *pDest, const CImageInfo &SourceImage)
 {
 	if(SourceImage.m_Format == CImageInfo::FORMAT_RGBA)
@@ -10,43 +13,45 @@ bool ConvertToRgba(uint8_t *pDest, const CImageInfo &SourceImage)
 		mem_copy(pDest, SourceImage.m_pData, SourceImage.DataSize());
 		return true;
 	}
-	else
+
+	// one loop per format, so the compiler can vectorize them
+	const size_t NumPixels = SourceImage.m_Width * SourceImage.m_Height;
+	const uint8_t *pSrc = SourceImage.m_pData;
+	if(SourceImage.m_Format == CImageInfo::FORMAT_RGB)
 	{
-		const size_t SrcChannelCount = CImageInfo::PixelSize(SourceImage.m_Format);
-		const size_t DstChannelCount = CImageInfo::PixelSize(CImageInfo::FORMAT_RGBA);
-		for(size_t Y = 0; Y < SourceImage.m_Height; ++Y)
+		for(size_t i = 0; i < NumPixels; ++i)
 		{
-			for(size_t X = 0; X < SourceImage.m_Width; ++X)
-			{
-				size_t ImgOffsetSrc = (Y * SourceImage.m_Width * SrcChannelCount) + (X * SrcChannelCount);
-				size_t ImgOffsetDest = (Y * SourceImage.m_Width * DstChannelCount) + (X * DstChannelCount);
-				if(SourceImage.m_Format == CImageInfo::FORMAT_RGB)
-				{
-					mem_copy(&pDest[ImgOffsetDest], &SourceImage.m_pData[ImgOffsetSrc], SrcChannelCount);
-					pDest[ImgOffsetDest + 3] = 255;
-				}
-				else if(SourceImage.m_Format == CImageInfo::FORMAT_RA)
-				{
-					pDest[ImgOffsetDest + 0] = SourceImage.m_pData[ImgOffsetSrc];
-					pDest[ImgOffsetDest + 1] = SourceImage.m_pData[ImgOffsetSrc];
-					pDest[ImgOffsetDest + 2] = SourceImage.m_pData[ImgOffsetSrc];
-					pDest[ImgOffsetDest + 3] = SourceImage.m_pData[ImgOffsetSrc + 1];
-				}
-				else if(SourceImage.m_Format == CImageInfo::FORMAT_R)
-				{
-					pDest[ImgOffsetDest + 0] = 255;
-					pDest[ImgOffsetDest + 1] = 255;
-					pDest[ImgOffsetDest + 2] = 255;
-					pDest[ImgOffsetDest + 3] = SourceImage.m_pData[ImgOffsetSrc];
-				}
-				else
-				{
-					dbg_assert_failed("SourceImage.m_Format invalid");
-				}
-			}
+			pDest[i * 4 + 0] = pSrc[i * 3 + 0];
+			pDest[i * 4 + 1] = pSrc[i * 3 + 1];
+			pDest[i * 4 + 2] = pSrc[i * 3 + 2];
+			pDest[i * 4 + 3] = 255;
+		}
+	}
+	else if(SourceImage.m_Format == CImageInfo::FORMAT_RA)
+	{
+		for(size_t i = 0; i < NumPixels; ++i)
+		{
+			pDest[i * 4 + 0] = pSrc[i * 2];
+			pDest[i * 4 + 1] = pSrc[i * 2];
+			pDest[i * 4 + 2] = pSrc[i * 2];
+			pDest[i * 4 + 3] = pSrc[i * 2 + 1];
+		}
+	}
+	else if(SourceImage.m_Format == CImageInfo::FORMAT_R)
+	{
+		for(size_t i = 0; i < NumPixels; ++i)
+		{
+			pDest[i * 4 + 0] = 255;
+			pDest[i * 4 + 1] = 255;
+			pDest[i * 4 + 2] = 255;
+			pDest[i * 4 + 3] = pSrc[i];
 		}
-		return false;
 	}
+	else
+	{
+		dbg_assert_failed("SourceImage.m_Format invalid");
+	}
+	return false;
 }
 
 bool ConvertToRgbaAlloc(uint8_t *&pDest, const CImageInfo &SourceImage)
@@ -74,82 +79,75 @@ void ConvertToGrayscale(const CImageInfo &Image)
 		return;
 
 	const size_t Step = Image.PixelSize();
-	for(size_t i = 0; i < Image.m_Width * Image.m_Height; ++i)
+	const size_t NumPixels = Image.m_Width * Image.m_Height;
+	uint8_t *pData = Image.m_pData;
+	for(size_t i = 0; i < NumPixels; ++i)
 	{
-		const uint8_t R = Image.m_pData[i * Step];
-		const uint8_t G = Image.m_pData[i * Step + 1];
-		const uint8_t B = Image.m_pData[i * Step + 2];
-		const uint8_t Luma = (uint8_t)(0.2126f * R + 0.7152f * G + 0.0722f * B);
-
-		Image.m_pData[i * Step] = Luma;
-		Image.m_pData[i * Step + 1] = Luma;
-		Image.m_pData[i * Step + 2] = Luma;
+		uint8_t *pPixel = &pData[i * Step];
+		const uint8_t Luma = (uint8_t)(0.2126f * pPixel[0] + 0.7152f * pPixel[1] + 0.0722f * pPixel[2]);
+		pPixel[0] = Luma;
+		pPixel[1] = Luma;
+		pPixel[2] = Luma;
 	}
 }
 
 static constexpr int DILATE_BPP = 4; // RGBA assumed
 static constexpr uint8_t DILATE_ALPHA_THRESHOLD = 10;
 
-static void Dilate(int w, int h, const uint8_t *pSrc, uint8_t *pDest)
+// Gives transparent pixels the color of their first opaque neighbor (up, left, right, down).
+// Returns whether any pixel changed.
+static bool Dilate(int w, int h, const uint8_t *pSrc, uint8_t *pDest)
 {
-	const int aDirX[] = {0, -1, 1, 0};
-	const int aDirY[] = {-1, 0, 0, 1};
+	const size_t Pitch = (size_t)w * DILATE_BPP;
+	mem_copy(pDest, pSrc, Pitch * h);
 
-	int m = 0;
+	bool Changed = false;
 	for(int y = 0; y < h; y++)
 	{
-		for(int x = 0; x < w; x++, m += DILATE_BPP)
+		// neighbors outside of the image are clamped to the pixel itself, which is transparent
+		const uint8_t *pRow = &pSrc[y * Pitch];
+		const uint8_t *pRowAbove = y > 0 ? pRow - Pitch : pRow;
+		const uint8_t *pRowBelow = y < h - 1 ? pRow + Pitch : pRow;
+		uint8_t *pDestRow = &pDest[y * Pitch];
+		for(int x = 0; x < w; x++)
 		{
-			for(int i = 0; i < DILATE_BPP; ++i)
-				pDest[m + i] = pSrc[m + i];
-			if(pSrc[m + DILATE_BPP - 1] > DILATE_ALPHA_THRESHOLD)
+			const size_t m = (size_t)x * DILATE_BPP;
+			if(pRow[m + DILATE_BPP - 1] > DILATE_ALPHA_THRESHOLD)
 				continue;
 
-			// --- Implementation Note ---
-			// The sum and counter variable can be used to compute a smoother dilated image.
-			// In this reference implementation, the loop breaks as soon as Counter == 1.
-			// We break the loop here to match the selection of the previously used algorithm.
-			int aSumOfOpaque[] = {0, 0, 0};
-			int Counter = 0;
-			for(int c = 0; c < 4; c++)
-			{
-				const int ClampedX = std::clamp(x + aDirX[c], 0, w - 1);
-				const int ClampedY = std::clamp(y + aDirY[c], 0, h - 1);
-				const int SrcIndex = ClampedY * w * DILATE_BPP + ClampedX * DILATE_BPP;
-				if(pSrc[SrcIndex + DILATE_BPP - 1] > DILATE_ALPHA_THRESHOLD)
-				{
-					for(int p = 0; p < DILATE_BPP - 1; ++p)
-						aSumOfOpaque[p] += pSrc[SrcIndex + p];
-					++Counter;
-					break;
-				}
-			}
-
-			if(Counter > 0)
-			{
-				for(int i = 0; i < DILATE_BPP - 1; ++i)
-				{
-					aSumOfOpaque[i] /= Counter;
-					pDest[m + i] = (uint8_t)aSumOfOpaque[i];
-				}
+			const size_t Left = x > 0 ? m - DILATE_BPP : m;
+			const size_t Right = x < w - 1 ? m + DILATE_BPP : m;
+			const uint8_t *pOpaque;
+			if(pRowAbove[m + DILATE_BPP - 1] > DILATE_ALPHA_THRESHOLD)
+				pOpaque = &pRowAbove[m];
+			else if(pRow[Left + DILATE_BPP - 1] > DILATE_ALPHA_THRESHOLD)
+				pOpaque = &pRow[Left];
+			else if(pRow[Right + DILATE_BPP - 1] > DILATE_ALPHA_THRESHOLD)
+				pOpaque = &pRow[Right];
+			else if(pRowBelow[m + DILATE_BPP - 1] > DILATE_ALPHA_THRESHOLD)
+				pOpaque = &pRowBelow[m];
+			else
+				continue;
 
-				pDest[m + DILATE_BPP - 1] = 255;
-			}
+			for(int i = 0; i < DILATE_BPP - 1; ++i)
+				pDestRow[m + i] = pOpaque[i];
+			pDestRow[m + DILATE_BPP - 1] = 255;
+			Changed = true;
 		}
 	}
+	return Changed;
 }
 
 static void CopyColorValues(int w, int h, const uint8_t *pSrc, uint8_t *pDest)
 {
-	int m = 0;
-	for(int y = 0; y < h; y++)
+	const size_t NumPixels = (size_t)w * h;
+	for(size_t i = 0; i < NumPixels; i++)
 	{
-		for(int x = 0; x < w; x++, m += DILATE_BPP)
+		const size_t m = i * DILATE_BPP;
+		if(pDest[m + DILATE_BPP - 1] == 0)
 		{
-			if(pDest[m + DILATE_BPP - 1] == 0)
-			{
-				mem_copy(&pDest[m], &pSrc[m], DILATE_BPP - 1);
-			}
+			for(int c = 0; c < DILATE_BPP - 1; ++c)
+				pDest[m + c] = pSrc[m + c];
 		}
 	}
 }
@@ -182,12 +180,12 @@ void DilateImageSub(uint8_t *pImageBuff, int w, int h, int x, int y, int SubWidt
 		mem_copy(&pBufferOriginal[DstImgOffset], &pImageBuff[SrcImgOffset], CopySize);
 	}
 
-	Dilate(SubWidth, SubHeight, pBufferOriginal, apBuffer[0]);
-
-	for(int i = 0; i < 5; i++)
+	// 11 passes, once a pass changes nothing the remaining ones would not either
+	bool Changed = Dilate(SubWidth, SubHeight, pBufferOriginal, apBuffer[0]);
+	for(int i = 0; i < 10 && Changed; i++)
 	{
-		Dilate(SubWidth, SubHeight, apBuffer[0], apBuffer[1]);
-		Dilate(SubWidth, SubHeight, apBuffer[1], apBuffer[0]);
+		Changed = Dilate(SubWidth, SubHeight, apBuffer[0], apBuffer[1]);
+		std::swap(apBuffer[0], apBuffer[1]);
 	}
 
 	CopyColorValues(SubWidth, SubHeight, apBuffer[0], pBufferOriginal);
@@ -216,55 +214,60 @@ static float CubicHermite(float A, float B, float C, float D, float t)
 	return (a * t * t * t) + (b * t * t) + (c * t) + d;
 }
 
-static void GetPixelClamped(const uint8_t *pSourceImage, int x, int y, uint32_t W, uint32_t H, size_t BPP, uint8_t aSample[4])
+// Clamped source indices and fraction of the bicubic samples along one axis
+struct SBicubicAxis
 {
-	x = std::clamp<int>(x, 0, (int)W - 1);
-	y = std::clamp<int>(y, 0, (int)H - 1);
+	size_t m_aIndices[4];
+	float m_Fraction;
+};
 
-	mem_copy(aSample, &pSourceImage[x * BPP + (W * BPP * y)], BPP);
-}
-
-static void SampleBicubic(const uint8_t *pSourceImage, float u, float v, uint32_t W, uint32_t H, size_t BPP, uint8_t aSample[4])
+static void BicubicAxis(uint32_t Size, uint32_t NewSize, std::vector<SBicubicAxis> &vAxis)
 {
-	float X = (u * W) - 0.5f;
-	const int RoundedX = (int)X;
-	const float FractionX = X - std::floor(X);
-
-	float Y = (v * H) - 0.5f;
-	const int RoundedY = (int)Y;
-	const float FractionY = Y - std::floor(Y);
-
-	uint8_t aaaSamples[4][4][4];
-	for(int y = 0; y < 4; ++y)
+	vAxis.resize(NewSize);
+	for(int i = 0; i < (int)NewSize; ++i)
 	{
-		for(int x = 0; x < 4; ++x)
-		{
-			GetPixelClamped(pSourceImage, RoundedX + x - 1, RoundedY + y - 1, W, H, BPP, aaaSamples[x][y]);
-		}
-	}
-
-	for(size_t i = 0; i < BPP; i++)
-	{
-		float aRows[4];
-		for(int y = 0; y < 4; ++y)
-		{
-			aRows[y] = CubicHermite(aaaSamples[0][y][i], aaaSamples[1][y][i], aaaSamples[2][y][i], aaaSamples[3][y][i], FractionX);
-		}
-		aSample[i] = (uint8_t)std::clamp<float>(CubicHermite(aRows[0], aRows[1], aRows[2], aRows[3], FractionY), 0.0f, 255.0f);
+		const float Position = ((float)i / (float)(NewSize - 1) * Size) - 0.5f;
+		const int Rounded = (int)Position;
+		vAxis[i].m_Fraction = Position - std::floor(Position);
+		for(int k = 0; k < 4; ++k)
+			vAxis[i].m_aIndices[k] = std::clamp<int>(Rounded + k - 1, 0, (int)Size - 1);
 	}
 }
 
 static void ResizeImage(const uint8_t *pSourceImage, uint32_t SW, uint32_t SH, uint8_t *pDestinationImage, uint32_t W, uint32_t H, size_t BPP)
 {
-	for(int y = 0; y < (int)H; ++y)
+	// the sample positions only depend on the column and the row
+	std::vector<SBicubicAxis> vColumns;
+	std::vector<SBicubicAxis> vRows;
+	BicubicAxis(SW, W, vColumns);
+	BicubicAxis(SH, H, vRows);
+
+	for(uint32_t y = 0; y < H; ++y)
 	{
-		float v = (float)y / (float)(H - 1);
-		for(int x = 0; x < (int)W; ++x)
+		const SBicubicAxis &Row = vRows[y];
+		const uint8_t *apSourceRows[4];
+		for(int k = 0; k < 4; ++k)
+			apSourceRows[k] = &pSourceImage[Row.m_aIndices[k] * SW * BPP];
+
+		uint8_t *pDestinationRow = &pDestinationImage[(size_t)W * BPP * y];
+		for(uint32_t x = 0; x < W; ++x)
 		{
-			float u = (float)x / (float)(W - 1);
-			uint8_t aSample[4];
-			SampleBicubic(pSourceImage, u, v, SW, SH, BPP, aSample);
-			mem_copy(&pDestinationImage[x * BPP + ((W * BPP) * y)], aSample, BPP);
+			const SBicubicAxis &Column = vColumns[x];
+			for(size_t i = 0; i < BPP; i++)
+			{
+				float aRows[4];
+				for(int k = 0; k < 4; ++k)
+				{
+					const uint8_t *pSourceRow = apSourceRows[k];
+					aRows[k] = CubicHermite(
+						pSourceRow[Column.m_aIndices[0] * BPP + i],
+						pSourceRow[Column.m_aIndices[1] * BPP + i],
+						pSourceRow[Column.m_aIndices[2] * BPP + i],
+						pSourceRow[Column.m_aIndices[3] * BPP + i],
+						Column.m_Fraction);
+				}
+				pDestinationRow[x * BPP + i] = (uint8_t)std::clamp<float>(CubicHermite(aRows[0], aRows[1], aRows[2], aRows[3], Row.m_Fraction), 0.0f, 255.0f);
+			}
 		}
 	}
 }
@@ -281,6 +281,21 @@ public:
 	virtual uint64_t StreamedMemoryUsage() const = 0;
 	virtual uint64_t StagingMemoryUsage() const = 0;
 
+	/**
+	 * Commands and data submitted to the backend during one frame.
+	 */
+	struct SCommandBufferStats
+	{
+		size_t m_NumCommands = 0;
+		size_t m_NumRenderCalls = 0;
+		size_t m_CommandSize = 0;
+		size_t m_DataSize = 0;
+	};
+	/**
+	 * Returns the command buffer statistics of the last frame that was completed with @link Swap @endlink.
+	 */
+	virtual SCommandBufferStats LastFrameCommandBufferStats() const = 0;
+
 	virtual const TTwGraphicsGpuList &GetGpus() const = 0;
 
 	virtual bool LoadPng(CImageInfo &Image, const char *pFilename, int StorageType) = 0;
@@ -293,6 +308,8 @@ public:
 	virtual CTextureHandle LoadTextureRaw(const CImageInfo &Image, int Flags, const char *pTexName = nullptr) = 0;
 	virtual CTextureHandle LoadTextureRawMove(CImageInfo &Image, int Flags, const char *pTexName = nullptr) = 0;
 	virtual CTextureHandle LoadTexture(const char *pFilename, int StorageType, int Flags = 0) = 0;
+	// the texture that is used in place of textures that failed to load
+	virtual CTextureHandle NullTexture() const = 0;
 	virtual void TextureSet(CTextureHandle Texture) = 0;
 	void TextureClear() { TextureSet(CTextureHandle()); }
 
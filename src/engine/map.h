@@ -36,7 +36,16 @@ class IEngineMap : public IMap
 {
 	MACRO_INTERFACE("enginemap")
 public:
-	[[nodiscard]] virtual bool Load(const char *pMapName) = 0;
+	// Preload: decompress all data right away and in parallel
+	[[nodiscard]] virtual bool Load(const char *pMapName, bool MemoryMapped = false, bool Preload = false) = 0;
+	// Loads the map from the contents of its file, which must stay valid until
+	// the map is unloaded. Does not need the kernel, so a separate map can be
+	// loaded on another thread and then moved into this one with Replace.
+	// Preload decompresses all data, without using other threads.
+	[[nodiscard]] virtual bool LoadMemory(const char *pName, const void *pData, int64_t DataSize, bool Preload = false) = 0;
+	virtual void Replace(IEngineMap *pMap) = 0;
+	// decompresses the data of the game, front, tele, speedup, switch and tune layers
+	virtual void PreloadGameLayers() = 0;
 	virtual void Unload() = 0;
 	virtual bool IsLoaded() const = 0;
 	virtual IOHANDLE File() const = 0;
@@ -20,6 +20,7 @@
 #include <array>
 #include <optional>
 #include <type_traits>
+#include <vector>
 
 struct CAntibotRoundData;
 
@@ -295,6 +296,9 @@ public:
 	virtual const char *GetMapName() const = 0;
 
 	virtual bool IsSixup(int ClientId) const = 0;
+
+	// timings of the tick phases, the sections don't take time while it is disabled
+	virtual class CTickProfiler *TickProfiler() = 0;
 };
 
 class IGameServer : public IInterface
@@ -306,8 +310,9 @@ public:
 	// is instantiated.
 	virtual void OnInit(const void *pPersistentData) = 0;
 	virtual void OnConsoleInit() = 0;
-	// Returns `true` if map change accepted.
-	[[nodiscard]] virtual bool OnMapChange(char *pNewMapName, int MapNameSize) = 0;
+	// Called before a map is loaded. Returns `true` if the settings of the
+	// map are to be replaced by the ones filled into `pvSettings`.
+	virtual bool OnMapChange(std::vector<char> *pvSettings) = 0;
 	// `pPersistentData` may be null if this is the last time `IGameServer`
 	// is destroyed.
 	virtual void OnShutdown(void *pPersistentData) = 0;
@@ -51,6 +51,17 @@ public:
 	// has to be called to return the connection back to the pool
 	virtual void Disconnect() = 0;
 
+	// executes a statement without parameters and results, used to group
+	// several writes into one transaction
+	//
+	// returns true on success
+	virtual bool Execute(const char *pStmt, char *pError, int ErrorSize) = 0;
+	// starts a transaction that already holds the write lock, so that
+	// statements reading before writing don't fail on upgrading it
+	//
+	// returns true on success
+	virtual bool BeginTransaction(char *pError, int ErrorSize) = 0;
+
 	// ? for Placeholders, connection has to be established, can overwrite previous prepared statements
 	//
 	// returns true on success
@@ -2,15 +2,20 @@
 
 #include "connection.h"
 
+#include <base/lock.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
 
 #include <engine/console.h>
 #include <engine/shared/config.h>
 
+#include <algorithm>
 #include <chrono>
+#include <condition_variable>
 #include <cstring>
-#include <iterator>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 
@@ -67,6 +72,11 @@ struct CSqlExecData
 
 	std::unique_ptr<const ISqlData> m_pThreadData;
 	const char *m_pName;
+	// for the log and the queue statistics, set when the query is queued
+	int m_JobNum = 0;
+	int64_t m_QueueTime = 0;
+	// a read waits until the writes queued before it are done
+	int64_t m_WritesBefore = 0;
 };
 
 CSqlExecData::CSqlExecData(
@@ -120,25 +130,222 @@ CSqlExecData::CSqlExecData(IConsole *pConsole, CDbConnectionPool::Mode m) :
 	m_Ptr.m_Print.m_Mode = m;
 }
 
+// fifo of queries between the main thread and the database threads
+class CSqlQueue
+{
+public:
+	void Push(std::unique_ptr<CSqlExecData> pData)
+	{
+		{
+			const CLockScope LockScope(m_Lock);
+			m_vpQueries.push_back(std::move(pData));
+		}
+		{
+			std::unique_lock WaitLock(m_WaitMutex);
+			m_NumQueries.Signal();
+		}
+		m_WaitCondition.notify_all();
+	}
+	// blocks until there is a query, nullptr tells the thread to exit
+	std::unique_ptr<CSqlExecData> Pop()
+	{
+		m_NumQueries.Wait();
+		const CLockScope LockScope(m_Lock);
+		std::unique_ptr<CSqlExecData> pData = std::move(m_vpQueries.front());
+		m_vpQueries.pop_front();
+		return pData;
+	}
+	// doesn't block, only for queues with a single thread taking queries
+	bool TryPop(std::unique_ptr<CSqlExecData> *ppData)
+	{
+		if(m_NumQueries.GetApproximateValue() <= 0)
+			return false;
+		*ppData = Pop();
+		return true;
+	}
+	// like TryPop, but waits for a query until Deadline (see time_get_nanoseconds)
+	bool TryPopUntil(std::unique_ptr<CSqlExecData> *ppData, std::chrono::nanoseconds Deadline)
+	{
+		{
+			std::unique_lock WaitLock(m_WaitMutex);
+			if(!m_WaitCondition.wait_for(WaitLock, Deadline - time_get_nanoseconds(), [this]() { return m_NumQueries.GetApproximateValue() > 0; }))
+				return false;
+		}
+		*ppData = Pop();
+		return true;
+	}
+	int Size() { return m_NumQueries.GetApproximateValue(); }
+
+	// times in nanoseconds, waiting is from queueing to the start of the query
+	void AddStats(int64_t Wait, int64_t Run)
+	{
+		const CLockScope LockScope(m_Lock);
+		m_NumDone++;
+		m_WaitSum += Wait;
+		m_MaxWait = std::max(m_MaxWait, Wait);
+		m_RunSum += Run;
+		m_MaxRun = std::max(m_MaxRun, Run);
+	}
+	void AddBatch(int Size)
+	{
+		const CLockScope LockScope(m_Lock);
+		m_NumBatches++;
+		m_MaxBatch = std::max(m_MaxBatch, Size);
+	}
+	void PrintStats(IConsole *pConsole, const char *pName, int Queued)
+	{
+		const CLockScope LockScope(m_Lock);
+		const int64_t NumDone = std::max(m_NumDone, (int64_t)1);
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "%s: %d queued, %" PRId64 " done, wait avg %.2fms max %.2fms, run avg %.2fms max %.2fms",
+			pName, Queued, m_NumDone, m_WaitSum / NumDone / 1e6, m_MaxWait / 1e6, m_RunSum / NumDone / 1e6, m_MaxRun / 1e6);
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+		if(m_NumBatches > 0)
+		{
+			str_format(aBuf, sizeof(aBuf), "%s: %" PRId64 " transactions, %.2f queries per transaction avg, %d max",
+				pName, m_NumBatches, (double)m_NumDone / m_NumBatches, m_MaxBatch);
+			pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+		}
+	}
+
+private:
+	CLock m_Lock;
+	std::deque<std::unique_ptr<CSqlExecData>> m_vpQueries GUARDED_BY(m_Lock);
+	CSemaphore m_NumQueries;
+	// lets TryPopUntil wait for Push
+	std::mutex m_WaitMutex;
+	std::condition_variable m_WaitCondition;
+
+	int64_t m_NumDone GUARDED_BY(m_Lock) = 0;
+	int64_t m_WaitSum GUARDED_BY(m_Lock) = 0;
+	int64_t m_MaxWait GUARDED_BY(m_Lock) = 0;
+	int64_t m_RunSum GUARDED_BY(m_Lock) = 0;
+	int64_t m_MaxRun GUARDED_BY(m_Lock) = 0;
+	int64_t m_NumBatches GUARDED_BY(m_Lock) = 0;
+	int m_MaxBatch GUARDED_BY(m_Lock) = 0;
+};
+
+enum
+{
+	MAX_WRITE_BATCH = 64,
+};
+
+// a batch ends early once no further write arrives for this long
+static constexpr std::chrono::nanoseconds WRITE_BATCH_GAP = 2ms;
+
+// Takes the writes that follow the first one of a batch from the queue,
+// waiting up to Window nanoseconds in total for more of them, but at most
+// WRITE_BATCH_GAP for each. Stops at the first query that isn't a write,
+// which is returned in ppNext. Returns false if the thread should exit
+// after the batch.
+static bool CollectWrites(CSqlQueue *pQueue, const std::atomic_bool &Shutdown, std::chrono::nanoseconds Window, std::vector<std::unique_ptr<CSqlExecData>> *pvpBatch, std::unique_ptr<CSqlExecData> *ppNext)
+{
+	const std::chrono::nanoseconds Deadline = time_get_nanoseconds() + Window;
+	while(pvpBatch->size() < MAX_WRITE_BATCH)
+	{
+		std::unique_ptr<CSqlExecData> pData;
+		const std::chrono::nanoseconds WaitUntil = Shutdown ? 0ns : std::min(Deadline, time_get_nanoseconds() + WRITE_BATCH_GAP);
+		if(!pQueue->TryPopUntil(&pData, WaitUntil))
+			return true;
+		if(pData == nullptr)
+			return false;
+		if(pData->m_Mode != CSqlExecData::WRITE_ACCESS)
+		{
+			*ppNext = std::move(pData);
+			return true;
+		}
+		pvpBatch->push_back(std::move(pData));
+	}
+	return true;
+}
+
+struct CDbConnectionPool::CSharedData
+{
+	// Used as signal that shutdown is in progress from main thread to
+	// speed up the queries by discarding read queries and writing to
+	// the sqlite file instead of the remote mysql server.
+	std::atomic_bool m_Shutdown{false};
+	// The threads decrement this when they processed all their queries.
+	std::atomic_int m_NumRunning{0};
+
+	// Write queries go to the backup thread first, it passes them on to the
+	// write worker after storing them in the backup database.
+	CSqlQueue m_BackupQueue;
+	CSqlQueue m_WriteQueue;
+	CSqlQueue m_ReadQueue;
+
+	// Every thread creates its own connections to the registered databases.
+	CLock m_DatabasesLock;
+	std::vector<std::unique_ptr<CSqlExecData>> m_vpDatabases GUARDED_BY(m_DatabasesLock);
+
+	// Reads are held back here until the writes queued before them are
+	// done, so they see e.g. the finish of the requesting player like with
+	// a single queue.
+	CLock m_WritesLock;
+	int64_t m_NumWritesDone GUARDED_BY(m_WritesLock) = 0;
+	std::vector<std::unique_ptr<CSqlExecData>> m_vpWaitingReads GUARDED_BY(m_WritesLock);
+	// the write worker stops the read workers after passing on the last reads
+	std::atomic_int m_NumReadWorkers{0};
+
+	void QueueRead(std::unique_ptr<CSqlExecData> pData) REQUIRES(!m_WritesLock);
+	// passes on the reads that waited for these writes
+	void FinishWrites(int64_t Num) REQUIRES(!m_WritesLock);
+};
+
+void CDbConnectionPool::CSharedData::QueueRead(std::unique_ptr<CSqlExecData> pData)
+{
+	const CLockScope LockScope(m_WritesLock);
+	if(pData->m_WritesBefore <= m_NumWritesDone)
+		m_ReadQueue.Push(std::move(pData));
+	else
+		m_vpWaitingReads.push_back(std::move(pData));
+}
+
+void CDbConnectionPool::CSharedData::FinishWrites(int64_t Num)
+{
+	const CLockScope LockScope(m_WritesLock);
+	m_NumWritesDone += Num;
+	// reads are queued in order, the ones that can run now come first
+	auto It = m_vpWaitingReads.begin();
+	for(; It != m_vpWaitingReads.end() && (*It)->m_WritesBefore <= m_NumWritesDone; ++It)
+		m_ReadQueue.Push(std::move(*It));
+	m_vpWaitingReads.erase(m_vpWaitingReads.begin(), It);
+}
+
 void CDbConnectionPool::Print(IConsole *pConsole, Mode DatabaseMode)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pConsole, DatabaseMode);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	auto pData = std::make_unique<CSqlExecData>(pConsole, DatabaseMode);
+	pData->m_JobNum = m_NextJobNum++;
+	if(DatabaseMode == Mode::READ)
+	{
+		StartReadWorkers();
+		m_pShared->m_ReadQueue.Push(std::move(pData));
+	}
+	else
+	{
+		m_pShared->m_BackupQueue.Push(std::move(pData));
+	}
+}
+
+void CDbConnectionPool::PrintStats(IConsole *pConsole)
+{
+	char aBuf[128];
+	str_format(aBuf, sizeof(aBuf), "%d read workers, 1 write worker", (int)m_vpReadWorkerThreads.size());
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	m_pShared->m_ReadQueue.PrintStats(pConsole, "read", m_pShared->m_ReadQueue.Size());
+	m_pShared->m_WriteQueue.PrintStats(pConsole, "write", m_pShared->m_BackupQueue.Size() + m_pShared->m_WriteQueue.Size());
 }
 
 void CDbConnectionPool::RegisterSqliteDatabase(Mode DatabaseMode, const char aFilename[64])
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, aFilename);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	const CLockScope LockScope(m_pShared->m_DatabasesLock);
+	m_pShared->m_vpDatabases.push_back(std::make_unique<CSqlExecData>(DatabaseMode, aFilename));
 }
 
 void CDbConnectionPool::RegisterMysqlDatabase(Mode DatabaseMode, const CMysqlConfig *pMysqlConfig)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	const CLockScope LockScope(m_pShared->m_DatabasesLock);
+	m_pShared->m_vpDatabases.push_back(std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig));
 }
 
 void CDbConnectionPool::Execute(
@@ -146,9 +353,12 @@ void CDbConnectionPool::Execute(
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	StartReadWorkers();
+	auto pData = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
+	pData->m_JobNum = m_NextJobNum++;
+	pData->m_QueueTime = time_get_nanoseconds().count();
+	pData->m_WritesBefore = m_NumWritesQueued;
+	m_pShared->QueueRead(std::move(pData));
 }
 
 void CDbConnectionPool::ExecuteWrite(
@@ -156,9 +366,11 @@ void CDbConnectionPool::ExecuteWrite(
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	auto pData = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
+	pData->m_JobNum = m_NextJobNum++;
+	pData->m_QueueTime = time_get_nanoseconds().count();
+	m_NumWritesQueued++;
+	m_pShared->m_BackupQueue.Push(std::move(pData));
 }
 
 void CDbConnectionPool::OnShutdown()
@@ -167,9 +379,10 @@ void CDbConnectionPool::OnShutdown()
 		return;
 	m_Shutdown = true;
 	m_pShared->m_Shutdown.store(true);
-	m_pShared->m_NumBackup.Signal();
+	// the write worker stops the read workers once it is done
+	m_pShared->m_BackupQueue.Push(nullptr);
 	int i = 0;
-	while(m_pShared->m_Shutdown.load())
+	while(m_pShared->m_NumRunning.load() > 0)
 	{
 		// print a log about every two seconds
 		if(i % 20 == 0 && i > 0)
@@ -181,16 +394,66 @@ void CDbConnectionPool::OnShutdown()
 	}
 }
 
+// The connections of one database thread to the registered databases of
+// the given modes.
+class CConnections
+{
+public:
+	CConnections(std::shared_ptr<CDbConnectionPool::CSharedData> pShared, unsigned Modes) :
+		m_pShared(std::move(pShared)), m_Modes(Modes) {}
+
+	// connects to the databases registered since the last call
+	void Update();
+
+	std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
+	std::unique_ptr<IDbConnection> m_pWriteConnection;
+	std::unique_ptr<IDbConnection> m_pWriteBackup;
+
+private:
+	std::shared_ptr<CDbConnectionPool::CSharedData> m_pShared;
+	unsigned m_Modes;
+	size_t m_NumDatabases = 0;
+};
+
+void CConnections::Update()
+{
+	const CLockScope LockScope(m_pShared->m_DatabasesLock);
+	for(; m_NumDatabases < m_pShared->m_vpDatabases.size(); m_NumDatabases++)
+	{
+		const CSqlExecData *pData = m_pShared->m_vpDatabases[m_NumDatabases].get();
+		const bool Mysql = pData->m_Mode == CSqlExecData::ADD_MYSQL;
+		const CDbConnectionPool::Mode Mode = Mysql ? pData->m_Ptr.m_Mysql.m_Mode : pData->m_Ptr.m_Sqlite.m_Mode;
+		if(!(m_Modes & (1 << Mode)))
+			continue;
+
+		auto pConnection = Mysql ? CreateMysqlConnection(pData->m_Ptr.m_Mysql.m_Config) : CreateSqliteConnection(pData->m_Ptr.m_Sqlite.m_Filename, true);
+		switch(Mode)
+		{
+		case CDbConnectionPool::Mode::READ:
+			m_vpReadConnections.push_back(std::move(pConnection));
+			break;
+		case CDbConnectionPool::Mode::WRITE:
+			m_pWriteConnection = std::move(pConnection);
+			break;
+		case CDbConnectionPool::Mode::WRITE_BACKUP:
+			m_pWriteBackup = std::move(pConnection);
+			break;
+		case CDbConnectionPool::Mode::NUM_MODES:
+			break;
+		}
+	}
+}
+
 // The backup worker thread looks at write queries and stores them
-// in the sqlite database (WRITE_BACKUP). It skips over read queries.
-// After processing the query, it gets passed on to the Worker thread.
+// in the sqlite database (WRITE_BACKUP).
+// After processing the query, it gets passed on to the write worker thread.
 // This is done to not loose ranks when the server shuts down before all
 // queries are executed on the mysql server
 class CBackup
 {
 public:
 	CBackup(std::shared_ptr<CDbConnectionPool::CSharedData> pShared, int DebugSql) :
-		m_DebugSql(DebugSql), m_pShared(std::move(pShared)) {}
+		m_DebugSql(DebugSql), m_Connections(pShared, 1 << CDbConnectionPool::Mode::WRITE_BACKUP), m_pShared(std::move(pShared)) {}
 	static void Start(void *pUser);
 
 private:
@@ -198,7 +461,7 @@ private:
 
 	void ProcessQueries();
 
-	std::unique_ptr<IDbConnection> m_pWriteBackup;
+	CConnections m_Connections;
 
 	std::shared_ptr<CDbConnectionPool::CSharedData> m_pShared;
 };
@@ -213,49 +476,74 @@ void CBackup::Start(void *pUser)
 
 void CBackup::ProcessQueries()
 {
-	for(int JobNum = 0;; JobNum++)
+	std::unique_ptr<CSqlExecData> pNext;
+	bool Exit = false;
+	while(!Exit)
 	{
-		m_pShared->m_NumBackup.Wait();
-		CSqlExecData *pThreadData = m_pShared->m_aQueries[JobNum % std::size(m_pShared->m_aQueries)].get();
+		std::unique_ptr<CSqlExecData> pThreadData = pNext ? std::move(pNext) : m_pShared->m_BackupQueue.Pop();
 
 		// work through all database jobs after OnShutdown is called before exiting the thread
 		if(pThreadData == nullptr)
-		{
-			m_pShared->m_NumWorker.Signal();
-			return;
-		}
+			break;
 
-		if(pThreadData->m_Mode == CSqlExecData::ADD_SQLITE &&
-			pThreadData->m_Ptr.m_Sqlite.m_Mode == CDbConnectionPool::Mode::WRITE_BACKUP)
+		if(pThreadData->m_Mode != CSqlExecData::WRITE_ACCESS)
 		{
-			m_pWriteBackup = CreateSqliteConnection(pThreadData->m_Ptr.m_Sqlite.m_Filename, true);
+			m_pShared->m_WriteQueue.Push(std::move(pThreadData));
+			continue;
 		}
-		else if(pThreadData->m_Mode == CSqlExecData::WRITE_ACCESS && m_pWriteBackup.get())
+
+		// only combine the writes that are already queued, the write worker
+		// waits for more
+		std::vector<std::unique_ptr<CSqlExecData>> vpBatch;
+		vpBatch.push_back(std::move(pThreadData));
+		Exit = !CollectWrites(&m_pShared->m_BackupQueue, m_pShared->m_Shutdown, 0ns, &vpBatch, &pNext);
+
+		m_Connections.Update();
+		if(m_Connections.m_pWriteBackup)
 		{
-			bool Success = CDbConnectionPool::ExecSqlFunc(m_pWriteBackup.get(), pThreadData, Write::BACKUP_FIRST);
-			if(m_DebugSql || !Success)
-				dbg_msg("sql", "[%i] %s done on write backup database, Success=%i", JobNum, pThreadData->m_pName, Success);
+			const int Num = vpBatch.size();
+			std::vector<CSqlExecData *> vpData;
+			for(auto &pData : vpBatch)
+				vpData.push_back(pData.get());
+			std::vector<Write> vModes(Num, Write::BACKUP_FIRST);
+			std::unique_ptr<bool[]> pSuccess(new bool[Num]);
+			CDbConnectionPool::ExecSqlBatch(m_Connections.m_pWriteBackup.get(), vpData.data(), vModes.data(), pSuccess.get(), Num);
+			for(int i = 0; i < Num; i++)
+			{
+				if(m_DebugSql || !pSuccess[i])
+					dbg_msg("sql", "[%i] %s done on write backup database, Success=%i", vpData[i]->m_JobNum, vpData[i]->m_pName, pSuccess[i]);
+			}
 		}
-		m_pShared->m_NumWorker.Signal();
+		for(auto &pData : vpBatch)
+			m_pShared->m_WriteQueue.Push(std::move(pData));
 	}
+	m_pShared->m_WriteQueue.Push(nullptr);
+	m_pShared->m_NumRunning.fetch_sub(1);
 }
 
-// the worker threads executes queries on mysql or sqlite. If we write on
-// a mysql server and have a backup server configured, we'll remove the
-// entry from the backup server after completing it on the write server.
-// static void Worker(void *pUser);
+// The worker threads execute queries on mysql or sqlite. There is one for
+// the write queue and several for the read queue. If we write on a mysql
+// server and have a backup server configured, we'll remove the entry from
+// the backup server after completing it on the write server.
 class CWorker
 {
 public:
-	CWorker(std::shared_ptr<CDbConnectionPool::CSharedData> pShared, int DebugSql) :
-		m_DebugSql(DebugSql), m_pShared(std::move(pShared)) {}
+	CWorker(std::shared_ptr<CDbConnectionPool::CSharedData> pShared, CSqlQueue *pQueue, unsigned Modes, int DebugSql) :
+		m_DebugSql(DebugSql), m_pQueue(pQueue), m_Connections(pShared, Modes), m_pShared(std::move(pShared)) {}
 	static void Start(void *pUser);
 	void ProcessQueries();
 
 private:
+	void ProcessWrites(std::vector<std::unique_ptr<CSqlExecData>> &vpBatch, int64_t StartTime);
+	// reports the result of a query back to the main thread
+	void Finish(CSqlExecData *pData, bool Success, int64_t StartTime);
 	void Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode);
 
 	bool m_DebugSql;
+	CSqlQueue *m_pQueue;
+	// enter fail mode when a sql request fails, skip read request during it and
+	// write to the backup database until all requests are handled
+	bool m_FailMode = false;
 
 	// There are two possible configurations
 	//  * sqlite mode: There exists exactly one READ and the same WRITE server
@@ -264,10 +552,7 @@ private:
 	//                most one WRITE server. The WRITE server for all DDNet
 	//                Servers must be the same (to counteract double loads).
 	//                There may be one WRITE_BACKUP sqlite server.
-	// This variable should only change, before the worker threads
-	std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
-	std::unique_ptr<IDbConnection> m_pWriteConnection;
-	std::unique_ptr<IDbConnection> m_pWriteBackup;
+	CConnections m_Connections;
 
 	std::shared_ptr<CDbConnectionPool::CSharedData> m_pShared;
 };
@@ -284,42 +569,53 @@ void CWorker::ProcessQueries()
 {
 	// remember last working server and try to connect to it first
 	int ReadServer = 0;
-	// enter fail mode when a sql request fails, skip read request during it and
-	// write to the backup database until all requests are handled
-	bool FailMode = false;
-	for(int JobNum = 0;; JobNum++)
+	// a query that ended a batch of writes, processed after it
+	std::unique_ptr<CSqlExecData> pNext;
+	bool Exit = false;
+	while(!Exit)
 	{
-		if(FailMode && m_pShared->m_NumWorker.GetApproximateValue() == 0)
+		if(m_FailMode && m_pQueue->Size() == 0 && !pNext)
 		{
-			FailMode = false;
+			m_FailMode = false;
 		}
-		m_pShared->m_NumWorker.Wait();
-		auto pThreadData = std::move(m_pShared->m_aQueries[JobNum % std::size(m_pShared->m_aQueries)]);
+		std::unique_ptr<CSqlExecData> pThreadData = pNext ? std::move(pNext) : m_pQueue->Pop();
 		// work through all database jobs after OnShutdown is called before exiting the thread
 		if(pThreadData == nullptr)
+			break;
+		m_Connections.Update();
+		const int64_t StartTime = time_get_nanoseconds().count();
+
+		if(pThreadData->m_Mode == CSqlExecData::WRITE_ACCESS)
 		{
-			m_pShared->m_Shutdown.store(false);
-			return;
+			std::vector<std::unique_ptr<CSqlExecData>> vpBatch;
+			vpBatch.push_back(std::move(pThreadData));
+			const std::chrono::nanoseconds Window = m_pShared->m_Shutdown ? 0ns : std::chrono::milliseconds(g_Config.m_SvSqlWriteBatchWindow);
+			Exit = !CollectWrites(m_pQueue, m_pShared->m_Shutdown, Window, &vpBatch, &pNext);
+			ProcessWrites(vpBatch, StartTime);
+			continue;
 		}
+
+		std::vector<std::unique_ptr<IDbConnection>> &vpReadConnections = m_Connections.m_vpReadConnections;
+		const int JobNum = pThreadData->m_JobNum;
 		bool Success = false;
 		switch(pThreadData->m_Mode)
 		{
 		case CSqlExecData::READ_ACCESS:
 		{
-			for(size_t i = 0; i < m_vpReadConnections.size(); i++)
+			for(size_t i = 0; i < vpReadConnections.size(); i++)
 			{
 				if(m_pShared->m_Shutdown)
 				{
 					dbg_msg("sql", "[%i] %s dismissed read request during shutdown", JobNum, pThreadData->m_pName);
 					break;
 				}
-				if(FailMode)
+				if(m_FailMode)
 				{
 					dbg_msg("sql", "[%i] %s dismissed read request during FailMode", JobNum, pThreadData->m_pName);
 					break;
 				}
-				int CurServer = (ReadServer + i) % (int)m_vpReadConnections.size();
-				if(CDbConnectionPool::ExecSqlFunc(m_vpReadConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
+				int CurServer = (ReadServer + i) % (int)vpReadConnections.size();
+				if(CDbConnectionPool::ExecSqlFunc(vpReadConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
 				{
 					ReadServer = CurServer;
 					if(m_DebugSql)
@@ -330,89 +626,95 @@ void CWorker::ProcessQueries()
 			}
 			if(!Success)
 			{
-				FailMode = true;
+				m_FailMode = true;
 			}
 		}
 		break;
-		case CSqlExecData::WRITE_ACCESS:
-		{
-			if(m_pShared->m_Shutdown && m_pWriteBackup != nullptr)
-			{
-				dbg_msg("sql", "[%i] %s skipped to backup database during shutdown", JobNum, pThreadData->m_pName);
-			}
-			else if(FailMode && m_pWriteBackup != nullptr)
-			{
-				dbg_msg("sql", "[%i] %s skipped to backup database during FailMode", JobNum, pThreadData->m_pName);
-			}
-			else if(CDbConnectionPool::ExecSqlFunc(m_pWriteConnection.get(), pThreadData.get(), Write::NORMAL))
-			{
-				if(m_DebugSql)
-					dbg_msg("sql", "[%i] %s done on write database", JobNum, pThreadData->m_pName);
-				Success = true;
-			}
-			// enter fail mode if not successful
-			FailMode = FailMode || !Success;
-			const Write w = Success ? Write::NORMAL_SUCCEEDED : Write::NORMAL_FAILED;
-			if(m_pWriteBackup && CDbConnectionPool::ExecSqlFunc(m_pWriteBackup.get(), pThreadData.get(), w))
-			{
-				if(m_DebugSql)
-					dbg_msg("sql", "[%i] %s done move write on backup database to non-backup table", JobNum, pThreadData->m_pName);
-				Success = true;
-			}
-		}
-		break;
-		case CSqlExecData::ADD_MYSQL:
-		{
-			auto pMysql = CreateMysqlConnection(pThreadData->m_Ptr.m_Mysql.m_Config);
-			switch(pThreadData->m_Ptr.m_Mysql.m_Mode)
-			{
-			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pMysql));
-				break;
-			case CDbConnectionPool::Mode::WRITE:
-				m_pWriteConnection = std::move(pMysql);
-				break;
-			case CDbConnectionPool::Mode::WRITE_BACKUP:
-				m_pWriteBackup = std::move(pMysql);
-				break;
-			case CDbConnectionPool::Mode::NUM_MODES:
-				break;
-			}
-			Success = true;
-			break;
-		}
-		case CSqlExecData::ADD_SQLITE:
-		{
-			auto pSqlite = CreateSqliteConnection(pThreadData->m_Ptr.m_Sqlite.m_Filename, true);
-			switch(pThreadData->m_Ptr.m_Sqlite.m_Mode)
-			{
-			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pSqlite));
-				break;
-			case CDbConnectionPool::Mode::WRITE:
-				m_pWriteConnection = std::move(pSqlite);
-				break;
-			case CDbConnectionPool::Mode::WRITE_BACKUP:
-				m_pWriteBackup = std::move(pSqlite);
-				break;
-			case CDbConnectionPool::Mode::NUM_MODES:
-				break;
-			}
-			Success = true;
-			break;
-		}
 		case CSqlExecData::PRINT:
 			Print(pThreadData->m_Ptr.m_Print.m_pConsole, pThreadData->m_Ptr.m_Print.m_Mode);
 			Success = true;
 			break;
+		case CSqlExecData::WRITE_ACCESS:
+		case CSqlExecData::ADD_MYSQL:
+		case CSqlExecData::ADD_SQLITE:
+			dbg_assert_failed("unreachable");
 		}
-		if(!Success)
-			dbg_msg("sql", "[%i] %s failed on all databases", JobNum, pThreadData->m_pName);
-		if(pThreadData->m_pThreadData != nullptr && pThreadData->m_pThreadData->m_pResult != nullptr)
+		Finish(pThreadData.get(), Success, StartTime);
+	}
+	if(m_pQueue == &m_pShared->m_WriteQueue)
+	{
+		// all writes are done, the reads waiting for them are queued already
+		for(int i = 0; i < m_pShared->m_NumReadWorkers.load(); i++)
+			m_pShared->m_ReadQueue.Push(nullptr);
+	}
+	m_pShared->m_NumRunning.fetch_sub(1);
+}
+
+void CWorker::ProcessWrites(std::vector<std::unique_ptr<CSqlExecData>> &vpBatch, int64_t StartTime)
+{
+	const int Num = vpBatch.size();
+	std::vector<CSqlExecData *> vpData;
+	for(auto &pData : vpBatch)
+		vpData.push_back(pData.get());
+	std::vector<Write> vModes(Num, Write::NORMAL);
+	std::unique_ptr<bool[]> pSuccess(new bool[Num]());
+	IDbConnection *pWriteBackup = m_Connections.m_pWriteBackup.get();
+
+	if(m_pShared->m_Shutdown && pWriteBackup != nullptr)
+	{
+		for(const CSqlExecData *pData : vpData)
+			dbg_msg("sql", "[%i] %s skipped to backup database during shutdown", pData->m_JobNum, pData->m_pName);
+	}
+	else if(m_FailMode && pWriteBackup != nullptr)
+	{
+		for(const CSqlExecData *pData : vpData)
+			dbg_msg("sql", "[%i] %s skipped to backup database during FailMode", pData->m_JobNum, pData->m_pName);
+	}
+	else
+	{
+		CDbConnectionPool::ExecSqlBatch(m_Connections.m_pWriteConnection.get(), vpData.data(), vModes.data(), pSuccess.get(), Num);
+		for(int i = 0; i < Num; i++)
+		{
+			if(m_DebugSql && pSuccess[i])
+				dbg_msg("sql", "[%i] %s done on write database", vpData[i]->m_JobNum, vpData[i]->m_pName);
+		}
+	}
+
+	for(int i = 0; i < Num; i++)
+	{
+		// enter fail mode if not successful
+		m_FailMode = m_FailMode || !pSuccess[i];
+		vModes[i] = pSuccess[i] ? Write::NORMAL_SUCCEEDED : Write::NORMAL_FAILED;
+	}
+	std::unique_ptr<bool[]> pBackupSuccess(new bool[Num]());
+	if(pWriteBackup != nullptr)
+		CDbConnectionPool::ExecSqlBatch(pWriteBackup, vpData.data(), vModes.data(), pBackupSuccess.get(), Num);
+
+	for(int i = 0; i < Num; i++)
+	{
+		if(pBackupSuccess[i])
 		{
-			pThreadData->m_pThreadData->m_pResult->m_Success = Success;
-			pThreadData->m_pThreadData->m_pResult->m_Completed.store(true);
+			if(m_DebugSql)
+				dbg_msg("sql", "[%i] %s done move write on backup database to non-backup table", vpData[i]->m_JobNum, vpData[i]->m_pName);
 		}
+		if(pSuccess[i] || (pBackupSuccess[i] && vModes[i] == Write::NORMAL_FAILED))
+			vpData[i]->m_pThreadData->OnCommitted();
+		Finish(vpData[i], pSuccess[i] || pBackupSuccess[i], StartTime);
+	}
+	m_pQueue->AddBatch(Num);
+	m_pShared->FinishWrites(Num);
+}
+
+void CWorker::Finish(CSqlExecData *pData, bool Success, int64_t StartTime)
+{
+	if(pData->m_Mode == CSqlExecData::READ_ACCESS || pData->m_Mode == CSqlExecData::WRITE_ACCESS)
+		m_pQueue->AddStats(StartTime - pData->m_QueueTime, time_get_nanoseconds().count() - StartTime);
+	if(!Success)
+		dbg_msg("sql", "[%i] %s failed on all databases", pData->m_JobNum, pData->m_pName);
+	if(pData->m_pThreadData != nullptr && pData->m_pThreadData->m_pResult != nullptr)
+	{
+		pData->m_pThreadData->m_pResult->m_Success = Success;
+		pData->m_pThreadData->m_pResult->m_Completed.store(true);
 	}
 }
 
@@ -420,22 +722,22 @@ void CWorker::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
 {
 	if(DatabaseMode == CDbConnectionPool::Mode::READ)
 	{
-		for(auto &pReadConnection : m_vpReadConnections)
+		for(auto &pReadConnection : m_Connections.m_vpReadConnections)
 			pReadConnection->Print(pConsole, "Read");
-		if(m_vpReadConnections.empty())
+		if(m_Connections.m_vpReadConnections.empty())
 			pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no read databases");
 	}
 	else if(DatabaseMode == CDbConnectionPool::Mode::WRITE)
 	{
-		if(m_pWriteConnection)
-			m_pWriteConnection->Print(pConsole, "Write");
+		if(m_Connections.m_pWriteConnection)
+			m_Connections.m_pWriteConnection->Print(pConsole, "Write");
 		else
 			pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no write databases");
 	}
 	else if(DatabaseMode == CDbConnectionPool::Mode::WRITE_BACKUP)
 	{
-		if(m_pWriteBackup)
-			m_pWriteBackup->Print(pConsole, "WriteBackup");
+		if(m_Connections.m_pWriteBackup)
+			m_Connections.m_pWriteBackup->Print(pConsole, "WriteBackup");
 		else
 			pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no write backup databases");
 	}
@@ -475,10 +777,55 @@ bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pD
 	return Success;
 }
 
+/* static */
+void CDbConnectionPool::ExecSqlBatch(IDbConnection *pConnection, CSqlExecData *const *ppData, const Write *pModes, bool *pSuccess, int Num)
+{
+	std::fill(pSuccess, pSuccess + Num, false);
+	if(pConnection == nullptr)
+	{
+		dbg_msg("sql", "No database given");
+		return;
+	}
+	char aError[256] = "unknown error";
+	if(!pConnection->Connect(aError, sizeof(aError)))
+	{
+		dbg_msg("sql", "failed connecting to db: %s", aError);
+		return;
+	}
+	// single writes run in a transaction as well, so that a failing write
+	// never leaves parts of it behind
+	bool Valid = pConnection->BeginTransaction(aError, sizeof(aError));
+	for(int i = 0; i < Num && Valid; i++)
+	{
+		Valid = pConnection->Execute("SAVEPOINT write", aError, sizeof(aError));
+		if(!Valid)
+			break;
+		char aWriteError[256] = "unknown error";
+		dbg_assert(ppData[i]->m_Mode == CSqlExecData::WRITE_ACCESS, "only writes can be batched");
+		pSuccess[i] = ppData[i]->m_Ptr.m_pWriteFunc(pConnection, ppData[i]->m_pThreadData.get(), pModes[i], aWriteError, sizeof(aWriteError));
+		if(!pSuccess[i])
+		{
+			dbg_msg("sql", "%s failed: %s", ppData[i]->m_pName, aWriteError);
+			Valid = pConnection->Execute("ROLLBACK TO SAVEPOINT write", aError, sizeof(aError));
+		}
+		Valid = Valid && pConnection->Execute("RELEASE SAVEPOINT write", aError, sizeof(aError));
+	}
+	if(!Valid || !pConnection->Execute("COMMIT", aError, sizeof(aError)))
+	{
+		dbg_msg("sql", "transaction of %d writes failed: %s", Num, aError);
+		char aRollbackError[256];
+		pConnection->Execute("ROLLBACK", aRollbackError, sizeof(aRollbackError));
+		std::fill(pSuccess, pSuccess + Num, false);
+	}
+	pConnection->Disconnect();
+}
+
 CDbConnectionPool::CDbConnectionPool()
 {
 	m_pShared = std::make_shared<CSharedData>();
-	m_pWorkerThread = thread_init(CWorker::Start, new CWorker(m_pShared, g_Config.m_DbgSql), "database worker thread");
+	m_pShared->m_NumRunning.fetch_add(2);
+	const unsigned WriteModes = (1 << Mode::WRITE) | (1 << Mode::WRITE_BACKUP);
+	m_pWorkerThread = thread_init(CWorker::Start, new CWorker(m_pShared, &m_pShared->m_WriteQueue, WriteModes, g_Config.m_DbgSql), "database worker thread");
 	m_pBackupThread = thread_init(CBackup::Start, new CBackup(m_pShared, g_Config.m_DbgSql), "database backup worker thread");
 }
 
@@ -489,4 +836,19 @@ CDbConnectionPool::~CDbConnectionPool()
 		thread_wait(m_pWorkerThread);
 	if(m_pBackupThread)
 		thread_wait(m_pBackupThread);
+	for(void *pThread : m_vpReadWorkerThreads)
+		thread_wait(pThread);
+}
+
+void CDbConnectionPool::StartReadWorkers()
+{
+	// the pool is created before the config is loaded, the read workers
+	// start with the first query
+	if(!m_vpReadWorkerThreads.empty() || m_Shutdown)
+		return;
+	const int NumWorkers = std::max(g_Config.m_SvSqlReadWorkers, 1);
+	m_pShared->m_NumRunning.fetch_add(NumWorkers);
+	m_pShared->m_NumReadWorkers.store(NumWorkers);
+	for(int i = 0; i < NumWorkers; i++)
+		m_vpReadWorkerThreads.push_back(thread_init(CWorker::Start, new CWorker(m_pShared, &m_pShared->m_ReadQueue, 1 << Mode::READ, g_Config.m_DbgSql), "database read worker thread"));
 }
@@ -1,7 +1,7 @@
 #ifndef ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
 #define ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
 
-#include <base/tl/threading.h>
+#include <base/system.h>
 
 #include <atomic>
 #include <memory>
@@ -29,6 +29,12 @@ struct ISqlData
 	}
 	virtual ~ISqlData() = default;
 
+	// Called by the write worker once a write is committed to the write
+	// database, or after it was moved from the backup table with
+	// Write::NORMAL_FAILED. The function itself may run in a transaction
+	// together with other writes, so it can't do this itself.
+	virtual void OnCommitted() const {}
+
 	mutable std::shared_ptr<ISqlResult> m_pResult;
 };
 
@@ -78,6 +84,8 @@ public:
 	};
 
 	void Print(IConsole *pConsole, Mode DatabaseMode);
+	// prints the queue depths and latencies of read and write queries
+	void PrintStats(IConsole *pConsole);
 
 	void RegisterSqliteDatabase(Mode DatabaseMode, const char aFilename[64]);
 	void RegisterMysqlDatabase(Mode DatabaseMode, const CMysqlConfig *pMysqlConfig);
@@ -97,38 +105,32 @@ public:
 
 	friend class CWorker;
 	friend class CBackup;
+	friend class CConnections;
 
 private:
 	static bool ExecSqlFunc(IDbConnection *pConnection, struct CSqlExecData *pData, Write w);
-
-	// Only the main thread accesses this variable. It points to the index,
-	// where the next query is added to the queue.
-	int m_InsertIdx = 0;
-
+	// Executes the writes in one transaction, so they are written to disk
+	// together. Each write gets its own savepoint, a failing one doesn't undo
+	// the others. If the transaction can't be committed, all of them fail.
+	static void ExecSqlBatch(IDbConnection *pConnection, struct CSqlExecData *const *ppData, const Write *pModes, bool *pSuccess, int Num);
+
+	// Read queries are executed by several read workers with their own
+	// connections, so a slow read doesn't delay the others. Write queries go
+	// through the backup thread to one write worker, they are executed in
+	// order and never wait for read queries. A read query starts only after
+	// the writes queued before it are done.
+	void StartReadWorkers();
+
+	// Only the main thread accesses these variables.
+	int m_NextJobNum = 0;
+	int64_t m_NumWritesQueued = 0;
 	bool m_Shutdown = false;
 
-	struct CSharedData
-	{
-		// Used as signal that shutdown is in progress from main thread to
-		// speed up the queries by discarding read queries and writing to
-		// the sqlite file instead of the remote mysql server.
-		// The worker thread signals the main thread that all queries are
-		// processed by setting this variable to false again.
-		std::atomic_bool m_Shutdown{false};
-		// Queries go first to the backup thread. This semaphore signals about
-		// new queries.
-		CSemaphore m_NumBackup;
-		// When the backup thread processed the query, it signals the main
-		// thread with this semaphore about the new query
-		CSemaphore m_NumWorker;
-
-		// spsc queue with additional backup worker to look at queries first.
-		std::unique_ptr<struct CSqlExecData> m_aQueries[512];
-	};
-
+	struct CSharedData;
 	std::shared_ptr<CSharedData> m_pShared;
 	void *m_pWorkerThread = nullptr;
 	void *m_pBackupThread = nullptr;
+	std::vector<void *> m_vpReadWorkerThreads;
 };
 
 #endif // ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
@@ -82,6 +82,8 @@ public:
 
 	bool Connect(char *pError, int ErrorSize) override;
 	void Disconnect() override;
+	bool Execute(const char *pStmt, char *pError, int ErrorSize) override;
+	bool BeginTransaction(char *pError, int ErrorSize) override;
 
 	bool PrepareStatement(const char *pStmt, char *pError, int ErrorSize) override;
 
@@ -317,6 +319,29 @@ void CMysqlConnection::Disconnect()
 	m_InUse.store(false);
 }
 
+bool CMysqlConnection::Execute(const char *pStmt, char *pError, int ErrorSize)
+{
+	// the connection is out of sync while a result of the last statement is pending
+	if(m_pStmt && mysql_stmt_free_result(m_pStmt.get()))
+	{
+		StoreErrorStmt("free_result");
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+		return false;
+	}
+	if(mysql_real_query(&m_Mysql, pStmt, str_length(pStmt)))
+	{
+		StoreErrorMysql("query");
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+		return false;
+	}
+	return true;
+}
+
+bool CMysqlConnection::BeginTransaction(char *pError, int ErrorSize)
+{
+	return Execute("BEGIN", pError, ErrorSize);
+}
+
 bool CMysqlConnection::PrepareStatement(const char *pStmt, char *pError, int ErrorSize)
 {
 	if(mysql_stmt_prepare(m_pStmt.get(), pStmt, str_length(pStmt)))
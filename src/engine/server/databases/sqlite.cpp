@@ -7,6 +7,7 @@
 #include <sqlite3.h>
 
 #include <atomic>
+#include <limits>
 
 class CSqliteConnection : public IDbConnection
 {
@@ -30,6 +31,8 @@ public:
 
 	bool Connect(char *pError, int ErrorSize) override;
 	void Disconnect() override;
+	bool Execute(const char *pStmt, char *pError, int ErrorSize) override;
+	bool BeginTransaction(char *pError, int ErrorSize) override;
 
 	bool PrepareStatement(const char *pStmt, char *pError, int ErrorSize) override;
 
@@ -65,8 +68,6 @@ private:
 	sqlite3 *m_pDb;
 	sqlite3_stmt *m_pStmt;
 	bool m_Done; // no more rows available for Step
-	// returns false, if the query succeeded
-	bool Execute(const char *pQuery, char *pError, int ErrorSize);
 	// returns true on failure
 	bool ConnectImpl(char *pError, int ErrorSize);
 
@@ -143,8 +144,10 @@ bool CSqliteConnection::ConnectImpl(char *pError, int ErrorSize)
 		return false;
 	}
 
-	// wait for database to unlock so we don't have to handle SQLITE_BUSY errors
-	sqlite3_busy_timeout(m_pDb, -1);
+	// wait for database to unlock so we don't have to handle SQLITE_BUSY errors,
+	// the read and write workers use the file at the same time (a negative
+	// timeout would turn the waiting off)
+	sqlite3_busy_timeout(m_pDb, std::numeric_limits<int>::max());
 
 	if(m_Setup)
 	{
@@ -361,10 +364,16 @@ const char *CSqliteConnection::MedianMapTime(char *pBuffer, int BufferSize) cons
 	return pBuffer;
 }
 
-bool CSqliteConnection::Execute(const char *pQuery, char *pError, int ErrorSize)
+bool CSqliteConnection::Execute(const char *pStmt, char *pError, int ErrorSize)
 {
+	// a statement that is still running keeps the transaction from committing
+	if(m_pStmt != nullptr)
+		sqlite3_finalize(m_pStmt);
+	m_pStmt = nullptr;
+	m_Done = true;
+
 	char *pErrorMsg;
-	int Result = sqlite3_exec(m_pDb, pQuery, nullptr, nullptr, &pErrorMsg);
+	int Result = sqlite3_exec(m_pDb, pStmt, nullptr, nullptr, &pErrorMsg);
 	if(Result != SQLITE_OK)
 	{
 		str_format(pError, ErrorSize, "error executing query: '%s'", pErrorMsg);
@@ -374,6 +383,11 @@ bool CSqliteConnection::Execute(const char *pQuery, char *pError, int ErrorSize)
 	return true;
 }
 
+bool CSqliteConnection::BeginTransaction(char *pError, int ErrorSize)
+{
+	return Execute("BEGIN IMMEDIATE", pError, ErrorSize);
+}
+
 bool CSqliteConnection::FormatError(int Result, char *pError, int ErrorSize)
 {
 	if(Result != SQLITE_OK)
@@ -20,6 +20,7 @@
 #include <engine/shared/compression.h>
 #include <engine/shared/config.h>
 #include <engine/shared/console.h>
+#include <engine/shared/datafile.h>
 #include <engine/shared/demo.h>
 #include <engine/shared/econ.h>
 #include <engine/shared/fifo.h>
@@ -40,6 +41,7 @@
 #include <engine/shared/snapshot.h>
 #include <engine/storage.h>
 
+#include <game/mapitems.h>
 #include <game/version.h>
 
 #include <zlib.h>
@@ -258,6 +260,10 @@ CServer::CServer()
 	m_RconClientId = IServer::RCON_CID_SERV;
 	m_RconAuthLevel = AUTHED_ADMIN;
 
+	static const char *const s_apProfileSectionNames[NUM_PROFILE_SECTIONS] = {"busy", "network", "input", "tick", "snap", "snap.game"};
+	for(int i = 0; i < NUM_PROFILE_SECTIONS; i++)
+		m_aProfileSections[i] = m_TickProfiler.Section(s_apProfileSectionNames[i]);
+
 	m_ServerInfoFirstRequest = 0;
 	m_ServerInfoNumRequests = 0;
 	m_ServerInfoNeedsUpdate = false;
@@ -276,6 +282,11 @@ CServer::CServer()
 
 CServer::~CServer()
 {
+	if(m_NetReactor)
+	{
+		net_reactor_destroy(m_NetReactor);
+	}
+
 	for(auto &pCurrentMapData : m_apCurrentMapData)
 	{
 		free(pCurrentMapData);
@@ -1000,8 +1011,103 @@ void CServer::SendMsgRaw(int ClientId, const void *pData, int Size, int Flags)
 	m_NetServer.Send(&Packet);
 }
 
+void CServer::EncodeClientSnapshot(CClient *pClient, int Tick, int TickSpeed, const CSnapshot *pData, int SnapshotSize, CSnapshotDelta *pDelta, CSnapshotDeltaCache *pDeltaCache, CSnapshotPacket *pPacket)
+{
+	pPacket->m_Crc = pData->Crc();
+
+	// remove old snapshots
+	// keep 3 seconds worth of snapshots
+	pClient->m_Snapshots.PurgeUntil(Tick - TickSpeed * 3);
+
+	// save the snapshot
+	pClient->m_Snapshots.Add(Tick, time_get(), SnapshotSize, pData, 0, nullptr);
+
+	// find snapshot that we can perform delta against
+	pPacket->m_DeltaTick = -1;
+	const CSnapshot *pDeltashot = CSnapshot::EmptySnapshot();
+	int DeltashotSize = pClient->m_Snapshots.Get(pClient->m_LastAckedSnapshot, nullptr, &pDeltashot, nullptr);
+	if(DeltashotSize >= 0)
+		pPacket->m_DeltaTick = pClient->m_LastAckedSnapshot;
+	else
+	{
+		DeltashotSize = sizeof(CSnapshot);
+
+		// no acked package found, force client to recover rate
+		if(pClient->m_SnapRate == CClient::SNAPRATE_FULL)
+			pClient->m_SnapRate = CClient::SNAPRATE_RECOVER;
+	}
+
+	// reuse the delta if another client has the same base and target snapshot
+	const CSnapshot *pStoredData = pClient->m_Snapshots.m_pLast->m_pSnap;
+	unsigned DeltashotCrc = 0;
+	if(pDeltaCache)
+	{
+		DeltashotCrc = pDeltashot->Crc();
+		if(pDeltaCache->Find(pDeltashot, DeltashotSize, DeltashotCrc, pStoredData, SnapshotSize, pPacket->m_Crc, pClient->m_Sixup, pPacket))
+			return;
+	}
+
+	// create delta
+	pDelta->SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, pClient->m_Sixup);
+	pDelta->SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, pClient->m_Sixup);
+	char aDeltaData[CSnapshot::MAX_SIZE];
+	int DeltaSize = pDelta->CreateDelta(pDeltashot, pData, aDeltaData);
+
+	// compress it
+	pPacket->m_DataSize = DeltaSize ? CVariableInt::Compress(aDeltaData, DeltaSize, pPacket->m_aData, sizeof(pPacket->m_aData)) : 0;
+
+	if(pDeltaCache)
+		pDeltaCache->Add(pDeltashot, DeltashotSize, DeltashotCrc, pStoredData, SnapshotSize, pPacket->m_Crc, pClient->m_Sixup, pPacket);
+}
+
+void CServer::SendClientSnapshot(int ClientId, const CSnapshotPacket *pPacket)
+{
+	if(pPacket->m_DataSize)
+	{
+		const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+		int NumPackets = (pPacket->m_DataSize + MaxSize - 1) / MaxSize;
+
+		for(int n = 0, Left = pPacket->m_DataSize; Left > 0; n++)
+		{
+			int Chunk = Left < MaxSize ? Left : MaxSize;
+			Left -= Chunk;
+
+			if(NumPackets == 1)
+			{
+				CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick - pPacket->m_DeltaTick);
+				Msg.AddInt(pPacket->m_Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pPacket->m_aData[n * MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
+			}
+			else
+			{
+				CMsgPacker Msg(NETMSG_SNAP, true);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick - pPacket->m_DeltaTick);
+				Msg.AddInt(NumPackets);
+				Msg.AddInt(n);
+				Msg.AddInt(pPacket->m_Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pPacket->m_aData[n * MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
+			}
+		}
+	}
+	else
+	{
+		CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+		Msg.AddInt(m_CurrentGameTick);
+		Msg.AddInt(m_CurrentGameTick - pPacket->m_DeltaTick);
+		SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
+	}
+}
+
 void CServer::DoSnapshot()
 {
+	CProfileScope SnapProfile(&m_TickProfiler, m_aProfileSections[PROFILE_SNAP]);
 	bool IsGlobalSnap = Config()->m_SvHighBandwidth || (m_CurrentGameTick % 2) == 0;
 
 	if(m_aDemoRecorder[RECORDER_MANUAL].IsRecording() || m_aDemoRecorder[RECORDER_AUTO].IsRecording())
@@ -1021,6 +1127,24 @@ void CServer::DoSnapshot()
 			m_aDemoRecorder[RECORDER_AUTO].RecordSnapshot(Tick(), aData, SnapshotSize);
 	}
 
+	// (re)start the snapshot workers if the number of threads changed
+	if(m_SnapshotWorkers.NumThreads() != Config()->m_SvSnapshotThreads)
+	{
+		if(m_SnapshotWorkers.NumThreads() > 0)
+			m_SnapshotWorkers.Shutdown();
+		if(Config()->m_SvSnapshotThreads > 0)
+			m_SnapshotWorkers.Init(Config()->m_SvSnapshotThreads, m_SnapshotDelta);
+	}
+	const bool UseWorkers = m_SnapshotWorkers.NumThreads() > 0;
+	CSnapshotDeltaCache *pDeltaCache = nullptr;
+	if(Config()->m_SvSnapshotDeltaCache)
+	{
+		m_SnapshotDeltaCache.Clear();
+		pDeltaCache = &m_SnapshotDeltaCache;
+	}
+	int aSnapClients[MAX_CLIENTS];
+	int NumSnapClients = 0;
+
 	// create snapshots for all clients
 	for(int i = 0; i < MaxClients(); i++)
 	{
@@ -1044,97 +1168,65 @@ void CServer::DoSnapshot()
 			m_SnapshotBuilder.Init(m_aClients[i].m_Sixup);
 
 			// only snap events on global ticks
-			GameServer()->OnSnap(i, IsGlobalSnap);
+			{
+				CProfileScope GameProfile(&m_TickProfiler, m_aProfileSections[PROFILE_SNAP_GAME]);
+				GameServer()->OnSnap(i, IsGlobalSnap);
+			}
 
-			// finish snapshot
+			// finish snapshot, into the client's slot if the workers encode it later
 			char aData[CSnapshot::MAX_SIZE];
-			CSnapshot *pData = (CSnapshot *)aData; // Fix compiler warning for strict-aliasing
+			char *pBuffer = aData;
+			if(UseWorkers)
+			{
+				if(!m_apSnapshotSlots[i])
+					m_apSnapshotSlots[i] = std::make_unique<CSnapshotSlot>();
+				pBuffer = m_apSnapshotSlots[i]->m_aData;
+			}
+			CSnapshot *pData = (CSnapshot *)pBuffer; // Fix compiler warning for strict-aliasing
 			int SnapshotSize = m_SnapshotBuilder.Finish(pData);
 
 			if(m_aDemoRecorder[i].IsRecording())
 			{
 				// write snapshot
-				m_aDemoRecorder[i].RecordSnapshot(Tick(), aData, SnapshotSize);
-			}
-
-			int Crc = pData->Crc();
-
-			// remove old snapshots
-			// keep 3 seconds worth of snapshots
-			m_aClients[i].m_Snapshots.PurgeUntil(m_CurrentGameTick - TickSpeed() * 3);
-
-			// save the snapshot
-			m_aClients[i].m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0, nullptr);
-
-			// find snapshot that we can perform delta against
-			int DeltaTick = -1;
-			const CSnapshot *pDeltashot = CSnapshot::EmptySnapshot();
-			{
-				int DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, nullptr, &pDeltashot, nullptr);
-				if(DeltashotSize >= 0)
-					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
-				else
-				{
-					// no acked package found, force client to recover rate
-					if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
-						m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
-				}
+				m_aDemoRecorder[i].RecordSnapshot(Tick(), pBuffer, SnapshotSize);
 			}
 
-			// create delta
+			// the demo recorders share this delta, so keep its sizes in sync with the workers
 			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, m_aClients[i].m_Sixup);
 			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, m_aClients[i].m_Sixup);
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			int DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
 
-			if(DeltaSize)
+			if(UseWorkers)
 			{
-				// compress it
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
-
-				char aCompData[CSnapshot::MAX_SIZE];
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
-				int NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
-
-				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
-				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
-
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-				}
+				m_apSnapshotSlots[i]->m_SnapshotSize = SnapshotSize;
+				aSnapClients[NumSnapClients++] = i;
 			}
 			else
 			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
-				Msg.AddInt(m_CurrentGameTick);
-				Msg.AddInt(m_CurrentGameTick - DeltaTick);
-				SendMsg(&Msg, MSGFLAG_FLUSH, i);
+				CSnapshotPacket Packet;
+				EncodeClientSnapshot(&m_aClients[i], m_CurrentGameTick, TickSpeed(), pData, SnapshotSize, &m_SnapshotDelta, pDeltaCache, &Packet);
+				SendClientSnapshot(i, &Packet);
 			}
 		}
 	}
 
+	if(NumSnapClients > 0)
+	{
+		const int CurrentGameTick = m_CurrentGameTick;
+		const int TickSpeedValue = TickSpeed();
+		m_SnapshotWorkers.Run(NumSnapClients, [&](int Task, CSnapshotDelta *pDelta) {
+			const int ClientId = aSnapClients[Task];
+			CSnapshotSlot *pSlot = m_apSnapshotSlots[ClientId].get();
+			EncodeClientSnapshot(&m_aClients[ClientId], CurrentGameTick, TickSpeedValue, (const CSnapshot *)pSlot->m_aData, pSlot->m_SnapshotSize, pDelta, pDeltaCache, &pSlot->m_Packet);
+		});
+
+		// send in client order, so the output does not depend on the scheduling of the workers
+		for(int Task = 0; Task < NumSnapClients; Task++)
+		{
+			const int ClientId = aSnapClients[Task];
+			SendClientSnapshot(ClientId, &m_apSnapshotSlots[ClientId]->m_Packet);
+		}
+	}
+
 	if(IsGlobalSnap)
 	{
 		GameServer()->OnPostGlobalSnap();
@@ -2755,6 +2847,7 @@ void CServer::UpdateServerInfo(bool Resend)
 
 void CServer::PumpNetwork(bool PacketWaiting)
 {
+	CProfileScope NetworkProfile(&m_TickProfiler, m_aProfileSections[PROFILE_NETWORK]);
 	CNetChunk Packet;
 	SECURITY_TOKEN ResponseToken;
 
@@ -2854,6 +2947,56 @@ void CServer::PumpNetwork(bool PacketWaiting)
 	m_Econ.Update();
 }
 
+bool CServer::WaitForNetwork(std::chrono::nanoseconds Deadline)
+{
+	if(Config()->m_SvNetReactor && !m_NetReactor)
+	{
+		m_NetReactor = net_reactor_create();
+	}
+	else if(!Config()->m_SvNetReactor && m_NetReactor)
+	{
+		net_reactor_destroy(m_NetReactor);
+		m_NetReactor = nullptr;
+	}
+
+	const std::chrono::nanoseconds Now = time_get_nanoseconds();
+	if(Deadline <= Now)
+	{
+		return true;
+	}
+	if(!m_NetReactor)
+	{
+		return net_socket_read_wait(m_NetServer.Socket(), Deadline - Now);
+	}
+	net_reactor_add(m_NetReactor, m_NetServer.Socket());
+	m_Econ.AddSocketsToReactor(m_NetReactor);
+	return net_reactor_wait(m_NetReactor, Deadline);
+}
+
+const int CServer::CTickJitter::ms_aBucketLimitsUs[NUM_BUCKETS - 1] = {50, 100, 250, 500, 1000, 2000, 5000};
+
+void CServer::CTickJitter::Reset()
+{
+	std::fill(std::begin(m_aBuckets), std::end(m_aBuckets), 0);
+	m_Count = 0;
+	m_Sum = 0;
+	m_Max = 0;
+}
+
+void CServer::CTickJitter::Add(int64_t Lateness)
+{
+	const int64_t LatenessUs = Lateness * 1000000 / time_freq();
+	int Bucket = 0;
+	while(Bucket < NUM_BUCKETS - 1 && LatenessUs >= ms_aBucketLimitsUs[Bucket])
+	{
+		Bucket++;
+	}
+	m_aBuckets[Bucket]++;
+	m_Count++;
+	m_Sum += Lateness;
+	m_Max = maximum(m_Max, Lateness);
+}
+
 const char *CServer::GetMapName() const
 {
 	return m_pCurrentMapName;
@@ -2870,54 +3013,268 @@ void CServer::ReloadMap()
 	m_SameMapReload = true;
 }
 
-int CServer::LoadMap(const char *pMapName)
+// Reads a map, its download data and the 0.7 version of it. This is done on
+// a job thread for map changes, so that the main thread only has to swap the
+// results in.
+class CServer::CMapLoadJob : public IJob
 {
-	m_MapReload = false;
-	m_SameMapReload = false;
+	IStorage *m_pStorage;
+
+	void Run() override
+	{
+		Load();
+	}
+
+public:
+	char m_aName[IO_MAX_PATH_LENGTH];
+	char m_aPath[IO_MAX_PATH_LENGTH];
+	// the settings that replace the ones in the map, if m_ImportSettings is set
+	bool m_ImportSettings = false;
+	std::vector<char> m_vSettings;
+	bool m_Sixup;
+	bool m_Preload;
+	bool m_SameMapReload = false;
+
+	bool m_Success = false;
+	std::unique_ptr<IEngineMap> m_pMap; // nullptr if the server's map was loaded directly
+	SHA256_DIGEST m_aSha256[NUM_MAP_TYPES];
+	unsigned m_aCrc[NUM_MAP_TYPES] = {0, 0};
+	unsigned char *m_apData[NUM_MAP_TYPES] = {nullptr, nullptr};
+	unsigned m_aSize[NUM_MAP_TYPES] = {0, 0};
+	int64_t m_Start;
+	int64_t m_Duration = 0;
+
+	CMapLoadJob(IStorage *pStorage, const char *pName, const char *pPath, bool Sixup, bool Preload) :
+		m_pStorage(pStorage),
+		m_Sixup(Sixup),
+		m_Preload(Preload),
+		m_Start(time_get_nanoseconds().count())
+	{
+		str_copy(m_aName, pName);
+		str_copy(m_aPath, pPath);
+	}
+
+	~CMapLoadJob() override
+	{
+		// the map can refer to the download data, so it has to go first
+		m_pMap = nullptr;
+		for(unsigned char *pData : m_apData)
+		{
+			free(pData);
+		}
+	}
+
+	// reads the file once and uses it as both the map and the download data
+	bool Load()
+	{
+		void *pData;
+		if(!m_pStorage->ReadFile(m_aPath, IStorage::TYPE_ALL, &pData, &m_aSize[MAP_TYPE_SIX]))
+		{
+			log_error("server", "failed to read map '%s'", m_aPath);
+			return false;
+		}
+		m_apData[MAP_TYPE_SIX] = static_cast<unsigned char *>(pData);
+		if(m_ImportSettings && !ImportSettings())
+		{
+			return false;
+		}
 
+		m_pMap = std::unique_ptr<IEngineMap>(CreateEngineMap());
+		if(!m_pMap->LoadMemory(m_aPath, m_apData[MAP_TYPE_SIX], m_aSize[MAP_TYPE_SIX], m_Preload))
+		{
+			return false;
+		}
+		m_pMap->PreloadGameLayers();
+		m_aSha256[MAP_TYPE_SIX] = m_pMap->Sha256();
+		m_aCrc[MAP_TYPE_SIX] = m_pMap->Crc();
+
+		LoadSixup();
+		m_Duration = time_get_nanoseconds().count() - m_Start;
+		m_Success = true;
+		return true;
+	}
+
+	// replaces the settings of the map data by m_vSettings in memory, the
+	// download data is the map with the new settings
+	bool ImportSettings()
+	{
+		CDataFileReader Reader;
+		if(!Reader.OpenMemory(m_aPath, m_apData[MAP_TYPE_SIX], m_aSize[MAP_TYPE_SIX]))
+		{
+			log_error("server", "failed to import settings: failed to open map '%s'", m_aPath);
+			return false;
+		}
+
+		const int TotalLength = m_vSettings.size();
+		CDataFileWriter Writer;
+
+		int SettingsIndex = Reader.NumData();
+		bool FoundInfo = false;
+		for(int i = 0; i < Reader.NumItems(); i++)
+		{
+			int TypeId;
+			int ItemId;
+			void *pData = Reader.GetItem(i, &TypeId, &ItemId);
+			int Size = Reader.GetItemSize(i);
+			CMapItemInfoSettings MapInfo;
+			if(TypeId == MAPITEMTYPE_INFO && ItemId == 0)
+			{
+				FoundInfo = true;
+				if(Size >= (int)sizeof(CMapItemInfoSettings))
+				{
+					CMapItemInfoSettings *pInfo = (CMapItemInfoSettings *)pData;
+					if(pInfo->m_Settings > -1)
+					{
+						SettingsIndex = pInfo->m_Settings;
+						char *pMapSettings = (char *)Reader.GetData(SettingsIndex);
+						int DataSize = Reader.GetDataSize(SettingsIndex);
+						if(DataSize == TotalLength && mem_comp(m_vSettings.data(), pMapSettings, DataSize) == 0)
+						{
+							// Configs coincide, no need to update map.
+							return true;
+						}
+						Reader.UnloadData(pInfo->m_Settings);
+					}
+					else
+					{
+						MapInfo = *pInfo;
+						MapInfo.m_Settings = SettingsIndex;
+						pData = &MapInfo;
+						Size = sizeof(MapInfo);
+					}
+				}
+				else
+				{
+					*(CMapItemInfo *)&MapInfo = *(CMapItemInfo *)pData;
+					MapInfo.m_Settings = SettingsIndex;
+					pData = &MapInfo;
+					Size = sizeof(MapInfo);
+				}
+			}
+			Writer.AddItem(TypeId, ItemId, Size, pData);
+		}
+
+		if(!FoundInfo)
+		{
+			CMapItemInfoSettings Info;
+			Info.m_Version = 1;
+			Info.m_Author = -1;
+			Info.m_MapVersion = -1;
+			Info.m_Credits = -1;
+			Info.m_License = -1;
+			Info.m_Settings = SettingsIndex;
+			Writer.AddItem(MAPITEMTYPE_INFO, 0, sizeof(Info), &Info);
+		}
+
+		for(int i = 0; i < Reader.NumData() || i == SettingsIndex; i++)
+		{
+			if(i == SettingsIndex)
+			{
+				Writer.AddData(TotalLength, m_vSettings.data());
+				continue;
+			}
+			const void *pData = Reader.GetData(i);
+			int Size = Reader.GetDataSize(i);
+			Writer.AddData(Size, pData);
+			Reader.UnloadData(i);
+		}
+		Reader.Close();
+
+		// this runs on a job, so the data can't be compressed on further jobs
+		void *pData;
+		Writer.OpenMemory(&pData, &m_aSize[MAP_TYPE_SIX]);
+		Writer.Finish();
+		free(m_apData[MAP_TYPE_SIX]);
+		m_apData[MAP_TYPE_SIX] = static_cast<unsigned char *>(pData);
+		log_info("server", "imported settings into map '%s'", m_aPath);
+		return true;
+	}
+
+	// for memory mapped maps, which are loaded into the server's map directly
+	bool LoadDownloadData(IEngineMap *pMap)
+	{
+		void *pData;
+		if(!m_pStorage->ReadFile(m_aPath, IStorage::TYPE_ALL, &pData, &m_aSize[MAP_TYPE_SIX]))
+		{
+			log_error("server", "failed to read map '%s'", m_aPath);
+			return false;
+		}
+		m_apData[MAP_TYPE_SIX] = static_cast<unsigned char *>(pData);
+		m_aSha256[MAP_TYPE_SIX] = pMap->Sha256();
+		m_aCrc[MAP_TYPE_SIX] = pMap->Crc();
+
+		LoadSixup();
+		m_Duration = time_get_nanoseconds().count() - m_Start;
+		m_Success = true;
+		return true;
+	}
+
+	void LoadSixup()
+	{
+		if(!m_Sixup)
+		{
+			return;
+		}
+		char aPath[IO_MAX_PATH_LENGTH];
+		str_format(aPath, sizeof(aPath), "maps7/%s.map", m_aName);
+		void *pData;
+		if(!m_pStorage->ReadFile(aPath, IStorage::TYPE_ALL, &pData, &m_aSize[MAP_TYPE_SIXUP]))
+		{
+			return;
+		}
+		m_apData[MAP_TYPE_SIXUP] = static_cast<unsigned char *>(pData);
+		m_aSha256[MAP_TYPE_SIXUP] = sha256(m_apData[MAP_TYPE_SIXUP], m_aSize[MAP_TYPE_SIXUP]);
+		m_aCrc[MAP_TYPE_SIXUP] = crc32(0, m_apData[MAP_TYPE_SIXUP], m_aSize[MAP_TYPE_SIXUP]);
+	}
+};
+
+std::shared_ptr<CServer::CMapLoadJob> CServer::PrepareMapLoad(const char *pMapName)
+{
 	char aBuf[IO_MAX_PATH_LENGTH];
 	str_format(aBuf, sizeof(aBuf), "maps/%s.map", pMapName);
 	if(!str_valid_filename(fs_filename(aBuf)))
 	{
 		log_error("server", "The name '%s' cannot be used for maps because not all platforms support it", aBuf);
-		return 0;
-	}
-	if(!GameServer()->OnMapChange(aBuf, sizeof(aBuf)))
-	{
-		return 0;
+		return nullptr;
 	}
-	if(!m_pMap->Load(aBuf))
+	auto pJob = std::make_shared<CMapLoadJob>(Storage(), pMapName, aBuf, Config()->m_SvSixup, Config()->m_SvMapPreload);
+	pJob->m_ImportSettings = GameServer()->OnMapChange(&pJob->m_vSettings);
+	return pJob;
+}
+
+void CServer::SwapMap(CMapLoadJob *pJob)
+{
+	if(pJob->m_pMap)
 	{
-		return 0;
+		m_pMap->Replace(pJob->m_pMap.get());
 	}
 
 	// reinit snapshot ids
 	m_IdPool.TimeoutIds();
 
 	// get the crc of the map
-	m_aCurrentMapSha256[MAP_TYPE_SIX] = m_pMap->Sha256();
-	m_aCurrentMapCrc[MAP_TYPE_SIX] = m_pMap->Crc();
+	m_aCurrentMapSha256[MAP_TYPE_SIX] = pJob->m_aSha256[MAP_TYPE_SIX];
+	m_aCurrentMapCrc[MAP_TYPE_SIX] = pJob->m_aCrc[MAP_TYPE_SIX];
 	char aBufMsg[256];
 	char aSha256[SHA256_MAXSTRSIZE];
 	sha256_str(m_aCurrentMapSha256[MAP_TYPE_SIX], aSha256, sizeof(aSha256));
-	str_format(aBufMsg, sizeof(aBufMsg), "%s sha256 is %s", aBuf, aSha256);
+	str_format(aBufMsg, sizeof(aBufMsg), "%s sha256 is %s", pJob->m_aPath, aSha256);
 	Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBufMsg);
 
-	str_copy(m_aCurrentMap, pMapName);
+	str_copy(m_aCurrentMap, pJob->m_aName);
 	m_pCurrentMapName = fs_filename(m_aCurrentMap);
 
-	// load complete map into memory for download
-	{
-		free(m_apCurrentMapData[MAP_TYPE_SIX]);
-		void *pData;
-		Storage()->ReadFile(aBuf, IStorage::TYPE_ALL, &pData, &m_aCurrentMapSize[MAP_TYPE_SIX]);
-		m_apCurrentMapData[MAP_TYPE_SIX] = (unsigned char *)pData;
-	}
+	// take the complete map for download, the previous map no longer refers to it
+	free(m_apCurrentMapData[MAP_TYPE_SIX]);
+	m_apCurrentMapData[MAP_TYPE_SIX] = pJob->m_apData[MAP_TYPE_SIX];
+	m_aCurrentMapSize[MAP_TYPE_SIX] = pJob->m_aSize[MAP_TYPE_SIX];
+	pJob->m_apData[MAP_TYPE_SIX] = nullptr;
 
 	if(Config()->m_SvMapsBaseUrl[0])
 	{
+		char aBuf[IO_MAX_PATH_LENGTH];
 		char aEscaped[256];
-		str_format(aBuf, sizeof(aBuf), "%s_%s.map", pMapName, aSha256);
+		str_format(aBuf, sizeof(aBuf), "%s_%s.map", pJob->m_aName, aSha256);
 		EscapeUrl(aEscaped, aBuf);
 		str_format(m_aMapDownloadUrl, sizeof(m_aMapDownloadUrl), "%s%s", Config()->m_SvMapsBaseUrl, aEscaped);
 	}
@@ -2926,30 +3283,30 @@ int CServer::LoadMap(const char *pMapName)
 		m_aMapDownloadUrl[0] = '\0';
 	}
 
-	// load sixup version of the map
+	// use sixup version of the map
 	if(Config()->m_SvSixup)
 	{
-		str_format(aBuf, sizeof(aBuf), "maps7/%s.map", pMapName);
-		void *pData;
-		if(!Storage()->ReadFile(aBuf, IStorage::TYPE_ALL, &pData, &m_aCurrentMapSize[MAP_TYPE_SIXUP]))
+		if(pJob->m_apData[MAP_TYPE_SIXUP] == nullptr)
 		{
 			Config()->m_SvSixup = 0;
 			if(m_pRegister)
 			{
 				m_pRegister->OnConfigChange();
 			}
-			log_error("sixup", "couldn't load map %s", aBuf);
+			log_error("sixup", "couldn't load map maps7/%s.map", pJob->m_aName);
 			log_info("sixup", "disabling 0.7 compatibility");
 		}
 		else
 		{
 			free(m_apCurrentMapData[MAP_TYPE_SIXUP]);
-			m_apCurrentMapData[MAP_TYPE_SIXUP] = (unsigned char *)pData;
+			m_apCurrentMapData[MAP_TYPE_SIXUP] = pJob->m_apData[MAP_TYPE_SIXUP];
+			m_aCurrentMapSize[MAP_TYPE_SIXUP] = pJob->m_aSize[MAP_TYPE_SIXUP];
+			pJob->m_apData[MAP_TYPE_SIXUP] = nullptr;
 
-			m_aCurrentMapSha256[MAP_TYPE_SIXUP] = sha256(m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP]);
-			m_aCurrentMapCrc[MAP_TYPE_SIXUP] = crc32(0, m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP]);
+			m_aCurrentMapSha256[MAP_TYPE_SIXUP] = pJob->m_aSha256[MAP_TYPE_SIXUP];
+			m_aCurrentMapCrc[MAP_TYPE_SIXUP] = pJob->m_aCrc[MAP_TYPE_SIXUP];
 			sha256_str(m_aCurrentMapSha256[MAP_TYPE_SIXUP], aSha256, sizeof(aSha256));
-			str_format(aBufMsg, sizeof(aBufMsg), "%s sha256 is %s", aBuf, aSha256);
+			str_format(aBufMsg, sizeof(aBufMsg), "maps7/%s.map sha256 is %s", pJob->m_aName, aSha256);
 			Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "sixup", aBufMsg);
 		}
 	}
@@ -2961,10 +3318,57 @@ int CServer::LoadMap(const char *pMapName)
 
 	for(int i = 0; i < MAX_CLIENTS; i++)
 		m_aPrevStates[i] = m_aClients[i].m_State;
+}
+
+int CServer::LoadMap(const char *pMapName)
+{
+	m_MapReload = false;
+	m_SameMapReload = false;
+
+	const int64_t LoadStart = time_get_nanoseconds().count();
+
+	std::shared_ptr<CMapLoadJob> pJob = PrepareMapLoad(pMapName);
+	if(!pJob)
+	{
+		return 0;
+	}
+	if(Config()->m_SvMapMemoryMapped && !pJob->m_ImportSettings)
+	{
+		// the download data is read separately, the game can modify the mapping
+		if(!m_pMap->Load(pJob->m_aPath, true, Config()->m_SvMapPreload) || !pJob->LoadDownloadData(m_pMap))
+		{
+			return 0;
+		}
+	}
+	else if(!pJob->Load())
+	{
+		return 0;
+	}
+	SwapMap(pJob.get());
+
+	const int64_t LoadEnd = time_get_nanoseconds().count();
+	log_info("server", "loaded map '%s' in %.2fms (mapped=%d)", pMapName, (LoadEnd - LoadStart) / 1e6, Config()->m_SvMapMemoryMapped);
 
 	return 1;
 }
 
+void CServer::StartMapLoad()
+{
+	const bool SameMapReload = m_SameMapReload;
+	m_MapReload = false;
+	m_SameMapReload = false;
+
+	m_pMapLoadJob = PrepareMapLoad(Config()->m_SvMap);
+	if(!m_pMapLoadJob)
+	{
+		log_error("server", "failed to load map. mapname='%s'", Config()->m_SvMap);
+		str_copy(Config()->m_SvMap, m_aCurrentMap);
+		return;
+	}
+	m_pMapLoadJob->m_SameMapReload = SameMapReload;
+	Engine()->AddJob(m_pMapLoadJob);
+}
+
 #ifdef CONF_DEBUG
 void CServer::UpdateDebugDummies(bool ForceDisconnect)
 {
@@ -3157,6 +3561,9 @@ int CServer::Run()
 		UpdateServerInfo();
 		while(m_RunServer < STOPPING)
 		{
+			const int64_t LoopStart = time_get_nanoseconds().count();
+			m_TickProfiler.SetEnabled(Config()->m_SvTickProfile);
+
 			if(NonActive)
 				PumpNetwork(PacketWaiting);
 
@@ -3166,86 +3573,129 @@ int CServer::Run()
 			int NewTicks = 0;
 
 			// load new map
-			if(m_MapReload || m_SameMapReload || m_CurrentGameTick >= MAX_TICK) // force reload to make sure the ticks stay within a valid range
+			bool MapLoaded = false;
+			bool SameMapReload = false;
+			const int64_t SwapStart = time_get_nanoseconds().count();
+			if(m_pMapLoadJob && m_pMapLoadJob->Done())
+			{
+				std::shared_ptr<CMapLoadJob> pJob = std::move(m_pMapLoadJob);
+				if(str_comp(pJob->m_aName, Config()->m_SvMap) != 0)
+				{
+					// map was changed again while loading, the reload flags are set for it
+					log_info("server", "discarding map '%s' loaded in the background", pJob->m_aName);
+				}
+				else if(!pJob->m_Success)
+				{
+					str_format(aBuf, sizeof(aBuf), "failed to load map. mapname='%s'", Config()->m_SvMap);
+					Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+					str_copy(Config()->m_SvMap, m_aCurrentMap);
+				}
+				else
+				{
+					// changes to the same map while it was loading are covered by it
+					m_MapReload = false;
+					m_SameMapReload = false;
+					SameMapReload = pJob->m_SameMapReload;
+					SwapMap(pJob.get());
+					MapLoaded = true;
+					log_info("server", "loaded map '%s' in the background in %.2fms", pJob->m_aName, pJob->m_Duration / 1e6);
+				}
+			}
+			else if((m_MapReload || m_SameMapReload || m_CurrentGameTick >= MAX_TICK) && !m_pMapLoadJob) // force reload to make sure the ticks stay within a valid range
 			{
-				const bool SameMapReload = m_SameMapReload;
-				// load map
-				if(LoadMap(Config()->m_SvMap))
+				if(Config()->m_SvMapBackgroundLoad && !Config()->m_SvMapMemoryMapped)
 				{
-					// new map loaded
+					StartMapLoad();
+				}
+				else
+				{
+					SameMapReload = m_SameMapReload;
+					// load map
+					MapLoaded = LoadMap(Config()->m_SvMap);
+					if(!MapLoaded)
+					{
+						str_format(aBuf, sizeof(aBuf), "failed to load map. mapname='%s'", Config()->m_SvMap);
+						Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+						str_copy(Config()->m_SvMap, m_aCurrentMap);
+					}
+				}
+			}
+			if(MapLoaded)
+			{
+				// new map loaded
 
-					// ask the game for the data it wants to persist past a map change
-					for(int i = 0; i < MAX_CLIENTS; i++)
+				// ask the game for the data it wants to persist past a map change
+				for(int i = 0; i < MAX_CLIENTS; i++)
+				{
+					if(m_aClients[i].m_State == CClient::STATE_INGAME)
 					{
-						if(m_aClients[i].m_State == CClient::STATE_INGAME)
-						{
-							m_aClients[i].m_HasPersistentData = GameServer()->OnClientDataPersist(i, m_aClients[i].m_pPersistentData);
-						}
+						m_aClients[i].m_HasPersistentData = GameServer()->OnClientDataPersist(i, m_aClients[i].m_pPersistentData);
 					}
+				}
 
 #ifdef CONF_DEBUG
-					UpdateDebugDummies(true);
+				UpdateDebugDummies(true);
 #endif
-					GameServer()->OnShutdown(m_pPersistentData);
-
-					for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
-					{
-						if(m_aClients[ClientId].m_State <= CClient::STATE_AUTH)
-							continue;
+				GameServer()->OnShutdown(m_pPersistentData);
 
-						if(SameMapReload)
-							SendMapReload(ClientId);
+				for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
+				{
+					if(m_aClients[ClientId].m_State <= CClient::STATE_AUTH)
+						continue;
 
-						SendMap(ClientId);
-						bool HasPersistentData = m_aClients[ClientId].m_HasPersistentData;
-						m_aClients[ClientId].Reset();
-						m_aClients[ClientId].m_HasPersistentData = HasPersistentData;
-						m_aClients[ClientId].m_State = CClient::STATE_CONNECTING;
-					}
+					if(SameMapReload)
+						SendMapReload(ClientId);
 
-					m_GameStartTime = time_get();
-					m_CurrentGameTick = MIN_TICK;
-					m_ServerInfoFirstRequest = 0;
-					Kernel()->ReregisterInterface(GameServer());
-					Console()->StoreCommands(true);
+					SendMap(ClientId);
+					bool HasPersistentData = m_aClients[ClientId].m_HasPersistentData;
+					m_aClients[ClientId].Reset();
+					m_aClients[ClientId].m_HasPersistentData = HasPersistentData;
+					m_aClients[ClientId].m_State = CClient::STATE_CONNECTING;
+				}
 
-					for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
-					{
-						CClient &Client = m_aClients[ClientId];
-						if(Client.m_State < CClient::STATE_PREAUTH)
-							continue;
+				m_GameStartTime = time_get();
+				m_CurrentGameTick = MIN_TICK;
+				m_ServerInfoFirstRequest = 0;
+				Kernel()->ReregisterInterface(GameServer());
+				Console()->StoreCommands(true);
 
-						// When doing a map change, a new Teehistorian file is created. For players that are already
-						// on the server, no PlayerJoin event is produced in Teehistorian from the network engine.
-						// Record PlayerJoin events here to record the Sixup version and player join event.
-						GameServer()->TeehistorianRecordPlayerJoin(ClientId, Client.m_Sixup);
+				for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
+				{
+					CClient &Client = m_aClients[ClientId];
+					if(Client.m_State < CClient::STATE_PREAUTH)
+						continue;
 
-						// Record the players auth state aswell if needed.
-						// This was recorded in AuthInit in the past.
-						if(IsRconAuthed(ClientId))
-						{
-							GameServer()->TeehistorianRecordAuthLogin(ClientId, GetAuthedState(ClientId), GetAuthName(ClientId));
-						}
-					}
+					// When doing a map change, a new Teehistorian file is created. For players that are already
+					// on the server, no PlayerJoin event is produced in Teehistorian from the network engine.
+					// Record PlayerJoin events here to record the Sixup version and player join event.
+					GameServer()->TeehistorianRecordPlayerJoin(ClientId, Client.m_Sixup);
 
-					GameServer()->OnInit(m_pPersistentData);
-					Console()->StoreCommands(false);
-					if(ErrorShutdown())
+					// Record the players auth state aswell if needed.
+					// This was recorded in AuthInit in the past.
+					if(IsRconAuthed(ClientId))
 					{
-						break;
+						GameServer()->TeehistorianRecordAuthLogin(ClientId, GetAuthedState(ClientId), GetAuthName(ClientId));
 					}
-					UpdateServerInfo(true);
 				}
-				else
+
+				GameServer()->OnInit(m_pPersistentData);
+				Console()->StoreCommands(false);
+				if(ErrorShutdown())
 				{
-					str_format(aBuf, sizeof(aBuf), "failed to load map. mapname='%s'", Config()->m_SvMap);
-					Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
-					str_copy(Config()->m_SvMap, m_aCurrentMap);
+					break;
 				}
+				UpdateServerInfo(true);
+				log_info("server", "map change stalled the tick for %.2fms", (time_get_nanoseconds().count() - SwapStart) / 1e6);
+			}
+
+			if(!NonActive && LastTime > TickStartTime(m_CurrentGameTick + 1))
+			{
+				m_TickJitter.Add(LastTime - TickStartTime(m_CurrentGameTick + 1));
 			}
 
 			while(LastTime > TickStartTime(m_CurrentGameTick + 1))
 			{
+				CProfileScope InputProfile(&m_TickProfiler, m_aProfileSections[PROFILE_INPUT]);
 				GameServer()->OnPreTickTeehistorian();
 
 #ifdef CONF_DEBUG
@@ -3291,8 +3741,12 @@ int CServer::Run()
 					if(!ClientHadInput)
 						GameServer()->OnClientPredictedInput(c, nullptr);
 				}
+				InputProfile.Stop();
 
-				GameServer()->OnTick();
+				{
+					CProfileScope TickProfile(&m_TickProfiler, m_aProfileSections[PROFILE_TICK]);
+					GameServer()->OnTick();
+				}
 				if(ErrorShutdown())
 				{
 					break;
@@ -3409,6 +3863,24 @@ int CServer::Run()
 				m_ReloadedWhenEmpty = false;
 			}
 
+			// send the packets queued during this iteration
+			m_NetServer.Flush();
+			m_NetServer.SetSendBatching(Config()->m_SvSendBatching);
+
+			if(m_TickProfiler.Enabled())
+			{
+				m_TickProfiler.Add(m_aProfileSections[PROFILE_BUSY], time_get_nanoseconds().count() - LoopStart);
+				if(NewTicks)
+					m_TickProfiler.EndTick();
+				if(Config()->m_SvTickProfileInterval && time_get() - m_LastTickProfileLog > Config()->m_SvTickProfileInterval * time_freq())
+				{
+					char aJson[4000];
+					m_TickProfiler.FormatJson(aJson, sizeof(aJson));
+					log_info("tick_profile", "%s", aJson);
+					m_LastTickProfileLog = time_get();
+				}
+			}
+
 			// wait for incoming data
 			if(NonActive && Config()->m_SvShutdownWhenEmpty)
 			{
@@ -3418,14 +3890,13 @@ int CServer::Run()
 				!m_aDemoRecorder[RECORDER_MANUAL].IsRecording() &&
 				!m_aDemoRecorder[RECORDER_AUTO].IsRecording())
 			{
-				PacketWaiting = net_socket_read_wait(m_NetServer.Socket(), 1s);
+				PacketWaiting = WaitForNetwork(time_get_nanoseconds() + 1s);
 			}
 			else
 			{
 				set_new_tick();
 				LastTime = time_get();
-				const auto MicrosecondsToWait = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds(TickStartTime(m_CurrentGameTick + 1) - LastTime)) + 1us;
-				PacketWaiting = MicrosecondsToWait > 0us ? net_socket_read_wait(m_NetServer.Socket(), MicrosecondsToWait) : true;
+				PacketWaiting = WaitForNetwork(std::chrono::nanoseconds(TickStartTime(m_CurrentGameTick + 1)) + 1us);
 			}
 			if(IsInterrupted())
 			{
@@ -3454,6 +3925,7 @@ int CServer::Run()
 	m_Econ.Shutdown();
 	m_Fifo.Shutdown();
 	Engine()->ShutdownJobs();
+	m_pMapLoadJob = nullptr;
 
 	GameServer()->OnShutdown(nullptr);
 	m_pMap->Unload();
@@ -3479,6 +3951,62 @@ void CServer::ConKick(IConsole::IResult *pResult, void *pUser)
 		((CServer *)pUser)->Kick(pResult->GetInteger(0), "Kicked by console");
 }
 
+void CServer::ConSnapshotDeltaCacheStats(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	const uint64_t Hits = pThis->m_SnapshotDeltaCache.Hits();
+	const uint64_t Misses = pThis->m_SnapshotDeltaCache.Misses();
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "hits=%" PRIu64 " misses=%" PRIu64 " hit_rate=%.2f%%", Hits, Misses, Hits + Misses ? Hits * 100.0 / (Hits + Misses) : 0.0);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+}
+
+void CServer::ConDbgTickJitter(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	CTickJitter &Jitter = pThis->m_TickJitter;
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "ticks=%" PRIu64 " mean=%.1fus max=%.1fus reactor=%s",
+		Jitter.m_Count,
+		Jitter.m_Count ? Jitter.m_Sum * 1000000.0 / time_freq() / Jitter.m_Count : 0.0,
+		Jitter.m_Max * 1000000.0 / time_freq(),
+		pThis->m_NetReactor ? "yes" : "no");
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	for(int i = 0; i < CTickJitter::NUM_BUCKETS; i++)
+	{
+		if(i < CTickJitter::NUM_BUCKETS - 1)
+			str_format(aBuf, sizeof(aBuf), "<%5dus: %" PRIu64, CTickJitter::ms_aBucketLimitsUs[i], Jitter.m_aBuckets[i]);
+		else
+			str_format(aBuf, sizeof(aBuf), ">=%4dus: %" PRIu64, CTickJitter::ms_aBucketLimitsUs[i - 1], Jitter.m_aBuckets[i]);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	}
+	Jitter.Reset();
+}
+
+void CServer::ConDbgTickProfile(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	const CTickProfiler &Profiler = pThis->m_TickProfiler;
+	if(pResult->NumArguments() == 1 && str_comp(pResult->GetString(0), "json") == 0)
+	{
+		char aJson[4000];
+		Profiler.FormatJson(aJson, sizeof(aJson));
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "tick_profile", aJson);
+		return;
+	}
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "ticks=%d enabled=%s", Profiler.NumSamples(), Profiler.Enabled() ? "yes" : "no");
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "tick_profile", aBuf);
+	for(int i = 0; i < Profiler.NumSections(); i++)
+	{
+		const CTickProfiler::CStats Stats = Profiler.Stats(i);
+		str_format(aBuf, sizeof(aBuf), "%-28s p50=%8.1fus p99=%8.1fus max=%8.1fus mean=%8.1fus",
+			Profiler.SectionName(i), Stats.m_P50 / 1e3, Stats.m_P99 / 1e3, Stats.m_Max / 1e3, Stats.m_Mean / 1e3);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "tick_profile", aBuf);
+	}
+}
+
 void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 {
 	char aBuf[1024];
@@ -3540,6 +4068,15 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 		}
 		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 	}
+
+	if(pName[0] == '\0')
+	{
+		NETSTATS Stats;
+		net_stats(&Stats);
+		str_format(aBuf, sizeof(aBuf), "net: sent_packets=%" PRIu64 " send_syscalls=%" PRIu64 " recv_packets=%" PRIu64 " recv_syscalls=%" PRIu64 " send_batching=%s",
+			Stats.sent_packets, Stats.send_syscalls, Stats.recv_packets, Stats.recv_syscalls, pThis->Config()->m_SvSendBatching ? "yes" : "no");
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	}
 }
 
 static int GetAuthLevel(const char *pLevel)
@@ -4077,6 +4614,12 @@ void CServer::ConDumpSqlServers(IConsole::IResult *pResult, void *pUserData)
 	}
 }
 
+void CServer::ConDumpSqlStats(IConsole::IResult *pResult, void *pUserData)
+{
+	CServer *pSelf = (CServer *)pUserData;
+	pSelf->DbPool()->PrintStats(pSelf->Console());
+}
+
 void CServer::ConReloadAnnouncement(IConsole::IResult *pResult, void *pUserData)
 {
 	CServer *pThis = static_cast<CServer *>(pUserData);
@@ -4371,9 +4914,13 @@ void CServer::RegisterCommands()
 	Console()->Register("stoprecord", "", CFGFLAG_SERVER, ConStopRecord, this, "Stop recording");
 
 	Console()->Register("reload", "", CFGFLAG_SERVER, ConMapReload, this, "Reload the map");
+	Console()->Register("dbg_tick_jitter", "", CFGFLAG_SERVER, ConDbgTickJitter, this, "Show a histogram of how late the ticks started since the last call and reset it");
+	Console()->Register("dbg_tick_profile", "?s['json']", CFGFLAG_SERVER, ConDbgTickProfile, this, "Show the p50, p99, max and mean time per tick of the server phases over the last ticks");
+	Console()->Register("snapshot_delta_cache_stats", "", CFGFLAG_SERVER, ConSnapshotDeltaCacheStats, this, "Show the hit rate of the snapshot delta cache (see sv_snapshot_delta_cache)");
 
 	Console()->Register("add_sqlserver", "s['r'|'w'] s[Database] s[Prefix] s[User] s[Password] s[IP] i[Port] ?i[SetUpDatabase ?]", CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, ConAddSqlServer, this, "add a sqlserver");
 	Console()->Register("dump_sqlservers", "s['r'|'w']", CFGFLAG_SERVER, ConDumpSqlServers, this, "dumps all sqlservers readservers = r, writeservers = w");
+	Console()->Register("dump_sqlstats", "", CFGFLAG_SERVER, ConDumpSqlStats, this, "dumps queue depths and query latencies of the sql threads");
 
 	Console()->Register("auth_add", "s[ident] s[level] r[pw]", CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, ConAuthAdd, this, "Add a rcon key");
 	Console()->Register("auth_add_p", "s[ident] s[level] s[hash] s[salt]", CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, ConAuthAddHashed, this, "Add a prehashed rcon key");
@@ -4439,6 +4986,7 @@ void *CServer::SnapNewItem(int Type, int Id, int Size)
 void CServer::SnapSetStaticsize(int ItemType, int Size)
 {
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
+	m_SnapshotWorkers.SetStaticsize(ItemType, Size);
 }
 
 CServer *CreateServer() { return new CServer(); }
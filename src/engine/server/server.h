@@ -7,6 +7,8 @@
 #include "authmanager.h"
 #include "name_ban.h"
 #include "snap_id_pool.h"
+#include "snapshot_delta_cache.h"
+#include "snapshot_workers.h"
 
 #include <base/hash.h>
 
@@ -20,6 +22,7 @@
 #include <engine/shared/network.h>
 #include <engine/shared/protocol.h>
 #include <engine/shared/snapshot.h>
+#include <engine/shared/tick_profiler.h>
 #include <engine/shared/uuid_manager.h>
 
 #include <memory>
@@ -216,8 +219,22 @@ public:
 
 	CSnapshotDelta m_SnapshotDelta;
 	CSnapshotBuilder m_SnapshotBuilder;
+	CSnapshotWorkers m_SnapshotWorkers;
+	CSnapshotDeltaCache m_SnapshotDeltaCache;
+
+	// finished snapshot of a client that is encoded by the snapshot workers
+	class CSnapshotSlot
+	{
+	public:
+		int m_SnapshotSize;
+		char m_aData[CSnapshot::MAX_SIZE];
+		CSnapshotPacket m_Packet;
+	};
+	std::unique_ptr<CSnapshotSlot> m_apSnapshotSlots[MAX_CLIENTS];
+
 	CSnapIdPool m_IdPool;
 	CNetServer m_NetServer;
+	NETREACTOR m_NetReactor = nullptr;
 	CEcon m_Econ;
 	CFifo m_Fifo;
 	CServerBan m_ServerBan;
@@ -267,6 +284,10 @@ public:
 	unsigned int m_aCurrentMapSize[NUM_MAP_TYPES];
 	char m_aMapDownloadUrl[256];
 
+	// next map that is loaded in the background
+	class CMapLoadJob;
+	std::shared_ptr<CMapLoadJob> m_pMapLoadJob;
+
 	CDemoRecorder m_aDemoRecorder[NUM_RECORDERS];
 	CAuthManager m_AuthManager;
 
@@ -335,6 +356,11 @@ public:
 	int GetClientVersion(int ClientId) const override;
 	int SendMsg(CMsgPacker *pMsg, int Flags, int ClientId) override;
 
+	// Stores the snapshot of the client and encodes it against the last snapshot acknowledged by the client.
+	// Only touches the state of this client, so it can run on a snapshot worker.
+	// The delta cache is optional.
+	static void EncodeClientSnapshot(CClient *pClient, int Tick, int TickSpeed, const CSnapshot *pData, int SnapshotSize, CSnapshotDelta *pDelta, CSnapshotDeltaCache *pDeltaCache, CSnapshotPacket *pPacket);
+	void SendClientSnapshot(int ClientId, const CSnapshotPacket *pPacket);
 	void DoSnapshot();
 
 	static int NewClientCallback(int ClientId, void *pUser, bool Sixup);
@@ -415,11 +441,51 @@ public:
 	void UpdateServerInfo(bool Resend = false);
 
 	void PumpNetwork(bool PacketWaiting);
+	bool WaitForNetwork(std::chrono::nanoseconds Deadline);
+
+	// how late the main loop starts to process the ticks, see dbg_tick_jitter
+	class CTickJitter
+	{
+	public:
+		enum
+		{
+			NUM_BUCKETS = 8,
+		};
+		static const int ms_aBucketLimitsUs[NUM_BUCKETS - 1];
+
+		uint64_t m_aBuckets[NUM_BUCKETS];
+		uint64_t m_Count;
+		int64_t m_Sum;
+		int64_t m_Max;
+
+		CTickJitter() { Reset(); }
+		void Reset();
+		void Add(int64_t Lateness);
+	};
+	CTickJitter m_TickJitter;
+
+	// phases of the main loop, see dbg_tick_profile
+	enum
+	{
+		PROFILE_BUSY,
+		PROFILE_NETWORK,
+		PROFILE_INPUT,
+		PROFILE_TICK,
+		PROFILE_SNAP,
+		PROFILE_SNAP_GAME,
+		NUM_PROFILE_SECTIONS
+	};
+	CTickProfiler m_TickProfiler;
+	int m_aProfileSections[NUM_PROFILE_SECTIONS];
+	int64_t m_LastTickProfileLog = 0;
 
 	void ChangeMap(const char *pMap) override;
 	const char *GetMapName() const override;
 	void ReloadMap() override;
+	std::shared_ptr<CMapLoadJob> PrepareMapLoad(const char *pMapName);
+	void SwapMap(CMapLoadJob *pJob);
 	int LoadMap(const char *pMapName);
+	void StartMapLoad();
 
 	void SaveDemo(int ClientId, float Time) override;
 	void StartRecord(int ClientId) override;
@@ -428,9 +494,14 @@ public:
 	void StopDemos() override;
 
 	int Run();
+	// sets the tick without running the main loop, for replaying teehistorian
+	void SetTick(int Tick) { m_CurrentGameTick = Tick; }
 
 	static void ConKick(IConsole::IResult *pResult, void *pUser);
 	static void ConStatus(IConsole::IResult *pResult, void *pUser);
+	static void ConSnapshotDeltaCacheStats(IConsole::IResult *pResult, void *pUser);
+	static void ConDbgTickJitter(IConsole::IResult *pResult, void *pUser);
+	static void ConDbgTickProfile(IConsole::IResult *pResult, void *pUser);
 	static void ConShutdown(IConsole::IResult *pResult, void *pUser);
 	static void ConRecord(IConsole::IResult *pResult, void *pUser);
 	static void ConStopRecord(IConsole::IResult *pResult, void *pUser);
@@ -450,6 +521,7 @@ public:
 	// console commands for sqlmasters
 	static void ConAddSqlServer(IConsole::IResult *pResult, void *pUserData);
 	static void ConDumpSqlServers(IConsole::IResult *pResult, void *pUserData);
+	static void ConDumpSqlStats(IConsole::IResult *pResult, void *pUserData);
 
 	static void ConReloadAnnouncement(IConsole::IResult *pResult, void *pUserData);
 	static void ConReloadMaplist(IConsole::IResult *pResult, void *pUserData);
@@ -526,6 +598,8 @@ public:
 
 	bool IsSixup(int ClientId) const override { return ClientId != SERVER_DEMO_CLIENT && m_aClients[ClientId].m_Sixup; }
 
+	CTickProfiler *TickProfiler() override { return &m_TickProfiler; }
+
 	void SetLoggers(std::shared_ptr<ILogger> &&pFileLogger, std::shared_ptr<ILogger> &&pStdoutLogger);
 
 #ifdef CONF_FAMILY_UNIX
@@ -0,0 +1,59 @@
+#include "snapshot_delta_cache.h"
+
+#include "snapshot_workers.h"
+
+#include <base/system.h>
+
+void CSnapshotDeltaCache::Clear()
+{
+	const CLockScope LockScope(m_Lock);
+	m_vpEntries.clear();
+}
+
+bool CSnapshotDeltaCache::Find(const CSnapshot *pFrom, int FromSize, unsigned FromCrc, const CSnapshot *pTo, int ToSize, unsigned ToCrc, bool Sixup, CSnapshotPacket *pPacket)
+{
+	// entries are never modified or removed while the snapshots are encoded,
+	// so they can be compared without holding the lock
+	std::vector<const CEntry *> vpCandidates;
+	{
+		const CLockScope LockScope(m_Lock);
+		for(const auto &pEntry : m_vpEntries)
+		{
+			if(pEntry->m_FromSize == FromSize && pEntry->m_FromCrc == FromCrc &&
+				pEntry->m_ToSize == ToSize && pEntry->m_ToCrc == ToCrc && pEntry->m_Sixup == Sixup)
+			{
+				vpCandidates.push_back(pEntry.get());
+			}
+		}
+	}
+
+	for(const CEntry *pEntry : vpCandidates)
+	{
+		if((pEntry->m_pFrom == pFrom || mem_comp(pEntry->m_pFrom, pFrom, FromSize) == 0) &&
+			(pEntry->m_pTo == pTo || mem_comp(pEntry->m_pTo, pTo, ToSize) == 0))
+		{
+			pPacket->m_DataSize = pEntry->m_vData.size();
+			mem_copy(pPacket->m_aData, pEntry->m_vData.data(), pEntry->m_vData.size());
+			m_Hits++;
+			return true;
+		}
+	}
+	m_Misses++;
+	return false;
+}
+
+void CSnapshotDeltaCache::Add(const CSnapshot *pFrom, int FromSize, unsigned FromCrc, const CSnapshot *pTo, int ToSize, unsigned ToCrc, bool Sixup, const CSnapshotPacket *pPacket)
+{
+	auto pEntry = std::make_unique<CEntry>();
+	pEntry->m_pFrom = pFrom;
+	pEntry->m_FromSize = FromSize;
+	pEntry->m_FromCrc = FromCrc;
+	pEntry->m_pTo = pTo;
+	pEntry->m_ToSize = ToSize;
+	pEntry->m_ToCrc = ToCrc;
+	pEntry->m_Sixup = Sixup;
+	pEntry->m_vData.assign(pPacket->m_aData, pPacket->m_aData + pPacket->m_DataSize);
+
+	const CLockScope LockScope(m_Lock);
+	m_vpEntries.push_back(std::move(pEntry));
+}
@@ -0,0 +1,75 @@
+#ifndef ENGINE_SERVER_SNAPSHOT_DELTA_CACHE_H
+#define ENGINE_SERVER_SNAPSHOT_DELTA_CACHE_H
+
+#include <base/lock.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class CSnapshot;
+class CSnapshotPacket;
+
+/**
+ * Compressed snapshot deltas of the current tick, shared between clients
+ * whose base and target snapshots are byte-identical, e.g. spectators of
+ * the same player.
+ *
+ * Entries only reference the snapshots, which must stay alive until the
+ * cache is cleared. The server clears the cache before encoding the
+ * snapshots of each tick, the snapshots are kept in the snapshot storage
+ * of the clients.
+ *
+ * Thread-safe, so it can be used by the snapshot workers.
+ */
+class CSnapshotDeltaCache
+{
+	class CEntry
+	{
+	public:
+		const CSnapshot *m_pFrom;
+		int m_FromSize;
+		unsigned m_FromCrc;
+		const CSnapshot *m_pTo;
+		int m_ToSize;
+		unsigned m_ToCrc;
+		bool m_Sixup;
+		std::vector<char> m_vData;
+	};
+
+	CLock m_Lock;
+	std::vector<std::unique_ptr<CEntry>> m_vpEntries GUARDED_BY(m_Lock);
+
+	std::atomic<uint64_t> m_Hits{0};
+	std::atomic<uint64_t> m_Misses{0};
+
+public:
+	void Clear() REQUIRES(!m_Lock);
+
+	/**
+	 * Looks up the compressed delta between two snapshots.
+	 *
+	 * @param pFrom The base snapshot.
+	 * @param FromSize Size of the base snapshot.
+	 * @param FromCrc CRC of the base snapshot.
+	 * @param pTo The target snapshot.
+	 * @param ToSize Size of the target snapshot.
+	 * @param ToCrc CRC of the target snapshot.
+	 * @param Sixup Whether the delta is for a 0.7 client, which uses different static item sizes.
+	 * @param pPacket Receives the compressed delta on success.
+	 *
+	 * @return `true` if the delta was found, `false` otherwise.
+	 */
+	bool Find(const CSnapshot *pFrom, int FromSize, unsigned FromCrc, const CSnapshot *pTo, int ToSize, unsigned ToCrc, bool Sixup, CSnapshotPacket *pPacket) REQUIRES(!m_Lock);
+
+	/**
+	 * Adds the compressed delta between two snapshots, see @link Find @endlink.
+	 */
+	void Add(const CSnapshot *pFrom, int FromSize, unsigned FromCrc, const CSnapshot *pTo, int ToSize, unsigned ToCrc, bool Sixup, const CSnapshotPacket *pPacket) REQUIRES(!m_Lock);
+
+	uint64_t Hits() const { return m_Hits; }
+	uint64_t Misses() const { return m_Misses; }
+};
+
+#endif
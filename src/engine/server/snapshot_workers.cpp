@@ -0,0 +1,78 @@
+#include "snapshot_workers.h"
+
+#include <base/math.h>
+#include <base/system.h>
+
+class CSnapshotWorkers::CWorkerJob : public IJob
+{
+	CSnapshotWorkers *m_pWorkers;
+	int m_Worker;
+	int m_NumTasks;
+	const FTask &m_Task;
+
+	void Run() override
+	{
+		CSnapshotDelta *pDelta = m_pWorkers->m_vpDeltas[m_Worker].get();
+		for(int Task = m_Worker; Task < m_NumTasks; Task += m_pWorkers->NumThreads())
+		{
+			m_Task(Task, pDelta);
+		}
+		m_pWorkers->m_Finished.Signal();
+	}
+
+public:
+	CWorkerJob(CSnapshotWorkers *pWorkers, int Worker, int NumTasks, const FTask &Task) :
+		m_pWorkers(pWorkers),
+		m_Worker(Worker),
+		m_NumTasks(NumTasks),
+		m_Task(Task)
+	{
+	}
+};
+
+CSnapshotWorkers::~CSnapshotWorkers()
+{
+	if(NumThreads() > 0)
+	{
+		Shutdown();
+	}
+}
+
+void CSnapshotWorkers::Init(int NumThreads, const CSnapshotDelta &Delta)
+{
+	dbg_assert(NumThreads > 0, "NumThreads invalid");
+	dbg_assert(m_vpDeltas.empty(), "Snapshot workers already running");
+	m_vpDeltas.reserve(NumThreads);
+	for(int i = 0; i < NumThreads; i++)
+	{
+		m_vpDeltas.push_back(std::make_unique<CSnapshotDelta>(Delta));
+	}
+	m_JobPool.Init(NumThreads);
+}
+
+void CSnapshotWorkers::Shutdown()
+{
+	m_JobPool.Shutdown();
+	m_vpDeltas.clear();
+}
+
+void CSnapshotWorkers::SetStaticsize(int ItemType, size_t Size)
+{
+	for(auto &pDelta : m_vpDeltas)
+	{
+		pDelta->SetStaticsize(ItemType, Size);
+	}
+}
+
+void CSnapshotWorkers::Run(int NumTasks, const FTask &Task)
+{
+	const int NumJobs = minimum(NumTasks, NumThreads());
+	for(int Worker = 0; Worker < NumJobs; Worker++)
+	{
+		m_JobPool.Add(std::make_shared<CWorkerJob>(this, Worker, NumTasks, Task));
+	}
+	for(int Worker = 0; Worker < NumJobs; Worker++)
+	{
+		m_Finished.Wait();
+	}
+}
@@ -0,0 +1,71 @@
+#ifndef ENGINE_SERVER_SNAPSHOT_WORKERS_H
+#define ENGINE_SERVER_SNAPSHOT_WORKERS_H
+
+#include <base/tl/threading.h>
+
+#include <engine/shared/jobs.h>
+#include <engine/shared/snapshot.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * Delta-encoded and compressed snapshot of a single client, ready to be
+ * split into snapshot messages.
+ */
+class CSnapshotPacket
+{
+public:
+	int m_Crc;
+	int m_DeltaTick;
+	/**
+	 * Size of the compressed delta in `m_aData`, 0 if the delta is empty.
+	 */
+	int m_DataSize;
+	char m_aData[CSnapshot::MAX_SIZE];
+};
+
+/**
+ * Worker threads which delta-encode and compress snapshots in parallel.
+ *
+ * Every worker has its own `CSnapshotDelta`, so the static item sizes
+ * registered by the game must be forwarded with @link SetStaticsize @endlink.
+ */
+class CSnapshotWorkers
+{
+	class CWorkerJob;
+
+	CJobPool m_JobPool;
+	std::vector<std::unique_ptr<CSnapshotDelta>> m_vpDeltas;
+	CSemaphore m_Finished;
+
+public:
+	using FTask = std::function<void(int Task, CSnapshotDelta *pDelta)>;
+
+	~CSnapshotWorkers();
+
+	/**
+	 * Starts the worker threads.
+	 *
+	 * @param NumThreads The number of worker threads.
+	 * @param Delta Snapshot delta whose static item sizes are copied to all workers.
+	 */
+	void Init(int NumThreads, const CSnapshotDelta &Delta);
+	void Shutdown();
+	int NumThreads() const { return m_vpDeltas.size(); }
+
+	void SetStaticsize(int ItemType, size_t Size);
+
+	/**
+	 * Runs the tasks `0` to `NumTasks - 1` on the worker threads and waits
+	 * until all of them are completed. The tasks are distributed to the
+	 * workers round-robin, every worker runs its tasks in ascending order.
+	 *
+	 * @param NumTasks The number of tasks.
+	 * @param Task The function to run for every task.
+	 */
+	void Run(int NumTasks, const FTask &Task);
+};
+
+#endif
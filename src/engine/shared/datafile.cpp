@@ -9,13 +9,21 @@
 #include <base/log.h>
 #include <base/math.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
 
+#include <engine/engine.h>
+#include <engine/shared/jobs.h>
 #include <engine/storage.h>
 
 #include <zlib.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <cstdlib>
+#include <functional>
 #include <limits>
+#include <thread>
 #include <unordered_set>
 
 static constexpr int MAX_ITEM_TYPE = 0xFFFF;
@@ -42,6 +50,65 @@ static inline int SwapEndianInt(int Number)
 	return Number;
 }
 
+// Runs the tasks 0 to NumTasks - 1 on the calling thread and on jobs of the
+// engine, returns when all of them are done. Must not be called from a job of
+// the same engine, as it waits for the jobs it adds.
+class CParallelTasks
+{
+	using FTask = std::function<void(int Task)>;
+
+	class CWorkerJob : public IJob
+	{
+		CParallelTasks *m_pTasks;
+
+		void Run() override
+		{
+			m_pTasks->Work();
+			m_pTasks->m_Finished.Signal();
+		}
+
+	public:
+		CWorkerJob(CParallelTasks *pTasks) :
+			m_pTasks(pTasks)
+		{
+		}
+	};
+
+	const FTask &m_Task;
+	const int m_NumTasks;
+	std::atomic<int> m_NextTask{0};
+	CSemaphore m_Finished;
+
+	void Work()
+	{
+		for(int Task = m_NextTask++; Task < m_NumTasks; Task = m_NextTask++)
+		{
+			m_Task(Task);
+		}
+	}
+
+	CParallelTasks(int NumTasks, const FTask &Task) :
+		m_Task(Task), m_NumTasks(NumTasks)
+	{
+	}
+
+public:
+	static void Run(IEngine *pEngine, int NumTasks, const FTask &Task)
+	{
+		CParallelTasks Tasks(NumTasks, Task);
+		const int NumJobs = pEngine == nullptr ? 0 : minimum<int>(NumTasks, std::thread::hardware_concurrency()) - 1;
+		for(int Job = 0; Job < NumJobs; Job++)
+		{
+			pEngine->AddJob(std::make_shared<CWorkerJob>(&Tasks));
+		}
+		Tasks.Work();
+		for(int Job = 0; Job < NumJobs; Job++)
+		{
+			Tasks.m_Finished.Wait();
+		}
+	}
+};
+
 class CItemEx
 {
 public:
@@ -125,6 +192,109 @@ public:
 	char *m_pDataStart;
 };
 
+// Bump allocator for the decompressed data of memory mapped datafiles. The
+// data is only freed all at once when the datafile is closed.
+class CDatafileArena
+{
+	static constexpr size_t BLOCK_SIZE = 1024 * 1024;
+	static constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+
+	class CBlock
+	{
+	public:
+		CBlock *m_pPrev;
+		size_t m_Size;
+		size_t m_Used;
+
+		char *Data() { return reinterpret_cast<char *>(this) + HeaderSize(); }
+		static constexpr size_t HeaderSize() { return (sizeof(CBlock) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; }
+	};
+
+	CBlock *m_pCurrent;
+	CBlock *m_pFull;
+
+	static CBlock *NewBlock(size_t Size, CBlock *pPrev)
+	{
+		CBlock *pBlock = static_cast<CBlock *>(malloc(CBlock::HeaderSize() + Size));
+		if(pBlock == nullptr)
+			return nullptr;
+		pBlock->m_pPrev = pPrev;
+		pBlock->m_Size = Size;
+		pBlock->m_Used = 0;
+		return pBlock;
+	}
+
+	static void FreeBlocks(CBlock *pBlock)
+	{
+		while(pBlock != nullptr)
+		{
+			CBlock *pPrev = pBlock->m_pPrev;
+			free(pBlock);
+			pBlock = pPrev;
+		}
+	}
+
+public:
+	void Init()
+	{
+		m_pCurrent = nullptr;
+		m_pFull = nullptr;
+	}
+
+	void *Allocate(size_t Size)
+	{
+		Size = (Size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		if(Size > BLOCK_SIZE / 4)
+		{
+			// large data gets its own block, so that the current one can still be filled
+			m_pFull = NewBlock(Size, m_pFull);
+			return m_pFull == nullptr ? nullptr : m_pFull->Data();
+		}
+		if(m_pCurrent == nullptr || m_pCurrent->m_Size - m_pCurrent->m_Used < Size)
+		{
+			CBlock *pBlock = NewBlock(BLOCK_SIZE, nullptr);
+			if(pBlock == nullptr)
+				return nullptr;
+			if(m_pCurrent != nullptr)
+			{
+				m_pCurrent->m_pPrev = m_pFull;
+				m_pFull = m_pCurrent;
+			}
+			m_pCurrent = pBlock;
+		}
+		void *pData = m_pCurrent->Data() + m_pCurrent->m_Used;
+		m_pCurrent->m_Used += Size;
+		return pData;
+	}
+
+	void Free()
+	{
+		FreeBlocks(m_pCurrent);
+		FreeBlocks(m_pFull);
+		Init();
+	}
+};
+
+// A compressed data item while it is being loaded
+class CDatafileDataLoad
+{
+public:
+	int m_Index;
+	const void *m_pSource;
+	void *m_pOwnedSource; // compressed data read from the file, nullptr if it is mapped
+	unsigned m_Size;
+	void *m_pDestination;
+	unsigned m_UncompressedSize;
+	unsigned long m_ActualUncompressedSize;
+	int m_Result;
+
+	void Decompress()
+	{
+		m_ActualUncompressedSize = m_UncompressedSize;
+		m_Result = uncompress(static_cast<Bytef *>(m_pDestination), &m_ActualUncompressedSize, static_cast<const Bytef *>(m_pSource), m_Size);
+	}
+};
+
 class CDatafile
 {
 public:
@@ -137,8 +307,25 @@ public:
 	int m_DataStartOffset;
 	void **m_ppDataPtrs;
 	int *m_pDataSizes;
+	bool *m_pDataOwned; // whether the data must be freed, otherwise it is in the file mapping or the arena
 	char *m_pData;
 
+	// file contents, if the file is memory mapped or was opened from memory
+	const char *m_pContents;
+	char *m_pMapping;
+	int64_t m_MappingSize;
+	mutable CDatafileArena m_Arena;
+
+	void FreeData(int Index) const
+	{
+		if(m_pDataOwned[Index])
+		{
+			free(m_ppDataPtrs[Index]);
+		}
+		m_ppDataPtrs[Index] = nullptr;
+		m_pDataOwned[Index] = false;
+	}
+
 	int GetFileDataSize(int Index) const
 	{
 		dbg_assert(Index >= 0 && Index < m_Header.m_NumRawData, "Invalid Index: %d", Index);
@@ -179,6 +366,86 @@ public:
 		return Size;
 	}
 
+	// Reads the compressed data of a v4 data item and allocates the memory for
+	// the uncompressed data. Only Decompress may be called on another thread.
+	bool BeginLoad(int Index, CDatafileDataLoad *pLoad) const
+	{
+		pLoad->m_Index = Index;
+		pLoad->m_pOwnedSource = nullptr;
+		pLoad->m_Size = GetFileDataSize(Index);
+		pLoad->m_UncompressedSize = m_Info.m_pDataSizes[Index];
+		const unsigned DataSize = pLoad->m_Size;
+		const unsigned OriginalUncompressedSize = pLoad->m_UncompressedSize;
+		const int64_t DataOffset = m_DataStartOffset + m_Info.m_pDataOffsets[Index];
+		log_trace("datafile", "loading data. index=%d size=%d uncompressed=%d", Index, DataSize, OriginalUncompressedSize);
+		if(OriginalUncompressedSize == 0)
+		{
+			log_error("datafile", "data size invalid. data will be ignored. index=%d size=%d uncompressed=%d", Index, DataSize, OriginalUncompressedSize);
+			m_ppDataPtrs[Index] = nullptr;
+			m_pDataSizes[Index] = -1;
+			return false;
+		}
+
+		// read the compressed data, unless it is in memory already
+		if(m_pContents != nullptr)
+		{
+			pLoad->m_pSource = m_pContents + DataOffset;
+		}
+		else
+		{
+			pLoad->m_pOwnedSource = malloc(DataSize);
+			if(pLoad->m_pOwnedSource == nullptr)
+			{
+				log_error("datafile", "out of memory. could not allocate memory for compressed data. index=%d size=%d", Index, DataSize);
+				m_ppDataPtrs[Index] = nullptr;
+				m_pDataSizes[Index] = -1;
+				return false;
+			}
+			unsigned ActualDataSize = 0;
+			if(io_seek(m_File, DataOffset, IOSEEK_START) == 0)
+			{
+				ActualDataSize = io_read(m_File, pLoad->m_pOwnedSource, DataSize);
+			}
+			if(DataSize != ActualDataSize)
+			{
+				log_error("datafile", "truncation error. could not read all compressed data. index=%d wanted=%d got=%d", Index, DataSize, ActualDataSize);
+				free(pLoad->m_pOwnedSource);
+				m_ppDataPtrs[Index] = nullptr;
+				m_pDataSizes[Index] = -1;
+				return false;
+			}
+			pLoad->m_pSource = pLoad->m_pOwnedSource;
+		}
+
+		m_pDataOwned[Index] = m_pMapping == nullptr;
+		m_ppDataPtrs[Index] = m_pDataOwned[Index] ? malloc(OriginalUncompressedSize) : m_Arena.Allocate(OriginalUncompressedSize);
+		if(m_ppDataPtrs[Index] == nullptr)
+		{
+			free(pLoad->m_pOwnedSource);
+			log_error("datafile", "out of memory. could not allocate memory for uncompressed data. index=%d size=%d", Index, OriginalUncompressedSize);
+			m_pDataOwned[Index] = false;
+			m_pDataSizes[Index] = -1;
+			return false;
+		}
+		pLoad->m_pDestination = m_ppDataPtrs[Index];
+		return true;
+	}
+
+	bool EndLoad(CDatafileDataLoad *pLoad) const
+	{
+		const int Index = pLoad->m_Index;
+		free(pLoad->m_pOwnedSource);
+		if(pLoad->m_Result != Z_OK || pLoad->m_ActualUncompressedSize != pLoad->m_UncompressedSize)
+		{
+			log_error("datafile", "failed to uncompress data. index=%d result=%d wanted=%d got=%ld", Index, pLoad->m_Result, pLoad->m_UncompressedSize, pLoad->m_ActualUncompressedSize);
+			FreeData(Index);
+			m_pDataSizes[Index] = -1;
+			return false;
+		}
+		m_pDataSizes[Index] = pLoad->m_UncompressedSize;
+		return true;
+	}
+
 	void *GetData(int Index, bool Swap) const
 	{
 		// Invalid data indices may appear in map items
@@ -200,63 +467,28 @@ public:
 		}
 
 		const unsigned DataSize = GetFileDataSize(Index);
+		const int64_t DataOffset = m_DataStartOffset + m_Info.m_pDataOffsets[Index];
 		if(m_Info.m_pDataSizes != nullptr)
 		{
 			// v4 has compressed data
-			const unsigned OriginalUncompressedSize = m_Info.m_pDataSizes[Index];
-			log_trace("datafile", "loading data. index=%d size=%d uncompressed=%d", Index, DataSize, OriginalUncompressedSize);
-			if(OriginalUncompressedSize == 0)
+			CDatafileDataLoad Load;
+			if(!BeginLoad(Index, &Load))
 			{
-				log_error("datafile", "data size invalid. data will be ignored. index=%d size=%d uncompressed=%d", Index, DataSize, OriginalUncompressedSize);
-				m_ppDataPtrs[Index] = nullptr;
-				m_pDataSizes[Index] = -1;
 				return nullptr;
 			}
-
-			// read the compressed data
-			void *pCompressedData = malloc(DataSize);
-			if(pCompressedData == nullptr)
+			Load.Decompress();
+			if(!EndLoad(&Load))
 			{
-				log_error("datafile", "out of memory. could not allocate memory for compressed data. index=%d size=%d", Index, DataSize);
-				m_ppDataPtrs[Index] = nullptr;
-				m_pDataSizes[Index] = -1;
 				return nullptr;
 			}
-			unsigned ActualDataSize = 0;
-			if(io_seek(m_File, m_DataStartOffset + m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
-			{
-				ActualDataSize = io_read(m_File, pCompressedData, DataSize);
-			}
-			if(DataSize != ActualDataSize)
-			{
-				log_error("datafile", "truncation error. could not read all compressed data. index=%d wanted=%d got=%d", Index, DataSize, ActualDataSize);
-				free(pCompressedData);
-				m_ppDataPtrs[Index] = nullptr;
-				m_pDataSizes[Index] = -1;
-				return nullptr;
-			}
-
-			// decompress the data
-			m_ppDataPtrs[Index] = static_cast<char *>(malloc(OriginalUncompressedSize));
-			if(m_ppDataPtrs[Index] == nullptr)
-			{
-				free(pCompressedData);
-				log_error("datafile", "out of memory. could not allocate memory for uncompressed data. index=%d size=%d", Index, OriginalUncompressedSize);
-				m_pDataSizes[Index] = -1;
-				return nullptr;
-			}
-			unsigned long UncompressedSize = OriginalUncompressedSize;
-			const int Result = uncompress(static_cast<Bytef *>(m_ppDataPtrs[Index]), &UncompressedSize, static_cast<Bytef *>(pCompressedData), DataSize);
-			free(pCompressedData);
-			if(Result != Z_OK || UncompressedSize != OriginalUncompressedSize)
-			{
-				log_error("datafile", "failed to uncompress data. index=%d result=%d wanted=%d got=%ld", Index, Result, OriginalUncompressedSize, UncompressedSize);
-				free(m_ppDataPtrs[Index]);
-				m_ppDataPtrs[Index] = nullptr;
-				m_pDataSizes[Index] = -1;
-				return nullptr;
-			}
-			m_pDataSizes[Index] = OriginalUncompressedSize;
+		}
+		else if(m_pMapping != nullptr)
+		{
+			// uncompressed data is used from the mapping directly
+			log_trace("datafile", "mapping data. index=%d size=%d", Index, DataSize);
+			m_ppDataPtrs[Index] = m_pMapping + DataOffset;
+			m_pDataOwned[Index] = false;
+			m_pDataSizes[Index] = DataSize;
 		}
 		else
 		{
@@ -268,16 +500,22 @@ public:
 				m_pDataSizes[Index] = -1;
 				return nullptr;
 			}
+			m_pDataOwned[Index] = true;
 			unsigned ActualDataSize = 0;
-			if(io_seek(m_File, m_DataStartOffset + m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
+			if(m_pContents != nullptr)
+			{
+				// the contents are not ours to modify
+				mem_copy(m_ppDataPtrs[Index], m_pContents + DataOffset, DataSize);
+				ActualDataSize = DataSize;
+			}
+			else if(io_seek(m_File, DataOffset, IOSEEK_START) == 0)
 			{
 				ActualDataSize = io_read(m_File, m_ppDataPtrs[Index], DataSize);
 			}
 			if(DataSize != ActualDataSize)
 			{
 				log_error("datafile", "truncation error. could not read all uncompressed data. index=%d wanted=%d got=%d", Index, DataSize, ActualDataSize);
-				free(m_ppDataPtrs[Index]);
-				m_ppDataPtrs[Index] = nullptr;
+				FreeData(Index);
 				m_pDataSizes[Index] = -1;
 				return nullptr;
 			}
@@ -442,7 +680,7 @@ CDataFileReader &CDataFileReader::operator=(CDataFileReader &&Other)
 	return *this;
 }
 
-bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
+bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType, bool MemoryMapped)
 {
 	dbg_assert(m_pDataFile == nullptr, "File already open");
 
@@ -455,10 +693,60 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		return false;
 	}
 
+	char *pMapping = nullptr;
+	int64_t MappingSize = 0;
+	if(MemoryMapped)
+	{
+		pMapping = static_cast<char *>(io_map(File, &MappingSize));
+		if(pMapping == nullptr)
+		{
+			log_warn("datafile", "could not map file '%s', reading it instead", pFilename);
+		}
+	}
+
+	return OpenImpl(pFilename, File, pMapping, MappingSize, pMapping, MappingSize);
+}
+
+bool CDataFileReader::OpenMemory(const char *pName, const void *pData, int64_t DataSize)
+{
+	dbg_assert(m_pDataFile == nullptr, "File already open");
+
+	log_trace("datafile", "loading '%s' from memory", pName);
+	return OpenImpl(pName, nullptr, nullptr, 0, static_cast<const char *>(pData), DataSize);
+}
+
+bool CDataFileReader::OpenImpl(const char *pFilename, IOHANDLE File, char *pMapping, int64_t MappingSize, const char *pContents, int64_t ContentsSize)
+{
+	const auto &&CloseFile = [&]() {
+		if(pMapping != nullptr)
+		{
+			io_unmap(pMapping, MappingSize);
+		}
+		if(File)
+		{
+			io_close(File);
+		}
+	};
+
 	// determine size and hashes of the file and store them
 	int64_t FileSize = 0;
 	unsigned Crc = 0;
 	SHA256_DIGEST Sha256;
+	if(pContents != nullptr)
+	{
+		FileSize = ContentsSize;
+		SHA256_CTX Sha256Ctxt;
+		sha256_init(&Sha256Ctxt);
+		constexpr int64_t CHUNK_SIZE = 64 * 1024 * 1024;
+		for(int64_t Offset = 0; Offset < ContentsSize; Offset += CHUNK_SIZE)
+		{
+			const unsigned Bytes = minimum(CHUNK_SIZE, ContentsSize - Offset);
+			Crc = crc32(Crc, reinterpret_cast<const Bytef *>(pContents + Offset), Bytes);
+			sha256_update(&Sha256Ctxt, pContents + Offset, Bytes);
+		}
+		Sha256 = sha256_finish(&Sha256Ctxt);
+	}
+	else
 	{
 		SHA256_CTX Sha256Ctxt;
 		sha256_init(&Sha256Ctxt);
@@ -475,7 +763,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		Sha256 = sha256_finish(&Sha256Ctxt);
 		if(io_seek(File, 0, IOSEEK_START) != 0)
 		{
-			io_close(File);
+			CloseFile();
 			log_error("datafile", "could not seek to start after calculating hashes");
 			return false;
 		}
@@ -483,9 +771,13 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 	// read header
 	CDatafileHeader Header;
-	if(io_read(File, &Header, sizeof(Header)) != sizeof(Header))
+	if(pContents != nullptr && ContentsSize >= (int64_t)sizeof(Header))
 	{
-		io_close(File);
+		mem_copy(&Header, pContents, sizeof(Header));
+	}
+	else if(pContents != nullptr || io_read(File, &Header, sizeof(Header)) != sizeof(Header))
+	{
+		CloseFile();
 		log_error("datafile", "could not read file header. file truncated or not a datafile.");
 		return false;
 	}
@@ -494,7 +786,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if((Header.m_aId[0] != 'A' || Header.m_aId[1] != 'T' || Header.m_aId[2] != 'A' || Header.m_aId[3] != 'D') &&
 		(Header.m_aId[0] != 'D' || Header.m_aId[1] != 'A' || Header.m_aId[2] != 'T' || Header.m_aId[3] != 'A'))
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "wrong header magic. magic=%x%x%x%x", Header.m_aId[0], Header.m_aId[1], Header.m_aId[2], Header.m_aId[3]);
 		return false;
 	}
@@ -504,7 +796,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	// check header version
 	if(Header.m_Version != 3 && Header.m_Version != 4)
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "unsupported header version. version=%d", Header.m_Version);
 		return false;
 	}
@@ -518,7 +810,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		Header.m_ItemSize % sizeof(int) != 0 ||
 		Header.m_DataSize < 0)
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "invalid header information. num_types=%d num_items=%d num_data=%d item_size=%d data_size=%d",
 			Header.m_NumItemTypes, Header.m_NumItems, Header.m_NumRawData, Header.m_ItemSize, Header.m_DataSize);
 		return false;
@@ -544,7 +836,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 	if((int64_t)sizeof(Header) + Size + (int64_t)Header.m_DataSize != FileSize)
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "invalid header data size or truncated file. data_size=%d file_size=%" PRId64, Header.m_DataSize, FileSize);
 		return false;
 	}
@@ -559,7 +851,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		}
 		else
 		{
-			io_close(File);
+			CloseFile();
 			log_error("datafile", "invalid header size or truncated file. size=%" PRId64 " actual=%" PRId64, HeaderFileSize, FileSize);
 			return false;
 		}
@@ -576,7 +868,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		}
 		else
 		{
-			io_close(File);
+			CloseFile();
 			log_error("datafile", "invalid header swaplen or truncated file. swaplen=%" PRId64 " actual=%" PRId64, HeaderSwaplen, FileSizeSwaplen);
 			return false;
 		}
@@ -584,12 +876,17 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 	constexpr int64_t MaxAllocSize = (int64_t)2 * 1024 * 1024 * 1024;
 	int64_t AllocSize = Size;
+	if(pMapping != nullptr)
+	{
+		AllocSize = 0; // types, offsets, sizes and item data are used from the mapping
+	}
 	AllocSize += sizeof(CDatafile); // add space for info structure
 	AllocSize += (int64_t)Header.m_NumRawData * sizeof(void *); // add space for data pointers
 	AllocSize += (int64_t)Header.m_NumRawData * sizeof(int); // add space for data sizes
+	AllocSize += (int64_t)Header.m_NumRawData * sizeof(bool); // add space for data ownership
 	if(AllocSize > MaxAllocSize)
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "file too large. alloc_size=%" PRId64 " max=%" PRId64, AllocSize, MaxAllocSize);
 		return false;
 	}
@@ -597,7 +894,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	CDatafile *pTmpDataFile = static_cast<CDatafile *>(malloc(AllocSize));
 	if(pTmpDataFile == nullptr)
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "out of memory. could not allocate memory for datafile. alloc_size=%" PRId64, AllocSize);
 		return false;
 	}
@@ -605,7 +902,20 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	pTmpDataFile->m_DataStartOffset = sizeof(CDatafileHeader) + Size;
 	pTmpDataFile->m_ppDataPtrs = (void **)(pTmpDataFile + 1);
 	pTmpDataFile->m_pDataSizes = (int *)(pTmpDataFile->m_ppDataPtrs + Header.m_NumRawData);
-	pTmpDataFile->m_pData = (char *)(pTmpDataFile->m_pDataSizes + Header.m_NumRawData);
+	if(pMapping != nullptr)
+	{
+		pTmpDataFile->m_pData = pMapping + sizeof(CDatafileHeader);
+		pTmpDataFile->m_pDataOwned = (bool *)(pTmpDataFile->m_pDataSizes + Header.m_NumRawData);
+	}
+	else
+	{
+		pTmpDataFile->m_pData = (char *)(pTmpDataFile->m_pDataSizes + Header.m_NumRawData);
+		pTmpDataFile->m_pDataOwned = (bool *)(pTmpDataFile->m_pData + Size);
+	}
+	pTmpDataFile->m_pContents = pContents;
+	pTmpDataFile->m_pMapping = pMapping;
+	pTmpDataFile->m_MappingSize = MappingSize;
+	pTmpDataFile->m_Arena.Init();
 	pTmpDataFile->m_File = File;
 	pTmpDataFile->m_FileSize = FileSize;
 	pTmpDataFile->m_Sha256 = Sha256;
@@ -614,15 +924,23 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	// clear the data pointers and sizes
 	mem_zero(pTmpDataFile->m_ppDataPtrs, Header.m_NumRawData * sizeof(void *));
 	mem_zero(pTmpDataFile->m_pDataSizes, Header.m_NumRawData * sizeof(int));
+	mem_zero(pTmpDataFile->m_pDataOwned, Header.m_NumRawData * sizeof(bool));
 
 	// read types, offsets, sizes and item data
-	const unsigned ReadSize = io_read(pTmpDataFile->m_File, pTmpDataFile->m_pData, Size);
-	if((int64_t)ReadSize != Size)
+	if(pMapping == nullptr && pContents != nullptr)
 	{
-		io_close(pTmpDataFile->m_File);
-		free(pTmpDataFile);
-		log_error("datafile", "truncation error. could not read all item data. wanted=%" PRId64 " got=%d", Size, ReadSize);
-		return false;
+		mem_copy(pTmpDataFile->m_pData, pContents + sizeof(CDatafileHeader), Size);
+	}
+	else if(pMapping == nullptr)
+	{
+		const unsigned ReadSize = io_read(pTmpDataFile->m_File, pTmpDataFile->m_pData, Size);
+		if((int64_t)ReadSize != Size)
+		{
+			CloseFile();
+			free(pTmpDataFile);
+			log_error("datafile", "truncation error. could not read all item data. wanted=%" PRId64 " got=%d", Size, ReadSize);
+			return false;
+		}
 	}
 
 	// The swap len also includes the size of the header (without the size offset), but the header was already swapped above.
@@ -647,13 +965,13 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 	if(!pTmpDataFile->Validate())
 	{
-		io_close(pTmpDataFile->m_File);
+		CloseFile();
 		free(pTmpDataFile);
 		return false;
 	}
 
 	m_pDataFile = pTmpDataFile;
-	log_trace("datafile", "loading done. datafile='%s'", pFilename);
+	log_trace("datafile", "loading done. datafile='%s' mapped=%d memory=%d", pFilename, pMapping != nullptr, pContents != nullptr && pMapping == nullptr);
 
 	return true;
 }
@@ -667,10 +985,18 @@ void CDataFileReader::Close()
 
 	for(int i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
 	{
-		free(m_pDataFile->m_ppDataPtrs[i]);
+		m_pDataFile->FreeData(i);
+	}
+	m_pDataFile->m_Arena.Free();
+	if(m_pDataFile->m_pMapping != nullptr)
+	{
+		io_unmap(m_pDataFile->m_pMapping, m_pDataFile->m_MappingSize);
 	}
 
-	io_close(m_pDataFile->m_File);
+	if(m_pDataFile->m_File)
+	{
+		io_close(m_pDataFile->m_File);
+	}
 	free(m_pDataFile);
 	m_pDataFile = nullptr;
 }
@@ -694,6 +1020,43 @@ int CDataFileReader::GetDataSize(int Index) const
 	return m_pDataFile->GetDataSize(Index);
 }
 
+void CDataFileReader::PreloadData(IEngine *pEngine)
+{
+	dbg_assert(m_pDataFile != nullptr, "File not open");
+
+	const int64_t PreloadStart = time_get_nanoseconds().count();
+	std::vector<CDatafileDataLoad> vLoads;
+	for(int Index = 0; Index < m_pDataFile->m_Header.m_NumRawData; Index++)
+	{
+		if(m_pDataFile->m_ppDataPtrs[Index] != nullptr || m_pDataFile->m_pDataSizes[Index] < 0)
+		{
+			continue;
+		}
+		if(m_pDataFile->m_Info.m_pDataSizes == nullptr)
+		{
+			// uncompressed data only has to be read
+			m_pDataFile->GetData(Index, false);
+			continue;
+		}
+		CDatafileDataLoad &Load = vLoads.emplace_back();
+		if(!m_pDataFile->BeginLoad(Index, &Load))
+		{
+			vLoads.pop_back();
+		}
+	}
+
+	std::stable_sort(vLoads.begin(), vLoads.end(), [](const CDatafileDataLoad &A, const CDatafileDataLoad &B) { return A.m_UncompressedSize > B.m_UncompressedSize; });
+	CParallelTasks::Run(pEngine, vLoads.size(), [&](int Task) {
+		vLoads[Task].Decompress();
+	});
+
+	for(CDatafileDataLoad &Load : vLoads)
+	{
+		m_pDataFile->EndLoad(&Load);
+	}
+	log_trace("datafile", "preloaded data. num=%d parallel=%d time=%.2fms", (int)vLoads.size(), pEngine != nullptr, (time_get_nanoseconds().count() - PreloadStart) / 1e6);
+}
+
 void *CDataFileReader::GetData(int Index)
 {
 	dbg_assert(m_pDataFile != nullptr, "File not open");
@@ -736,8 +1099,9 @@ void CDataFileReader::ReplaceData(int Index, char *pData, size_t Size)
 	dbg_assert(m_pDataFile != nullptr, "File not open");
 	dbg_assert(Index >= 0 && Index < m_pDataFile->m_Header.m_NumRawData, "Index invalid: %d", Index);
 
-	free(m_pDataFile->m_ppDataPtrs[Index]);
+	m_pDataFile->FreeData(Index);
 	m_pDataFile->m_ppDataPtrs[Index] = pData;
+	m_pDataFile->m_pDataOwned[Index] = true;
 	m_pDataFile->m_pDataSizes[Index] = Size;
 }
 
@@ -748,8 +1112,8 @@ void CDataFileReader::UnloadData(int Index)
 	if(Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData)
 		return;
 
-	free(m_pDataFile->m_ppDataPtrs[Index]);
-	m_pDataFile->m_ppDataPtrs[Index] = nullptr;
+	// data in the arena is only freed when the file is closed
+	m_pDataFile->FreeData(Index);
 	m_pDataFile->m_pDataSizes[Index] = 0;
 }
 
@@ -918,6 +1282,9 @@ int CDataFileReader::MapSize() const
 CDataFileWriter::CDataFileWriter()
 {
 	m_File = nullptr;
+	m_ppMemory = nullptr;
+	m_pMemorySize = nullptr;
+	m_MemoryOffset = 0;
 }
 
 CDataFileWriter::~CDataFileWriter()
@@ -943,10 +1310,33 @@ CDataFileWriter::~CDataFileWriter()
 bool CDataFileWriter::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
 {
 	dbg_assert(!m_File, "File already open");
+	dbg_assert(!m_ppMemory, "Memory already open");
 	m_File = pStorage->OpenFile(pFilename, IOFLAG_WRITE, StorageType);
 	return m_File != nullptr;
 }
 
+void CDataFileWriter::OpenMemory(void **ppData, unsigned *pSize)
+{
+	dbg_assert(!m_File, "File already open");
+	dbg_assert(!m_ppMemory, "Memory already open");
+	m_ppMemory = ppData;
+	m_pMemorySize = pSize;
+	m_MemoryOffset = 0;
+}
+
+void CDataFileWriter::Write(const void *pData, int64_t Size)
+{
+	if(m_ppMemory)
+	{
+		mem_copy(static_cast<char *>(*m_ppMemory) + m_MemoryOffset, pData, Size);
+		m_MemoryOffset += Size;
+	}
+	else
+	{
+		io_write(m_File, pData, Size);
+	}
+}
+
 int CDataFileWriter::GetTypeFromIndex(int Index) const
 {
 	return ITEMTYPE_EX - Index - 1;
@@ -1104,14 +1494,21 @@ static int CompressionLevelToZlib(CDataFileWriter::ECompressionLevel Compression
 	}
 }
 
-void CDataFileWriter::Finish()
+void CDataFileWriter::Finish(IEngine *pEngine)
 {
-	dbg_assert((bool)m_File, "File not open");
+	dbg_assert(m_File || m_ppMemory, "File not open");
 
 	// Compress data. This takes the majority of the time when saving a datafile,
 	// so it's delayed until the end so it can be off-loaded to another thread.
-	for(CDataInfo &DataInfo : m_vDatas)
-	{
+	// The data items are compressed independently, largest first, so the
+	// output does not depend on whether it is done in parallel.
+	std::vector<int> vOrder(m_vDatas.size());
+	for(size_t i = 0; i < m_vDatas.size(); i++)
+		vOrder[i] = i;
+	std::stable_sort(vOrder.begin(), vOrder.end(), [&](int A, int B) { return m_vDatas[A].m_UncompressedSize > m_vDatas[B].m_UncompressedSize; });
+	const int64_t CompressStart = time_get_nanoseconds().count();
+	CParallelTasks::Run(pEngine, vOrder.size(), [&](int Task) {
+		CDataInfo &DataInfo = m_vDatas[vOrder[Task]];
 		unsigned long CompressedSize = compressBound(DataInfo.m_UncompressedSize);
 		DataInfo.m_pCompressedData = malloc(CompressedSize);
 		const int Result = compress2(static_cast<Bytef *>(DataInfo.m_pCompressedData), &CompressedSize, static_cast<Bytef *>(DataInfo.m_pUncompressedData), DataInfo.m_UncompressedSize, CompressionLevelToZlib(DataInfo.m_CompressionLevel));
@@ -1119,7 +1516,8 @@ void CDataFileWriter::Finish()
 		free(DataInfo.m_pUncompressedData);
 		DataInfo.m_pUncompressedData = nullptr;
 		dbg_assert(Result == Z_OK, "datafile zlib compression failed with error %d", Result);
-	}
+	});
+	log_trace("datafile", "compressed data. num=%d parallel=%d time=%.2fms", (int)m_vDatas.size(), pEngine != nullptr, (time_get_nanoseconds().count() - CompressStart) / 1e6);
 
 	// Calculate total size of items
 	int64_t ItemSize = 0;
@@ -1146,6 +1544,12 @@ void CDataFileWriter::Finish()
 	// This also ensures that SwapSize, ItemSize and DataSize are valid.
 	dbg_assert(FileSize <= (int64_t)std::numeric_limits<int>::max(), "File size too large");
 
+	if(m_ppMemory)
+	{
+		*m_ppMemory = malloc(FileSize);
+		*m_pMemorySize = FileSize;
+	}
+
 	// Construct and write header
 	{
 		CDatafileHeader Header;
@@ -1163,7 +1567,7 @@ void CDataFileWriter::Finish()
 		Header.m_DataSize = DataSize;
 
 		SwapEndianInPlace(&Header);
-		io_write(m_File, &Header, sizeof(Header));
+		Write(&Header, sizeof(Header));
 	}
 
 	// Write item types
@@ -1178,7 +1582,7 @@ void CDataFileWriter::Finish()
 		Info.m_Num = ItemType.m_Num;
 
 		SwapEndianInPlace(&Info);
-		io_write(m_File, &Info, sizeof(Info));
+		Write(&Info, sizeof(Info));
 		ItemCount += ItemType.m_Num;
 	}
 
@@ -1190,7 +1594,7 @@ void CDataFileWriter::Finish()
 		for(int ItemIndex = ItemType.m_First; ItemIndex != -1; ItemIndex = m_vItems[ItemIndex].m_Next)
 		{
 			const int ItemOffsetWrite = SwapEndianInt(ItemOffset);
-			io_write(m_File, &ItemOffsetWrite, sizeof(ItemOffsetWrite));
+			Write(&ItemOffsetWrite, sizeof(ItemOffsetWrite));
 			ItemOffset += m_vItems[ItemIndex].m_Size + sizeof(CDatafileItem);
 		}
 	}
@@ -1200,7 +1604,7 @@ void CDataFileWriter::Finish()
 	for(const CDataInfo &DataInfo : m_vDatas)
 	{
 		const int DataOffsetWrite = SwapEndianInt(DataOffset);
-		io_write(m_File, &DataOffsetWrite, sizeof(DataOffsetWrite));
+		Write(&DataOffsetWrite, sizeof(DataOffsetWrite));
 		DataOffset += DataInfo.m_CompressedSize;
 	}
 
@@ -1208,7 +1612,7 @@ void CDataFileWriter::Finish()
 	for(const CDataInfo &DataInfo : m_vDatas)
 	{
 		const int UncompressedSizeWrite = SwapEndianInt(DataInfo.m_UncompressedSize);
-		io_write(m_File, &UncompressedSizeWrite, sizeof(UncompressedSizeWrite));
+		Write(&UncompressedSizeWrite, sizeof(UncompressedSizeWrite));
 	}
 
 	// Write items sorted by type
@@ -1222,12 +1626,12 @@ void CDataFileWriter::Finish()
 			Item.m_Size = m_vItems[ItemIndex].m_Size;
 
 			SwapEndianInPlace(&Item);
-			io_write(m_File, &Item, sizeof(Item));
+			Write(&Item, sizeof(Item));
 
 			if(m_vItems[ItemIndex].m_pData != nullptr)
 			{
 				SwapEndianInPlace(m_vItems[ItemIndex].m_pData, m_vItems[ItemIndex].m_Size);
-				io_write(m_File, m_vItems[ItemIndex].m_pData, m_vItems[ItemIndex].m_Size);
+				Write(m_vItems[ItemIndex].m_pData, m_vItems[ItemIndex].m_Size);
 				free(m_vItems[ItemIndex].m_pData);
 				m_vItems[ItemIndex].m_pData = nullptr;
 			}
@@ -1237,11 +1641,20 @@ void CDataFileWriter::Finish()
 	// Write data
 	for(CDataInfo &DataInfo : m_vDatas)
 	{
-		io_write(m_File, DataInfo.m_pCompressedData, DataInfo.m_CompressedSize);
+		Write(DataInfo.m_pCompressedData, DataInfo.m_CompressedSize);
 		free(DataInfo.m_pCompressedData);
 		DataInfo.m_pCompressedData = nullptr;
 	}
 
-	io_close(m_File);
-	m_File = nullptr;
+	if(m_ppMemory)
+	{
+		dbg_assert(m_MemoryOffset == FileSize, "Wrong datafile size in memory");
+		m_ppMemory = nullptr;
+		m_pMemorySize = nullptr;
+	}
+	else
+	{
+		io_close(m_File);
+		m_File = nullptr;
+	}
 }
@@ -24,6 +24,7 @@ class CDataFileReader
 {
 	class CDatafile *m_pDataFile = nullptr;
 
+	bool OpenImpl(const char *pFilename, IOHANDLE File, char *pMapping, int64_t MappingSize, const char *pContents, int64_t ContentsSize);
 	int GetExternalItemType(int InternalType, CUuid *pUuid);
 	int GetInternalItemType(int ExternalType);
 
@@ -31,11 +32,20 @@ public:
 	~CDataFileReader();
 	CDataFileReader &operator=(CDataFileReader &&Other);
 
-	[[nodiscard]] bool Open(class IStorage *pStorage, const char *pFilename, int StorageType);
+	// MemoryMapped: map the file instead of reading it, uncompressed data is
+	// used from the mapping and compressed data is decompressed into an arena
+	// that is only freed when the file is closed
+	[[nodiscard]] bool Open(class IStorage *pStorage, const char *pFilename, int StorageType, bool MemoryMapped = false);
+	// opens the datafile from its contents in memory, which are not modified
+	// and must stay valid until the datafile is closed
+	[[nodiscard]] bool OpenMemory(const char *pName, const void *pData, int64_t DataSize);
 	void Close();
 	bool IsOpen() const;
 	IOHANDLE File() const;
 
+	// decompresses all data that is not loaded yet, in parallel on jobs of the
+	// engine if it is not nullptr
+	void PreloadData(class IEngine *pEngine);
 	int GetDataSize(int Index) const;
 	void *GetData(int Index);
 	void *GetDataSwapped(int Index); // makes sure that the data is 32bit LE ints when saved
@@ -104,6 +114,10 @@ private:
 	};
 
 	IOHANDLE m_File;
+	// set by OpenMemory, Finish writes into the buffer instead of m_File
+	void **m_ppMemory;
+	unsigned *m_pMemorySize;
+	int64_t m_MemoryOffset;
 	std::map<uint16_t, CItemTypeInfo, std::less<>> m_ItemTypes; // item types must be sorted in ascending order
 	std::vector<CItemInfo> m_vItems;
 	std::vector<CDataInfo> m_vDatas;
@@ -111,6 +125,7 @@ private:
 
 	int GetTypeFromIndex(int Index) const;
 	int GetExtendedItemTypeIndex(int Type, const CUuid *pUuid);
+	void Write(const void *pData, int64_t Size);
 
 public:
 	CDataFileWriter();
@@ -118,6 +133,10 @@ public:
 	{
 		m_File = Other.m_File;
 		Other.m_File = nullptr;
+		m_ppMemory = Other.m_ppMemory;
+		Other.m_ppMemory = nullptr;
+		m_pMemorySize = Other.m_pMemorySize;
+		m_MemoryOffset = Other.m_MemoryOffset;
 		m_ItemTypes = std::move(Other.m_ItemTypes);
 		m_vItems = std::move(Other.m_vItems);
 		m_vDatas = std::move(Other.m_vDatas);
@@ -126,11 +145,16 @@ public:
 	~CDataFileWriter();
 
 	[[nodiscard]] bool Open(class IStorage *pStorage, const char *pFilename, int StorageType = IStorage::TYPE_SAVE);
+	// like Open, but Finish writes the datafile into a buffer allocated with
+	// malloc, which is returned in ppData and has to be freed by the caller
+	void OpenMemory(void **ppData, unsigned *pSize);
 	int AddItem(int Type, int Id, size_t Size, const void *pData, const CUuid *pUuid = nullptr);
 	int AddData(size_t Size, const void *pData, ECompressionLevel CompressionLevel = COMPRESSION_DEFAULT);
 	int AddDataSwapped(size_t Size, const void *pData);
 	int AddDataString(const char *pStr);
-	void Finish();
+	// compresses the data in parallel on jobs of the engine if it is not nullptr,
+	// the output is the same either way
+	void Finish(class IEngine *pEngine = nullptr);
 };
 
 #endif
@@ -1098,7 +1098,7 @@ void CDemoPlayer::AdjustSpeedIndex(int Offset)
 
 void CDemoPlayer::Update(bool RealTime)
 {
-	const int64_t Now = Time();
+	const int64_t Now = m_FixedTimeStep > 0 ? m_Info.m_LastUpdate + m_FixedTimeStep : Time();
 	const int64_t Freq = time_freq();
 	const int64_t DeltaTime = Now - m_Info.m_LastUpdate;
 	m_Info.m_LastUpdate = Now;
@@ -137,6 +137,7 @@ private:
 	class CSnapshotDelta *m_pSnapshotDelta;
 
 	bool m_UseVideo;
+	int64_t m_FixedTimeStep = 0;
 #if defined(CONF_VIDEORECORDER)
 	bool m_WasRecording = false;
 #endif
@@ -191,6 +192,11 @@ public:
 	const char *ErrorMessage() const override { return m_aErrorMessage; }
 
 	void Update(bool RealTime = true);
+	/**
+	 * Advances the playback by a fixed time on every @link Update @endlink
+	 * instead of the time that actually passed, 0 to use the real time again.
+	 */
+	void SetFixedTimeStep(int64_t TimeStep) { m_FixedTimeStep = TimeStep; }
 	bool IsSixup() const { return m_Sixup; }
 
 	const CPlaybackInfo *Info() const { return &m_Info; }
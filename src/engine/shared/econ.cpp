@@ -154,6 +154,14 @@ void CEcon::Update()
 	}
 }
 
+void CEcon::AddSocketsToReactor(NETREACTOR Reactor) const
+{
+	if(!m_Ready)
+		return;
+
+	m_NetConsole.AddSocketsToReactor(Reactor);
+}
+
 void CEcon::Send(int ClientId, const char *pLine)
 {
 	if(!m_Ready)
@@ -52,6 +52,7 @@ public:
 
 	void Init(CConfig *pConfig, IConsole *pConsole, CNetBan *pNetBan);
 	void Update();
+	void AddSocketsToReactor(NETREACTOR Reactor) const;
 	void Send(int ClientId, const char *pLine);
 	void Shutdown();
 };
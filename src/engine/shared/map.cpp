@@ -4,6 +4,7 @@
 
 #include <base/log.h>
 
+#include <engine/engine.h>
 #include <engine/storage.h>
 
 #include <game/mapitems.h>
@@ -70,7 +71,7 @@ int CMap::NumItems() const
 	return m_DataFile.NumItems();
 }
 
-bool CMap::Load(const char *pMapName)
+bool CMap::Load(const char *pMapName, bool MemoryMapped, bool Preload)
 {
 	IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
 	if(!pStorage)
@@ -79,9 +80,33 @@ bool CMap::Load(const char *pMapName)
 	// Ensure current datafile is not left in an inconsistent state if loading fails,
 	// by loading the new datafile separately first.
 	CDataFileReader NewDataFile;
-	if(!NewDataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL))
+	if(!NewDataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL, MemoryMapped))
 		return false;
 
+	if(Preload)
+	{
+		NewDataFile.PreloadData(Kernel()->RequestInterface<IEngine>());
+	}
+
+	return LoadDataFile(std::move(NewDataFile));
+}
+
+bool CMap::LoadMemory(const char *pName, const void *pData, int64_t DataSize, bool Preload)
+{
+	CDataFileReader NewDataFile;
+	if(!NewDataFile.OpenMemory(pName, pData, DataSize))
+		return false;
+
+	if(Preload)
+	{
+		NewDataFile.PreloadData(nullptr);
+	}
+
+	return LoadDataFile(std::move(NewDataFile));
+}
+
+bool CMap::LoadDataFile(CDataFileReader &&NewDataFile)
+{
 	// Check version
 	const CMapItemVersion *pItem = (CMapItemVersion *)NewDataFile.FindItem(MAPITEMTYPE_VERSION, 0);
 	if(pItem == nullptr || pItem->m_Version != 1)
@@ -130,6 +155,37 @@ bool CMap::Load(const char *pMapName)
 	return true;
 }
 
+void CMap::Replace(IEngineMap *pMap)
+{
+	m_DataFile.Close();
+	m_DataFile = std::move(static_cast<CMap *>(pMap)->m_DataFile);
+}
+
+void CMap::PreloadGameLayers()
+{
+	int LayersStart, LayersNum;
+	m_DataFile.GetType(MAPITEMTYPE_LAYER, &LayersStart, &LayersNum);
+	for(int l = 0; l < LayersNum; l++)
+	{
+		const CMapItemLayer *pLayer = static_cast<CMapItemLayer *>(m_DataFile.GetItem(LayersStart + l));
+		if(pLayer->m_Type != LAYERTYPE_TILES)
+			continue;
+		const CMapItemLayerTilemap *pTilemap = reinterpret_cast<const CMapItemLayerTilemap *>(pLayer);
+		// same as in CLayers, old versions had the data indices at other offsets
+		const auto &&Preload = [&](int Flag, int Data, int OldOffset) {
+			if(pTilemap->m_Flags & Flag)
+				m_DataFile.GetData(pTilemap->m_Version <= 2 ? *((const int *)(pTilemap) + OldOffset) : Data);
+		};
+		if(pTilemap->m_Flags & TILESLAYERFLAG_GAME)
+			m_DataFile.GetData(pTilemap->m_Data);
+		Preload(TILESLAYERFLAG_TELE, pTilemap->m_Tele, 15);
+		Preload(TILESLAYERFLAG_SPEEDUP, pTilemap->m_Speedup, 16);
+		Preload(TILESLAYERFLAG_FRONT, pTilemap->m_Front, 17);
+		Preload(TILESLAYERFLAG_SWITCH, pTilemap->m_Switch, 18);
+		Preload(TILESLAYERFLAG_TUNE, pTilemap->m_Tune, 19);
+	}
+}
+
 void CMap::Unload()
 {
 	m_DataFile.Close();
@@ -13,6 +13,8 @@ class CMap : public IEngineMap
 {
 	CDataFileReader m_DataFile;
 
+	bool LoadDataFile(CDataFileReader &&NewDataFile);
+
 public:
 	CMap();
 
@@ -32,7 +34,10 @@ public:
 	void *FindItem(int Type, int Id) override;
 	int NumItems() const override;
 
-	[[nodiscard]] bool Load(const char *pMapName) override;
+	[[nodiscard]] bool Load(const char *pMapName, bool MemoryMapped = false, bool Preload = false) override;
+	[[nodiscard]] bool LoadMemory(const char *pName, const void *pData, int64_t DataSize, bool Preload = false) override;
+	void Replace(IEngineMap *pMap) override;
+	void PreloadGameLayers() override;
 	void Unload() override;
 	bool IsLoaded() const override;
 	IOHANDLE File() const override;
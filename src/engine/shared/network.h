@@ -370,6 +370,7 @@ public:
 	EState State() const { return m_State; }
 	const NETADDR *PeerAddress() const { return &m_PeerAddr; }
 	const char *ErrorString() const { return m_aErrorString; }
+	NETSOCKET Socket() const { return m_Socket; }
 
 	void Reset();
 	int Update();
@@ -460,6 +461,10 @@ public:
 	int Send(CNetChunk *pChunk);
 	void Update();
 
+	// send batching, see net_udp_set_send_batching
+	void SetSendBatching(bool Batching) { net_udp_set_send_batching(m_Socket, Batching); }
+	int Flush() { return net_udp_flush(m_Socket); }
+
 	//
 	void Drop(int ClientId, const char *pReason);
 
@@ -518,6 +523,7 @@ public:
 	int Recv(char *pLine, int MaxLength, int *pClientId = nullptr);
 	int Send(int ClientId, const char *pLine);
 	void Update();
+	void AddSocketsToReactor(NETREACTOR Reactor) const;
 
 	//
 	int AcceptClient(NETSOCKET Socket, const NETADDR *pAddr);
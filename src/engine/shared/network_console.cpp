@@ -131,6 +131,16 @@ void CNetConsole::Update()
 	}
 }
 
+void CNetConsole::AddSocketsToReactor(NETREACTOR Reactor) const
+{
+	net_reactor_add(Reactor, m_Socket);
+	for(const auto &Slot : m_aSlots)
+	{
+		if(Slot.m_Connection.State() == CConsoleNetConnection::EState::ONLINE)
+			net_reactor_add(Reactor, Slot.m_Connection.Socket());
+	}
+}
+
 int CNetConsole::Recv(char *pLine, int MaxLength, int *pClientId)
 {
 	for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; i++)
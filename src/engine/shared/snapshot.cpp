@@ -11,6 +11,7 @@
 #include <generated/protocol7.h>
 #include <generated/protocolglue.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <limits>
 
@@ -58,7 +59,7 @@ int CSnapshot::GetExternalItemType(int InternalType) const
 
 int CSnapshot::GetItemIndex(int Key) const
 {
-	// TODO: OPT: this should not be a linear search. very bad
+	// linear search, use `CSnapshotIndex` for snapshots that are queried often
 	for(int i = 0; i < m_NumItems; i++)
 	{
 		if(GetItem(i)->Key() == Key)
@@ -160,6 +161,113 @@ bool CSnapshot::IsValid(size_t ActualSize) const
 	return true;
 }
 
+// CSnapshotIndex
+
+void CSnapshotIndex::Build(const CSnapshot *pSnapshot)
+{
+	m_pSnapshot = pSnapshot;
+	m_NumEntries = pSnapshot->NumItems();
+	for(int i = 0; i < m_NumEntries; i++)
+	{
+		m_aEntries[i].m_Key = pSnapshot->GetItem(i)->Key();
+		m_aEntries[i].m_Index = i;
+	}
+	std::sort(m_aEntries, m_aEntries + m_NumEntries);
+
+	m_NumUuidTypes = 0;
+	m_UuidTypesOverflow = false;
+	for(int i = 0; i < m_NumEntries && !m_UuidTypesOverflow; i++)
+	{
+		const CSnapshotItem *pItem = pSnapshot->GetItem(i);
+		if(pItem->Type() != 0 || pItem->Id() < CSnapshot::OFFSET_UUID_TYPE) // NETOBJTYPE_EX
+			continue;
+		// only the first item of each type counts, like in `CSnapshot`
+		bool Known = false;
+		for(int Type = 0; Type < m_NumUuidTypes && !Known; Type++)
+			Known = m_aUuidInternalTypes[Type] == pItem->Id();
+		if(Known)
+			continue;
+		if(m_NumUuidTypes == MAX_UUID_TYPES)
+		{
+			m_UuidTypesOverflow = true;
+			break;
+		}
+		int ExternalType = pItem->Id();
+		if(pSnapshot->GetItemSize(i) >= (int)sizeof(CUuid))
+		{
+			CUuid Uuid;
+			for(size_t b = 0; b < sizeof(CUuid) / sizeof(int32_t); b++)
+				uint_to_bytes_be(&Uuid.m_aData[b * sizeof(int32_t)], pItem->Data()[b]);
+			ExternalType = g_UuidManager.LookupUuid(Uuid);
+		}
+		m_aUuidInternalTypes[m_NumUuidTypes] = pItem->Id();
+		m_aUuidExternalTypes[m_NumUuidTypes] = ExternalType;
+		m_NumUuidTypes++;
+	}
+}
+
+int CSnapshotIndex::GetItemIndex(int Key) const
+{
+	CEntry Needle;
+	Needle.m_Key = Key;
+	Needle.m_Index = -1;
+	const CEntry *pEnd = m_aEntries + m_NumEntries;
+	const CEntry *pEntry = std::lower_bound(m_aEntries, pEnd, Needle);
+	if(pEntry == pEnd || pEntry->m_Key != Key)
+		return -1;
+	return pEntry->m_Index;
+}
+
+int CSnapshotIndex::GetItemType(int Index) const
+{
+	return GetExternalItemType(m_pSnapshot->GetItem(Index)->Type());
+}
+
+int CSnapshotIndex::GetExternalItemType(int InternalType) const
+{
+	if(InternalType < CSnapshot::OFFSET_UUID_TYPE)
+	{
+		return InternalType;
+	}
+	for(int i = 0; i < m_NumUuidTypes; i++)
+	{
+		if(m_aUuidInternalTypes[i] == InternalType)
+			return m_aUuidExternalTypes[i];
+	}
+	if(m_UuidTypesOverflow)
+	{
+		return m_pSnapshot->GetExternalItemType(InternalType);
+	}
+	return InternalType;
+}
+
+const void *CSnapshotIndex::FindItem(int Type, int Id) const
+{
+	int InternalType = Type;
+	if(Type >= OFFSET_UUID)
+	{
+		if(m_UuidTypesOverflow)
+		{
+			return m_pSnapshot->FindItem(Type, Id);
+		}
+		InternalType = -1;
+		for(int i = 0; i < m_NumUuidTypes; i++)
+		{
+			if(m_aUuidExternalTypes[i] == Type)
+			{
+				InternalType = m_aUuidInternalTypes[i];
+				break;
+			}
+		}
+		if(InternalType == -1)
+		{
+			return nullptr;
+		}
+	}
+	int Index = GetItemIndex((InternalType << 16) | Id);
+	return Index < 0 ? nullptr : m_pSnapshot->GetItem(Index)->Data();
+}
+
 // CSnapshotDelta
 
 enum
@@ -550,6 +658,10 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 		}
 	}
 
+	CSnapshotIndex FromIndex;
+	if(pDelta->m_NumUpdateItems > 0)
+		FromIndex.Build(pFrom);
+
 	// unpack updated stuff
 	for(int i = 0; i < pDelta->m_NumUpdateItems; i++)
 	{
@@ -590,11 +702,11 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 		if(!pNewData)
 			return -302;
 
-		const int FromIndex = pFrom->GetItemIndex(Key);
-		if(FromIndex != -1)
+		const int FromItemIndex = FromIndex.GetItemIndex(Key);
+		if(FromItemIndex != -1)
 		{
 			// we got an update so we need to apply the diff
-			UndiffItem(pFrom->GetItem(FromIndex)->Data(), pData, pNewData, ItemSize / sizeof(int32_t), &m_aSnapshotDataRate[Type]);
+			UndiffItem(pFrom->GetItem(FromItemIndex)->Data(), pData, pNewData, ItemSize / sizeof(int32_t), &m_aSnapshotDataRate[Type]);
 		}
 		else // no previous, just copy the pData
 		{
@@ -625,6 +737,7 @@ void CSnapshotStorage::PurgeAll()
 		CHolder *pNext = m_pFirst->m_pNext;
 		free(m_pFirst->m_pSnap);
 		free(m_pFirst->m_pAltSnap);
+		delete m_pFirst->m_pAltIndex;
 		free(m_pFirst);
 		m_pFirst = pNext;
 	}
@@ -642,6 +755,7 @@ void CSnapshotStorage::PurgeUntil(int Tick)
 			return; // no more to remove
 		free(pHolder->m_pSnap);
 		free(pHolder->m_pAltSnap);
+		delete pHolder->m_pAltIndex;
 		free(pHolder);
 
 		// did we come to the end of the list?
@@ -676,11 +790,14 @@ void CSnapshotStorage::Add(int Tick, int64_t Tagtime, size_t DataSize, const voi
 		pHolder->m_pAltSnap = static_cast<CSnapshot *>(malloc(AltDataSize));
 		mem_copy(pHolder->m_pAltSnap, pAltData, AltDataSize);
 		pHolder->m_AltSnapSize = AltDataSize;
+		pHolder->m_pAltIndex = new CSnapshotIndex();
+		pHolder->m_pAltIndex->Build(pHolder->m_pAltSnap);
 	}
 	else
 	{
 		pHolder->m_pAltSnap = nullptr;
 		pHolder->m_AltSnapSize = 0;
+		pHolder->m_pAltIndex = nullptr;
 	}
 
 	// link
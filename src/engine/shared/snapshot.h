@@ -72,6 +72,47 @@ public:
 	static const CSnapshot *EmptySnapshot() { return &ms_EmptySnapshot; }
 };
 
+// CSnapshotIndex
+
+// Sorted key index of a snapshot, to find items in O(log n) instead of
+// scanning all items. Also caches the external types of the UUID item types.
+// Must be rebuilt whenever the indexed snapshot changes.
+class CSnapshotIndex
+{
+	enum
+	{
+		MAX_UUID_TYPES = 64,
+	};
+
+	class CEntry
+	{
+	public:
+		int m_Key;
+		int m_Index;
+		bool operator<(const CEntry &Other) const { return m_Key < Other.m_Key || (m_Key == Other.m_Key && m_Index < Other.m_Index); }
+	};
+
+	const CSnapshot *m_pSnapshot = nullptr;
+	int m_NumEntries = 0;
+	CEntry m_aEntries[CSnapshot::MAX_ITEMS];
+
+	int m_NumUuidTypes = 0;
+	int m_aUuidInternalTypes[MAX_UUID_TYPES];
+	int m_aUuidExternalTypes[MAX_UUID_TYPES];
+	// the snapshot has more UUID types than are cached, fall back to the snapshot
+	bool m_UuidTypesOverflow = false;
+
+public:
+	void Build(const CSnapshot *pSnapshot);
+	const CSnapshot *Snapshot() const { return m_pSnapshot; }
+
+	// same results as the functions of `CSnapshot` with the same name
+	int GetItemIndex(int Key) const;
+	int GetItemType(int Index) const;
+	int GetExternalItemType(int InternalType) const;
+	const void *FindItem(int Type, int Id) const;
+};
+
 // CSnapshotDelta
 
 class CSnapshotDelta
@@ -132,6 +173,9 @@ public:
 
 		CSnapshot *m_pSnap;
 		CSnapshot *m_pAltSnap;
+
+		// index of the alternative snapshot, if one was stored
+		CSnapshotIndex *m_pAltIndex;
 	};
 
 	CHolder *m_pFirst;
@@ -0,0 +1,89 @@
+#include "tick_profiler.h"
+
+#include <algorithm>
+#include <iterator>
+
+CTickProfiler::CTickProfiler()
+{
+	Reset();
+}
+
+int CTickProfiler::Section(const char *pName)
+{
+	for(int i = 0; i < m_NumSections; i++)
+	{
+		if(str_comp(m_aSections[i].m_aName, pName) == 0)
+			return i;
+	}
+	dbg_assert(m_NumSections < MAX_SECTIONS, "too many profiler sections");
+	CSection &Section = m_aSections[m_NumSections];
+	str_copy(Section.m_aName, pName);
+	Section.m_Current = 0;
+	// the section didn't take any time in the ticks before it was registered
+	std::fill(std::begin(Section.m_aSamples), std::end(Section.m_aSamples), 0);
+	return m_NumSections++;
+}
+
+void CTickProfiler::EndTick()
+{
+	for(int i = 0; i < m_NumSections; i++)
+	{
+		m_aSections[i].m_aSamples[m_NextSample] = m_aSections[i].m_Current;
+		m_aSections[i].m_Current = 0;
+	}
+	m_NextSample = (m_NextSample + 1) % NUM_SAMPLES;
+	m_NumSamples = std::min(m_NumSamples + 1, (int)NUM_SAMPLES);
+}
+
+void CTickProfiler::Reset()
+{
+	for(int i = 0; i < m_NumSections; i++)
+	{
+		m_aSections[i].m_Current = 0;
+		std::fill(std::begin(m_aSections[i].m_aSamples), std::end(m_aSections[i].m_aSamples), 0);
+	}
+	m_NumSamples = 0;
+	m_NextSample = 0;
+}
+
+CTickProfiler::CStats CTickProfiler::Stats(int Section) const
+{
+	CStats Stats = {0, 0, 0, 0};
+	if(m_NumSamples == 0)
+		return Stats;
+
+	// the ring buffer is only full after NUM_SAMPLES ticks, until then the
+	// samples start at the beginning
+	int64_t aSamples[NUM_SAMPLES];
+	std::copy_n(m_aSections[Section].m_aSamples, m_NumSamples, aSamples);
+	int64_t *pEnd = aSamples + m_NumSamples;
+
+	int64_t Sum = 0;
+	for(const int64_t *pSample = aSamples; pSample < pEnd; pSample++)
+		Sum += *pSample;
+	Stats.m_Mean = Sum / m_NumSamples;
+
+	int64_t *pP50 = aSamples + (m_NumSamples - 1) / 2;
+	std::nth_element(aSamples, pP50, pEnd);
+	Stats.m_P50 = *pP50;
+	int64_t *pP99 = aSamples + (m_NumSamples - 1) * 99 / 100;
+	std::nth_element(pP50, pP99, pEnd);
+	Stats.m_P99 = *pP99;
+	Stats.m_Max = *std::max_element(pP99, pEnd);
+	return Stats;
+}
+
+void CTickProfiler::FormatJson(char *pBuffer, int BufferSize) const
+{
+	str_format(pBuffer, BufferSize, "{\"samples\":%d,\"sections\":{", m_NumSamples);
+	for(int i = 0; i < m_NumSections; i++)
+	{
+		const CStats Stats = this->Stats(i);
+		char aSection[160];
+		str_format(aSection, sizeof(aSection), "%s\"%s\":{\"p50\":%.1f,\"p99\":%.1f,\"max\":%.1f,\"mean\":%.1f}",
+			i == 0 ? "" : ",", m_aSections[i].m_aName,
+			Stats.m_P50 / 1e3, Stats.m_P99 / 1e3, Stats.m_Max / 1e3, Stats.m_Mean / 1e3);
+		str_append(pBuffer, aSection, BufferSize);
+	}
+	str_append(pBuffer, "}}", BufferSize);
+}
@@ -0,0 +1,95 @@
+#ifndef ENGINE_SHARED_TICK_PROFILER_H
+#define ENGINE_SHARED_TICK_PROFILER_H
+
+#include <base/system.h>
+
+#include <cstdint>
+
+// Time spent in the named sections of the server main loop, summed up per
+// iteration of the loop that ran game ticks and kept for the last NUM_SAMPLES
+// of them. That is one tick while the server keeps up, an idle server catches
+// up on all ticks at once. Section names use dots to show nesting,
+// "tick.world" is part of "tick".
+class CTickProfiler
+{
+public:
+	enum
+	{
+		NUM_SAMPLES = 512,
+		MAX_SECTIONS = 48,
+		MAX_NAME_LENGTH = 32,
+	};
+
+	class CStats
+	{
+	public:
+		// nanoseconds
+		int64_t m_P50;
+		int64_t m_P99;
+		int64_t m_Max;
+		int64_t m_Mean;
+	};
+
+private:
+	class CSection
+	{
+	public:
+		char m_aName[MAX_NAME_LENGTH];
+		int64_t m_Current;
+		int64_t m_aSamples[NUM_SAMPLES];
+	};
+
+	CSection m_aSections[MAX_SECTIONS];
+	bool m_Enabled = true;
+	int m_NumSections = 0;
+	int m_NumSamples = 0;
+	int m_NextSample = 0;
+
+public:
+	CTickProfiler();
+
+	bool Enabled() const { return m_Enabled; }
+	void SetEnabled(bool Enabled) { m_Enabled = Enabled; }
+
+	// returns the index of the section, registering it on first use
+	int Section(const char *pName);
+	int NumSections() const { return m_NumSections; }
+	const char *SectionName(int Section) const { return m_aSections[Section].m_aName; }
+
+	void Add(int Section, int64_t Duration) { m_aSections[Section].m_Current += Duration; }
+	// stores the time of all sections since the last call as one sample
+	void EndTick();
+	void Reset();
+
+	int NumSamples() const { return m_NumSamples; }
+	CStats Stats(int Section) const;
+	// one JSON object with the stats in microseconds, for the log and econ
+	void FormatJson(char *pBuffer, int BufferSize) const;
+};
+
+// adds the time until the end of the scope or until Stop to a section,
+// does nothing while the profiler is disabled
+class CProfileScope
+{
+	CTickProfiler *m_pProfiler;
+	int m_Section;
+	int64_t m_Start;
+
+public:
+	CProfileScope(CTickProfiler *pProfiler, int Section) :
+		m_pProfiler(pProfiler->Enabled() ? pProfiler : nullptr), m_Section(Section), m_Start(m_pProfiler ? time_get_nanoseconds().count() : 0)
+	{
+	}
+	~CProfileScope() { Stop(); }
+
+	void Stop()
+	{
+		if(m_pProfiler)
+		{
+			m_pProfiler->Add(m_Section, time_get_nanoseconds().count() - m_Start);
+			m_pProfiler = nullptr;
+		}
+	}
+};
+
+#endif
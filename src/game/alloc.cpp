@@ -0,0 +1,66 @@
+#include "alloc.h"
+
+#include <base/math.h>
+
+#include <cstddef>
+
+CAllocPool::CAllocPool(size_t BlockSize, int ChunkSize) :
+	m_BlockSize(maximum(sizeof(CFreeBlock), (BlockSize + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1))),
+	m_ChunkSize(ChunkSize)
+{
+	dbg_assert(ChunkSize > 0, "invalid chunk size");
+}
+
+CAllocPool::~CAllocPool()
+{
+	// objects that outlive the pool at shutdown keep their memory
+	if(m_NumUsed > 0)
+		return;
+	for(char *pChunk : m_vpChunks)
+	{
+		ASAN_UNPOISON_MEMORY_REGION(pChunk, m_BlockSize * m_ChunkSize);
+		free(pChunk);
+	}
+}
+
+void CAllocPool::AllocateChunk()
+{
+	char *pChunk = static_cast<char *>(malloc(m_BlockSize * m_ChunkSize));
+	dbg_assert(pChunk != nullptr, "out of memory");
+	m_vpChunks.push_back(pChunk);
+
+	// push the blocks in reverse so they are handed out in address order
+	for(int i = m_ChunkSize - 1; i >= 0; i--)
+	{
+		CFreeBlock *pBlock = reinterpret_cast<CFreeBlock *>(pChunk + i * m_BlockSize);
+		pBlock->m_pNext = m_pFirstFree;
+		m_pFirstFree = pBlock;
+		ASAN_POISON_MEMORY_REGION(pChunk + i * m_BlockSize + sizeof(CFreeBlock), m_BlockSize - sizeof(CFreeBlock));
+	}
+}
+
+void *CAllocPool::Allocate(size_t Size)
+{
+	dbg_assert(Size <= m_BlockSize, "size error");
+	if(!m_pFirstFree)
+		AllocateChunk();
+
+	CFreeBlock *pBlock = m_pFirstFree;
+	m_pFirstFree = pBlock->m_pNext;
+	m_NumUsed++;
+	ASAN_UNPOISON_MEMORY_REGION(pBlock, m_BlockSize);
+	mem_zero(pBlock, m_BlockSize);
+	return pBlock;
+}
+
+void CAllocPool::Free(void *pBlock)
+{
+	if(!pBlock)
+		return;
+	dbg_assert(m_NumUsed > 0, "not used");
+	m_NumUsed--;
+	CFreeBlock *pFree = static_cast<CFreeBlock *>(pBlock);
+	pFree->m_pNext = m_pFirstFree;
+	m_pFirstFree = pFree;
+	ASAN_POISON_MEMORY_REGION(static_cast<char *>(pBlock) + sizeof(CFreeBlock), m_BlockSize - sizeof(CFreeBlock));
+}
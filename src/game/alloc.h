@@ -6,6 +6,7 @@
 #include <base/system.h>
 
 #include <new>
+#include <vector>
 
 #ifndef __has_feature
 #define __has_feature(x) 0
@@ -78,4 +79,70 @@ private:
 		ASAN_POISON_MEMORY_REGION(gs_PoolData##POOLTYPE[Id], sizeof(gs_PoolData##POOLTYPE[Id])); \
 	}
 
+/**
+ * Fixed size blocks that are allocated in chunks of contiguous memory and
+ * recycled through a free list instead of being returned to the heap.
+ * Used by @link MACRO_ALLOC_POOL @endlink for objects that are created and
+ * destroyed very often. Not thread-safe.
+ */
+class CAllocPool
+{
+	struct CFreeBlock
+	{
+		CFreeBlock *m_pNext;
+	};
+
+	size_t m_BlockSize;
+	int m_ChunkSize;
+	std::vector<char *> m_vpChunks;
+	CFreeBlock *m_pFirstFree = nullptr;
+	int m_NumUsed = 0;
+
+	void AllocateChunk();
+
+public:
+	CAllocPool(size_t BlockSize, int ChunkSize);
+	~CAllocPool();
+
+	CAllocPool(const CAllocPool &Other) = delete;
+	CAllocPool &operator=(const CAllocPool &Other) = delete;
+
+	/**
+	 * Returns a zeroed block, allocating a new chunk only if all blocks are in use.
+	 */
+	void *Allocate(size_t Size);
+	void Free(void *pBlock);
+
+	size_t BlockSize() const { return m_BlockSize; }
+	int NumUsed() const { return m_NumUsed; }
+	int NumChunks() const { return m_vpChunks.size(); }
+};
+
+#define MACRO_ALLOC_POOL() \
+public: \
+	void *operator new(size_t Size); \
+	void operator delete(void *pObj); \
+	static const CAllocPool &AllocPool(); \
+\
+private:
+
+#define MACRO_ALLOC_POOL_IMPL(POOLTYPE, ChunkSize) \
+	static CAllocPool &AllocPool##POOLTYPE() \
+	{ \
+		static CAllocPool s_Pool(sizeof(POOLTYPE), ChunkSize); \
+		return s_Pool; \
+	} \
+	void *POOLTYPE::operator new(size_t Size) \
+	{ \
+		return AllocPool##POOLTYPE().Allocate(Size); \
+	} \
+	void POOLTYPE::operator delete(void *pObj) \
+	{ \
+		AllocPool##POOLTYPE().Free(pObj); \
+	} \
+	const CAllocPool &POOLTYPE::AllocPool() \
+	{ \
+		return AllocPool##POOLTYPE(); \
+	}
+
 #endif
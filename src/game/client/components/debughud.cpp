@@ -78,6 +78,9 @@ void CDebugHud::RenderNetCorrections()
 	str_format(aBuf, sizeof(aBuf), "%d", GameClient()->NetobjNumCorrections());
 	RenderRow("Netobj corrections", aBuf);
 	RenderRow(" on:", GameClient()->NetobjCorrectedOn());
+
+	str_format(aBuf, sizeof(aBuf), "%d / %d", GameClient()->m_PredictionTicksSimulated, GameClient()->m_PredictionTicksReused);
+	RenderRow("Predicted ticks (new / reused):", aBuf);
 }
 
 void CDebugHud::RenderTuning()
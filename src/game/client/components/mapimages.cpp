@@ -3,9 +3,12 @@
 #include "mapimages.h"
 
 #include <base/log.h>
+#include <base/tl/threading.h>
 
+#include <engine/engine.h>
 #include <engine/graphics.h>
 #include <engine/map.h>
+#include <engine/shared/jobs.h>
 #include <engine/storage.h>
 #include <engine/textrender.h>
 
@@ -16,6 +19,81 @@
 #include <game/localization.h>
 #include <game/mapitems.h>
 
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/**
+ * Decodes the external map images (PNG files from mapres) in parallel.
+ *
+ * Images are claimed from a shared index by the decode jobs and by the main
+ * thread alike, so map loading never waits on jobs that are queued behind
+ * unrelated work in the job pool.
+ */
+class CExternalMapImageDecoder
+{
+public:
+	class CImage
+	{
+	public:
+		int m_Index;
+		int m_LoadFlag;
+		char m_aPath[IO_MAX_PATH_LENGTH];
+		CImageInfo m_Info;
+		bool m_Success = false;
+	};
+
+	CExternalMapImageDecoder(IGraphics *pGraphics, std::vector<CImage> &&vImages) :
+		m_pGraphics(pGraphics),
+		m_vImages(std::move(vImages))
+	{
+	}
+
+	void DecodeRemaining()
+	{
+		while(true)
+		{
+			const size_t ImageIndex = m_NextImage.fetch_add(1);
+			if(ImageIndex >= m_vImages.size())
+			{
+				return;
+			}
+			CImage &Image = m_vImages[ImageIndex];
+			Image.m_Success = m_pGraphics->LoadPng(Image.m_Info, Image.m_aPath, IStorage::TYPE_ALL);
+			if(m_NumDecoded.fetch_add(1) + 1 == m_vImages.size())
+				m_AllDecoded.Signal();
+		}
+	}
+
+	// blocks until the last image has been decoded
+	void Wait() { m_AllDecoded.Wait(); }
+	std::vector<CImage> &Images() { return m_vImages; }
+
+private:
+	IGraphics *m_pGraphics;
+	std::vector<CImage> m_vImages;
+	std::atomic<size_t> m_NextImage = 0;
+	std::atomic<size_t> m_NumDecoded = 0;
+	CSemaphore m_AllDecoded;
+};
+
+class CExternalMapImageDecodeJob : public IJob
+{
+	std::shared_ptr<CExternalMapImageDecoder> m_pDecoder;
+
+	void Run() override
+	{
+		m_pDecoder->DecodeRemaining();
+	}
+
+public:
+	CExternalMapImageDecodeJob(std::shared_ptr<CExternalMapImageDecoder> pDecoder) :
+		m_pDecoder(std::move(pDecoder))
+	{
+	}
+};
+
 CMapImages::CMapImages()
 {
 	m_Count = 0;
@@ -97,8 +175,9 @@ void CMapImages::OnMapLoadImpl(class CLayers *pLayers, IMap *pMap)
 
 	const int TextureLoadFlag = Graphics()->Uses2DTextureArrays() ? IGraphics::TEXLOAD_TO_2D_ARRAY_TEXTURE : IGraphics::TEXLOAD_TO_3D_TEXTURE;
 
-	// load new textures
+	// load new textures, external images are decoded in parallel and uploaded afterwards
 	bool ShowWarning = false;
+	std::vector<CExternalMapImageDecoder::CImage> vExternalImages;
 	for(int i = 0; i < m_Count; i++)
 	{
 		if(aTextureUsedByTileOrQuadLayerFlag[i] == 0)
@@ -131,7 +210,6 @@ void CMapImages::OnMapLoadImpl(class CLayers *pLayers, IMap *pMap)
 
 		if(pImg->m_External)
 		{
-			char aPath[IO_MAX_PATH_LENGTH];
 			bool Translated = false;
 			if(Client()->IsSixup())
 			{
@@ -141,8 +219,10 @@ void CMapImages::OnMapLoadImpl(class CLayers *pLayers, IMap *pMap)
 					!str_comp(pName, "winter_main") ||
 					!str_comp(pName, "generic_unhookable");
 			}
-			str_format(aPath, sizeof(aPath), "mapres/%s%s.png", pName, Translated ? "_0.7" : "");
-			m_aTextures[i] = Graphics()->LoadTexture(aPath, IStorage::TYPE_ALL, LoadFlag);
+			CExternalMapImageDecoder::CImage &ExternalImage = vExternalImages.emplace_back();
+			ExternalImage.m_Index = i;
+			ExternalImage.m_LoadFlag = LoadFlag;
+			str_format(ExternalImage.m_aPath, sizeof(ExternalImage.m_aPath), "mapres/%s%s.png", pName, Translated ? "_0.7" : "");
 		}
 		else
 		{
@@ -169,6 +249,39 @@ void CMapImages::OnMapLoadImpl(class CLayers *pLayers, IMap *pMap)
 		pMap->UnloadData(pImg->m_ImageName);
 		ShowWarning = ShowWarning || m_aTextures[i].IsNullTexture();
 	}
+
+	if(!vExternalImages.empty())
+	{
+		auto pDecoder = std::make_shared<CExternalMapImageDecoder>(Graphics(), std::move(vExternalImages));
+		// the main thread decodes too, jobs that start late return immediately
+		const size_t NumJobs = std::min<size_t>(pDecoder->Images().size(), std::max(std::thread::hardware_concurrency(), 1u)) - 1;
+		for(size_t Job = 0; Job < NumJobs; Job++)
+		{
+			Engine()->AddJob(std::make_shared<CExternalMapImageDecodeJob>(pDecoder));
+		}
+		pDecoder->DecodeRemaining();
+		pDecoder->Wait();
+
+		for(CExternalMapImageDecoder::CImage &ExternalImage : pDecoder->Images())
+		{
+			if(!ExternalImage.m_Success)
+			{
+				// LoadPng already logged the error
+				m_aTextures[ExternalImage.m_Index] = Graphics()->NullTexture();
+			}
+			else
+			{
+				m_aTextures[ExternalImage.m_Index] = Graphics()->LoadTextureRawMove(ExternalImage.m_Info, ExternalImage.m_LoadFlag, ExternalImage.m_aPath);
+				if(!m_aTextures[ExternalImage.m_Index].IsValid())
+				{
+					// load synchronously again, which falls back to the null texture
+					m_aTextures[ExternalImage.m_Index] = Graphics()->LoadTexture(ExternalImage.m_aPath, IStorage::TYPE_ALL, ExternalImage.m_LoadFlag);
+				}
+			}
+			ShowWarning = ShowWarning || m_aTextures[ExternalImage.m_Index].IsNullTexture();
+		}
+	}
+
 	if(ShowWarning)
 	{
 		Client()->AddWarning(SWarning(Localize("Some map images could not be loaded. Check the local console for details.")));
@@ -79,6 +79,11 @@
 
 #include <chrono>
 #include <limits>
+#include <typeinfo>
+
+#if defined(__GNUC__)
+#include <cxxabi.h>
+#endif
 
 using namespace std::chrono_literals;
 
@@ -681,6 +686,7 @@ void CGameClient::OnReset()
 	m_GameWorld.m_WorldConfig.m_InfiniteAmmo = true;
 	m_PredictedWorld.CopyWorld(&m_GameWorld);
 	m_PrevPredictedWorld.CopyWorld(&m_PredictedWorld);
+	InvalidatePredictionCache();
 
 	m_vSnapEntities.clear();
 
@@ -829,8 +835,22 @@ void CGameClient::OnRender()
 	UpdateSpectatorCursor();
 
 	// render all systems
-	for(auto &pComponent : m_vpAll)
-		pComponent->OnRender();
+	if(m_ComponentProfiling)
+	{
+		for(size_t i = 0; i < m_vpAll.size(); i++)
+		{
+			const int64_t Start = time_get();
+			m_vpAll[i]->OnRender();
+			const int64_t Time = time_get() - Start;
+			m_vComponentProfile[i].m_TotalTime += Time;
+			m_vComponentProfile[i].m_MaxTime = maximum(m_vComponentProfile[i].m_MaxTime, Time);
+		}
+	}
+	else
+	{
+		for(auto &pComponent : m_vpAll)
+			pComponent->OnRender();
+	}
 
 	// clear all events/input for this frame
 	Input()->Clear();
@@ -1032,6 +1052,7 @@ void CGameClient::OnMessage(int MsgId, CUnpacker *pUnpacker, int Conn, bool Dumm
 		m_aReceivedTuning[Conn] = true;
 		// apply new tuning
 		m_aTuning[Conn] = NewTuning;
+		InvalidatePredictionCache();
 		return;
 	}
 
@@ -1140,6 +1161,7 @@ void CGameClient::OnMessage(int MsgId, CUnpacker *pUnpacker, int Conn, bool Dumm
 			if(CCharacter *pChar = m_GameWorld.GetCharacterById(pMsg->m_Victim))
 				pChar->ResetPrediction();
 			m_GameWorld.ReleaseHooked(pMsg->m_Victim);
+			InvalidatePredictionCache();
 		}
 
 		// if we are spectating a static id set (team 0) and somebody killed, and its not a guy in solo, we remove him from the list
@@ -1185,6 +1207,7 @@ void CGameClient::OnMessage(int MsgId, CUnpacker *pUnpacker, int Conn, bool Dumm
 				m_GameWorld.ReleaseHooked(i);
 			}
 		}
+		InvalidatePredictionCache();
 		std::stable_sort(vStrongWeakSorted.begin(), vStrongWeakSorted.end(), [](auto &Left, auto &Right) { return Left.second > Right.second; });
 		for(auto Id : vStrongWeakSorted)
 		{
@@ -1206,6 +1229,9 @@ void CGameClient::OnMessage(int MsgId, CUnpacker *pUnpacker, int Conn, bool Dumm
 	{
 		CNetMsg_Sv_PreInput *pMsg = (CNetMsg_Sv_PreInput *)pRawMsg;
 		m_aClients[pMsg->m_Owner].m_aPreInputs[pMsg->m_IntendedTick % 200] = *pMsg;
+		// the cached prediction already simulated this tick without the input
+		if(m_PredictionCache.m_Valid && pMsg->m_IntendedTick <= m_PredictionCache.m_PredTick)
+			InvalidatePredictionCache();
 	}
 	else if(MsgId == NETMSGTYPE_SV_SAVECODE)
 	{
@@ -1225,6 +1251,53 @@ void CGameClient::OnStateChange(int NewState, int OldState)
 		pComponent->OnStateChange(NewState, OldState);
 }
 
+void CGameClient::SetComponentProfiling(bool Profiling)
+{
+	m_ComponentProfiling = Profiling;
+	if(Profiling)
+		m_vComponentProfile.assign(m_vpAll.size(), SComponentProfile());
+}
+
+// Components have no names, their class name is good enough to tell them
+// apart. Gives the same name with every compiler, e.g. "CCamera".
+static void ComponentName(const CComponent *pComponent, char *pBuf, int BufSize)
+{
+	const char *pTypeName = typeid(*pComponent).name();
+#if defined(__GNUC__)
+	int Status;
+	char *pDemangled = abi::__cxa_demangle(pTypeName, nullptr, nullptr, &Status);
+	if(Status == 0 && pDemangled)
+	{
+		str_copy(pBuf, pDemangled, BufSize);
+		free(pDemangled);
+		return;
+	}
+	free(pDemangled);
+#endif
+	// MSVC already returns readable names like "class CCamera"
+	const char *pName = str_startswith(pTypeName, "class ");
+	if(!pName)
+		pName = str_startswith(pTypeName, "struct ");
+	str_copy(pBuf, pName ? pName : pTypeName, BufSize);
+}
+
+void CGameClient::WriteComponentProfile(IOHANDLE File, int NumFrames) const
+{
+	if(m_vComponentProfile.size() != m_vpAll.size())
+		return;
+	for(size_t i = 0; i < m_vpAll.size(); i++)
+	{
+		char aName[128];
+		ComponentName(m_vpAll[i], aName, sizeof(aName));
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "component %d %s: avg %.1f us, max %.1f us\n",
+			(int)i, aName,
+			NumFrames > 0 ? m_vComponentProfile[i].m_TotalTime * 1000000.0 / time_freq() / NumFrames : 0.0,
+			m_vComponentProfile[i].m_MaxTime * 1000000.0 / time_freq());
+		io_write(File, aBuf, str_length(aBuf));
+	}
+}
+
 void CGameClient::OnShutdown()
 {
 	for(auto &pComponent : m_vpAll)
@@ -2348,6 +2421,7 @@ void CGameClient::OnNewSnapshot()
 
 	UpdateLocalTuning();
 	m_IsDummySwapping = 0;
+	InvalidatePredictionCache();
 	if(Client()->State() != IClient::STATE_DEMOPLAYBACK)
 		UpdatePrediction();
 }
@@ -2401,21 +2475,32 @@ void CGameClient::OnPredict()
 
 	// init
 	bool Dummy = g_Config.m_ClDummy ^ m_IsDummySwapping;
-	m_PredictedWorld.CopyWorld(&m_GameWorld);
+	int PredictionTick = Client()->GetPredictionTick();
+	int StartTick = Client()->GameTick(g_Config.m_ClDummy) + 1;
+	if(ResumePrediction(PredictionTick))
+	{
+		// the predicted world is still the one of the last prediction, continue from it
+		StartTick = m_PredictionCache.m_PredTick + 1;
+	}
+	else
+	{
+		m_PredictionCache.m_Valid = false;
+		m_PredictedWorld.CopyWorld(&m_GameWorld);
 
-	// don't predict inactive players, or entities from other teams
-	for(int i = 0; i < MAX_CLIENTS; i++)
-		if(CCharacter *pChar = m_PredictedWorld.GetCharacterById(i))
-			if((!m_Snap.m_aCharacters[i].m_Active && pChar->m_SnapTicks > 10) || IsOtherTeam(i))
-				pChar->Destroy();
+		// don't predict inactive players, or entities from other teams
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			if(CCharacter *pChar = m_PredictedWorld.GetCharacterById(i))
+				if((!m_Snap.m_aCharacters[i].m_Active && pChar->m_SnapTicks > 10) || IsOtherTeam(i))
+					pChar->Destroy();
 
-	CProjectile *pProjNext = nullptr;
-	for(CProjectile *pProj = (CProjectile *)m_PredictedWorld.FindFirst(CGameWorld::ENTTYPE_PROJECTILE); pProj; pProj = pProjNext)
-	{
-		pProjNext = (CProjectile *)pProj->TypeNext();
-		if(IsOtherTeam(pProj->GetOwner()))
+		CProjectile *pProjNext = nullptr;
+		for(CProjectile *pProj = (CProjectile *)m_PredictedWorld.FindFirst(CGameWorld::ENTTYPE_PROJECTILE); pProj; pProj = pProjNext)
 		{
-			pProj->Destroy();
+			pProjNext = (CProjectile *)pProj->TypeNext();
+			if(IsOtherTeam(pProj->GetOwner()))
+			{
+				pProj->Destroy();
+			}
 		}
 	}
 
@@ -2426,9 +2511,11 @@ void CGameClient::OnPredict()
 	if(PredictDummy())
 		pDummyChar = m_PredictedWorld.GetCharacterById(m_aLocalIds[!g_Config.m_ClDummy]);
 
-	int PredictionTick = Client()->GetPredictionTick();
+	m_PredictionTicksReused = StartTick - 1 - Client()->GameTick(g_Config.m_ClDummy);
+	m_PredictionTicksSimulated = maximum(0, Client()->PredGameTick(g_Config.m_ClDummy) - StartTick + 1);
+
 	// predict
-	for(int Tick = Client()->GameTick(g_Config.m_ClDummy) + 1; Tick <= Client()->PredGameTick(g_Config.m_ClDummy); Tick++)
+	for(int Tick = StartTick; Tick <= Client()->PredGameTick(g_Config.m_ClDummy); Tick++)
 	{
 		// fetch the previous characters
 		if(Tick == PredictionTick)
@@ -2456,6 +2543,14 @@ void CGameClient::OnPredict()
 		CNetObj_PlayerInput *pDummyInputData = !pDummyChar ? nullptr : (CNetObj_PlayerInput *)Client()->GetInput(Tick, m_IsDummySwapping ^ 1);
 		bool DummyFirst = pInputData && pDummyInputData && pDummyChar->GetCid() < pLocalChar->GetCid();
 
+		// remember the inputs, the next prediction can only continue from here if they stay the same
+		m_PredictionCache.m_aaHasInput[0][Tick % 200] = pInputData != nullptr;
+		if(pInputData)
+			m_PredictionCache.m_aaInputs[0][Tick % 200] = *pInputData;
+		m_PredictionCache.m_aaHasInput[1][Tick % 200] = pDummyInputData != nullptr;
+		if(pDummyInputData)
+			m_PredictionCache.m_aaInputs[1][Tick % 200] = *pDummyInputData;
+
 		if(DummyFirst)
 			pDummyChar->OnDirectInput(pDummyInputData);
 		if(pInputData)
@@ -2590,6 +2685,19 @@ void CGameClient::OnPredict()
 		}
 	}
 
+	if(g_Config.m_ClPredictionCache)
+	{
+		m_PredictionCache.m_Valid = true;
+		m_PredictionCache.m_GameTick = Client()->GameTick(g_Config.m_ClDummy);
+		m_PredictionCache.m_PredTick = maximum(StartTick - 1, Client()->PredGameTick(g_Config.m_ClDummy));
+		m_PredictionCache.m_Dummy = g_Config.m_ClDummy;
+		m_PredictionCache.m_DummySwapping = m_IsDummySwapping;
+		m_PredictionCache.m_PredictDummy = pDummyChar != nullptr;
+		m_PredictionCache.m_AntiPingPreInput = g_Config.m_ClAntiPingPreInput;
+		m_PredictionCache.m_aLocalIds[0] = m_aLocalIds[0];
+		m_PredictionCache.m_aLocalIds[1] = m_aLocalIds[1];
+	}
+
 	// detect mispredictions of other players and make corrections smoother when possible
 	if(g_Config.m_ClAntiPingSmooth && Predict() && AntiPingPlayers() && m_NewTick && m_PredictedTick >= MIN_TICK && absolute(m_PredictedTick - Client()->PredGameTick(g_Config.m_ClDummy)) <= 1 && absolute(Client()->GameTick(g_Config.m_ClDummy) - Client()->PrevGameTick(g_Config.m_ClDummy)) <= 2)
 	{
@@ -3749,6 +3857,46 @@ void CGameClient::Echo(const char *pString)
 	m_Chat.Echo(pString);
 }
 
+bool CGameClient::ResumePrediction(int PredictionTick)
+{
+	const SPredictionCache &Cache = m_PredictionCache;
+	if(!g_Config.m_ClPredictionCache || !Cache.m_Valid)
+		return false;
+
+	// the predicted world must still be an unmodified copy of the current game world
+	if(!m_PredictedWorld.m_IsValidCopy || m_PredictedWorld.m_pParent != &m_GameWorld)
+		return false;
+
+	// freeze prediction depends on the tick the prediction ends at
+	if(g_Config.m_ClPredictFreeze == 2)
+		return false;
+
+	const int GameTick = Client()->GameTick(g_Config.m_ClDummy);
+	const int PredGameTick = Client()->PredGameTick(g_Config.m_ClDummy);
+	if(Cache.m_GameTick != GameTick || Cache.m_PredTick >= PredictionTick || Cache.m_PredTick >= PredGameTick || PredGameTick - GameTick >= 200)
+		return false;
+
+	if(Cache.m_Dummy != g_Config.m_ClDummy || Cache.m_DummySwapping != m_IsDummySwapping || Cache.m_AntiPingPreInput != g_Config.m_ClAntiPingPreInput ||
+		Cache.m_aLocalIds[0] != m_aLocalIds[0] || Cache.m_aLocalIds[1] != m_aLocalIds[1])
+		return false;
+	if(Cache.m_PredictDummy != (PredictDummy() && m_PredictedWorld.GetCharacterById(m_aLocalIds[!g_Config.m_ClDummy]) != nullptr))
+		return false;
+
+	// all ticks that were already predicted must have been predicted with the same inputs
+	for(int Tick = GameTick + 1; Tick <= Cache.m_PredTick; Tick++)
+	{
+		const CNetObj_PlayerInput *pInputData = (CNetObj_PlayerInput *)Client()->GetInput(Tick, m_IsDummySwapping);
+		if((pInputData != nullptr) != Cache.m_aaHasInput[0][Tick % 200] || (pInputData && mem_comp(pInputData, &Cache.m_aaInputs[0][Tick % 200], sizeof(*pInputData)) != 0))
+			return false;
+		if(!Cache.m_PredictDummy)
+			continue;
+		const CNetObj_PlayerInput *pDummyInputData = (CNetObj_PlayerInput *)Client()->GetInput(Tick, m_IsDummySwapping ^ 1);
+		if((pDummyInputData != nullptr) != Cache.m_aaHasInput[1][Tick % 200] || (pDummyInputData && mem_comp(pDummyInputData, &Cache.m_aaInputs[1][Tick % 200], sizeof(*pDummyInputData)) != 0))
+			return false;
+	}
+	return true;
+}
+
 bool CGameClient::IsOtherTeam(int ClientId) const
 {
 	bool Local = m_Snap.m_LocalClientId == ClientId;
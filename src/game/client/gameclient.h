@@ -189,6 +189,14 @@ public:
 private:
 	std::vector<class CComponent *> m_vpAll;
 	std::vector<class CComponent *> m_vpInput;
+
+	struct SComponentProfile
+	{
+		int64_t m_TotalTime = 0;
+		int64_t m_MaxTime = 0;
+	};
+	bool m_ComponentProfiling = false;
+	std::vector<SComponentProfile> m_vComponentProfile; // indexed like m_vpAll
 	CNetObjHandler m_NetObjHandler;
 	protocol7::CNetObjHandler m_NetObjHandler7;
 
@@ -615,6 +623,9 @@ public:
 
 	void ForceUpdateConsoleRemoteCompletionSuggestions() override;
 
+	void SetComponentProfiling(bool Profiling) override;
+	void WriteComponentProfile(IOHANDLE File, int NumFrames) const override;
+
 	void RefreshSkin(const std::shared_ptr<CManagedTeeRenderInfo> &pManagedTeeRenderInfo);
 	void RefreshSkins(int SkinDescriptorFlags);
 	void OnSkinUpdate(const char *pSkinName);
@@ -680,6 +691,10 @@ public:
 	CGameWorld m_PredictedWorld;
 	CGameWorld m_PrevPredictedWorld;
 
+	// ticks simulated and reused by the last prediction, see OnPredict
+	int m_PredictionTicksSimulated = 0;
+	int m_PredictionTicksReused = 0;
+
 	std::vector<SSwitchers> &Switchers() { return m_GameWorld.m_Core.m_vSwitchers; }
 	std::vector<SSwitchers> &PredSwitchers() { return m_PredictedWorld.m_Core.m_vSwitchers; }
 
@@ -886,6 +901,26 @@ private:
 
 	void UpdateLocalTuning();
 	void UpdatePrediction();
+
+	// m_PredictedWorld after the last OnPredict and the inputs it was predicted
+	// with, so that the next prediction can continue from it instead of
+	// simulating all ticks from m_GameWorld again
+	struct SPredictionCache
+	{
+		bool m_Valid = false;
+		int m_GameTick;
+		int m_PredTick;
+		int m_Dummy;
+		bool m_DummySwapping;
+		bool m_PredictDummy;
+		int m_AntiPingPreInput;
+		int m_aLocalIds[NUM_DUMMIES];
+		bool m_aaHasInput[NUM_DUMMIES][200];
+		CNetObj_PlayerInput m_aaInputs[NUM_DUMMIES][200];
+	};
+	SPredictionCache m_PredictionCache;
+	void InvalidatePredictionCache() { m_PredictionCache.m_Valid = false; }
+	bool ResumePrediction(int PredictionTick);
 	void UpdateSpectatorCursor();
 	void UpdateRenderedCharacters();
 
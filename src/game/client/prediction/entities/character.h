@@ -22,6 +22,8 @@ enum
 
 class CCharacter : public CEntity
 {
+	MACRO_ALLOC_POOL()
+
 	friend class CGameWorld;
 
 public:
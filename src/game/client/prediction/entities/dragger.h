@@ -8,6 +8,8 @@ class CLaserData;
 
 class CDragger : public CEntity
 {
+	MACRO_ALLOC_POOL()
+
 	vec2 m_Core;
 	float m_Strength;
 	bool m_IgnoreWalls;
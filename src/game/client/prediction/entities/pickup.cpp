@@ -10,6 +10,8 @@
 #include <game/collision.h>
 #include <game/mapitems.h>
 
+MACRO_ALLOC_POOL_IMPL(CPickup, 64)
+
 static constexpr int gs_PickupPhysSize = 14;
 
 void CPickup::Tick()
@@ -142,7 +144,7 @@ void CPickup::Move()
 		{
 			m_IsCoreActive = true;
 		}
-		m_Pos += m_Core;
+		SetPos(m_Pos + m_Core);
 	}
 }
 
@@ -12,6 +12,8 @@
 #include <game/collision.h>
 #include <game/mapitems.h>
 
+MACRO_ALLOC_POOL_IMPL(CProjectile, 128)
+
 CProjectile::CProjectile(
 	CGameWorld *pGameWorld,
 	int Type,
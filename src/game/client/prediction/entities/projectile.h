@@ -9,6 +9,8 @@ class CProjectileData;
 
 class CProjectile : public CEntity
 {
+	MACRO_ALLOC_POOL()
+
 	friend class CGameWorld;
 	friend class CItems;
 
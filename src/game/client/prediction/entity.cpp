@@ -21,6 +21,12 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType, vec2 Pos, int ProximityRad
 
 	m_pPrevTypeEntity = nullptr;
 	m_pNextTypeEntity = nullptr;
+	m_pPrevGridEntity = nullptr;
+	m_pNextGridEntity = nullptr;
+	m_GridBucket = CEntityGrid<CEntity>::BUCKET_NONE;
+	m_GridCellX = 0;
+	m_GridCellY = 0;
+	m_GridOrder = 0;
 	m_SnapTicks = -1;
 
 	// DDRace
@@ -36,6 +42,13 @@ CEntity::~CEntity()
 		GameWorld()->RemoveEntity(this);
 }
 
+void CEntity::SetPos(vec2 Pos)
+{
+	m_Pos = Pos;
+	if(m_GridBucket != CEntityGrid<CEntity>::BUCKET_NONE)
+		m_pGameWorld->OnEntityMoved(this);
+}
+
 bool CEntity::GameLayerClipped(vec2 CheckPos)
 {
 	return round_to_int(CheckPos.x) / 32 < -200 || round_to_int(CheckPos.x) / 32 > Collision()->GetWidth() + 200 ||
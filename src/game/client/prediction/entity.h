@@ -8,6 +8,7 @@
 #include <base/vmath.h>
 
 #include <game/alloc.h>
+#include <game/entity_grid.h>
 
 class CEntity
 {
@@ -18,6 +19,15 @@ private:
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
 
+	template<typename TEntity>
+	friend class CEntityGrid; // spatial index of the game world
+	CEntity *m_pPrevGridEntity;
+	CEntity *m_pNextGridEntity;
+	int m_GridBucket;
+	int m_GridCellX;
+	int m_GridCellY;
+	int64_t m_GridOrder;
+
 protected:
 	CGameWorld *m_pGameWorld;
 	bool m_MarkedForDestroy;
@@ -40,6 +50,8 @@ public:
 	CEntity *TypePrev() { return m_pPrevTypeEntity; }
 	const vec2 &GetPos() const { return m_Pos; }
 	float GetProximityRadius() const { return m_ProximityRadius; }
+	// must be used instead of writing m_Pos once the entity is in a world
+	void SetPos(vec2 Pos);
 	virtual bool CanCollide(int ClientId) { return true; }
 
 	virtual void Destroy() { delete this; }
@@ -69,6 +81,9 @@ public:
 	{
 		m_Id = -1;
 		m_pGameWorld = nullptr;
+		m_pPrevGridEntity = nullptr;
+		m_pNextGridEntity = nullptr;
+		m_GridBucket = CEntityGrid<CEntity>::BUCKET_NONE;
 	}
 };
 
@@ -71,23 +71,61 @@ CEntity *CGameWorld::FindLast(int Type)
 	return pLast;
 }
 
+int CGameWorld::GridIndex(int Type)
+{
+	switch(Type)
+	{
+	case ENTTYPE_CHARACTER: return GRID_CHARACTER;
+	case ENTTYPE_PICKUP: return GRID_PICKUP;
+	default: return -1;
+	}
+}
+
+// Calls `Fn` in list order for the entities of `Type` that may be closer
+// than `Radius` plus their proximity radius to the box from `Min` to `Max`,
+// until it returns false.
+template<typename F>
+void CGameWorld::ForEachEntityNear(int Type, vec2 Min, vec2 Max, float Radius, F &&Fn)
+{
+	const int Grid = GridIndex(Type);
+	if(Grid >= 0)
+	{
+		// take the buffer, so that nested queries do not overwrite it
+		std::vector<CEntity *> vpNear;
+		std::swap(vpNear, m_vpNearEntities);
+		if(m_aEntityGrids[Grid].Query(Min, Max, Radius, vpNear))
+		{
+			for(CEntity *pEnt : vpNear)
+				if(!Fn(pEnt))
+					break;
+			std::swap(vpNear, m_vpNearEntities);
+			return;
+		}
+		std::swap(vpNear, m_vpNearEntities);
+	}
+
+	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		if(!Fn(pEnt))
+			break;
+}
+
 int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
 {
 	if(Type < 0 || Type >= NUM_ENTTYPES)
 		return 0;
 
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
-	{
+	ForEachEntityNear(Type, Pos, Pos, Radius, [&](CEntity *pEnt) {
 		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
 		{
 			if(ppEnts)
 				ppEnts[Num] = pEnt;
 			Num++;
 			if(Num == Max)
-				break;
+				return false;
 		}
-	}
+		return true;
+	});
 
 	return Num;
 }
@@ -123,6 +161,10 @@ void CGameWorld::InsertEntity(CEntity *pEnt, bool Last)
 		pEnt->m_pNextTypeEntity = nullptr;
 	}
 
+	const int Grid = GridIndex(pEnt->m_ObjType);
+	if(Grid >= 0)
+		m_aEntityGrids[Grid].Insert(pEnt, Last ? --m_LastEntityOrder : ++m_FirstEntityOrder);
+
 	if(pEnt->m_ObjType == ENTTYPE_CHARACTER)
 	{
 		auto *pChar = (CCharacter *)pEnt;
@@ -157,6 +199,10 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = nullptr;
 	pEnt->m_pPrevTypeEntity = nullptr;
 
+	const int Grid = GridIndex(pEnt->m_ObjType);
+	if(Grid >= 0)
+		m_aEntityGrids[Grid].Remove(pEnt);
+
 	if(pEnt->m_pParent)
 	{
 		if(m_IsValidCopy && m_pParent && m_pParent->m_pChild == this)
@@ -171,6 +217,13 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 	}
 }
 
+void CGameWorld::OnEntityMoved(CEntity *pEnt)
+{
+	const int Grid = GridIndex(pEnt->m_ObjType);
+	if(Grid >= 0)
+		m_aEntityGrids[Grid].Move(pEnt);
+}
+
 void CGameWorld::RemoveCharacter(CCharacter *pChar)
 {
 	int Id = pChar->GetCid();
@@ -203,6 +256,8 @@ void CGameWorld::Tick()
 	{
 		// It's important to call PreTick() and Tick() after each other.
 		// If we call PreTick() before, and Tick() after other entities have been processed, it causes physics changes such as a stronger shotgun or grenade.
+		if(i == ENTTYPE_CHARACTER)
+			m_Core.BuildBroadPhase();
 		if(m_WorldConfig.m_NoWeakHookAndBounce && i == ENTTYPE_CHARACTER)
 		{
 			auto *pEnt = m_apFirstEntityTypes[i];
@@ -218,9 +273,13 @@ void CGameWorld::Tick()
 		for(; pEnt;)
 		{
 			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+			const int Cid = i == ENTTYPE_CHARACTER ? ((CCharacter *)pEnt)->GetCid() : -1;
 			pEnt->Tick();
+			m_Core.UpdateBroadPhase(Cid);
 			pEnt = m_pNextTraverseEntity;
 		}
+		if(i == ENTTYPE_CHARACTER)
+			m_Core.ClearBroadPhase();
 	}
 
 	for(auto *pEnt : m_apFirstEntityTypes)
@@ -264,20 +323,21 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 
 CEntity *CGameWorld::IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, int Type, vec2 &NewPos, const CEntity *pNotThis, int CollideWith, const CEntity *pThisOnly)
 {
+	if(Type < 0 || Type >= NUM_ENTTYPES)
+		return nullptr;
+
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CEntity *pClosest = nullptr;
 
-	CEntity *pEntity = FindFirst(Type);
-	for(; pEntity; pEntity = pEntity->TypeNext())
-	{
+	ForEachEntityNear(Type, vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)), vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)), Radius, [&](CEntity *pEntity) {
 		if(pEntity == pNotThis)
-			continue;
+			return true;
 
 		if(pThisOnly && pEntity != pThisOnly)
-			continue;
+			return true;
 
 		if(CollideWith != -1 && !pEntity->CanCollide(CollideWith))
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, pEntity->m_Pos, IntersectPos))
@@ -294,7 +354,8 @@ CEntity *CGameWorld::IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, int Typ
 				}
 			}
 		}
-	}
+		return true;
+	});
 
 	return pClosest;
 }
@@ -302,11 +363,9 @@ CEntity *CGameWorld::IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, int Typ
 std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, const CEntity *pNotThis)
 {
 	std::vector<CCharacter *> vpCharacters;
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
-	{
+	ForEachEntityNear(ENTTYPE_CHARACTER, vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)), vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)), Radius, [&](CEntity *pChr) {
 		if(pChr == pNotThis)
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, pChr->m_Pos, IntersectPos))
@@ -314,10 +373,11 @@ std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1
 			float Len = distance(pChr->m_Pos, IntersectPos);
 			if(Len < pChr->m_ProximityRadius + Radius)
 			{
-				vpCharacters.push_back(pChr);
+				vpCharacters.push_back((CCharacter *)pChr);
 			}
 		}
-	}
+		return true;
+	});
 	return vpCharacters;
 }
 
@@ -492,7 +552,7 @@ void CGameWorld::NetObjAdd(int ObjId, int ObjType, const void *pObjData, const C
 		{
 			if(NetPickup.Match(pPickup))
 			{
-				pPickup->m_Pos = NetPickup.m_Pos;
+				pPickup->SetPos(NetPickup.m_Pos);
 				pPickup->Keep();
 				return;
 			}
@@ -594,7 +654,8 @@ void CGameWorld::NetObjEnd()
 				if(CCharacter *pHookedChar = GetCharacterById(pChar->m_Core.HookedPlayer()))
 					if(pHookedChar->m_MarkedForDestroy)
 					{
-						pHookedChar->m_Pos = pHookedChar->m_Core.m_Pos = pChar->m_Core.m_HookPos;
+						pHookedChar->m_Core.m_Pos = pChar->m_Core.m_HookPos;
+						pHookedChar->SetPos(pHookedChar->m_Core.m_Pos);
 						pHookedChar->ResetVelocity();
 						mem_zero(&pHookedChar->m_SavedInput, sizeof(pHookedChar->m_SavedInput));
 						pHookedChar->m_SavedInput.m_TargetY = -1;
@@ -637,7 +698,7 @@ void CGameWorld::CopyWorld(CGameWorld *pFrom)
 	m_pMapBugs = pFrom->m_pMapBugs;
 	m_Teams = pFrom->m_Teams;
 	m_Core.m_vSwitchers = pFrom->m_Core.m_vSwitchers;
-	// delete the previous entities
+	// delete the previous entities, the copies reuse their pooled memory
 	Clear();
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
@@ -3,9 +3,11 @@
 #ifndef GAME_CLIENT_PREDICTION_GAMEWORLD_H
 #define GAME_CLIENT_PREDICTION_GAMEWORLD_H
 
+#include <game/entity_grid.h>
 #include <game/gamecore.h>
 #include <game/teamscore.h>
 
+#include <cstdint>
 #include <list>
 #include <vector>
 
@@ -46,6 +48,7 @@ public:
 	CEntity *IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, int Type, vec2 &NewPos, const CEntity *pNotThis = nullptr, int CollideWith = -1, const CEntity *pThisOnly = nullptr);
 	void InsertEntity(CEntity *pEntity, bool Last = false);
 	void RemoveEntity(CEntity *pEntity);
+	void OnEntityMoved(CEntity *pEntity);
 	void RemoveCharacter(CCharacter *pChar);
 	void Tick();
 
@@ -116,6 +119,22 @@ private:
 	CEntity *m_pNextTraverseEntity = nullptr;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// spatial index of the entity types queried by position
+	enum
+	{
+		GRID_CHARACTER = 0,
+		GRID_PICKUP,
+		NUM_GRIDS
+	};
+	static int GridIndex(int Type);
+	template<typename F>
+	void ForEachEntityNear(int Type, vec2 Min, vec2 Max, float Radius, F &&Fn);
+	CEntityGrid<CEntity> m_aEntityGrids[NUM_GRIDS];
+	std::vector<CEntity *> m_vpNearEntities;
+	// entities inserted at the front count up, the ones at the back down
+	int64_t m_FirstEntityOrder = 0;
+	int64_t m_LastEntityOrder = 0;
+
 	CCharacter *m_apCharacters[MAX_CLIENTS];
 
 	CCollision *m_pCollision;
@@ -14,6 +14,7 @@
 #include <game/mapitems.h>
 
 #include <cmath>
+#include <limits>
 
 vec2 ClampVel(int MoveRestriction, vec2 Vel)
 {
@@ -325,12 +326,83 @@ int CCollision::GetTile(int x, int y) const
 	return 0;
 }
 
-// TODO: rewrite this smarter!
+// The line intersection functions sample a line about once per pixel, but
+// all their checks only depend on the 32x32 tile (the rounded or truncated
+// sample position divided by 32) a sample is in. This walks the samples tile
+// by tile instead: samples that are guaranteed to be in the same tile as an
+// already checked one are skipped, so the results stay bit-identical.
+class CLineTileWalker
+{
+	double m_StepX;
+	double m_StepY;
+	double m_Margin;
+	int m_LastSample;
+
+	// number of steps that keep the coordinate inside its current tile
+	double StepsInTile(float Pos, double Step) const
+	{
+		if(Step == 0.0)
+			return std::numeric_limits<double>::max();
+		// rounding moves the tile borders by up to half a pixel in both directions
+		const double Tile = std::floor(Pos / 32.0) * 32.0;
+		if(Pos - Tile <= m_Margin || Tile + 32.0 - Pos <= m_Margin)
+			return 0.0;
+		const double Border = Step > 0.0 ? Tile + 32.0 - m_Margin : Tile + m_Margin;
+		return (Border - Pos) / Step;
+	}
+
+public:
+	/**
+	 * @param Pos0 Start of the line.
+	 * @param Pos1 End of the line.
+	 * @param Divisor Sample `i` is at `mix(Pos0, Pos1, i / Divisor)`.
+	 * @param LastSample Index of the last sample.
+	 */
+	CLineTileWalker(vec2 Pos0, vec2 Pos1, float Divisor, int LastSample) :
+		m_LastSample(LastSample)
+	{
+		// the sample indices must be exact as floats
+		if(Divisor <= 0.0f || LastSample > (1 << 22))
+		{
+			m_StepX = 0.0;
+			m_StepY = 0.0;
+			m_LastSample = -1;
+			m_Margin = 0.0;
+			return;
+		}
+		m_StepX = ((double)Pos1.x - Pos0.x) / Divisor;
+		m_StepY = ((double)Pos1.y - Pos0.y) / Divisor;
+		// half a pixel for rounding plus generous bounds for the float error of the samples
+		const double Error = ((double)absolute(Pos0.x) + absolute(Pos0.y) + absolute(Pos1.x) + absolute(Pos1.y)) / (1 << 20);
+		m_Margin = 1.0 + Error;
+	}
+
+	/**
+	 * Skips the samples after `Sample` at `Pos` that are in the same tile.
+	 *
+	 * @return The sample to continue from. The sample after it is either the
+	 * last one guaranteed to be in the same tile, so that the sample before a
+	 * collision is still computed by the caller, or the next one.
+	 */
+	int Skip(vec2 Pos, int Sample) const
+	{
+		if(Sample >= m_LastSample)
+			return Sample;
+		const double Steps = std::min(StepsInTile(Pos.x, m_StepX), StepsInTile(Pos.y, m_StepY));
+		// also catches NaN positions
+		if(!(Steps >= 2.0))
+			return Sample;
+		const int SameTile = Sample + (int)std::min(Steps, (double)(m_LastSample - Sample));
+		return SameTile - 1;
+	}
+};
+
 int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
 	vec2 Last = Pos0;
+	const CLineTileWalker Walker(Pos0, Pos1, End, End);
 	for(int i = 0; i <= End; i++)
 	{
 		float a = i / (float)End;
@@ -349,6 +421,7 @@ int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *p
 		}
 
 		Last = Pos;
+		i = Walker.Skip(Pos, i);
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -362,6 +435,7 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
 	vec2 Last = Pos0;
+	const CLineTileWalker Walker(Pos0, Pos1, End, End);
 	int dx = 0, dy = 0; // Offset for checking the "through" tile
 	ThroughOffset(Pos0, Pos1, &dx, &dy);
 	for(int i = 0; i <= End; i++)
@@ -409,6 +483,7 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 		}
 
 		Last = Pos;
+		i = Walker.Skip(Pos, i);
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -422,6 +497,7 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
 	vec2 Last = Pos0;
+	const CLineTileWalker Walker(Pos0, Pos1, End, End);
 	for(int i = 0; i <= End; i++)
 	{
 		float a = i / (float)End;
@@ -457,6 +533,7 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 		}
 
 		Last = Pos;
+		i = Walker.Skip(Pos, i);
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -518,6 +595,59 @@ bool CCollision::TestBox(vec2 Pos, vec2 Size) const
 	return false;
 }
 
+// The tiles of the four corners TestBox checks for a box. Every box with the
+// same corner tiles as a box that was tested free is free as well.
+class CBoxTiles
+{
+public:
+	int m_Left;
+	int m_Top;
+	int m_Right;
+	int m_Bottom;
+
+	CBoxTiles() = default;
+	CBoxTiles(const CCollision *pCollision, vec2 Pos, vec2 HalfSize) :
+		m_Left(Tile(Pos.x - HalfSize.x, pCollision->GetWidth())),
+		m_Top(Tile(Pos.y - HalfSize.y, pCollision->GetHeight())),
+		m_Right(Tile(Pos.x + HalfSize.x, pCollision->GetWidth())),
+		m_Bottom(Tile(Pos.y + HalfSize.y, pCollision->GetHeight()))
+	{
+	}
+
+	bool operator==(const CBoxTiles &Other) const
+	{
+		return m_Left == Other.m_Left && m_Top == Other.m_Top && m_Right == Other.m_Right && m_Bottom == Other.m_Bottom;
+	}
+
+	// guess for the number of steps that keep all corners in their tiles
+	static int StepsInTiles(vec2 Pos, vec2 HalfSize, vec2 Step)
+	{
+		const double Steps = std::min({StepsInTile(Pos.x - HalfSize.x, Step.x), StepsInTile(Pos.x + HalfSize.x, Step.x),
+			StepsInTile(Pos.y - HalfSize.y, Step.y), StepsInTile(Pos.y + HalfSize.y, Step.y)});
+		// also catches NaN positions
+		if(!(Steps >= 1.0))
+			return 0;
+		return (int)std::min(Steps, (double)std::numeric_limits<int>::max());
+	}
+
+private:
+	// same as the tile lookup of CheckPoint
+	static int Tile(float Pos, int Size)
+	{
+		return std::clamp(round_to_int(Pos) / 32, 0, Size - 1);
+	}
+
+	static double StepsInTile(float Pos, float Step)
+	{
+		if(Step == 0.0f)
+			return std::numeric_limits<double>::max();
+		// rounding moves the tile borders by half a pixel, one pixel also covers the float error of the steps
+		const double Tile = std::floor(Pos / 32.0) * 32.0;
+		const double Border = Step > 0.0f ? Tile + 32.0 - 1.0 : Tile + 1.0;
+		return (Border - Pos) / Step;
+	}
+};
+
 void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, vec2 Elasticity, bool *pGrounded) const
 {
 	// do the move
@@ -533,6 +663,14 @@ void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, vec2 Elast
 		float ElasticityX = std::clamp(Elasticity.x, -1.0f, 1.0f);
 		float ElasticityY = std::clamp(Elasticity.y, -1.0f, 1.0f);
 
+		// Steps through tiles that were already tested free don't need to
+		// test them again. All steps are still computed one after another,
+		// so that the resulting position stays bit-identical.
+		const vec2 HalfSize = Size * 0.5f;
+		const bool SkipFreeTiles = m_pTiles != nullptr;
+		CBoxTiles FreeTiles;
+		bool HasFreeTiles = false;
+
 		for(int i = 0; i <= Max; i++)
 		{
 			// Early break as optimization to stop checking for collisions for
@@ -552,7 +690,22 @@ void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, vec2 Elast
 				break;
 			}
 
-			if(TestBox(vec2(NewPos.x, NewPos.y), Size))
+			if(HasFreeTiles && CBoxTiles(this, NewPos, HalfSize) == FreeTiles)
+			{
+				// The coordinates only move in one direction, so if the box
+				// is still in the free tiles after the skipped steps, it was
+				// in them for all of them. Otherwise only take this step.
+				const int Steps = std::min(CBoxTiles::StepsInTiles(NewPos, HalfSize, Vel * Fraction), Max - i);
+				vec2 SkipPos = NewPos;
+				for(int j = 0; j < Steps; j++)
+					SkipPos = SkipPos + Vel * Fraction;
+				if(Steps > 0 && CBoxTiles(this, SkipPos, HalfSize) == FreeTiles)
+				{
+					NewPos = SkipPos;
+					i += Steps;
+				}
+			}
+			else if(TestBox(vec2(NewPos.x, NewPos.y), Size))
 			{
 				int Hits = 0;
 
@@ -584,6 +737,11 @@ void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, vec2 Elast
 					Vel.x *= -ElasticityX;
 				}
 			}
+			else if(SkipFreeTiles)
+			{
+				FreeTiles = CBoxTiles(this, NewPos, HalfSize);
+				HasFreeTiles = true;
+			}
 
 			Pos = NewPos;
 		}
@@ -933,6 +1091,7 @@ std::vector<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxI
 	else
 	{
 		int LastIndex = 0;
+		const CLineTileWalker Walker(PrevPos, Pos, d, End - 1);
 		for(int i = 0; i < End; i++)
 		{
 			float a = i / d;
@@ -947,6 +1106,7 @@ std::vector<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxI
 				vIndices.push_back(Index);
 				LastIndex = Index;
 			}
+			i = Walker.Skip(Tmp, i);
 		}
 
 		return vIndices;
@@ -1143,6 +1303,7 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 	vec2 Last = Pos0;
 
 	const int DistanceRounded = std::ceil(Distance);
+	const CLineTileWalker Walker(Pos0, Pos1, Distance, DistanceRounded - 1);
 	for(int i = 0; i < DistanceRounded; i++)
 	{
 		float a = i / Distance;
@@ -1161,6 +1322,7 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 				return GetCollisionAt(Pos.x, Pos.y);
 		}
 		Last = Pos;
+		i = Walker.Skip(Pos, i);
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -1175,6 +1337,7 @@ int CCollision::IntersectNoLaserNoWalls(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 	vec2 Last = Pos0;
 
 	const int DistanceRounded = std::ceil(Distance);
+	const CLineTileWalker Walker(Pos0, Pos1, Distance, DistanceRounded - 1);
 	for(int i = 0; i < DistanceRounded; i++)
 	{
 		float a = (float)i / Distance;
@@ -1191,6 +1354,7 @@ int CCollision::IntersectNoLaserNoWalls(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 				return GetFrontCollisionAt(Pos.x, Pos.y);
 		}
 		Last = Pos;
+		i = Walker.Skip(Pos, i);
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -1205,6 +1369,7 @@ int CCollision::IntersectAir(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pO
 	vec2 Last = Pos0;
 
 	const int DistanceRounded = std::ceil(Distance);
+	const CLineTileWalker Walker(Pos0, Pos1, Distance, DistanceRounded - 1);
 	for(int i = 0; i < DistanceRounded; i++)
 	{
 		float a = (float)i / Distance;
@@ -1223,6 +1388,7 @@ int CCollision::IntersectAir(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pO
 				return GetFrontTile(round_to_int(Pos.x), round_to_int(Pos.y));
 		}
 		Last = Pos;
+		i = Walker.Skip(Pos, i);
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -0,0 +1,183 @@
+#ifndef GAME_ENTITY_GRID_H
+#define GAME_ENTITY_GRID_H
+
+#include <base/math.h>
+#include <base/vmath.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Uniform grid over the positions of the entities of one type, used by the
+ * game worlds to answer proximity queries without walking all entities of
+ * the type.
+ *
+ * The entities are linked into hashed cell buckets intrusively, `TEntity`
+ * must provide the members `m_Pos`, `m_pPrevGridEntity`, `m_pNextGridEntity`,
+ * `m_GridBucket`, `m_GridCellX`, `m_GridCellY` and `m_GridOrder` and the
+ * function `GetProximityRadius()`. The owner must call @link Move @endlink
+ * whenever the position of an inserted entity changes.
+ */
+template<typename TEntity>
+class CEntityGrid
+{
+public:
+	enum
+	{
+		CELL_SIZE = 256,
+		NUM_BUCKETS = 256,
+		// queries covering more cells are answered by walking the entity list
+		MAX_QUERY_CELLS = 64,
+		// entities at positions too far out to be assigned to a cell
+		BUCKET_OUTSIDE = NUM_BUCKETS,
+		BUCKET_NONE = -1,
+	};
+
+	CEntityGrid()
+	{
+		std::fill(std::begin(m_apBuckets), std::end(m_apBuckets), nullptr);
+	}
+
+	/**
+	 * Adds the entity to the grid.
+	 *
+	 * @param pEnt The entity, must not be in a grid.
+	 * @param Order Position of the entity in the entity list of the world,
+	 * entities with higher order are returned first by @link Query @endlink.
+	 */
+	void Insert(TEntity *pEnt, int64_t Order)
+	{
+		m_MaxProximityRadius = maximum(m_MaxProximityRadius, pEnt->GetProximityRadius());
+		pEnt->m_GridOrder = Order;
+		int X = 0, Y = 0;
+		const int NewBucket = CellOf(pEnt->m_Pos, &X, &Y) ? Bucket(X, Y) : (int)BUCKET_OUTSIDE;
+		Link(pEnt, NewBucket, X, Y);
+	}
+
+	void Remove(TEntity *pEnt)
+	{
+		if(pEnt->m_GridBucket == BUCKET_NONE)
+			return;
+		Unlink(pEnt);
+	}
+
+	/**
+	 * Moves the entity to the cell of its current position, does nothing if
+	 * the entity is not in the grid.
+	 */
+	void Move(TEntity *pEnt)
+	{
+		if(pEnt->m_GridBucket == BUCKET_NONE)
+			return;
+		int X = 0, Y = 0;
+		const int NewBucket = CellOf(pEnt->m_Pos, &X, &Y) ? Bucket(X, Y) : (int)BUCKET_OUTSIDE;
+		if(NewBucket == pEnt->m_GridBucket && (NewBucket == BUCKET_OUTSIDE || (X == pEnt->m_GridCellX && Y == pEnt->m_GridCellY)))
+			return;
+		Unlink(pEnt);
+		Link(pEnt, NewBucket, X, Y);
+	}
+
+	/**
+	 * Finds the entities which may be closer than `Radius` plus their
+	 * proximity radius to the box from `Min` to `Max`.
+	 *
+	 * @param vpResult Receives the candidates ordered by descending order,
+	 * i.e. in the order of the entity list of the world.
+	 *
+	 * @return `false` if the box covers too many cells, the caller must walk
+	 * all entities of the type instead.
+	 */
+	bool Query(vec2 Min, vec2 Max, float Radius, std::vector<TEntity *> &vpResult) const
+	{
+		// one extra pixel covers rounding in the distance checks of the callers
+		const float Margin = Radius + m_MaxProximityRadius + 1.0f;
+		int MinX, MinY, MaxX, MaxY;
+		if(!CellOf(Min - vec2(Margin, Margin), &MinX, &MinY) || !CellOf(Max + vec2(Margin, Margin), &MaxX, &MaxY))
+			return false;
+		if((int64_t)(MaxX - MinX + 1) * (MaxY - MinY + 1) > MAX_QUERY_CELLS)
+			return false;
+
+		vpResult.clear();
+		for(TEntity *pEnt = m_apBuckets[BUCKET_OUTSIDE]; pEnt; pEnt = pEnt->m_pNextGridEntity)
+			vpResult.push_back(pEnt);
+		for(int Y = MinY; Y <= MaxY; Y++)
+		{
+			for(int X = MinX; X <= MaxX; X++)
+			{
+				// different cells share buckets, only take the entities of this cell
+				for(TEntity *pEnt = m_apBuckets[Bucket(X, Y)]; pEnt; pEnt = pEnt->m_pNextGridEntity)
+				{
+					if(pEnt->m_GridCellX == X && pEnt->m_GridCellY == Y)
+						vpResult.push_back(pEnt);
+				}
+			}
+		}
+		std::sort(vpResult.begin(), vpResult.end(), [](const TEntity *pA, const TEntity *pB) {
+			return pA->m_GridOrder > pB->m_GridOrder;
+		});
+		return true;
+	}
+
+	/**
+	 * Checks that the entity is in the cell of its current position.
+	 */
+	static bool IsInCell(const TEntity *pEnt)
+	{
+		int X, Y;
+		if(!CellOf(pEnt->m_Pos, &X, &Y))
+			return pEnt->m_GridBucket == BUCKET_OUTSIDE;
+		return pEnt->m_GridBucket == Bucket(X, Y) && pEnt->m_GridCellX == X && pEnt->m_GridCellY == Y;
+	}
+
+private:
+	TEntity *m_apBuckets[NUM_BUCKETS + 1];
+	float m_MaxProximityRadius = 0.0f;
+
+	static bool CellOf(vec2 Pos, int *pX, int *pY)
+	{
+		// also false for NaN
+		if(!(std::fabs(Pos.x) < 1e8f && std::fabs(Pos.y) < 1e8f))
+		{
+			*pX = 0;
+			*pY = 0;
+			return false;
+		}
+		*pX = (int)std::floor(Pos.x / CELL_SIZE);
+		*pY = (int)std::floor(Pos.y / CELL_SIZE);
+		return true;
+	}
+
+	static int Bucket(int X, int Y)
+	{
+		return (int)(((unsigned)X * 73856093u ^ (unsigned)Y * 19349663u) % NUM_BUCKETS);
+	}
+
+	void Link(TEntity *pEnt, int Bucket, int X, int Y)
+	{
+		pEnt->m_GridBucket = Bucket;
+		pEnt->m_GridCellX = X;
+		pEnt->m_GridCellY = Y;
+		pEnt->m_pPrevGridEntity = nullptr;
+		pEnt->m_pNextGridEntity = m_apBuckets[Bucket];
+		if(m_apBuckets[Bucket])
+			m_apBuckets[Bucket]->m_pPrevGridEntity = pEnt;
+		m_apBuckets[Bucket] = pEnt;
+	}
+
+	void Unlink(TEntity *pEnt)
+	{
+		if(pEnt->m_pPrevGridEntity)
+			pEnt->m_pPrevGridEntity->m_pNextGridEntity = pEnt->m_pNextGridEntity;
+		else
+			m_apBuckets[pEnt->m_GridBucket] = pEnt->m_pNextGridEntity;
+		if(pEnt->m_pNextGridEntity)
+			pEnt->m_pNextGridEntity->m_pPrevGridEntity = pEnt->m_pPrevGridEntity;
+		pEnt->m_pPrevGridEntity = nullptr;
+		pEnt->m_pNextGridEntity = nullptr;
+		pEnt->m_GridBucket = BUCKET_NONE;
+	}
+};
+
+#endif
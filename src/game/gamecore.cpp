@@ -10,6 +10,8 @@
 
 #include <engine/shared/config.h>
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
 
 const char *CTuningParams::ms_apNames[] =
@@ -346,8 +348,11 @@ void CCharacterCore::Tick(bool UseInput, bool DoDeferredTick)
 		if(!m_HookHitDisabled && m_pWorld && m_Tuning.m_PlayerHooking && (m_HookState == HOOK_FLYING || !m_NewHook))
 		{
 			float Distance = 0.0f;
-			for(int i = 0; i < MAX_CLIENTS; i++)
+			int aIds[MAX_CLIENTS];
+			const int NumIds = m_pWorld->CharactersNear(vec2(minimum(m_HookPos.x, NewPos.x), minimum(m_HookPos.y, NewPos.y)), vec2(maximum(m_HookPos.x, NewPos.x), maximum(m_HookPos.y, NewPos.y)), PhysicalSize() + 2.0f, aIds);
+			for(int Index = 0; Index < NumIds; Index++)
 			{
+				const int i = aIds[Index];
 				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
 				if(!pCharCore || pCharCore == this || (!(m_Super || pCharCore->m_Super) && ((m_Id != -1 && !m_pTeams->CanCollide(i, m_Id)) || pCharCore->m_Solo || m_Solo)))
 					continue;
@@ -459,8 +464,12 @@ void CCharacterCore::TickDeferred()
 {
 	if(m_pWorld)
 	{
-		for(int i = 0; i < MAX_CLIENTS; i++)
+		// only close characters collide, the hooked one is dragged from anywhere
+		int aIds[MAX_CLIENTS];
+		const int NumIds = m_pWorld->CharactersNear(m_Pos, m_Pos, PhysicalSize() * 1.25f, aIds, m_HookedPlayer);
+		for(int Index = 0; Index < NumIds; Index++)
 		{
+			const int i = aIds[Index];
 			CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
 			if(!pCharCore)
 				continue;
@@ -757,4 +766,125 @@ void CWorldCore::InitSwitchers(int HighestSwitchNumber)
 	}
 }
 
+void CWorldCore::BuildBroadPhase()
+{
+	m_BroadPhase = true;
+	m_NumSorted = 0;
+	m_NumUnsorted = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		m_apBroadPhaseCharacters[i] = nullptr;
+		InsertIntoBroadPhase(i);
+	}
+}
+
+void CWorldCore::UpdateBroadPhase(int ClientId)
+{
+	if(!m_BroadPhase || ClientId < 0 || ClientId >= MAX_CLIENTS)
+		return;
+#ifdef CONF_DEBUG
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(i != ClientId && m_apCharacters[i] && m_apCharacters[i] == m_apBroadPhaseCharacters[i])
+			dbg_assert(mem_comp(&m_apCharacters[i]->m_Pos, &m_aBroadPhasePos[i], sizeof(vec2)) == 0, "character moved without UpdateBroadPhase");
+		else if(i != ClientId)
+			dbg_assert(!m_apCharacters[i], "character added without UpdateBroadPhase");
+	}
+#endif
+	const CCharacterCore *pCharCore = m_apCharacters[ClientId];
+	if(pCharCore == m_apBroadPhaseCharacters[ClientId] && (!pCharCore || mem_comp(&pCharCore->m_Pos, &m_aBroadPhasePos[ClientId], sizeof(vec2)) == 0))
+		return;
+	RemoveFromBroadPhase(ClientId);
+	InsertIntoBroadPhase(ClientId);
+}
+
+void CWorldCore::ClearBroadPhase()
+{
+	m_BroadPhase = false;
+}
+
+void CWorldCore::RemoveFromBroadPhase(int ClientId)
+{
+	if(!m_apBroadPhaseCharacters[ClientId])
+		return;
+	m_apBroadPhaseCharacters[ClientId] = nullptr;
+	for(int i = 0; i < m_NumUnsorted; i++)
+	{
+		if(m_aUnsortedIds[i] == ClientId)
+		{
+			m_aUnsortedIds[i] = m_aUnsortedIds[--m_NumUnsorted];
+			return;
+		}
+	}
+	for(int i = 0; i < m_NumSorted; i++)
+	{
+		if(m_aSortedIds[i] == ClientId)
+		{
+			std::copy(m_aSortedIds + i + 1, m_aSortedIds + m_NumSorted, m_aSortedIds + i);
+			std::copy(m_aSortedX + i + 1, m_aSortedX + m_NumSorted, m_aSortedX + i);
+			m_NumSorted--;
+			return;
+		}
+	}
+}
+
+void CWorldCore::InsertIntoBroadPhase(int ClientId)
+{
+	const CCharacterCore *pCharCore = m_apCharacters[ClientId];
+	if(!pCharCore)
+		return;
+	m_apBroadPhaseCharacters[ClientId] = pCharCore;
+	m_aBroadPhasePos[ClientId] = pCharCore->m_Pos;
+	const vec2 Pos = pCharCore->m_Pos;
+	// also false for NaN
+	if(!(std::fabs(Pos.x) < 1e8f && std::fabs(Pos.y) < 1e8f))
+	{
+		m_aUnsortedIds[m_NumUnsorted++] = ClientId;
+		return;
+	}
+	const int Index = std::upper_bound(m_aSortedX, m_aSortedX + m_NumSorted, Pos.x) - m_aSortedX;
+	std::copy_backward(m_aSortedIds + Index, m_aSortedIds + m_NumSorted, m_aSortedIds + m_NumSorted + 1);
+	std::copy_backward(m_aSortedX + Index, m_aSortedX + m_NumSorted, m_aSortedX + m_NumSorted + 1);
+	m_aSortedIds[Index] = ClientId;
+	m_aSortedX[Index] = Pos.x;
+	m_NumSorted++;
+}
+
+int CWorldCore::CharactersNear(vec2 Min, vec2 Max, float Radius, int *pIds, int AlsoId) const
+{
+	if(!m_BroadPhase)
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			pIds[i] = i;
+		return MAX_CLIENTS;
+	}
+
+	// one extra pixel covers rounding in the distance checks of the callers
+	const float Margin = Radius + 1.0f;
+	const vec2 BoxMin = Min - vec2(Margin, Margin);
+	const vec2 BoxMax = Max + vec2(Margin, Margin);
+	bool aFound[MAX_CLIENTS] = {};
+	int Num = 0;
+	auto &&Add = [&](int Id) {
+		if(!aFound[Id])
+		{
+			aFound[Id] = true;
+			pIds[Num++] = Id;
+		}
+	};
+	for(int i = std::lower_bound(m_aSortedX, m_aSortedX + m_NumSorted, BoxMin.x) - m_aSortedX; i < m_NumSorted && m_aSortedX[i] <= BoxMax.x; i++)
+	{
+		const float Y = m_aBroadPhasePos[m_aSortedIds[i]].y;
+		if(Y >= BoxMin.y && Y <= BoxMax.y)
+			Add(m_aSortedIds[i]);
+	}
+	for(int i = 0; i < m_NumUnsorted; i++)
+		Add(m_aUnsortedIds[i]);
+	if(AlsoId >= 0 && AlsoId < MAX_CLIENTS)
+		Add(AlsoId);
+	// keep the order of the full loop, the results depend on it
+	std::sort(pIds, pIds + Num);
+	return Num;
+}
+
 const CTuningParams CTuningParams::DEFAULT;
@@ -173,6 +173,48 @@ public:
 
 	void InitSwitchers(int HighestSwitchNumber);
 	std::vector<SSwitchers> m_vSwitchers;
+
+	/**
+	 * Sorts the characters by their x coordinate, so that the player
+	 * interaction of @link CCharacterCore::Tick @endlink and
+	 * @link CCharacterCore::TickDeferred @endlink only looks at the
+	 * characters near the ticking one.
+	 *
+	 * Until @link ClearBroadPhase @endlink is called, the owner must call
+	 * @link UpdateBroadPhase @endlink after a character was moved, added or
+	 * removed, except for the character which is currently ticking.
+	 */
+	void BuildBroadPhase();
+	void UpdateBroadPhase(int ClientId);
+	void ClearBroadPhase();
+
+	/**
+	 * Finds the characters which may be closer than `Radius` to the box from
+	 * `Min` to `Max`. Without a broad-phase, these are all characters.
+	 *
+	 * @param pIds Receives the ids in ascending order, must have room for
+	 * `MAX_CLIENTS` ids.
+	 * @param AlsoId Id to return in any case, e.g. the hooked player, or -1.
+	 *
+	 * @return The number of ids.
+	 */
+	int CharactersNear(vec2 Min, vec2 Max, float Radius, int *pIds, int AlsoId = -1) const;
+
+private:
+	void RemoveFromBroadPhase(int ClientId);
+	void InsertIntoBroadPhase(int ClientId);
+
+	bool m_BroadPhase = false;
+	// ids of the characters with a finite position, sorted by x
+	int m_NumSorted = 0;
+	int m_aSortedIds[MAX_CLIENTS];
+	float m_aSortedX[MAX_CLIENTS];
+	// ids of the characters which can't be sorted
+	int m_NumUnsorted = 0;
+	int m_aUnsortedIds[MAX_CLIENTS];
+	// core and position of each character when it was last sorted
+	const CCharacterCore *m_apBroadPhaseCharacters[MAX_CLIENTS];
+	vec2 m_aBroadPhasePos[MAX_CLIENTS];
 };
 
 class CCharacterCore
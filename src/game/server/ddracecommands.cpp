@@ -8,6 +8,8 @@
 #include <game/server/gamemodes/DDRace.h>
 #include <game/server/player.h>
 #include <game/server/save.h>
+#include <game/server/score.h>
+#include <game/server/scorecache.h>
 #include <game/server/teams.h>
 
 void CGameContext::ConGoLeft(IConsole::IResult *pResult, void *pUserData)
@@ -386,7 +388,7 @@ void CGameContext::ModifyWeapons(IConsole::IResult *pResult, void *pUserData,
 void CGameContext::Teleport(CCharacter *pChr, vec2 Pos)
 {
 	pChr->SetPosition(Pos);
-	pChr->m_Pos = Pos;
+	pChr->SetPos(Pos);
 	pChr->m_PrevPos = Pos;
 	pChr->m_DDRaceState = ERaceState::CHEATED;
 }
@@ -629,6 +631,20 @@ void CGameContext::ConDumpLog(IConsole::IResult *pResult, void *pUserData)
 	}
 }
 
+void CGameContext::ConScoreCacheStats(IConsole::IResult *pResult, void *pUserData)
+{
+	CGameContext *pSelf = (CGameContext *)pUserData;
+	if(!pSelf->Score())
+		return;
+	CScoreCache *pCache = pSelf->Score()->Cache();
+	const uint64_t Hits = pCache->Hits();
+	const uint64_t Misses = pCache->Misses();
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "hits=%" PRIu64 " misses=%" PRIu64 " hit_rate=%.1f%% invalidations=%" PRIu64 " entries=%d",
+		Hits, Misses, Hits + Misses > 0 ? 100.0 * Hits / (Hits + Misses) : 0.0, pCache->Invalidations(), pCache->NumEntries());
+	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "score_cache", aBuf);
+}
+
 void CGameContext::LogEvent(const char *Description, int ClientId)
 {
 	CLog *pNewEntry = &m_aLogs[m_LatestLog];
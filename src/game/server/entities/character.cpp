@@ -71,7 +71,7 @@ bool CCharacter::Spawn(CPlayer *pPlayer, vec2 Pos)
 	m_IsBlueTeleGunTeleport = false;
 
 	m_pPlayer = pPlayer;
-	m_Pos = Pos;
+	SetPos(Pos);
 
 	mem_zero(&m_LatestPrevPrevInput, sizeof(m_LatestPrevPrevInput));
 	m_LatestPrevPrevInput.m_TargetY = -1;
@@ -843,6 +843,12 @@ void CCharacter::Tick()
 }
 
 void CCharacter::TickDeferred()
+{
+	TickDeferredCore();
+	TickDeferredEvents();
+}
+
+void CCharacter::TickDeferredCore()
 {
 	// advance the dummy
 	{
@@ -856,19 +862,44 @@ void CCharacter::TickDeferred()
 	}
 
 	//lastsentcore
-	vec2 StartPos = m_Core.m_Pos;
-	vec2 StartVel = m_Core.m_Vel;
-	bool StuckBefore = Collision()->TestBox(m_Core.m_Pos, CCharacterCore::PhysicalSizeVec2());
+	m_StuckStartPos = m_Core.m_Pos;
+	m_StuckStartVel = m_Core.m_Vel;
+	m_StuckBefore = Collision()->TestBox(m_Core.m_Pos, CCharacterCore::PhysicalSizeVec2());
 
 	m_Core.m_Id = m_pPlayer->GetCid();
 	m_Core.Move();
-	bool StuckAfterMove = Collision()->TestBox(m_Core.m_Pos, CCharacterCore::PhysicalSizeVec2());
+	m_StuckAfterMove = Collision()->TestBox(m_Core.m_Pos, CCharacterCore::PhysicalSizeVec2());
 	m_Core.Quantize();
-	bool StuckAfterQuant = Collision()->TestBox(m_Core.m_Pos, CCharacterCore::PhysicalSizeVec2());
-	m_Pos = m_Core.m_Pos;
+	m_StuckAfterQuant = Collision()->TestBox(m_Core.m_Pos, CCharacterCore::PhysicalSizeVec2());
+
+	// update the m_SendCore if needed
+	{
+		CNetObj_Character Predicted;
+		CNetObj_Character Current;
+		mem_zero(&Predicted, sizeof(Predicted));
+		mem_zero(&Current, sizeof(Current));
+		m_ReckoningCore.Write(&Predicted);
+		m_Core.Write(&Current);
+
+		// only allow dead reckoning for a top of 3 seconds
+		if(m_Core.m_Reset || m_ReckoningTick + Server()->TickSpeed() * 3 < Server()->Tick() || mem_comp(&Predicted, &Current, sizeof(CNetObj_Character)) != 0)
+		{
+			m_ReckoningTick = Server()->Tick();
+			m_SendCore = m_Core;
+			m_ReckoningCore = m_Core;
+			m_Core.m_Reset = false;
+		}
+	}
+}
+
+void CCharacter::TickDeferredEvents()
+{
+	SetPos(m_Core.m_Pos);
 
-	if(!StuckBefore && (StuckAfterMove || StuckAfterQuant))
+	if(!m_StuckBefore && (m_StuckAfterMove || m_StuckAfterQuant))
 	{
+		const vec2 StartPos = m_StuckStartPos;
+		const vec2 StartVel = m_StuckStartVel;
 		// Hackish solution to get rid of strict-aliasing warning
 		union
 		{
@@ -883,9 +914,9 @@ void CCharacter::TickDeferred()
 
 		char aBuf[256];
 		str_format(aBuf, sizeof(aBuf), "STUCK!!! %d %d %d %f %f %f %f %x %x %x %x",
-			StuckBefore,
-			StuckAfterMove,
-			StuckAfterQuant,
+			m_StuckBefore,
+			m_StuckAfterMove,
+			m_StuckAfterQuant,
 			StartPos.x, StartPos.y,
 			StartVel.x, StartVel.y,
 			StartPosX.u, StartPosY.u,
@@ -932,25 +963,6 @@ void CCharacter::TickDeferred()
 		m_Pos.x = m_Input.m_TargetX;
 		m_Pos.y = m_Input.m_TargetY;
 	}
-
-	// update the m_SendCore if needed
-	{
-		CNetObj_Character Predicted;
-		CNetObj_Character Current;
-		mem_zero(&Predicted, sizeof(Predicted));
-		mem_zero(&Current, sizeof(Current));
-		m_ReckoningCore.Write(&Predicted);
-		m_Core.Write(&Current);
-
-		// only allow dead reckoning for a top of 3 seconds
-		if(m_Core.m_Reset || m_ReckoningTick + Server()->TickSpeed() * 3 < Server()->Tick() || mem_comp(&Predicted, &Current, sizeof(CNetObj_Character)) != 0)
-		{
-			m_ReckoningTick = Server()->Tick();
-			m_SendCore = m_Core;
-			m_ReckoningCore = m_Core;
-			m_Core.m_Reset = false;
-		}
-	}
 }
 
 void CCharacter::TickPaused()
@@ -39,6 +39,11 @@ public:
 	void PreTick();
 	void Tick() override;
 	void TickDeferred() override;
+	// first part of TickDeferred, only touches the character itself and
+	// reads the cores of the characters it can collide with
+	void TickDeferredCore();
+	// second part of TickDeferred, updates the world and creates the events
+	void TickDeferredEvents();
 	void TickPaused() override;
 	void Snap(int SnappingClient) override;
 	void SwapClients(int Client1, int Client2) override;
@@ -167,6 +172,13 @@ private:
 	CCharacterCore m_SendCore; // core that we should send
 	CCharacterCore m_ReckoningCore; // the dead reckoning core
 
+	// collision tests of the last move, reported by TickDeferredEvents
+	vec2 m_StuckStartPos;
+	vec2 m_StuckStartVel;
+	bool m_StuckBefore = false;
+	bool m_StuckAfterMove = false;
+	bool m_StuckAfterQuant = false;
+
 	// DDRace
 
 	void SnapCharacter(int SnappingClient, int Id);
@@ -23,6 +23,13 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType, vec2 Pos, int ProximityRad
 
 	m_pPrevTypeEntity = nullptr;
 	m_pNextTypeEntity = nullptr;
+
+	m_pPrevGridEntity = nullptr;
+	m_pNextGridEntity = nullptr;
+	m_GridBucket = CEntityGrid<CEntity>::BUCKET_NONE;
+	m_GridCellX = 0;
+	m_GridCellY = 0;
+	m_GridOrder = 0;
 }
 
 CEntity::~CEntity()
@@ -31,6 +38,13 @@ CEntity::~CEntity()
 	Server()->SnapFreeId(m_Id);
 }
 
+void CEntity::SetPos(vec2 Pos)
+{
+	m_Pos = Pos;
+	if(m_GridBucket != CEntityGrid<CEntity>::BUCKET_NONE)
+		m_pGameWorld->OnEntityMoved(this);
+}
+
 bool CEntity::NetworkClipped(int SnappingClient) const
 {
 	return ::NetworkClipped(m_pGameWorld->GameServer(), SnappingClient, m_Pos);
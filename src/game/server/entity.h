@@ -9,6 +9,7 @@
 #include <base/vmath.h>
 
 #include <game/alloc.h>
+#include <game/entity_grid.h>
 
 class CCollision;
 class CGameContext;
@@ -26,6 +27,15 @@ private:
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
 
+	template<typename TEntity>
+	friend class CEntityGrid; // spatial index of the game world
+	CEntity *m_pPrevGridEntity;
+	CEntity *m_pNextGridEntity;
+	int m_GridBucket;
+	int m_GridCellX;
+	int m_GridCellY;
+	int64_t m_GridOrder;
+
 	/* Identity */
 	CGameWorld *m_pGameWorld;
 	CCollision *m_pCCollision;
@@ -76,6 +86,16 @@ public: // TODO: Maybe make protected
 	const vec2 &GetPos() const { return m_Pos; }
 	float GetProximityRadius() const { return m_ProximityRadius; }
 
+	/* Setters */
+
+	/*
+		Function: SetPos
+			Moves the entity. Must be used instead of writing
+			m_Pos directly once the entity is in the game world,
+			so that the proximity queries of the world find it.
+	*/
+	void SetPos(vec2 Pos);
+
 	/* Other functions */
 
 	/*
@@ -20,12 +20,12 @@
 #include <engine/map.h>
 #include <engine/server/server.h>
 #include <engine/shared/config.h>
-#include <engine/shared/datafile.h>
 #include <engine/shared/json.h>
 #include <engine/shared/linereader.h>
 #include <engine/shared/memheap.h>
 #include <engine/shared/protocol.h>
 #include <engine/shared/protocolglue.h>
+#include <engine/shared/tick_profiler.h>
 #include <engine/storage.h>
 
 #include <generated/protocol.h>
@@ -124,8 +124,8 @@ CGameContext::CGameContext(bool Resetting) :
 		m_pVoteOptionHeap = new CHeap();
 	}
 
-	m_aDeleteTempfile[0] = 0;
 	m_TeeHistorianActive = false;
+	m_TeeHistorianCompress = false;
 }
 
 CGameContext::~CGameContext()
@@ -172,11 +172,26 @@ void CGameContext::Clear()
 }
 
 void CGameContext::TeeHistorianWrite(const void *pData, int DataSize, void *pUser)
+{
+	CGameContext *pSelf = (CGameContext *)pUser;
+	if(pSelf->m_TeeHistorianCompress)
+		pSelf->m_TeeHistorianBlocks.Write(pData, DataSize);
+	else
+		aio_write(pSelf->m_pTeeHistorianFile, pData, DataSize);
+}
+
+void CGameContext::TeeHistorianWriteBlock(const void *pData, int DataSize, void *pUser)
 {
 	CGameContext *pSelf = (CGameContext *)pUser;
 	aio_write(pSelf->m_pTeeHistorianFile, pData, DataSize);
 }
 
+void CGameContext::TeeHistorianWriteIndex(const void *pData, int DataSize, void *pUser)
+{
+	CGameContext *pSelf = (CGameContext *)pUser;
+	aio_write(pSelf->m_pTeeHistorianIndexFile, pData, DataSize);
+}
+
 void CGameContext::CommandCallback(int ClientId, int FlagMask, const char *pCmd, IConsole::IResult *pResult, void *pUser)
 {
 	CGameContext *pSelf = (CGameContext *)pUser;
@@ -1072,6 +1087,7 @@ void CGameContext::OnPreTickTeehistorian()
 	if(!m_TeeHistorianActive)
 		return;
 
+	CProfileScope Profile(Server()->TickProfiler(), m_aProfileSections[PROFILE_PRETICK_TEEHISTORIAN]);
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
 		if(m_apPlayers[i] != nullptr)
@@ -1090,9 +1106,13 @@ void CGameContext::OnTick()
 	// check tuning
 	CheckPureTuning();
 
+	CTickProfiler *pProfiler = Server()->TickProfiler();
 	if(m_TeeHistorianActive)
 	{
+		CProfileScope Profile(pProfiler, m_aProfileSections[PROFILE_TEEHISTORIAN]);
 		int Error = aio_error(m_pTeeHistorianFile);
+		if(!Error && m_TeeHistorianCompress)
+			Error = aio_error(m_pTeeHistorianIndexFile);
 		if(Error)
 		{
 			dbg_msg("teehistorian", "error writing to file, err=%d", Error);
@@ -1104,18 +1124,24 @@ void CGameContext::OnTick()
 			m_TeeHistorian.EndInputs();
 			m_TeeHistorian.EndTick();
 		}
-		m_TeeHistorian.BeginTick(Server()->Tick());
+		const bool NewBlock = m_TeeHistorianCompress && m_TeeHistorianBlocks.BeginTick(Server()->Tick(), m_TeeHistorian.LastWrittenTick());
+		m_TeeHistorian.BeginTick(Server()->Tick(), NewBlock);
 		m_TeeHistorian.BeginPlayers();
 	}
 
 	// copy tuning
 	*m_World.GetTuning(0) = m_aTuningList[0];
+	CProfileScope WorldProfile(pProfiler, m_aProfileSections[PROFILE_WORLD]);
 	m_World.Tick();
+	WorldProfile.Stop();
 
 	UpdatePlayerMaps();
 
+	CProfileScope ControllerProfile(pProfiler, m_aProfileSections[PROFILE_CONTROLLER]);
 	m_pController->Tick();
+	ControllerProfile.Stop();
 
+	CProfileScope PlayersProfile(pProfiler, m_aProfileSections[PROFILE_PLAYERS]);
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
 		if(m_apPlayers[i])
@@ -1133,8 +1159,10 @@ void CGameContext::OnTick()
 		if(pPlayer)
 			pPlayer->PostPostTick();
 	}
+	PlayersProfile.Stop();
 
 	// update voting
+	CProfileScope VotesProfile(pProfiler, m_aProfileSections[PROFILE_VOTES]);
 	if(m_VoteCloseTime)
 	{
 		// abort the kick-vote on player-leave
@@ -1359,6 +1387,7 @@ void CGameContext::OnTick()
 
 	if(m_SqlRandomMapResult != nullptr && m_SqlRandomMapResult->m_Completed)
 	{
+		CProfileScope Profile(pProfiler, m_aProfileSections[PROFILE_SQL]);
 		if(m_SqlRandomMapResult->m_Success)
 		{
 			if(m_SqlRandomMapResult->m_ClientId != -1 && m_apPlayers[m_SqlRandomMapResult->m_ClientId] && m_SqlRandomMapResult->m_aMessage[0] != '\0')
@@ -1374,6 +1403,7 @@ void CGameContext::OnTick()
 	// Record player position at the end of the tick
 	if(m_TeeHistorianActive)
 	{
+		CProfileScope Profile(pProfiler, m_aProfileSections[PROFILE_TEEHISTORIAN]);
 		for(int i = 0; i < MAX_CLIENTS; i++)
 		{
 			if(m_apPlayers[i] && m_apPlayers[i]->GetCharacter())
@@ -3969,6 +3999,7 @@ void CGameContext::RegisterDDRaceCommands()
 	Console()->Register("vote_no", "", CFGFLAG_SERVER, ConVoteNo, this, "Same as \"vote no\"");
 	Console()->Register("save_dry", "", CFGFLAG_SERVER, ConDrySave, this, "Dump the current savestring");
 	Console()->Register("dump_log", "?i[seconds]", CFGFLAG_SERVER, ConDumpLog, this, "Show logs of the last i seconds");
+	Console()->Register("score_cache_stats", "", CFGFLAG_SERVER, ConScoreCacheStats, this, "Show the hit rate of the cache of rank and top queries (see sv_sql_cache_ttl)");
 
 	Console()->Chain("sv_practice_by_default", ConchainPracticeByDefaultUpdate, this);
 }
@@ -4093,6 +4124,10 @@ void CGameContext::OnInit(const void *pPersistentData)
 	m_World.SetGameServer(this);
 	m_Events.SetGameServer(this);
 
+	static const char *s_apProfileSectionNames[NUM_PROFILE_SECTIONS] = {"tick.teehistorian", "tick.world", "tick.controller", "tick.players", "tick.votes", "tick.sql", "input.teehistorian"};
+	for(int i = 0; i < NUM_PROFILE_SECTIONS; i++)
+		m_aProfileSections[i] = Server()->TickProfiler()->Section(s_apProfileSectionNames[i]);
+
 	m_GameUuid = RandomUuid();
 	Console()->SetTeeHistorianCommandCallback(CommandCallback, this);
 
@@ -4101,8 +4136,6 @@ void CGameContext::OnInit(const void *pPersistentData)
 	m_Prng.Seed(aSeed);
 	m_World.m_Core.m_pPrng = &m_Prng;
 
-	DeleteTempfile();
-
 	for(int i = 0; i < NUM_NETOBJTYPES; i++)
 		Server()->SnapSetStaticsize(i, m_NetObjHandler.GetObjSize(i));
 
@@ -4201,8 +4234,9 @@ void CGameContext::OnInit(const void *pPersistentData)
 		char aGameUuid[UUID_MAXSTRSIZE];
 		FormatUuid(m_GameUuid, aGameUuid, sizeof(aGameUuid));
 
+		m_TeeHistorianCompress = g_Config.m_SvTeeHistorianCompress;
 		char aFilename[IO_MAX_PATH_LENGTH];
-		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian", aGameUuid);
+		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian%s", aGameUuid, m_TeeHistorianCompress ? ".blocks" : "");
 
 		IOHANDLE THFile = Storage()->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
 		if(!THFile)
@@ -4217,6 +4251,24 @@ void CGameContext::OnInit(const void *pPersistentData)
 		}
 		m_pTeeHistorianFile = aio_new(THFile);
 
+		if(m_TeeHistorianCompress)
+		{
+			str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian.index", aGameUuid);
+			IOHANDLE IndexFile = Storage()->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+			if(!IndexFile)
+			{
+				dbg_msg("teehistorian", "failed to open '%s'", aFilename);
+				Server()->SetErrorShutdown("teehistorian open error");
+				aio_close(m_pTeeHistorianFile);
+				aio_wait(m_pTeeHistorianFile);
+				aio_free(m_pTeeHistorianFile);
+				m_TeeHistorianActive = false;
+				return;
+			}
+			m_pTeeHistorianIndexFile = aio_new(IndexFile);
+			m_TeeHistorianBlocks.Reset(TeeHistorianWriteBlock, TeeHistorianWriteIndex, this);
+		}
+
 		char aVersion[128];
 		if(GIT_SHORTREV_HASH)
 		{
@@ -4384,16 +4436,7 @@ CPlayer *CGameContext::CreatePlayer(int ClientId, int StartTeam, bool Afk, int L
 	return m_apPlayers[ClientId];
 }
 
-void CGameContext::DeleteTempfile()
-{
-	if(m_aDeleteTempfile[0] != 0)
-	{
-		Storage()->RemoveFile(m_aDeleteTempfile, IStorage::TYPE_SAVE);
-		m_aDeleteTempfile[0] = 0;
-	}
-}
-
-bool CGameContext::OnMapChange(char *pNewMapName, int MapNameSize)
+bool CGameContext::OnMapChange(std::vector<char> *pvSettings)
 {
 	char aConfig[IO_MAX_PATH_LENGTH];
 	str_format(aConfig, sizeof(aConfig), "maps/%s.cfg", g_Config.m_SvMap);
@@ -4402,121 +4445,17 @@ bool CGameContext::OnMapChange(char *pNewMapName, int MapNameSize)
 	if(!LineReader.OpenFile(Storage()->OpenFile(aConfig, IOFLAG_READ, IStorage::TYPE_ALL)))
 	{
 		// No map-specific config, just return.
-		return true;
-	}
-
-	CDataFileReader Reader;
-	if(!Reader.Open(Storage(), pNewMapName, IStorage::TYPE_ALL))
-	{
-		log_error("mapchange", "Failed to import settings from '%s': failed to open map '%s' for reading", aConfig, pNewMapName);
 		return false;
 	}
 
-	std::vector<const char *> vpLines;
-	int TotalLength = 0;
+	// the settings are imported into the map by the map load job, so that
+	// the main thread doesn't have to rewrite the whole map
+	pvSettings->clear();
 	while(const char *pLine = LineReader.Get())
 	{
-		vpLines.push_back(pLine);
-		TotalLength += str_length(pLine) + 1;
-	}
-
-	char *pSettings = (char *)malloc(maximum(1, TotalLength));
-	int Offset = 0;
-	for(const char *pLine : vpLines)
-	{
-		int Length = str_length(pLine) + 1;
-		mem_copy(pSettings + Offset, pLine, Length);
-		Offset += Length;
-	}
-
-	CDataFileWriter Writer;
-
-	int SettingsIndex = Reader.NumData();
-	bool FoundInfo = false;
-	for(int i = 0; i < Reader.NumItems(); i++)
-	{
-		int TypeId;
-		int ItemId;
-		void *pData = Reader.GetItem(i, &TypeId, &ItemId);
-		int Size = Reader.GetItemSize(i);
-		CMapItemInfoSettings MapInfo;
-		if(TypeId == MAPITEMTYPE_INFO && ItemId == 0)
-		{
-			FoundInfo = true;
-			if(Size >= (int)sizeof(CMapItemInfoSettings))
-			{
-				CMapItemInfoSettings *pInfo = (CMapItemInfoSettings *)pData;
-				if(pInfo->m_Settings > -1)
-				{
-					SettingsIndex = pInfo->m_Settings;
-					char *pMapSettings = (char *)Reader.GetData(SettingsIndex);
-					int DataSize = Reader.GetDataSize(SettingsIndex);
-					if(DataSize == TotalLength && mem_comp(pSettings, pMapSettings, DataSize) == 0)
-					{
-						// Configs coincide, no need to update map.
-						free(pSettings);
-						return true;
-					}
-					Reader.UnloadData(pInfo->m_Settings);
-				}
-				else
-				{
-					MapInfo = *pInfo;
-					MapInfo.m_Settings = SettingsIndex;
-					pData = &MapInfo;
-					Size = sizeof(MapInfo);
-				}
-			}
-			else
-			{
-				*(CMapItemInfo *)&MapInfo = *(CMapItemInfo *)pData;
-				MapInfo.m_Settings = SettingsIndex;
-				pData = &MapInfo;
-				Size = sizeof(MapInfo);
-			}
-		}
-		Writer.AddItem(TypeId, ItemId, Size, pData);
-	}
-
-	if(!FoundInfo)
-	{
-		CMapItemInfoSettings Info;
-		Info.m_Version = 1;
-		Info.m_Author = -1;
-		Info.m_MapVersion = -1;
-		Info.m_Credits = -1;
-		Info.m_License = -1;
-		Info.m_Settings = SettingsIndex;
-		Writer.AddItem(MAPITEMTYPE_INFO, 0, sizeof(Info), &Info);
+		pvSettings->insert(pvSettings->end(), pLine, pLine + str_length(pLine) + 1);
 	}
-
-	for(int i = 0; i < Reader.NumData() || i == SettingsIndex; i++)
-	{
-		if(i == SettingsIndex)
-		{
-			Writer.AddData(TotalLength, pSettings);
-			continue;
-		}
-		const void *pData = Reader.GetData(i);
-		int Size = Reader.GetDataSize(i);
-		Writer.AddData(Size, pData);
-		Reader.UnloadData(i);
-	}
-
-	free(pSettings);
-	Reader.Close();
-
-	char aTemp[IO_MAX_PATH_LENGTH];
-	if(!Writer.Open(Storage(), IStorage::FormatTmpPath(aTemp, sizeof(aTemp), pNewMapName)))
-	{
-		log_error("mapchange", "Failed to import settings from '%s': failed to open map '%s' for writing", aConfig, aTemp);
-		return false;
-	}
-	Writer.Finish();
-	log_info("mapchange", "Imported settings from '%s' into '%s'", aConfig, aTemp);
-
-	str_copy(pNewMapName, aTemp, MapNameSize);
-	str_copy(m_aDeleteTempfile, aTemp, sizeof(m_aDeleteTempfile));
+	log_info("mapchange", "Importing settings from '%s'", aConfig);
 	return true;
 }
 
@@ -4534,21 +4473,30 @@ void CGameContext::OnShutdown(void *pPersistentData)
 	if(m_TeeHistorianActive)
 	{
 		m_TeeHistorian.Finish();
-		aio_close(m_pTeeHistorianFile);
-		aio_wait(m_pTeeHistorianFile);
-		int Error = aio_error(m_pTeeHistorianFile);
-		if(Error)
+		if(m_TeeHistorianCompress)
+		{
+			m_TeeHistorianBlocks.Flush();
+			dbg_msg("teehistorian", "compressed %" PRId64 " bytes to %" PRId64 " bytes", m_TeeHistorianBlocks.UncompressedSize(), m_TeeHistorianBlocks.CompressedSize());
+		}
+		for(ASYNCIO *pFile : {m_pTeeHistorianFile, m_TeeHistorianCompress ? m_pTeeHistorianIndexFile : nullptr})
 		{
-			dbg_msg("teehistorian", "error closing file, err=%d", Error);
-			Server()->SetErrorShutdown("teehistorian close error");
+			if(!pFile)
+				continue;
+			aio_close(pFile);
+			aio_wait(pFile);
+			int Error = aio_error(pFile);
+			if(Error)
+			{
+				dbg_msg("teehistorian", "error closing file, err=%d", Error);
+				Server()->SetErrorShutdown("teehistorian close error");
+			}
+			aio_free(pFile);
 		}
-		aio_free(m_pTeeHistorianFile);
 	}
 
 	// Stop any demos being recorded.
 	Server()->StopDemos();
 
-	DeleteTempfile();
 	ConfigManager()->ResetGameSettings();
 	Collision()->Unload();
 	Layers()->Unload();
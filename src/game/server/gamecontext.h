@@ -121,6 +121,10 @@ class CGameContext : public IGameServer
 	bool m_TeeHistorianActive;
 	CTeeHistorian m_TeeHistorian;
 	ASYNCIO *m_pTeeHistorianFile;
+	// only used with sv_tee_historian_compress
+	bool m_TeeHistorianCompress;
+	CTeeHistorianBlockWriter m_TeeHistorianBlocks;
+	ASYNCIO *m_pTeeHistorianIndexFile;
 	CUuid m_GameUuid;
 	CMapBugs m_MapBugs;
 	CPrng m_Prng;
@@ -129,6 +133,8 @@ class CGameContext : public IGameServer
 
 	static void CommandCallback(int ClientId, int FlagMask, const char *pCmd, IConsole::IResult *pResult, void *pUser);
 	static void TeeHistorianWrite(const void *pData, int DataSize, void *pUser);
+	static void TeeHistorianWriteBlock(const void *pData, int DataSize, void *pUser);
+	static void TeeHistorianWriteIndex(const void *pData, int DataSize, void *pUser);
 
 	static void ConTuneParam(IConsole::IResult *pResult, void *pUserData);
 	static void ConToggleTuneParam(IConsole::IResult *pResult, void *pUserData);
@@ -168,6 +174,7 @@ class CGameContext : public IGameServer
 	static void ConchainSettingUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainPracticeByDefaultUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConDumpLog(IConsole::IResult *pResult, void *pUserData);
+	static void ConScoreCacheStats(IConsole::IResult *pResult, void *pUserData);
 
 	void AddVote(const char *pDescription, const char *pCommand);
 	static int MapScan(const char *pName, int IsDir, int DirType, void *pUserData);
@@ -251,9 +258,6 @@ public:
 	void CreateAllEntities(bool Initial);
 	CPlayer *CreatePlayer(int ClientId, int StartTeam, bool Afk, int LastWhisperTo);
 
-	char m_aDeleteTempfile[128];
-	void DeleteTempfile();
-
 	enum
 	{
 		VOTE_ENFORCE_UNKNOWN = 0,
@@ -321,7 +325,7 @@ public:
 	void OnConsoleInit() override;
 	void RegisterDDRaceCommands();
 	void RegisterChatCommands();
-	[[nodiscard]] bool OnMapChange(char *pNewMapName, int MapNameSize) override;
+	bool OnMapChange(std::vector<char> *pvSettings) override;
 	void OnShutdown(void *pPersistentData) override;
 
 	void OnTick() override;
@@ -408,6 +412,21 @@ public:
 
 	std::shared_ptr<CScoreRandomMapResult> m_SqlRandomMapResult;
 
+	// tick profiler sections of the phases of OnTick, and of
+	// OnPreTickTeehistorian which runs in the input phase of the server
+	enum
+	{
+		PROFILE_TEEHISTORIAN,
+		PROFILE_WORLD,
+		PROFILE_CONTROLLER,
+		PROFILE_PLAYERS,
+		PROFILE_VOTES,
+		PROFILE_SQL,
+		PROFILE_PRETICK_TEEHISTORIAN,
+		NUM_PROFILE_SECTIONS
+	};
+	int m_aProfileSections[NUM_PROFILE_SECTIONS];
+
 private:
 	// starting 1 to make 0 the special value "no client id"
 	uint32_t m_NextUniqueClientId = 1;
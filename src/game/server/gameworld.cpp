@@ -7,8 +7,10 @@
 #include "entity.h"
 #include "gamecontext.h"
 #include "gamecontroller.h"
+#include "player.h"
 
 #include <engine/shared/config.h>
+#include <engine/shared/tick_profiler.h>
 
 #include <game/collision.h>
 
@@ -43,6 +45,16 @@ void CGameWorld::SetGameServer(CGameContext *pGameServer)
 	m_pGameServer = pGameServer;
 	m_pConfig = m_pGameServer->Config();
 	m_pServer = m_pGameServer->Server();
+
+	static const char *s_apEntityTypeNames[NUM_ENTTYPES] = {"projectile", "laser", "pickup", "flag", "character"};
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+		char aName[CTickProfiler::MAX_NAME_LENGTH];
+		str_format(aName, sizeof(aName), "tick.world.%s", s_apEntityTypeNames[i]);
+		m_aTickProfileSections[i] = m_pServer->TickProfiler()->Section(aName);
+		str_format(aName, sizeof(aName), "snap.world.%s", s_apEntityTypeNames[i]);
+		m_aSnapProfileSections[i] = m_pServer->TickProfiler()->Section(aName);
+	}
 }
 
 void CGameWorld::Init(CCollision *pCollision, CTuningParams *pTuningList)
@@ -56,23 +68,72 @@ CEntity *CGameWorld::FindFirst(int Type)
 	return Type < 0 || Type >= NUM_ENTTYPES ? nullptr : m_apFirstEntityTypes[Type];
 }
 
+int CGameWorld::GridIndex(int Type)
+{
+	switch(Type)
+	{
+	case ENTTYPE_CHARACTER: return GRID_CHARACTER;
+	case ENTTYPE_PICKUP: return GRID_PICKUP;
+	default: return -1;
+	}
+}
+
+// Calls `Fn` in list order for the entities of `Type` that may be closer
+// than `Radius` plus their proximity radius to the box from `Min` to `Max`,
+// until it returns false.
+template<typename F>
+void CGameWorld::ForEachEntityNear(int Type, vec2 Min, vec2 Max, float Radius, F &&Fn)
+{
+	const int Grid = GridIndex(Type);
+	if(Grid >= 0)
+	{
+		// take the buffer, so that nested queries do not overwrite it
+		std::vector<CEntity *> vpNear;
+		std::swap(vpNear, m_vpNearEntities);
+		if(m_aEntityGrids[Grid].Query(Min, Max, Radius, vpNear))
+		{
+			for(CEntity *pEnt : vpNear)
+				if(!Fn(pEnt))
+					break;
+			std::swap(vpNear, m_vpNearEntities);
+			return;
+		}
+		std::swap(vpNear, m_vpNearEntities);
+	}
+
+	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		if(!Fn(pEnt))
+			break;
+}
+
+void CGameWorld::ValidateEntityGrids() const
+{
+	for(int Type = 0; Type < NUM_ENTTYPES; Type++)
+	{
+		if(GridIndex(Type) < 0)
+			continue;
+		for(const CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			dbg_assert(CEntityGrid<CEntity>::IsInCell(pEnt), "entity moved without SetPos");
+	}
+}
+
 int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
 {
 	if(Type < 0 || Type >= NUM_ENTTYPES)
 		return 0;
 
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
-	{
+	ForEachEntityNear(Type, Pos, Pos, Radius, [&](CEntity *pEnt) {
 		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
 		{
 			if(ppEnts)
 				ppEnts[Num] = pEnt;
 			Num++;
 			if(Num == Max)
-				break;
+				return false;
 		}
-	}
+		return true;
+	});
 
 	return Num;
 }
@@ -90,6 +151,11 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = nullptr;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+
+	// later insertions come first in the list
+	const int Grid = GridIndex(pEnt->m_ObjType);
+	if(Grid >= 0)
+		m_aEntityGrids[Grid].Insert(pEnt, ++m_NextEntityOrder);
 }
 
 void CGameWorld::RemoveEntity(CEntity *pEnt)
@@ -112,16 +178,31 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 
 	pEnt->m_pNextTypeEntity = nullptr;
 	pEnt->m_pPrevTypeEntity = nullptr;
+
+	const int Grid = GridIndex(pEnt->m_ObjType);
+	if(Grid >= 0)
+		m_aEntityGrids[Grid].Remove(pEnt);
+}
+
+void CGameWorld::OnEntityMoved(CEntity *pEnt)
+{
+	const int Grid = GridIndex(pEnt->m_ObjType);
+	if(Grid >= 0)
+		m_aEntityGrids[Grid].Move(pEnt);
 }
 
 //
 void CGameWorld::Snap(int SnappingClient)
 {
-	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt;)
+	CTickProfiler *pProfiler = Server()->TickProfiler();
 	{
-		m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-		pEnt->Snap(SnappingClient);
-		pEnt = m_pNextTraverseEntity;
+		CProfileScope Profile(pProfiler, m_aSnapProfileSections[ENTTYPE_CHARACTER]);
+		for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt;)
+		{
+			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+			pEnt->Snap(SnappingClient);
+			pEnt = m_pNextTraverseEntity;
+		}
 	}
 
 	for(int i = 0; i < NUM_ENTTYPES; i++)
@@ -129,6 +210,7 @@ void CGameWorld::Snap(int SnappingClient)
 		if(i == ENTTYPE_CHARACTER)
 			continue;
 
+		CProfileScope Profile(pProfiler, m_aSnapProfileSections[i]);
 		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt;)
 		{
 			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
@@ -200,6 +282,55 @@ void CGameWorld::RemoveEntities()
 		}
 }
 
+bool CGameWorld::TickDeferredTeams()
+{
+	if(m_Workers.NumThreads() != Config()->m_SvWorldThreads)
+	{
+		if(m_Workers.NumThreads() > 0)
+			m_Workers.Shutdown();
+		if(Config()->m_SvWorldThreads > 0)
+			m_Workers.Init(Config()->m_SvWorldThreads);
+	}
+	if(m_Workers.NumThreads() == 0)
+		return false;
+
+	// characters only collide with the characters of their own team while
+	// moving, unless one of them is super. The teams are ticked in the order
+	// of their first character, every team in the order of the list.
+	const CTeamsCore &TeamsCore = GameServer()->m_pController->Teams().m_Core;
+	const int SuperTeam = TeamsCore.m_IsDDRace16 ? VANILLA_TEAM_SUPER : TEAM_SUPER;
+	int aPartition[NUM_DDRACE_TEAMS];
+	std::fill(std::begin(aPartition), std::end(aPartition), -1);
+	int NumPartitions = 0;
+	for(auto &vpCharacters : m_vvpTeamCharacters)
+		vpCharacters.clear();
+	for(CCharacter *pChr = (CCharacter *)FindFirst(ENTTYPE_CHARACTER); pChr; pChr = (CCharacter *)pChr->TypeNext())
+	{
+		const int Team = pChr->Team();
+		if(Team == SuperTeam || pChr->Core()->m_Super)
+			return false;
+		if(aPartition[Team] < 0)
+		{
+			aPartition[Team] = NumPartitions++;
+			if((int)m_vvpTeamCharacters.size() < NumPartitions)
+				m_vvpTeamCharacters.emplace_back();
+		}
+		m_vvpTeamCharacters[aPartition[Team]].push_back(pChr);
+	}
+	if(NumPartitions < 2)
+		return false;
+
+	m_Workers.Run(NumPartitions, [this](int Partition) {
+		for(CCharacter *pChr : m_vvpTeamCharacters[Partition])
+			pChr->TickDeferredCore();
+	});
+
+	// the grid, console and events aren't thread-safe
+	for(CCharacter *pChr = (CCharacter *)FindFirst(ENTTYPE_CHARACTER); pChr; pChr = (CCharacter *)pChr->TypeNext())
+		pChr->TickDeferredEvents();
+	return true;
+}
+
 void CGameWorld::Tick()
 {
 	if(m_ResetRequested)
@@ -210,8 +341,11 @@ void CGameWorld::Tick()
 		// update all objects
 		for(int i = 0; i < NUM_ENTTYPES; i++)
 		{
+			CProfileScope Profile(Server()->TickProfiler(), m_aTickProfileSections[i]);
 			// It's important to call PreTick() and Tick() after each other.
 			// If we call PreTick() before, and Tick() after other entities have been processed, it causes physics changes such as a stronger shotgun or grenade.
+			if(i == ENTTYPE_CHARACTER)
+				m_Core.BuildBroadPhase();
 			if(g_Config.m_SvNoWeakHook && i == ENTTYPE_CHARACTER)
 			{
 				auto *pEnt = m_apFirstEntityTypes[i];
@@ -227,18 +361,27 @@ void CGameWorld::Tick()
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				const int Cid = i == ENTTYPE_CHARACTER ? ((CCharacter *)pEnt)->GetPlayer()->GetCid() : -1;
 				pEnt->Tick();
+				m_Core.UpdateBroadPhase(Cid);
 				pEnt = m_pNextTraverseEntity;
 			}
+			if(i == ENTTYPE_CHARACTER)
+				m_Core.ClearBroadPhase();
 		}
 
-		for(auto *pEnt : m_apFirstEntityTypes)
+		for(int i = 0; i < NUM_ENTTYPES; i++)
+		{
+			if(i == ENTTYPE_CHARACTER && TickDeferredTeams())
+				continue;
+			auto *pEnt = m_apFirstEntityTypes[i];
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
 				pEnt->TickDeferred();
 				pEnt = m_pNextTraverseEntity;
 			}
+		}
 	}
 	else
 	{
@@ -254,6 +397,10 @@ void CGameWorld::Tick()
 
 	RemoveEntities();
 
+#ifdef CONF_DEBUG
+	ValidateEntityGrids();
+#endif
+
 	// find the characters' strong/weak id
 	int StrongWeakId = 0;
 	for(CCharacter *pChar = (CCharacter *)FindFirst(ENTTYPE_CHARACTER); pChar; pChar = (CCharacter *)pChar->TypeNext())
@@ -297,20 +444,21 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 
 CEntity *CGameWorld::IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, int Type, vec2 &NewPos, const CEntity *pNotThis, int CollideWith, const CEntity *pThisOnly)
 {
+	if(Type < 0 || Type >= NUM_ENTTYPES)
+		return nullptr;
+
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CEntity *pClosest = nullptr;
 
-	CEntity *pEntity = FindFirst(Type);
-	for(; pEntity; pEntity = pEntity->TypeNext())
-	{
+	ForEachEntityNear(Type, vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)), vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)), Radius, [&](CEntity *pEntity) {
 		if(pEntity == pNotThis)
-			continue;
+			return true;
 
 		if(pThisOnly && pEntity != pThisOnly)
-			continue;
+			return true;
 
 		if(CollideWith != -1 && !pEntity->CanCollide(CollideWith))
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, pEntity->m_Pos, IntersectPos))
@@ -327,7 +475,8 @@ CEntity *CGameWorld::IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, int Typ
 				}
 			}
 		}
-	}
+		return true;
+	});
 
 	return pClosest;
 }
@@ -338,11 +487,9 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 	float ClosestRange = Radius * 2;
 	CCharacter *pClosest = nullptr;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
-	{
+	ForEachEntityNear(ENTTYPE_CHARACTER, Pos, Pos, Radius, [&](CEntity *p) {
 		if(p == pNotThis)
-			continue;
+			return true;
 
 		float Len = distance(Pos, p->m_Pos);
 		if(Len < p->m_ProximityRadius + Radius)
@@ -350,10 +497,11 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 			if(Len < ClosestRange)
 			{
 				ClosestRange = Len;
-				pClosest = p;
+				pClosest = (CCharacter *)p;
 			}
 		}
-	}
+		return true;
+	});
 
 	return pClosest;
 }
@@ -361,11 +509,9 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, const CEntity *pNotThis)
 {
 	std::vector<CCharacter *> vpCharacters;
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
-	{
+	ForEachEntityNear(ENTTYPE_CHARACTER, vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)), vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)), Radius, [&](CEntity *pChr) {
 		if(pChr == pNotThis)
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, pChr->m_Pos, IntersectPos))
@@ -373,10 +519,11 @@ std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1
 			float Len = distance(pChr->m_Pos, IntersectPos);
 			if(Len < pChr->m_ProximityRadius + Radius)
 			{
-				vpCharacters.push_back(pChr);
+				vpCharacters.push_back((CCharacter *)pChr);
 			}
 		}
-	}
+		return true;
+	});
 	return vpCharacters;
 }
 
@@ -4,9 +4,12 @@
 #define GAME_SERVER_GAMEWORLD_H
 
 #include "save.h"
+#include "world_workers.h"
 
+#include <game/entity_grid.h>
 #include <game/gamecore.h>
 
+#include <cstdint>
 #include <vector>
 
 class CCollision;
@@ -38,6 +41,31 @@ private:
 	CEntity *m_pNextTraverseEntity = nullptr;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// spatial index of the entity types queried by position
+	enum
+	{
+		GRID_CHARACTER = 0,
+		GRID_PICKUP,
+		NUM_GRIDS
+	};
+	static int GridIndex(int Type);
+	template<typename F>
+	void ForEachEntityNear(int Type, vec2 Min, vec2 Max, float Radius, F &&Fn);
+	void ValidateEntityGrids() const;
+	CEntityGrid<CEntity> m_aEntityGrids[NUM_GRIDS];
+	std::vector<CEntity *> m_vpNearEntities;
+	int64_t m_NextEntityOrder = 0;
+
+	// runs the deferred tick of the characters of different teams in
+	// parallel, see sv_world_threads
+	bool TickDeferredTeams();
+	CWorldWorkers m_Workers;
+	std::vector<std::vector<CCharacter *>> m_vvpTeamCharacters;
+
+	// tick profiler sections of the tick and snap of each entity type
+	int m_aTickProfileSections[NUM_ENTTYPES];
+	int m_aSnapProfileSections[NUM_ENTTYPES];
+
 	class CGameContext *m_pGameServer;
 	class CConfig *m_pConfig;
 	class IServer *m_pServer;
@@ -144,6 +172,16 @@ public:
 	*/
 	void RemoveEntity(CEntity *pEntity);
 
+	/*
+		Function: OnEntityMoved
+			Updates the spatial index after the position of an
+			entity changed, called by CEntity::SetPos.
+
+		Arguments:
+			pEntity - Entity that moved
+	*/
+	void OnEntityMoved(CEntity *pEntity);
+
 	void RemoveEntitiesFromPlayer(int PlayerId);
 	void RemoveEntitiesFromPlayers(int PlayerIds[], int NumPlayers);
 
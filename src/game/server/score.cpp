@@ -2,6 +2,7 @@
 
 #include "player.h"
 #include "save.h"
+#include "scorecache.h"
 #include "scoreworker.h"
 
 #include <base/system.h>
@@ -50,6 +51,47 @@ void CScore::ExecPlayerThread(
 	m_pPool->Execute(pFuncPtr, std::move(Tmp), pThreadName);
 }
 
+void CScore::ExecCachedPlayerThread(
+	bool (*pFuncPtr)(IDbConnection *, const ISqlData *, char *pError, int ErrorSize),
+	const char *pThreadName,
+	int ClientId,
+	const char *pName,
+	int Offset,
+	int CacheFlags)
+{
+	if(g_Config.m_SvSqlCacheTtl == 0)
+	{
+		ExecPlayerThread(pFuncPtr, pThreadName, ClientId, pName, Offset);
+		return;
+	}
+
+	auto pResult = NewSqlPlayerResult(ClientId);
+	if(pResult == nullptr)
+		return;
+	auto Tmp = std::make_unique<CSqlCachedPlayerRequest>(pResult);
+	str_copy(Tmp->m_aName, pName, sizeof(Tmp->m_aName));
+	str_copy(Tmp->m_aMap, Server()->GetMapName(), sizeof(Tmp->m_aMap));
+	str_copy(Tmp->m_aServer, g_Config.m_SvSqlServerName, sizeof(Tmp->m_aServer));
+	str_copy(Tmp->m_aRequestingPlayer, Server()->ClientName(ClientId), sizeof(Tmp->m_aRequestingPlayer));
+	Tmp->m_Offset = Offset;
+	str_copy(Tmp->m_aCacheMap, CacheFlags & CACHE_MAP ? Tmp->m_aMap : "");
+
+	char aKey[512];
+	str_format(aKey, sizeof(aKey), "%s\n%s\n%s\n%d\n%s\n%s", pThreadName, Tmp->m_aCacheMap, Tmp->m_aName,
+		Offset, Tmp->m_aServer, CacheFlags & CACHE_REQUESTER ? Tmp->m_aRequestingPlayer : "");
+	if(m_pCache->Find(aKey, (int64_t)g_Config.m_SvSqlCacheTtl * 1000000000, pResult.get(), &Tmp->m_Generation))
+	{
+		pResult->m_Success = true;
+		pResult->m_Completed = true;
+		return;
+	}
+
+	Tmp->m_pfnQuery = pFuncPtr;
+	Tmp->m_pCache = m_pCache;
+	Tmp->m_Key = aKey;
+	m_pPool->Execute(CScoreCache::Query, std::move(Tmp), pThreadName);
+}
+
 bool CScore::RateLimitPlayer(int ClientId)
 {
 	CPlayer *pPlayer = GameServer()->m_apPlayers[ClientId];
@@ -75,6 +117,7 @@ void CScore::GeneratePassphrase(char *pBuf, int BufSize)
 
 CScore::CScore(CGameContext *pGameServer, CDbConnectionPool *pPool) :
 	m_pPool(pPool),
+	m_pCache(std::make_shared<CScoreCache>()),
 	m_pGameServer(pGameServer),
 	m_pServer(pGameServer->Server())
 {
@@ -143,7 +186,7 @@ void CScore::MapInfo(int ClientId, const char *pMapName)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::MapInfo, "map info", ClientId, pMapName, 0);
+	ExecCachedPlayerThread(CScoreWorker::MapInfo, "map info", ClientId, pMapName, 0, CACHE_REQUESTER);
 }
 
 void CScore::SaveScore(int ClientId, int TimeTicks, const char *pTimestamp, const float aTimeCp[NUM_CHECKPOINTS], bool NotEligible)
@@ -167,6 +210,7 @@ void CScore::SaveScore(int ClientId, int TimeTicks, const char *pTimestamp, cons
 	str_copy(Tmp->m_aTimestamp, pTimestamp, sizeof(Tmp->m_aTimestamp));
 	for(int i = 0; i < NUM_CHECKPOINTS; i++)
 		Tmp->m_aCurrentTimeCp[i] = aTimeCp[i];
+	Tmp->m_pCache = m_pCache;
 
 	m_pPool->ExecuteWrite(CScoreWorker::SaveScore, std::move(Tmp), "save score");
 }
@@ -201,7 +245,7 @@ void CScore::ShowRank(int ClientId, const char *pName)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowRank, "show rank", ClientId, pName, 0);
+	ExecCachedPlayerThread(CScoreWorker::ShowRank, "show rank", ClientId, pName, 0, CACHE_MAP | CACHE_REQUESTER);
 }
 
 void CScore::ShowTeamRank(int ClientId, const char *pName)
@@ -215,7 +259,7 @@ void CScore::ShowTop(int ClientId, int Offset)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowTop, "show top5", ClientId, "", Offset);
+	ExecCachedPlayerThread(CScoreWorker::ShowTop, "show top5", ClientId, "", Offset, CACHE_MAP);
 }
 
 void CScore::ShowTeamTop5(int ClientId, int Offset)
@@ -250,14 +294,14 @@ void CScore::ShowPoints(int ClientId, const char *pName)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowPoints, "show points", ClientId, pName, 0);
+	ExecCachedPlayerThread(CScoreWorker::ShowPoints, "show points", ClientId, pName, 0, CACHE_REQUESTER);
 }
 
 void CScore::ShowTopPoints(int ClientId, int Offset)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowTopPoints, "show top points", ClientId, "", Offset);
+	ExecCachedPlayerThread(CScoreWorker::ShowTopPoints, "show top points", ClientId, "", Offset, 0);
 }
 
 void CScore::RandomMap(int ClientId, int MinStars, int MaxStars)
@@ -5,7 +5,10 @@
 
 #include <game/prng.h>
 
+#include <memory>
+
 class CDbConnectionPool;
+class CScoreCache;
 class CGameContext;
 class IDbConnection;
 class IServer;
@@ -15,6 +18,8 @@ class CScore
 {
 	CPlayerData m_aPlayerData[MAX_CLIENTS];
 	CDbConnectionPool *m_pPool;
+	// shared with the database workers, which might outlive this
+	std::shared_ptr<CScoreCache> m_pCache;
 
 	CGameContext *GameServer() const { return m_pGameServer; }
 	IServer *Server() const { return m_pServer; }
@@ -34,6 +39,21 @@ class CScore
 		int ClientId,
 		const char *pName,
 		int Offset);
+	enum
+	{
+		// the result depends on the current map
+		CACHE_MAP = 1 << 0,
+		// the result depends on the player requesting it
+		CACHE_REQUESTER = 1 << 1,
+	};
+	// Like ExecPlayerThread, but answers from the cache if possible
+	void ExecCachedPlayerThread(
+		bool (*pFuncPtr)(IDbConnection *, const ISqlData *, char *pError, int ErrorSize),
+		const char *pThreadName,
+		int ClientId,
+		const char *pName,
+		int Offset,
+		int CacheFlags);
 
 	// returns true if the player should be rate limited
 	bool RateLimitPlayer(int ClientId);
@@ -42,6 +62,7 @@ public:
 	CScore(CGameContext *pGameServer, CDbConnectionPool *pPool);
 
 	CPlayerData *PlayerData(int Id) { return &m_aPlayerData[Id]; }
+	CScoreCache *Cache() { return m_pCache.get(); }
 
 	void LoadBestTime();
 	void MapInfo(int ClientId, const char *pMapName);
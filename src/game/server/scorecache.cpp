@@ -0,0 +1,75 @@
+#include "scorecache.h"
+
+#include <base/system.h>
+
+bool CScoreCache::Find(const char *pKey, int64_t MaxAge, CScorePlayerResult *pResult, uint64_t *pGeneration)
+{
+	const CLockScope LockScope(m_Lock);
+	*pGeneration = m_Generation;
+	auto It = m_Entries.find(pKey);
+	if(It == m_Entries.end() || time_get_nanoseconds().count() - It->second->m_Time > MaxAge)
+	{
+		m_Misses++;
+		return false;
+	}
+	pResult->m_MessageKind = It->second->m_MessageKind;
+	pResult->m_Data = It->second->m_Data;
+	m_Hits++;
+	return true;
+}
+
+void CScoreCache::Add(const char *pKey, const char *pMap, uint64_t Generation, const CScorePlayerResult *pResult)
+{
+	auto pEntry = std::make_unique<CEntry>();
+	pEntry->m_Map = pMap;
+	pEntry->m_Time = time_get_nanoseconds().count();
+	pEntry->m_MessageKind = pResult->m_MessageKind;
+	pEntry->m_Data = pResult->m_Data;
+
+	const CLockScope LockScope(m_Lock);
+	if(Generation != m_Generation)
+		return;
+	if(m_Entries.size() >= MAX_ENTRIES && m_Entries.find(pKey) == m_Entries.end())
+	{
+		// most entries are outdated by then, the commands come in bursts
+		m_Entries.clear();
+	}
+	m_Entries[pKey] = std::move(pEntry);
+}
+
+void CScoreCache::Invalidate(const char *pMap)
+{
+	const CLockScope LockScope(m_Lock);
+	m_Generation++;
+	m_Invalidations++;
+	for(auto It = m_Entries.begin(); It != m_Entries.end();)
+	{
+		if(It->second->m_Map.empty() || It->second->m_Map == pMap)
+			It = m_Entries.erase(It);
+		else
+			++It;
+	}
+}
+
+void CScoreCache::Clear()
+{
+	const CLockScope LockScope(m_Lock);
+	m_Generation++;
+	m_Entries.clear();
+}
+
+int CScoreCache::NumEntries()
+{
+	const CLockScope LockScope(m_Lock);
+	return m_Entries.size();
+}
+
+bool CScoreCache::Query(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const auto *pData = dynamic_cast<const CSqlCachedPlayerRequest *>(pGameData);
+	if(!pData->m_pfnQuery(pSqlServer, pGameData, pError, ErrorSize))
+		return false;
+	auto *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
+	pData->m_pCache->Add(pData->m_Key.c_str(), pData->m_aCacheMap, pData->m_Generation, pResult);
+	return true;
+}
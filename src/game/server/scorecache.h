@@ -0,0 +1,107 @@
+#ifndef GAME_SERVER_SCORECACHE_H
+#define GAME_SERVER_SCORECACHE_H
+
+#include "scoreworker.h"
+
+#include <base/lock.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+class IDbConnection;
+
+/**
+ * Results of the read-only chat commands like /top5 and /points, so players
+ * spamming them don't cause a database round-trip each time.
+ *
+ * Entries are looked up on the main thread before a query is queued and
+ * added by the database workers once it succeeded. Saving a score drops the
+ * entries of its map and the ones that don't belong to a map, see
+ * @link Invalidate @endlink. Other servers sharing the database aren't
+ * noticed, their finishes show up once the entries expire.
+ *
+ * Thread-safe.
+ */
+class CScoreCache
+{
+public:
+	enum
+	{
+		MAX_ENTRIES = 512,
+	};
+
+private:
+	class CEntry
+	{
+	public:
+		std::string m_Map;
+		int64_t m_Time;
+		CScorePlayerResult::Variant m_MessageKind;
+		decltype(CScorePlayerResult::m_Data) m_Data;
+	};
+
+	CLock m_Lock;
+	std::unordered_map<std::string, std::unique_ptr<CEntry>> m_Entries GUARDED_BY(m_Lock);
+	// increased by each invalidation, results of queries that were started
+	// before aren't added as they might be outdated already
+	uint64_t m_Generation GUARDED_BY(m_Lock) = 0;
+
+	std::atomic<uint64_t> m_Hits{0};
+	std::atomic<uint64_t> m_Misses{0};
+	std::atomic<uint64_t> m_Invalidations{0};
+
+public:
+	/**
+	 * Looks up a result.
+	 *
+	 * @param pKey Identifies the query and its arguments.
+	 * @param MaxAge Maximum age of the entry in nanoseconds.
+	 * @param pResult Receives the messages of the entry on success.
+	 * @param pGeneration Receives the value to pass to @link Add @endlink
+	 * on failure.
+	 *
+	 * @return `true` if the result was found, `false` otherwise.
+	 */
+	bool Find(const char *pKey, int64_t MaxAge, CScorePlayerResult *pResult, uint64_t *pGeneration) REQUIRES(!m_Lock);
+
+	/**
+	 * Adds the result of a query, see @link Find @endlink.
+	 *
+	 * @param pMap The map the result depends on, empty if it is about all maps.
+	 */
+	void Add(const char *pKey, const char *pMap, uint64_t Generation, const CScorePlayerResult *pResult) REQUIRES(!m_Lock);
+
+	/**
+	 * Drops the entries of a map and the ones that don't belong to a map.
+	 */
+	void Invalidate(const char *pMap) REQUIRES(!m_Lock);
+	void Clear() REQUIRES(!m_Lock);
+
+	int NumEntries() REQUIRES(!m_Lock);
+	uint64_t Hits() const { return m_Hits; }
+	uint64_t Misses() const { return m_Misses; }
+	uint64_t Invalidations() const { return m_Invalidations; }
+
+	// executes the query of a CSqlCachedPlayerRequest and adds its result
+	static bool Query(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+};
+
+struct CSqlCachedPlayerRequest : CSqlPlayerRequest
+{
+	CSqlCachedPlayerRequest(std::shared_ptr<CScorePlayerResult> pResult) :
+		CSqlPlayerRequest(std::move(pResult))
+	{
+	}
+
+	bool (*m_pfnQuery)(IDbConnection *, const ISqlData *, char *pError, int ErrorSize);
+	std::shared_ptr<CScoreCache> m_pCache;
+	std::string m_Key;
+	// empty if the result doesn't depend on the current map
+	char m_aCacheMap[MAX_MAP_LENGTH];
+	uint64_t m_Generation;
+};
+
+#endif // GAME_SERVER_SCORECACHE_H
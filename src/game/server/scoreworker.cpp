@@ -1,5 +1,7 @@
 #include "scoreworker.h"
 
+#include "scorecache.h"
+
 #include <base/log.h>
 #include <base/system.h>
 
@@ -490,6 +492,12 @@ bool CScoreWorker::MapInfo(IDbConnection *pSqlServer, const ISqlData *pGameData,
 	return true;
 }
 
+void CSqlScoreData::OnCommitted() const
+{
+	if(m_pCache)
+		m_pCache->Invalidate(m_aMap);
+}
+
 bool CScoreWorker::SaveScore(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlScoreData *>(pGameData);
@@ -15,6 +15,7 @@
 #include <utility>
 #include <vector>
 
+class CScoreCache;
 class IDbConnection;
 class IGameController;
 
@@ -131,6 +132,8 @@ struct CSqlScoreData : ISqlData
 	{
 	}
 
+	void OnCommitted() const override;
+
 	char m_aMap[MAX_MAP_LENGTH];
 	char m_aGameUuid[UUID_MAXSTRSIZE];
 	char m_aName[MAX_MAP_LENGTH];
@@ -142,6 +145,8 @@ struct CSqlScoreData : ISqlData
 	int m_Num;
 	bool m_Search;
 	char m_aRequestingPlayer[MAX_NAME_LENGTH];
+	// invalidated once the rank is committed, can be null
+	std::shared_ptr<CScoreCache> m_pCache;
 };
 
 struct CScoreSaveResult : ISqlResult
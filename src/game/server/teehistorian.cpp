@@ -9,6 +9,12 @@
 
 #include <game/gamecore.h>
 
+#include <zlib.h>
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
 class CTeehistorianPacker : public CAbstractPacker
 {
 public:
@@ -63,6 +69,7 @@ void CTeeHistorian::Reset(const CGameInfo *pGameInfo, WRITE_CALLBACK pfnWriteCal
 	m_LastWrittenTick = 0;
 	// Tick 0 is implicit at the start, game starts as tick 1.
 	m_TickWritten = true;
+	m_ExplicitTick = false;
 	m_MaxClientId = MAX_CLIENTS;
 
 	// `m_PrevMaxClientId` is initialized in `BeginPlayers`
@@ -238,12 +245,14 @@ void CTeeHistorian::WriteExtra(CUuid Uuid, const void *pData, int DataSize)
 	Write(pData, DataSize);
 }
 
-void CTeeHistorian::BeginTick(int Tick)
+void CTeeHistorian::BeginTick(int Tick, bool ExplicitTick)
 {
 	dbg_assert(m_State == STATE_START || m_State == STATE_BEFORE_TICK, "invalid teehistorian state");
 
 	m_Tick = Tick;
 	m_TickWritten = false;
+	// stays set until a tick is actually written
+	m_ExplicitTick = m_ExplicitTick || ExplicitTick;
 
 	if(m_Debug > 1)
 	{
@@ -270,7 +279,7 @@ void CTeeHistorian::EnsureTickWrittenPlayerData(int ClientId)
 	dbg_assert(ClientId > m_MaxClientId, "invalid player data order");
 	m_MaxClientId = ClientId;
 
-	if(!m_TickWritten && (ClientId > m_PrevMaxClientId || m_LastWrittenTick + 1 != m_Tick))
+	if(!m_TickWritten && (ClientId > m_PrevMaxClientId || m_LastWrittenTick + 1 != m_Tick || m_ExplicitTick))
 	{
 		WriteTick();
 	}
@@ -419,6 +428,7 @@ void CTeeHistorian::WriteTick()
 	Write(TickPacker.Data(), TickPacker.Size());
 
 	m_TickWritten = true;
+	m_ExplicitTick = false;
 	m_LastWrittenTick = m_Tick;
 }
 
@@ -877,3 +887,354 @@ void CTeeHistorian::Finish()
 
 	Write(Buffer.Data(), Buffer.Size());
 }
+
+CTeeHistorianBlockWriter::CTeeHistorianBlockWriter()
+{
+	Reset(nullptr, nullptr, nullptr);
+}
+
+void CTeeHistorianBlockWriter::Reset(CTeeHistorian::WRITE_CALLBACK pfnWriteData, CTeeHistorian::WRITE_CALLBACK pfnWriteIndex, void *pUser)
+{
+	m_pfnWriteData = pfnWriteData;
+	m_pfnWriteIndex = pfnWriteIndex;
+	m_pUser = pUser;
+	m_vBlock.clear();
+	m_FirstTick = -1;
+	m_PrevTick = 0;
+	m_NumTicks = 0;
+	m_Offset = 0;
+	m_UncompressedSize = 0;
+}
+
+void CTeeHistorianBlockWriter::Write(const void *pData, int DataSize)
+{
+	const unsigned char *pBytes = static_cast<const unsigned char *>(pData);
+	m_vBlock.insert(m_vBlock.end(), pBytes, pBytes + DataSize);
+}
+
+bool CTeeHistorianBlockWriter::BeginTick(int Tick, int LastWrittenTick)
+{
+	if(m_vBlock.size() >= MAX_BLOCK_SIZE || m_NumTicks >= MAX_BLOCK_TICKS)
+	{
+		Flush();
+	}
+	m_NumTicks++;
+	if(m_FirstTick != -1)
+	{
+		return false;
+	}
+	m_FirstTick = Tick;
+	m_PrevTick = LastWrittenTick;
+	return true;
+}
+
+void CTeeHistorianBlockWriter::Flush()
+{
+	if(m_vBlock.empty())
+	{
+		return;
+	}
+
+	uLongf CompressedSize = compressBound(m_vBlock.size());
+	m_vCompressed.resize(BLOCK_HEADER_SIZE + CompressedSize);
+	// favor speed, this runs on the main thread of the server
+	const int Result = compress2(m_vCompressed.data() + BLOCK_HEADER_SIZE, &CompressedSize, m_vBlock.data(), m_vBlock.size(), Z_BEST_SPEED);
+	dbg_assert(Result == Z_OK, "failed to compress teehistorian block");
+
+	uint_to_bytes_be(&m_vCompressed[0], CompressedSize);
+	uint_to_bytes_be(&m_vCompressed[4], m_vBlock.size());
+	uint_to_bytes_be(&m_vCompressed[8], m_FirstTick);
+	uint_to_bytes_be(&m_vCompressed[12], m_PrevTick);
+	m_pfnWriteData(m_vCompressed.data(), BLOCK_HEADER_SIZE + CompressedSize, m_pUser);
+
+	unsigned char aEntry[INDEX_ENTRY_SIZE];
+	uint_to_bytes_be(&aEntry[0], m_FirstTick);
+	uint_to_bytes_be(&aEntry[4], (uint64_t)m_Offset >> 32);
+	uint_to_bytes_be(&aEntry[8], (uint64_t)m_Offset & 0xffffffff);
+	m_pfnWriteIndex(aEntry, sizeof(aEntry), m_pUser);
+
+	m_Offset += BLOCK_HEADER_SIZE + CompressedSize;
+	m_UncompressedSize += m_vBlock.size();
+	m_vBlock.clear();
+	m_FirstTick = -1;
+	m_NumTicks = 0;
+}
+
+bool CTeeHistorianBlockReader::ReadIndex(IOHANDLE File, std::vector<CIndexEntry> &vIndex)
+{
+	vIndex.clear();
+	unsigned char aEntry[CTeeHistorianBlockWriter::INDEX_ENTRY_SIZE];
+	while(true)
+	{
+		const unsigned Read = io_read(File, aEntry, sizeof(aEntry));
+		if(Read == 0)
+			return true;
+		if(Read != sizeof(aEntry))
+			return false;
+
+		CIndexEntry Entry;
+		Entry.m_FirstTick = (int)bytes_be_to_uint(&aEntry[0]);
+		Entry.m_Offset = (int64_t)(((uint64_t)bytes_be_to_uint(&aEntry[4]) << 32) | bytes_be_to_uint(&aEntry[8]));
+		vIndex.push_back(Entry);
+	}
+}
+
+int64_t CTeeHistorianBlockReader::FindTick(const std::vector<CIndexEntry> &vIndex, int Tick)
+{
+	// blocks without a tick only contain the header or the end of the file
+	// and belong to the ticks around them
+	auto It = std::upper_bound(vIndex.begin(), vIndex.end(), Tick, [](int Value, const CIndexEntry &Entry) {
+		return Entry.m_FirstTick != -1 && Value < Entry.m_FirstTick;
+	});
+	if(It == vIndex.begin())
+		return -1;
+	return std::prev(It)->m_Offset;
+}
+
+bool CTeeHistorianBlockReader::ReadBlock(IOHANDLE File, CBlockHeader *pHeader, std::vector<unsigned char> &vData)
+{
+	unsigned char aHeader[CTeeHistorianBlockWriter::BLOCK_HEADER_SIZE];
+	if(io_read(File, aHeader, sizeof(aHeader)) != sizeof(aHeader))
+		return false;
+
+	pHeader->m_CompressedSize = (int)bytes_be_to_uint(&aHeader[0]);
+	pHeader->m_UncompressedSize = (int)bytes_be_to_uint(&aHeader[4]);
+	pHeader->m_FirstTick = (int)bytes_be_to_uint(&aHeader[8]);
+	pHeader->m_PrevTick = (int)bytes_be_to_uint(&aHeader[12]);
+	if(pHeader->m_CompressedSize <= 0 || pHeader->m_UncompressedSize <= 0)
+		return false;
+
+	std::vector<unsigned char> vCompressed(pHeader->m_CompressedSize);
+	if(io_read(File, vCompressed.data(), vCompressed.size()) != vCompressed.size())
+		return false;
+
+	vData.resize(pHeader->m_UncompressedSize);
+	uLongf UncompressedSize = vData.size();
+	return uncompress(vData.data(), &UncompressedSize, vCompressed.data(), vCompressed.size()) == Z_OK && UncompressedSize == vData.size();
+}
+
+bool CTeeHistorianReader::Load(IOHANDLE File)
+{
+	m_vData.clear();
+	CUuid Uuid;
+	if(io_read(File, &Uuid, sizeof(Uuid)) != sizeof(Uuid))
+		return false;
+	io_seek(File, 0, IOSEEK_START);
+
+	if(Uuid == TEEHISTORIAN_UUID)
+	{
+		const int64_t Length = io_length(File);
+		if(Length <= 0 || Length > std::numeric_limits<int>::max())
+			return false;
+		m_vData.resize(Length);
+		if(io_read(File, m_vData.data(), m_vData.size()) != m_vData.size())
+			return false;
+	}
+	else
+	{
+		// a block that can't be read ends the file, the server might not
+		// have finished writing it
+		CTeeHistorianBlockReader::CBlockHeader Header;
+		std::vector<unsigned char> vBlock;
+		while(CTeeHistorianBlockReader::ReadBlock(File, &Header, vBlock))
+		{
+			m_vData.insert(m_vData.end(), vBlock.begin(), vBlock.end());
+			if(m_vData.size() > (size_t)std::numeric_limits<int>::max())
+				return false;
+		}
+		if(m_vData.size() < sizeof(Uuid) || mem_comp(m_vData.data(), &TEEHISTORIAN_UUID, sizeof(Uuid)) != 0)
+			return false;
+	}
+
+	m_Unpacker.Reset(m_vData.data() + sizeof(Uuid), m_vData.size() - sizeof(Uuid));
+	m_pHeaderJson = m_Unpacker.GetString(0);
+	m_Error = m_Unpacker.Error();
+	m_Finished = false;
+
+	m_Tick = 0;
+	m_LastPlayerId = MAX_CLIENTS;
+	for(auto &Player : m_aPlayers)
+	{
+		Player.m_Alive = false;
+		Player.m_X = 0;
+		Player.m_Y = 0;
+		mem_zero(&Player.m_Input, sizeof(Player.m_Input));
+	}
+	return !m_Error;
+}
+
+bool CTeeHistorianReader::PlayerChunk(int ClientId)
+{
+	if(ClientId < 0 || ClientId >= MAX_CLIENTS)
+		return false;
+	// player data is written in ascending order of client ids, going back
+	// starts the next tick if it isn't written explicitly
+	if(ClientId <= m_LastPlayerId)
+		m_Tick++;
+	m_LastPlayerId = ClientId;
+	return true;
+}
+
+bool CTeeHistorianReader::ReadChunk(CChunk *pChunk)
+{
+	while(!m_Finished && !m_Error)
+	{
+		if(m_Unpacker.RemainingSize() == 0)
+		{
+			// the server didn't finish the file, e.g. because it crashed
+			m_Finished = true;
+			break;
+		}
+
+		pChunk->m_ClientId = -1;
+		pChunk->m_pString = "";
+		pChunk->m_vpArgs.clear();
+		pChunk->m_pData = nullptr;
+		pChunk->m_DataSize = 0;
+
+		const int Type = m_Unpacker.GetInt();
+		if(Type >= 0)
+		{
+			// PLAYER_DIFF
+			const int ClientId = Type;
+			const int Dx = m_Unpacker.GetInt();
+			const int Dy = m_Unpacker.GetInt();
+			if(m_Unpacker.Error() || !PlayerChunk(ClientId) || !m_aPlayers[ClientId].m_Alive)
+			{
+				m_Error = true;
+				break;
+			}
+			m_aPlayers[ClientId].m_X += Dx;
+			m_aPlayers[ClientId].m_Y += Dy;
+			pChunk->m_Type = CHUNK_PLAYER;
+			pChunk->m_ClientId = ClientId;
+			pChunk->m_X = m_aPlayers[ClientId].m_X;
+			pChunk->m_Y = m_aPlayers[ClientId].m_Y;
+			pChunk->m_Tick = m_Tick;
+			return true;
+		}
+
+		switch(-Type)
+		{
+		case TEEHISTORIAN_FINISH:
+			m_Finished = true;
+			pChunk->m_Type = CHUNK_FINISH;
+			break;
+		case TEEHISTORIAN_TICK_SKIP:
+		{
+			const int TickDelta = m_Unpacker.GetInt();
+			if(m_Unpacker.Error() || TickDelta < 0)
+				m_Error = true;
+			m_Tick += TickDelta + 1;
+			m_LastPlayerId = -1;
+			continue;
+		}
+		case TEEHISTORIAN_PLAYER_NEW:
+		{
+			const int ClientId = m_Unpacker.GetInt();
+			const int X = m_Unpacker.GetInt();
+			const int Y = m_Unpacker.GetInt();
+			if(m_Unpacker.Error() || !PlayerChunk(ClientId))
+			{
+				m_Error = true;
+				break;
+			}
+			m_aPlayers[ClientId].m_Alive = true;
+			m_aPlayers[ClientId].m_X = X;
+			m_aPlayers[ClientId].m_Y = Y;
+			pChunk->m_Type = CHUNK_PLAYER;
+			pChunk->m_ClientId = ClientId;
+			pChunk->m_X = X;
+			pChunk->m_Y = Y;
+			break;
+		}
+		case TEEHISTORIAN_PLAYER_OLD:
+		{
+			const int ClientId = m_Unpacker.GetInt();
+			if(m_Unpacker.Error() || !PlayerChunk(ClientId))
+			{
+				m_Error = true;
+				break;
+			}
+			m_aPlayers[ClientId].m_Alive = false;
+			pChunk->m_Type = CHUNK_PLAYER_OLD;
+			pChunk->m_ClientId = ClientId;
+			break;
+		}
+		case TEEHISTORIAN_INPUT_DIFF:
+		case TEEHISTORIAN_INPUT_NEW:
+		{
+			const int ClientId = m_Unpacker.GetInt();
+			int aInput[sizeof(CNetObj_PlayerInput) / sizeof(int32_t)];
+			for(int &Value : aInput)
+				Value = m_Unpacker.GetInt();
+			if(m_Unpacker.Error() || ClientId < 0 || ClientId >= MAX_CLIENTS)
+			{
+				m_Error = true;
+				break;
+			}
+			CNetObj_PlayerInput *pInput = &m_aPlayers[ClientId].m_Input;
+			if(-Type == TEEHISTORIAN_INPUT_DIFF)
+			{
+				// the inverse of CSnapshotDelta::DiffItem
+				int *pValues = (int *)pInput;
+				for(size_t i = 0; i < std::size(aInput); i++)
+					pValues[i] += aInput[i];
+			}
+			else
+				mem_copy(pInput, aInput, sizeof(*pInput));
+			pChunk->m_Type = CHUNK_INPUT;
+			pChunk->m_ClientId = ClientId;
+			pChunk->m_Input = *pInput;
+			break;
+		}
+		case TEEHISTORIAN_MESSAGE:
+			pChunk->m_Type = CHUNK_MESSAGE;
+			pChunk->m_ClientId = m_Unpacker.GetInt();
+			pChunk->m_DataSize = m_Unpacker.GetInt();
+			pChunk->m_pData = m_Unpacker.GetRaw(pChunk->m_DataSize);
+			break;
+		case TEEHISTORIAN_JOIN:
+			pChunk->m_Type = CHUNK_JOIN;
+			pChunk->m_ClientId = m_Unpacker.GetInt();
+			break;
+		case TEEHISTORIAN_DROP:
+			pChunk->m_Type = CHUNK_DROP;
+			pChunk->m_ClientId = m_Unpacker.GetInt();
+			pChunk->m_pString = m_Unpacker.GetString(0);
+			break;
+		case TEEHISTORIAN_CONSOLE_COMMAND:
+		{
+			pChunk->m_Type = CHUNK_CONSOLE_COMMAND;
+			pChunk->m_ClientId = m_Unpacker.GetInt();
+			pChunk->m_FlagMask = m_Unpacker.GetInt();
+			pChunk->m_pString = m_Unpacker.GetString(0);
+			const int NumArgs = m_Unpacker.GetInt();
+			for(int i = 0; i < NumArgs && !m_Unpacker.Error(); i++)
+				pChunk->m_vpArgs.push_back(m_Unpacker.GetString(0));
+			break;
+		}
+		case TEEHISTORIAN_EX:
+		{
+			pChunk->m_Type = CHUNK_EX;
+			const unsigned char *pUuid = m_Unpacker.GetRaw(sizeof(pChunk->m_Uuid));
+			if(pUuid)
+				mem_copy(&pChunk->m_Uuid, pUuid, sizeof(pChunk->m_Uuid));
+			pChunk->m_DataSize = m_Unpacker.GetInt();
+			pChunk->m_pData = m_Unpacker.GetRaw(pChunk->m_DataSize);
+			break;
+		}
+		default:
+			m_Error = true;
+			break;
+		}
+
+		if(m_Unpacker.Error())
+			m_Error = true;
+		if(m_Error)
+			break;
+		pChunk->m_Tick = m_Tick;
+		return true;
+	}
+	return false;
+}
@@ -2,13 +2,17 @@
 #define GAME_SERVER_TEEHISTORIAN_H
 
 #include <base/hash.h>
+#include <base/system.h>
 
 #include <engine/console.h>
+#include <engine/shared/packer.h>
 #include <engine/shared/protocol.h>
 
 #include <generated/protocol.h>
 
+#include <cstdint>
 #include <ctime>
+#include <vector>
 
 class CConfig;
 class CTuningParams;
@@ -55,8 +59,11 @@ public:
 	void Finish();
 
 	bool Starting() const { return m_State == STATE_START; }
+	int LastWrittenTick() const { return m_LastWrittenTick; }
 
-	void BeginTick(int Tick);
+	// ExplicitTick: write the tick even if it would be implicit, so that
+	// reading can start at it
+	void BeginTick(int Tick, bool ExplicitTick = false);
 
 	void BeginPlayers();
 	void RecordPlayer(int ClientId, const CNetObj_CharacterCore *pChar);
@@ -143,6 +150,7 @@ private:
 
 	int m_LastWrittenTick;
 	bool m_TickWritten;
+	bool m_ExplicitTick;
 	int m_Tick;
 	int m_PrevMaxClientId;
 	int m_MaxClientId;
@@ -150,4 +158,148 @@ private:
 	CTeam m_aPrevTeams[MAX_CLIENTS];
 };
 
+// Writes the teehistorian stream as zlib blocks that can be decompressed on
+// their own. Each block starts at a tick that is written explicitly and is
+// preceded by a header, the index gets the first tick and the file offset of
+// each block. Player positions and inputs are still stored as differences to
+// the ticks before, so a reader that starts in the middle knows the ticks but
+// not the full player state.
+class CTeeHistorianBlockWriter
+{
+public:
+	enum
+	{
+		// big endian int32s: compressed size, uncompressed size, first tick
+		// and the last tick written before the block
+		BLOCK_HEADER_SIZE = 16,
+		// big endian int32 first tick and int64 file offset of the block
+		INDEX_ENTRY_SIZE = 12,
+		MAX_BLOCK_SIZE = 128 * 1024,
+		MAX_BLOCK_TICKS = 500,
+	};
+
+	CTeeHistorianBlockWriter();
+
+	void Reset(CTeeHistorian::WRITE_CALLBACK pfnWriteData, CTeeHistorian::WRITE_CALLBACK pfnWriteIndex, void *pUser);
+	void Write(const void *pData, int DataSize);
+	// call before CTeeHistorian::BeginTick, returns whether the tick starts
+	// a new block and must be written explicitly
+	bool BeginTick(int Tick, int LastWrittenTick);
+	// compresses and writes the current block
+	void Flush();
+
+	int64_t UncompressedSize() const { return m_UncompressedSize; }
+	int64_t CompressedSize() const { return m_Offset; }
+
+private:
+	CTeeHistorian::WRITE_CALLBACK m_pfnWriteData;
+	CTeeHistorian::WRITE_CALLBACK m_pfnWriteIndex;
+	void *m_pUser;
+
+	std::vector<unsigned char> m_vBlock;
+	std::vector<unsigned char> m_vCompressed;
+	int m_FirstTick;
+	int m_PrevTick;
+	int m_NumTicks;
+	int64_t m_Offset;
+	int64_t m_UncompressedSize;
+};
+
+class CTeeHistorianBlockReader
+{
+public:
+	class CBlockHeader
+	{
+	public:
+		int m_CompressedSize;
+		int m_UncompressedSize;
+		int m_FirstTick; // -1 if the block contains no tick
+		int m_PrevTick;
+	};
+
+	class CIndexEntry
+	{
+	public:
+		int m_FirstTick;
+		int64_t m_Offset;
+	};
+
+	// returns false if the index is truncated
+	static bool ReadIndex(IOHANDLE File, std::vector<CIndexEntry> &vIndex);
+	// offset of the block that contains the tick, -1 if it is before the first
+	static int64_t FindTick(const std::vector<CIndexEntry> &vIndex, int Tick);
+	// reads and decompresses the block at the current file position, returns
+	// false at the end of the file or if the block is corrupt
+	static bool ReadBlock(IOHANDLE File, CBlockHeader *pHeader, std::vector<unsigned char> &vData);
+};
+
+// Reads the chunks of a teehistorian file in the plain format or as written
+// by CTeeHistorianBlockWriter. The whole file is loaded at once so that going
+// through it doesn't wait on the disk. Player positions and inputs are
+// returned as absolute values, strings and data point into the loaded file.
+class CTeeHistorianReader
+{
+public:
+	enum
+	{
+		CHUNK_FINISH,
+		CHUNK_PLAYER, // m_ClientId, m_X, m_Y
+		CHUNK_PLAYER_OLD, // m_ClientId
+		CHUNK_INPUT, // m_ClientId, m_Input
+		CHUNK_MESSAGE, // m_ClientId, m_pData, m_DataSize
+		CHUNK_JOIN, // m_ClientId
+		CHUNK_DROP, // m_ClientId, m_pString: reason
+		CHUNK_CONSOLE_COMMAND, // m_ClientId, m_FlagMask, m_pString: command, m_vpArgs
+		CHUNK_EX, // m_Uuid, m_pData, m_DataSize
+	};
+
+	class CChunk
+	{
+	public:
+		int m_Type;
+		int m_Tick;
+		int m_ClientId;
+		int m_X;
+		int m_Y;
+		CNetObj_PlayerInput m_Input;
+		int m_FlagMask;
+		const char *m_pString;
+		std::vector<const char *> m_vpArgs;
+		CUuid m_Uuid;
+		const void *m_pData;
+		int m_DataSize;
+	};
+
+	// returns false if the file is no teehistorian file
+	bool Load(IOHANDLE File);
+	const char *HeaderJson() const { return m_pHeaderJson; }
+
+	// returns false after the last chunk or if the file is corrupt
+	bool ReadChunk(CChunk *pChunk);
+	bool Error() const { return m_Error; }
+	int Tick() const { return m_Tick; }
+
+private:
+	class CPlayer
+	{
+	public:
+		bool m_Alive;
+		int m_X;
+		int m_Y;
+		CNetObj_PlayerInput m_Input;
+	};
+
+	std::vector<unsigned char> m_vData;
+	CUnpacker m_Unpacker;
+	const char *m_pHeaderJson = "";
+	bool m_Error = false;
+	bool m_Finished = false;
+
+	int m_Tick;
+	int m_LastPlayerId;
+	CPlayer m_aPlayers[MAX_CLIENTS];
+
+	bool PlayerChunk(int ClientId);
+};
+
 #endif // GAME_SERVER_TEEHISTORIAN_H
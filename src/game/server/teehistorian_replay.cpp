@@ -0,0 +1,444 @@
+#include "teehistorian_replay.h"
+
+#include "entities/character.h"
+#include "gamecontext.h"
+#include "gamecontroller.h"
+#include "player.h"
+#include "teams.h"
+
+#include <base/log.h>
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/server/server.h>
+#include <engine/shared/config.h>
+#include <engine/shared/json.h>
+#include <engine/shared/packer.h>
+#include <engine/shared/protocol_ex.h>
+
+#include <cstdio>
+
+#define UUID(id, name) static const CUuid UUID_##id = CalculateUuid(name);
+#include <engine/shared/teehistorian_ex_chunks.h>
+#undef UUID
+
+CTeeHistorianReplay::CTeeHistorianReplay(CServer *pServer, CTeeHistorianReader *pReader) :
+	m_pServer(pServer), m_pReader(pReader)
+{
+	for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
+		ResetClient(ClientId);
+}
+
+CTeeHistorianReplay::~CTeeHistorianReplay()
+{
+	if(m_pHeader)
+		json_value_free(m_pHeader);
+}
+
+CGameContext *CTeeHistorianReplay::GameServer() const
+{
+	return static_cast<CGameContext *>(m_pServer->GameServer());
+}
+
+bool CTeeHistorianReplay::ParseHeader()
+{
+	m_pHeader = json_parse(m_pReader->HeaderJson(), str_length(m_pReader->HeaderJson()));
+	if(!m_pHeader || m_pHeader->type != json_object)
+		return false;
+
+	const json_value *pMapName = json_object_get(m_pHeader, "map_name");
+	const json_value *pMapSha256 = json_object_get(m_pHeader, "map_sha256");
+	if(pMapName->type != json_string || pMapSha256->type != json_string)
+		return false;
+	str_copy(m_aMapName, json_string_get(pMapName));
+	return sha256_from_str(&m_MapSha256, json_string_get(pMapSha256)) == 0;
+}
+
+void CTeeHistorianReplay::ApplyConfig(IConsole *pConsole)
+{
+	const json_value *pConfig = json_object_get(m_pHeader, "config");
+	if(pConfig->type != json_object)
+		return;
+	for(unsigned i = 0; i < pConfig->u.object.length; i++)
+	{
+		const json_value *pValue = pConfig->u.object.values[i].value;
+		if(pValue->type != json_string)
+			continue;
+		char aLine[IConsole::CMDLINE_LENGTH];
+		str_format(aLine, sizeof(aLine), "%s \"", pConfig->u.object.values[i].name);
+		char *pDst = aLine + str_length(aLine);
+		str_escape(&pDst, json_string_get(pValue), aLine + sizeof(aLine));
+		str_append(aLine, "\"");
+		pConsole->ExecuteLine(aLine);
+	}
+	// don't record the replay
+	pConsole->ExecuteLine("sv_tee_historian 0");
+}
+
+void CTeeHistorianReplay::Start()
+{
+	// the game server of the recording started at the first tick
+	m_pServer->SetTick(MIN_TICK);
+
+	unsigned aSeed[4];
+	const json_value *pPrng = json_object_get(m_pHeader, "prng_description");
+	if(pPrng->type == json_string && sscanf(json_string_get(pPrng), "pcg-xsh-rr:%8x%8x:%8x%8x", &aSeed[0], &aSeed[1], &aSeed[2], &aSeed[3]) == 4)
+	{
+		uint64_t aPrngSeed[2] = {(uint64_t)aSeed[0] << 32 | aSeed[1], (uint64_t)aSeed[2] << 32 | aSeed[3]};
+		m_Prng.Seed(aPrngSeed);
+		GameServer()->m_World.m_Core.m_pPrng = &m_Prng;
+	}
+	else
+	{
+		log_error("teehistorian_replay", "unknown prng, random teleports will differ");
+	}
+
+	// tuning is stored as the raw values of the params that differ from the
+	// defaults
+	const json_value *pTuning = json_object_get(m_pHeader, "tuning");
+	if(pTuning->type == json_object)
+	{
+		CTuneParam *pParams = (CTuneParam *)GameServer()->GlobalTuning();
+		for(unsigned i = 0; i < pTuning->u.object.length; i++)
+		{
+			const json_value *pValue = pTuning->u.object.values[i].value;
+			if(pValue->type != json_string)
+				continue;
+			for(int Param = 0; Param < CTuningParams::Num(); Param++)
+			{
+				if(str_comp(CTuningParams::Name(Param), pTuning->u.object.values[i].name) == 0)
+					pParams[Param].Set(str_toint(json_string_get(pValue)));
+			}
+		}
+	}
+}
+
+bool CTeeHistorianReplay::Run()
+{
+	Start();
+
+	CTeeHistorianReader::CChunk Chunk;
+	while(m_pReader->ReadChunk(&Chunk) && Chunk.m_Type != CTeeHistorianReader::CHUNK_FINISH)
+	{
+		while(m_pServer->Tick() < Chunk.m_Tick)
+		{
+			// ticks without chunks have the same positions as before
+			if(m_VerifyPending)
+				Verify();
+			Tick();
+			m_VerifyPending = true;
+		}
+
+		// the positions of a tick are written first, everything after them
+		// happened between the ticks
+		if(m_VerifyPending && Chunk.m_Type != CTeeHistorianReader::CHUNK_PLAYER && Chunk.m_Type != CTeeHistorianReader::CHUNK_PLAYER_OLD)
+			Verify();
+
+		CClient &Client = m_aClients[ClientValid(Chunk.m_ClientId) ? Chunk.m_ClientId : 0];
+		switch(Chunk.m_Type)
+		{
+		case CTeeHistorianReader::CHUNK_PLAYER:
+			Client.m_RecordedAlive = true;
+			Client.m_RecordedX = Chunk.m_X;
+			Client.m_RecordedY = Chunk.m_Y;
+			break;
+		case CTeeHistorianReader::CHUNK_PLAYER_OLD:
+			Client.m_RecordedAlive = false;
+			break;
+		case CTeeHistorianReader::CHUNK_INPUT:
+			Client.m_HasInput = true;
+			Client.m_InputChanged = true;
+			Client.m_Input = Chunk.m_Input;
+			break;
+		case CTeeHistorianReader::CHUNK_MESSAGE:
+			if(ClientValid(Chunk.m_ClientId))
+				OnMessage(Chunk.m_ClientId, Chunk.m_pData, Chunk.m_DataSize);
+			break;
+		case CTeeHistorianReader::CHUNK_JOIN:
+			if(!ClientValid(Chunk.m_ClientId))
+				break;
+			if(!m_pServer->ClientSlotEmpty(Chunk.m_ClientId))
+				CServer::DelClientCallback(Chunk.m_ClientId, "rejoined", m_pServer);
+			CServer::NewClientCallback(Chunk.m_ClientId, m_pServer, Client.m_Sixup);
+			break;
+		case CTeeHistorianReader::CHUNK_DROP:
+			if(!ClientValid(Chunk.m_ClientId))
+				break;
+			// the simulation might have dropped the client already
+			if(!m_pServer->ClientSlotEmpty(Chunk.m_ClientId))
+				CServer::DelClientCallback(Chunk.m_ClientId, Chunk.m_pString, m_pServer);
+			ResetClient(Chunk.m_ClientId);
+			break;
+		case CTeeHistorianReader::CHUNK_CONSOLE_COMMAND:
+			OnConsoleCommand(Chunk);
+			break;
+		case CTeeHistorianReader::CHUNK_EX:
+			OnEx(Chunk);
+			break;
+		}
+	}
+	if(m_VerifyPending)
+		Verify();
+
+	return !m_pReader->Error();
+}
+
+void CTeeHistorianReplay::Tick()
+{
+	CGameContext *pGameServer = GameServer();
+	const int64_t Start = time_get_nanoseconds().count();
+
+	for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
+	{
+		CClient &Client = m_aClients[ClientId];
+		if(Client.m_InputChanged && m_pServer->ClientIngame(ClientId))
+			pGameServer->OnClientDirectInput(ClientId, &Client.m_Input);
+		Client.m_InputChanged = false;
+		// the direct input can kick the client
+		if(m_pServer->ClientIngame(ClientId))
+			pGameServer->OnClientPredictedEarlyInput(ClientId, Client.m_HasInput ? &Client.m_Input : nullptr);
+	}
+
+	m_pServer->SetTick(m_pServer->Tick() + 1);
+
+	for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
+	{
+		if(m_pServer->ClientIngame(ClientId))
+			pGameServer->OnClientPredictedInput(ClientId, m_aClients[ClientId].m_HasInput ? &m_aClients[ClientId].m_Input : nullptr);
+	}
+	pGameServer->OnTick();
+
+	m_Stats.m_TickTime += time_get_nanoseconds().count() - Start;
+	m_Stats.m_Ticks++;
+}
+
+void CTeeHistorianReplay::Verify()
+{
+	m_VerifyPending = false;
+	for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
+	{
+		CClient &Client = m_aClients[ClientId];
+		CCharacter *pChr = GameServer()->GetPlayerChar(ClientId);
+		if(!Client.m_RecordedAlive && !pChr)
+			continue;
+
+		m_Stats.m_PlayerTicks++;
+		CNetObj_CharacterCore Core = {};
+		if(pChr)
+			pChr->GetCore().Write(&Core);
+		if(Client.m_RecordedAlive == (pChr != nullptr) && Core.m_X == Client.m_RecordedX && Core.m_Y == Client.m_RecordedY)
+			continue;
+
+		m_Stats.m_MismatchedPlayerTicks++;
+		if(Client.m_Mismatched)
+			continue;
+		// the following mismatches of the player usually follow from the
+		// first one, only that one is interesting
+		Client.m_Mismatched = true;
+		m_Stats.m_MismatchedPlayers++;
+		if(m_vMismatches.size() < MAX_MISMATCHES)
+		{
+			CMismatch Mismatch;
+			Mismatch.m_Tick = m_pServer->Tick();
+			Mismatch.m_ClientId = ClientId;
+			Mismatch.m_RecordedAlive = Client.m_RecordedAlive;
+			Mismatch.m_RecordedX = Client.m_RecordedX;
+			Mismatch.m_RecordedY = Client.m_RecordedY;
+			Mismatch.m_Alive = pChr != nullptr;
+			Mismatch.m_X = Core.m_X;
+			Mismatch.m_Y = Core.m_Y;
+			m_vMismatches.push_back(Mismatch);
+		}
+	}
+}
+
+void CTeeHistorianReplay::ResetClient(int ClientId)
+{
+	CClient &Client = m_aClients[ClientId];
+	Client.m_Sixup = false;
+	Client.m_Connected = false;
+	Client.m_HasInput = false;
+	Client.m_InputChanged = false;
+	mem_zero(&Client.m_Input, sizeof(Client.m_Input));
+	Client.m_RecordedAlive = false;
+	Client.m_RecordedX = 0;
+	Client.m_RecordedY = 0;
+	Client.m_Mismatched = false;
+}
+
+bool CTeeHistorianReplay::ClientValid(int ClientId) const
+{
+	return ClientId >= 0 && ClientId < MAX_CLIENTS;
+}
+
+void CTeeHistorianReplay::Connect(int ClientId)
+{
+	// the client got ready with a system message that isn't recorded, the
+	// first thing that is recorded after it is used instead
+	if(m_aClients[ClientId].m_Connected || m_pServer->ClientSlotEmpty(ClientId))
+		return;
+	m_aClients[ClientId].m_Connected = true;
+	m_pServer->m_aClients[ClientId].m_State = CServer::CClient::STATE_READY;
+	GameServer()->OnClientConnected(ClientId, nullptr);
+}
+
+void CTeeHistorianReplay::Enter(int ClientId)
+{
+	Connect(ClientId);
+	if(m_pServer->m_aClients[ClientId].m_State != CServer::CClient::STATE_READY)
+		return;
+	m_pServer->m_aClients[ClientId].m_State = CServer::CClient::STATE_INGAME;
+	GameServer()->OnClientEnter(ClientId);
+}
+
+void CTeeHistorianReplay::OnMessage(int ClientId, const void *pData, int DataSize)
+{
+	Connect(ClientId);
+	if(m_pServer->m_aClients[ClientId].m_State < CServer::CClient::STATE_READY)
+		return;
+
+	CUnpacker Unpacker;
+	Unpacker.Reset(pData, DataSize);
+	CMsgPacker Packer(NETMSG_EX, true);
+	int Msg;
+	bool Sys;
+	CUuid Uuid;
+	// only game messages are recorded, they are the same for both protocols
+	if(UnpackMessageId(&Msg, &Sys, &Uuid, &Unpacker, &Packer) != UNPACKMESSAGE_OK || Sys)
+		return;
+	GameServer()->OnMessage(Msg, &Unpacker, ClientId);
+}
+
+void CTeeHistorianReplay::OnConsoleCommand(const CTeeHistorianReader::CChunk &Chunk)
+{
+	// chat commands run again with the replayed messages and votes with the
+	// simulation, commands of the server console aren't known
+	if(!ClientValid(Chunk.m_ClientId))
+	{
+		m_Stats.m_SkippedCommands++;
+		return;
+	}
+	if(Chunk.m_FlagMask & CFGFLAG_CHAT)
+		return;
+
+	char aLine[IConsole::CMDLINE_LENGTH];
+	str_copy(aLine, Chunk.m_pString);
+	for(const char *pArg : Chunk.m_vpArgs)
+	{
+		str_append(aLine, " \"");
+		char *pDst = aLine + str_length(aLine);
+		str_escape(&pDst, pArg, aLine + sizeof(aLine));
+		str_append(aLine, "\"");
+	}
+
+	// like rcon commands of the client
+	IConsole *pConsole = m_pServer->Console();
+	m_pServer->m_RconClientId = Chunk.m_ClientId;
+	m_pServer->m_RconAuthLevel = m_pServer->GetAuthedState(Chunk.m_ClientId);
+	pConsole->ExecuteLineFlag(aLine, Chunk.m_FlagMask, Chunk.m_ClientId, false);
+	m_pServer->m_RconClientId = IServer::RCON_CID_SERV;
+	m_pServer->m_RconAuthLevel = AUTHED_ADMIN;
+}
+
+void CTeeHistorianReplay::OnEx(const CTeeHistorianReader::CChunk &Chunk)
+{
+	CUnpacker Unpacker;
+	Unpacker.Reset(Chunk.m_pData, Chunk.m_DataSize);
+
+	if(Chunk.m_Uuid == UUID_TEEHISTORIAN_TEAM_PRACTICE)
+	{
+		const int Team = Unpacker.GetInt();
+		const bool Practice = Unpacker.GetInt();
+		CGameTeams &Teams = GameServer()->m_pController->Teams();
+		if(!Unpacker.Error() && Team >= 0 && Team < TEAM_SUPER && Teams.IsPractice(Team) != Practice)
+		{
+			Teams.SetPractice(Team, Practice);
+			m_Stats.m_TeamCorrections++;
+		}
+		return;
+	}
+
+	// all other known chunks start with the client id
+	const int ClientId = Unpacker.GetInt();
+	if(Unpacker.Error() || !ClientValid(ClientId))
+		return;
+	CServer::CClient &ServerClient = m_pServer->m_aClients[ClientId];
+
+	if(Chunk.m_Uuid == UUID_TEEHISTORIAN_JOINVER6 || Chunk.m_Uuid == UUID_TEEHISTORIAN_JOINVER7)
+	{
+		m_aClients[ClientId].m_Sixup = Chunk.m_Uuid == UUID_TEEHISTORIAN_JOINVER7;
+	}
+	else if(Chunk.m_Uuid == UUID_TEEHISTORIAN_PLAYER_NAME)
+	{
+		const char *pName = Unpacker.GetString(0);
+		if(!Unpacker.Error() && !m_pServer->ClientSlotEmpty(ClientId))
+			str_copy(ServerClient.m_aName, pName);
+	}
+	else if(Chunk.m_Uuid == UUID_TEEHISTORIAN_PLAYER_READY)
+	{
+		Enter(ClientId);
+	}
+	else if(Chunk.m_Uuid == UUID_TEEHISTORIAN_DDNETVER || Chunk.m_Uuid == UUID_TEEHISTORIAN_DDNETVER_OLD)
+	{
+		CUuid ConnectionId = {};
+		const bool Old = Chunk.m_Uuid == UUID_TEEHISTORIAN_DDNETVER_OLD;
+		if(!Old)
+		{
+			const unsigned char *pConnectionId = Unpacker.GetRaw(sizeof(ConnectionId));
+			if(pConnectionId)
+				mem_copy(&ConnectionId, pConnectionId, sizeof(ConnectionId));
+		}
+		const int Version = Unpacker.GetInt();
+		const char *pVersionStr = Old ? "" : Unpacker.GetString(0);
+		if(Unpacker.Error() || !m_pServer->ClientIngame(ClientId))
+			return;
+		// a replayed message might have set the version already
+		if(ServerClient.m_DDNetVersionSettled && ServerClient.m_DDNetVersion == Version)
+			return;
+		ServerClient.m_DDNetVersion = Version;
+		ServerClient.m_DDNetVersionSettled = true;
+		if(!Old)
+		{
+			ServerClient.m_GotDDNetVersionPacket = true;
+			ServerClient.m_ConnectionId = ConnectionId;
+			str_copy(ServerClient.m_aDDNetVersionStr, pVersionStr);
+		}
+		GameServer()->OnClientDDNetVersionKnown(ClientId);
+	}
+	else if(Chunk.m_Uuid == UUID_TEEHISTORIAN_AUTH_INIT || Chunk.m_Uuid == UUID_TEEHISTORIAN_AUTH_LOGIN)
+	{
+		const int Level = Unpacker.GetInt();
+		const char *pAuthName = Unpacker.GetString(0);
+		if(Unpacker.Error() || Level < AUTHED_HELPER || Level > AUTHED_ADMIN || m_pServer->ClientSlotEmpty(ClientId))
+			return;
+		// the keys of the recording server aren't known, only their names
+		int KeySlot = m_pServer->m_AuthManager.FindKey(pAuthName);
+		if(KeySlot < 0)
+			KeySlot = m_pServer->m_AuthManager.AddKey(pAuthName, "", CAuthManager::AuthLevelToRoleName(Level));
+		ServerClient.m_AuthKey = KeySlot;
+		GameServer()->OnSetAuthed(ClientId, Level);
+	}
+	else if(Chunk.m_Uuid == UUID_TEEHISTORIAN_AUTH_LOGOUT)
+	{
+		if(m_pServer->ClientSlotEmpty(ClientId))
+			return;
+		ServerClient.m_AuthKey = -1;
+		GameServer()->OnSetAuthed(ClientId, AUTHED_NO);
+	}
+	else if(Chunk.m_Uuid == UUID_TEEHISTORIAN_PLAYER_TEAM)
+	{
+		// teams are recorded before each tick, they only differ after
+		// something that isn't replayed
+		const int Team = Unpacker.GetInt();
+		if(!Unpacker.Error() && Team >= 0 && Team < TEAM_SUPER && GameServer()->m_apPlayers[ClientId] && GameServer()->GetDDRaceTeam(ClientId) != Team)
+		{
+			GameServer()->m_pController->Teams().SetForceCharacterTeam(ClientId, Team);
+			m_Stats.m_TeamCorrections++;
+		}
+	}
+	else if(Chunk.m_Uuid == UUID_TEEHISTORIAN_SAVE_SUCCESS || Chunk.m_Uuid == UUID_TEEHISTORIAN_LOAD_SUCCESS)
+	{
+		// the first int is the team here, saves need the database
+		m_Stats.m_UnsupportedChunks++;
+	}
+}
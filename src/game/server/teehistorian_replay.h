@@ -0,0 +1,123 @@
+#ifndef GAME_SERVER_TEEHISTORIAN_REPLAY_H
+#define GAME_SERVER_TEEHISTORIAN_REPLAY_H
+
+#include "teehistorian.h"
+
+#include <base/hash.h>
+
+#include <engine/shared/protocol.h>
+
+#include <game/prng.h>
+
+#include <cstdint>
+#include <vector>
+
+class CGameContext;
+class CServer;
+class IConsole;
+typedef struct _json_value json_value;
+
+// Feeds a teehistorian file back through the game server without network
+// and as fast as possible. Joins, drops, inputs, messages and rcon commands
+// are replayed for fake clients, and the recorded player positions are
+// compared with the simulated ones after each tick.
+//
+// The replay is approximate where the file doesn't have the information:
+// inputs are applied at the tick they were recorded for, clients get
+// connected with their first message, commands of the server console and
+// team saves and loads aren't replayed.
+class CTeeHistorianReplay
+{
+public:
+	enum
+	{
+		MAX_MISMATCHES = 16,
+	};
+
+	class CMismatch
+	{
+	public:
+		int m_Tick;
+		int m_ClientId;
+		bool m_RecordedAlive;
+		int m_RecordedX;
+		int m_RecordedY;
+		bool m_Alive;
+		int m_X;
+		int m_Y;
+	};
+
+	class CStats
+	{
+	public:
+		int m_Ticks = 0;
+		// nanoseconds spent in the game server ticks
+		int64_t m_TickTime = 0;
+		int64_t m_PlayerTicks = 0;
+		int64_t m_MismatchedPlayerTicks = 0;
+		int m_MismatchedPlayers = 0;
+		int m_TeamCorrections = 0;
+		int m_SkippedCommands = 0;
+		int m_UnsupportedChunks = 0;
+	};
+
+	CTeeHistorianReplay(CServer *pServer, CTeeHistorianReader *pReader);
+	~CTeeHistorianReplay();
+
+	// parses the header of the file, returns false if it is invalid
+	bool ParseHeader();
+	const char *MapName() const { return m_aMapName; }
+	const SHA256_DIGEST &MapSha256() const { return m_MapSha256; }
+	// executes the config of the header, before the game server is initialized
+	void ApplyConfig(IConsole *pConsole);
+
+	// replays the whole file, returns false if it is corrupt
+	bool Run();
+
+	const CStats &Stats() const { return m_Stats; }
+	const std::vector<CMismatch> &Mismatches() const { return m_vMismatches; }
+
+private:
+	CServer *m_pServer;
+	CTeeHistorianReader *m_pReader;
+	json_value *m_pHeader = nullptr;
+	char m_aMapName[IO_MAX_PATH_LENGTH] = "";
+	SHA256_DIGEST m_MapSha256 = SHA256_ZEROED;
+	CPrng m_Prng;
+
+	class CClient
+	{
+	public:
+		bool m_Sixup;
+		bool m_Connected;
+		bool m_HasInput;
+		bool m_InputChanged;
+		CNetObj_PlayerInput m_Input;
+
+		bool m_RecordedAlive;
+		int m_RecordedX;
+		int m_RecordedY;
+		bool m_Mismatched;
+	};
+	CClient m_aClients[MAX_CLIENTS];
+	// the positions of the current tick are complete and not verified yet
+	bool m_VerifyPending = false;
+
+	CStats m_Stats;
+	std::vector<CMismatch> m_vMismatches;
+
+	CGameContext *GameServer() const;
+
+	void Start();
+	void Tick();
+	void Verify();
+	void ResetClient(int ClientId);
+	bool ClientValid(int ClientId) const;
+	void Connect(int ClientId);
+	void Enter(int ClientId);
+	void OnMessage(int ClientId, const void *pData, int DataSize);
+	void OnConsoleCommand(const CTeeHistorianReader::CChunk &Chunk);
+	void OnEx(const CTeeHistorianReader::CChunk &Chunk);
+};
+
+#endif // GAME_SERVER_TEEHISTORIAN_REPLAY_H
@@ -0,0 +1,65 @@
+#include "world_workers.h"
+
+#include <base/math.h>
+#include <base/system.h>
+
+class CWorldWorkers::CWorkerJob : public IJob
+{
+	CWorldWorkers *m_pWorkers;
+	int m_Worker;
+	int m_NumTasks;
+	const FTask &m_Task;
+
+	void Run() override
+	{
+		for(int Task = m_Worker; Task < m_NumTasks; Task += m_pWorkers->NumThreads())
+		{
+			m_Task(Task);
+		}
+		m_pWorkers->m_Finished.Signal();
+	}
+
+public:
+	CWorkerJob(CWorldWorkers *pWorkers, int Worker, int NumTasks, const FTask &Task) :
+		m_pWorkers(pWorkers),
+		m_Worker(Worker),
+		m_NumTasks(NumTasks),
+		m_Task(Task)
+	{
+	}
+};
+
+CWorldWorkers::~CWorldWorkers()
+{
+	if(NumThreads() > 0)
+	{
+		Shutdown();
+	}
+}
+
+void CWorldWorkers::Init(int NumThreads)
+{
+	dbg_assert(NumThreads > 0, "NumThreads invalid");
+	dbg_assert(m_NumThreads == 0, "World workers already running");
+	m_JobPool.Init(NumThreads);
+	m_NumThreads = NumThreads;
+}
+
+void CWorldWorkers::Shutdown()
+{
+	m_JobPool.Shutdown();
+	m_NumThreads = 0;
+}
+
+void CWorldWorkers::Run(int NumTasks, const FTask &Task)
+{
+	const int NumJobs = minimum(NumTasks, NumThreads());
+	for(int Worker = 0; Worker < NumJobs; Worker++)
+	{
+		m_JobPool.Add(std::make_shared<CWorkerJob>(this, Worker, NumTasks, Task));
+	}
+	for(int Worker = 0; Worker < NumJobs; Worker++)
+	{
+		m_Finished.Wait();
+	}
+}
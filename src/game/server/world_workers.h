@@ -0,0 +1,47 @@
+#ifndef GAME_SERVER_WORLD_WORKERS_H
+#define GAME_SERVER_WORLD_WORKERS_H
+
+#include <base/tl/threading.h>
+
+#include <engine/shared/jobs.h>
+
+#include <functional>
+
+/**
+ * Worker threads which run parts of the game world tick in parallel, see
+ * @link CGameWorld::TickDeferredTeams @endlink.
+ */
+class CWorldWorkers
+{
+	class CWorkerJob;
+
+	CJobPool m_JobPool;
+	int m_NumThreads = 0;
+	CSemaphore m_Finished;
+
+public:
+	using FTask = std::function<void(int Task)>;
+
+	~CWorldWorkers();
+
+	/**
+	 * Starts the worker threads.
+	 *
+	 * @param NumThreads The number of worker threads.
+	 */
+	void Init(int NumThreads);
+	void Shutdown();
+	int NumThreads() const { return m_NumThreads; }
+
+	/**
+	 * Runs the tasks `0` to `NumTasks - 1` on the worker threads and waits
+	 * until all of them are completed. The tasks are distributed to the
+	 * workers round-robin, every worker runs its tasks in ascending order.
+	 *
+	 * @param NumTasks The number of tasks.
+	 * @param Task The function to run for every task.
+	 */
+	void Run(int NumTasks, const FTask &Task);
+};
+
+#endif
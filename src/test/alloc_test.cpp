@@ -0,0 +1,150 @@
+#include <base/system.h>
+
+#include <game/alloc.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+class CPooledObject
+{
+	MACRO_ALLOC_POOL()
+
+public:
+	int m_aData[15];
+	CPooledObject *m_pNext;
+
+	virtual ~CPooledObject() = default;
+};
+
+MACRO_ALLOC_POOL_IMPL(CPooledObject, 8)
+
+class CHeapObject
+{
+	MACRO_ALLOC_HEAP()
+
+public:
+	int m_aData[15];
+	CHeapObject *m_pNext;
+
+	virtual ~CHeapObject() = default;
+};
+
+class CReusedObject
+{
+	MACRO_ALLOC_POOL()
+
+public:
+	int m_aData[15];
+};
+
+MACRO_ALLOC_POOL_IMPL(CReusedObject, 8)
+
+TEST(AllocPool, Zeroed)
+{
+	CAllocPool Pool(sizeof(CPooledObject), 4);
+	unsigned char *pBlock = static_cast<unsigned char *>(Pool.Allocate(sizeof(CPooledObject)));
+	std::fill(pBlock, pBlock + sizeof(CPooledObject), 0xff);
+	Pool.Free(pBlock);
+
+	// the freed block is handed out again and must not keep its old contents
+	unsigned char *pReused = static_cast<unsigned char *>(Pool.Allocate(sizeof(CPooledObject)));
+	EXPECT_EQ(pReused, pBlock);
+	for(size_t i = 0; i < sizeof(CPooledObject); i++)
+		ASSERT_EQ(pReused[i], 0) << "byte " << i;
+	Pool.Free(pReused);
+	EXPECT_EQ(Pool.NumUsed(), 0);
+}
+
+TEST(AllocPool, Reuse)
+{
+	std::vector<CReusedObject *> vpObjs;
+	for(int i = 0; i < 24; i++)
+		vpObjs.push_back(new CReusedObject);
+	EXPECT_EQ(CReusedObject::AllocPool().NumUsed(), 24);
+	// only as many chunks as needed, no other test uses this pool
+	const int NumChunks = CReusedObject::AllocPool().NumChunks();
+	EXPECT_EQ(NumChunks * 8, 24);
+
+	// blocks of the same chunk are contiguous
+	EXPECT_EQ((char *)vpObjs[1] - (char *)vpObjs[0], (ptrdiff_t)CReusedObject::AllocPool().BlockSize());
+
+	for(int Round = 0; Round < 10; Round++)
+	{
+		for(CReusedObject *pObj : vpObjs)
+			delete pObj;
+		EXPECT_EQ(CReusedObject::AllocPool().NumUsed(), 0);
+		for(CReusedObject *&pObj : vpObjs)
+			pObj = new CReusedObject;
+	}
+	EXPECT_EQ(CReusedObject::AllocPool().NumChunks(), NumChunks);
+
+	for(CReusedObject *pObj : vpObjs)
+		delete pObj;
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(AllocPool, DISABLED_Benchmark)
+{
+	// free and copy a list of objects like the prediction world copies its entities every frame
+	const int NumObjects = 256;
+	const int NumCopies = 2000;
+
+	std::chrono::nanoseconds Start = time_get_nanoseconds();
+	CPooledObject *pPooled = nullptr;
+	for(int Copy = 0; Copy < NumCopies; Copy++)
+	{
+		while(pPooled)
+		{
+			CPooledObject *pNext = pPooled->m_pNext;
+			delete pPooled;
+			pPooled = pNext;
+		}
+		for(int i = 0; i < NumObjects; i++)
+		{
+			CPooledObject *pObj = new CPooledObject();
+			pObj->m_aData[0] = i;
+			pObj->m_pNext = pPooled;
+			pPooled = pObj;
+		}
+	}
+	const std::chrono::nanoseconds PoolTime = time_get_nanoseconds() - Start;
+	const int NumChunks = CPooledObject::AllocPool().NumChunks();
+	while(pPooled)
+	{
+		CPooledObject *pNext = pPooled->m_pNext;
+		delete pPooled;
+		pPooled = pNext;
+	}
+
+	Start = time_get_nanoseconds();
+	CHeapObject *pHeap = nullptr;
+	for(int Copy = 0; Copy < NumCopies; Copy++)
+	{
+		while(pHeap)
+		{
+			CHeapObject *pNext = pHeap->m_pNext;
+			delete pHeap;
+			pHeap = pNext;
+		}
+		for(int i = 0; i < NumObjects; i++)
+		{
+			CHeapObject *pObj = new CHeapObject();
+			pObj->m_aData[0] = i;
+			pObj->m_pNext = pHeap;
+			pHeap = pObj;
+		}
+	}
+	const std::chrono::nanoseconds HeapTime = time_get_nanoseconds() - Start;
+	while(pHeap)
+	{
+		CHeapObject *pNext = pHeap->m_pNext;
+		delete pHeap;
+		pHeap = pNext;
+	}
+
+	dbg_msg("alloc_test", "%d copies of %d objects, pool %.3fms (%d chunk allocations), heap %.3fms (%d allocations)",
+		NumCopies, NumObjects, PoolTime.count() / 1e6, NumChunks, HeapTime.count() / 1e6, NumCopies * NumObjects);
+}
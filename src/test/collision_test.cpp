@@ -0,0 +1,783 @@
+#include "test.h"
+
+#include <base/math.h>
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/shared/config.h>
+#include <engine/storage.h>
+
+#include <game/collision.h>
+#include <game/gamecore.h>
+#include <game/layers.h>
+#include <game/mapitems.h>
+#include <game/teamscore.h>
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <memory>
+#include <random>
+
+// per-pixel implementations before the tile walk, to check that the results did not change
+static int RefIntersectLine(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+		if(Collision.CheckPoint(ix, iy))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return Collision.GetCollisionAt(ix, iy);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int RefIntersectLineTeleHook(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	int dx = 0, dy = 0;
+	ThroughOffset(Pos0, Pos1, &dx, &dy);
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+
+		int Index = Collision.GetPureMapIndex(Pos);
+		if(g_Config.m_SvOldTeleportHook)
+			*pTeleNr = Collision.IsTeleport(Index);
+		else
+			*pTeleNr = Collision.IsTeleportHook(Index);
+		if(*pTeleNr)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return TILE_TELEINHOOK;
+		}
+
+		int Hit = 0;
+		if(Collision.CheckPoint(ix, iy))
+		{
+			if(!Collision.IsThrough(ix, iy, dx, dy, Pos0, Pos1))
+				Hit = Collision.GetCollisionAt(ix, iy);
+		}
+		else if(Collision.IsHookBlocker(ix, iy, Pos0, Pos1))
+		{
+			Hit = TILE_NOHOOK;
+		}
+		if(Hit)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return Hit;
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int RefIntersectLineTeleWeapon(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+
+		int Index = Collision.GetPureMapIndex(Pos);
+		if(g_Config.m_SvOldTeleportWeapons)
+			*pTeleNr = Collision.IsTeleport(Index);
+		else
+			*pTeleNr = Collision.IsTeleportWeapon(Index);
+		if(*pTeleNr)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return TILE_TELEINWEAPON;
+		}
+
+		if(Collision.CheckPoint(ix, iy))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return Collision.GetCollisionAt(ix, iy);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int RefIntersectNoLaser(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float Distance = distance(Pos0, Pos1);
+	vec2 Last = Pos0;
+	const int DistanceRounded = std::ceil(Distance);
+	for(int i = 0; i < DistanceRounded; i++)
+	{
+		float a = i / Distance;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int Nx = std::clamp(round_to_int(Pos.x) / 32, 0, Collision.GetWidth() - 1);
+		int Ny = std::clamp(round_to_int(Pos.y) / 32, 0, Collision.GetHeight() - 1);
+		if(Collision.GetIndex(Nx, Ny) == TILE_SOLID || Collision.GetIndex(Nx, Ny) == TILE_NOHOOK || Collision.GetIndex(Nx, Ny) == TILE_NOLASER || Collision.GetFrontIndex(Nx, Ny) == TILE_NOLASER)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			if(Collision.GetFrontIndex(Nx, Ny) == TILE_NOLASER)
+				return Collision.GetFrontCollisionAt(Pos.x, Pos.y);
+			else
+				return Collision.GetCollisionAt(Pos.x, Pos.y);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int RefIntersectNoLaserNoWalls(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float Distance = distance(Pos0, Pos1);
+	vec2 Last = Pos0;
+	const int DistanceRounded = std::ceil(Distance);
+	for(int i = 0; i < DistanceRounded; i++)
+	{
+		float a = (float)i / Distance;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		if(Collision.IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)) || Collision.IsFrontNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			if(Collision.IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)))
+				return Collision.GetCollisionAt(Pos.x, Pos.y);
+			else
+				return Collision.GetFrontCollisionAt(Pos.x, Pos.y);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int RefIntersectAir(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float Distance = distance(Pos0, Pos1);
+	vec2 Last = Pos0;
+	const int DistanceRounded = std::ceil(Distance);
+	for(int i = 0; i < DistanceRounded; i++)
+	{
+		float a = (float)i / Distance;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		const int x = round_to_int(Pos.x);
+		const int y = round_to_int(Pos.y);
+		if(Collision.IsSolid(x, y) || (!Collision.GetTile(x, y) && !Collision.GetFrontTile(x, y)))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			if(!Collision.GetTile(x, y) && !Collision.GetFrontTile(x, y))
+				return -1;
+			else if(!Collision.GetTile(x, y))
+				return Collision.GetTile(x, y);
+			else
+				return Collision.GetFrontTile(x, y);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static std::vector<int> RefGetMapIndices(const CCollision &Collision, vec2 PrevPos, vec2 Pos, unsigned MaxIndices)
+{
+	std::vector<int> vIndices;
+	float d = distance(PrevPos, Pos);
+	int End(d + 1);
+	if(!d)
+		return Collision.GetMapIndices(PrevPos, Pos, MaxIndices);
+	int LastIndex = 0;
+	for(int i = 0; i < End; i++)
+	{
+		float a = i / d;
+		vec2 Tmp = mix(PrevPos, Pos, a);
+		int Nx = std::clamp((int)Tmp.x / 32, 0, Collision.GetWidth() - 1);
+		int Ny = std::clamp((int)Tmp.y / 32, 0, Collision.GetHeight() - 1);
+		int Index = Ny * Collision.GetWidth() + Nx;
+		if(Collision.TileExists(Index) && LastIndex != Index)
+		{
+			if(MaxIndices && vIndices.size() > MaxIndices)
+				return vIndices;
+			vIndices.push_back(Index);
+			LastIndex = Index;
+		}
+	}
+	return vIndices;
+}
+
+static void RefMoveBox(const CCollision &Collision, vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, vec2 Elasticity, bool *pGrounded)
+{
+	vec2 Pos = *pInoutPos;
+	vec2 Vel = *pInoutVel;
+	float Distance = length(Vel);
+	int Max = (int)Distance;
+	if(Distance > 0.00001f)
+	{
+		float Fraction = 1.0f / (float)(Max + 1);
+		float ElasticityX = std::clamp(Elasticity.x, -1.0f, 1.0f);
+		float ElasticityY = std::clamp(Elasticity.y, -1.0f, 1.0f);
+		for(int i = 0; i <= Max; i++)
+		{
+			if(Vel == vec2(0, 0))
+				break;
+			vec2 NewPos = Pos + Vel * Fraction;
+			if(NewPos == Pos)
+				break;
+			if(Collision.TestBox(vec2(NewPos.x, NewPos.y), Size))
+			{
+				int Hits = 0;
+				if(Collision.TestBox(vec2(Pos.x, NewPos.y), Size))
+				{
+					if(pGrounded && ElasticityY > 0 && Vel.y > 0)
+						*pGrounded = true;
+					NewPos.y = Pos.y;
+					Vel.y *= -ElasticityY;
+					Hits++;
+				}
+				if(Collision.TestBox(vec2(NewPos.x, Pos.y), Size))
+				{
+					NewPos.x = Pos.x;
+					Vel.x *= -ElasticityX;
+					Hits++;
+				}
+				if(Hits == 0)
+				{
+					if(pGrounded && ElasticityY > 0 && Vel.y > 0)
+						*pGrounded = true;
+					NewPos.y = Pos.y;
+					Vel.y *= -ElasticityY;
+					NewPos.x = Pos.x;
+					Vel.x *= -ElasticityX;
+				}
+			}
+			Pos = NewPos;
+		}
+	}
+	*pInoutPos = Pos;
+	*pInoutVel = Vel;
+}
+
+class CTestCollision : public ::testing::Test
+{
+protected:
+	std::unique_ptr<IKernel> m_pKernel;
+	CTestInfo m_TestInfo;
+	std::unique_ptr<IStorage> m_pStorage;
+	IEngineMap *m_pMap;
+	CLayers m_Layers;
+	CCollision m_Collision;
+
+	CTestCollision()
+	{
+		m_pKernel = std::unique_ptr<IKernel>(IKernel::Create());
+		m_TestInfo.m_DeleteTestStorageFilesOnSuccess = true;
+		m_pStorage = m_TestInfo.CreateTestStorage();
+		m_pKernel->RegisterInterface(m_pStorage.get(), false);
+		m_pMap = CreateEngineMap();
+		m_pKernel->RegisterInterface(m_pMap);
+	}
+
+	void LoadMap(const char *pMap)
+	{
+		char aPath[IO_MAX_PATH_LENGTH];
+		str_format(aPath, sizeof(aPath), "maps/%s.map", pMap);
+		ASSERT_TRUE(m_pMap->Load(aPath));
+		m_Layers.Init(m_pMap, true);
+		m_Collision.Init(&m_Layers);
+	}
+
+	// lines from inside the map, sometimes ending outside of it, some exactly on tile borders
+	std::vector<std::pair<vec2, vec2>> RandomLines(int Num, float MaxLength, unsigned Seed) const
+	{
+		std::mt19937 Rng(Seed);
+		const float Width = m_Collision.GetWidth() * 32.0f;
+		const float Height = m_Collision.GetHeight() * 32.0f;
+		std::uniform_real_distribution<float> DistX(0.0f, Width);
+		std::uniform_real_distribution<float> DistY(0.0f, Height);
+		std::uniform_real_distribution<float> DistAngle(0.0f, 2 * pi);
+		std::uniform_real_distribution<float> DistLength(0.0f, MaxLength);
+		std::uniform_int_distribution<int> DistKind(0, 7);
+		static const float s_aBorderOffsets[] = {-1.0f, -0.5f, -0.25f, 0.0f, 0.25f, 0.5f, 1.0f};
+		std::uniform_int_distribution<int> DistOffset(0, std::size(s_aBorderOffsets) - 1);
+
+		std::vector<std::pair<vec2, vec2>> vLines;
+		for(int i = 0; i < Num; i++)
+		{
+			vec2 Pos0(DistX(Rng), DistY(Rng));
+			const int Kind = DistKind(Rng);
+			if(Kind == 0)
+			{
+				// start on a tile border
+				Pos0.x = std::floor(Pos0.x / 32.0f) * 32.0f + s_aBorderOffsets[DistOffset(Rng)];
+				Pos0.y = std::floor(Pos0.y / 32.0f) * 32.0f + s_aBorderOffsets[DistOffset(Rng)];
+			}
+			const float Angle = Kind == 1 ? std::round(DistAngle(Rng) / (pi / 4)) * (pi / 4) : DistAngle(Rng);
+			float Length = DistLength(Rng);
+			if(Kind == 2)
+				Length = std::round(Length);
+			else if(Kind == 3)
+				Length = Length / MaxLength * 4.0f;
+			vec2 Pos1 = Pos0 + direction(Angle) * Length;
+			if(Kind == 4)
+			{
+				// axis aligned along a tile border
+				Pos1 = vec2(Pos0.x, Pos0.y + Length);
+				Pos0.x = Pos1.x = std::round(Pos0.x / 32.0f) * 32.0f + s_aBorderOffsets[DistOffset(Rng)];
+			}
+			else if(Kind == 5)
+			{
+				// far outside of the map
+				Pos1 = Pos0 + direction(Angle) * (Width + Height);
+			}
+			vLines.emplace_back(Pos0, Pos1);
+		}
+		return vLines;
+	}
+};
+
+static bool SameBits(vec2 A, vec2 B)
+{
+	return mem_comp(&A, &B, sizeof(A)) == 0;
+}
+
+TEST_F(CTestCollision, IntersectLineMatchesPerPixel)
+{
+	LoadMap("coverage");
+	const bool OldTeleportHook = g_Config.m_SvOldTeleportHook;
+	const bool OldTeleportWeapons = g_Config.m_SvOldTeleportWeapons;
+	int Collisions = 0;
+	for(const auto &[Pos0, Pos1] : RandomLines(20000, 1200.0f, 0))
+	{
+		char aLine[128];
+		str_format(aLine, sizeof(aLine), "%.9g,%.9g -> %.9g,%.9g", Pos0.x, Pos0.y, Pos1.x, Pos1.y);
+		for(int Old = 0; Old < 2; Old++)
+		{
+			g_Config.m_SvOldTeleportHook = Old;
+			g_Config.m_SvOldTeleportWeapons = Old;
+			vec2 aOut[4];
+			int aTeleNr[2] = {-1, -1};
+
+			int Result = m_Collision.IntersectLine(Pos0, Pos1, &aOut[0], &aOut[1]);
+			int Expected = RefIntersectLine(m_Collision, Pos0, Pos1, &aOut[2], &aOut[3]);
+			ASSERT_EQ(Result, Expected) << aLine;
+			ASSERT_TRUE(SameBits(aOut[0], aOut[2]) && SameBits(aOut[1], aOut[3])) << aLine;
+			Collisions += Result != 0;
+
+			Result = m_Collision.IntersectLineTeleHook(Pos0, Pos1, &aOut[0], &aOut[1], &aTeleNr[0]);
+			Expected = RefIntersectLineTeleHook(m_Collision, Pos0, Pos1, &aOut[2], &aOut[3], &aTeleNr[1]);
+			ASSERT_EQ(Result, Expected) << aLine;
+			ASSERT_EQ(aTeleNr[0], aTeleNr[1]) << aLine;
+			ASSERT_TRUE(SameBits(aOut[0], aOut[2]) && SameBits(aOut[1], aOut[3])) << aLine;
+
+			Result = m_Collision.IntersectLineTeleWeapon(Pos0, Pos1, &aOut[0], &aOut[1], &aTeleNr[0]);
+			Expected = RefIntersectLineTeleWeapon(m_Collision, Pos0, Pos1, &aOut[2], &aOut[3], &aTeleNr[1]);
+			ASSERT_EQ(Result, Expected) << aLine;
+			ASSERT_EQ(aTeleNr[0], aTeleNr[1]) << aLine;
+			ASSERT_TRUE(SameBits(aOut[0], aOut[2]) && SameBits(aOut[1], aOut[3])) << aLine;
+		}
+
+		vec2 aOut[4];
+		int Result = m_Collision.IntersectNoLaser(Pos0, Pos1, &aOut[0], &aOut[1]);
+		int Expected = RefIntersectNoLaser(m_Collision, Pos0, Pos1, &aOut[2], &aOut[3]);
+		ASSERT_EQ(Result, Expected) << aLine;
+		ASSERT_TRUE(SameBits(aOut[0], aOut[2]) && SameBits(aOut[1], aOut[3])) << aLine;
+
+		Result = m_Collision.IntersectNoLaserNoWalls(Pos0, Pos1, &aOut[0], &aOut[1]);
+		Expected = RefIntersectNoLaserNoWalls(m_Collision, Pos0, Pos1, &aOut[2], &aOut[3]);
+		ASSERT_EQ(Result, Expected) << aLine;
+		ASSERT_TRUE(SameBits(aOut[0], aOut[2]) && SameBits(aOut[1], aOut[3])) << aLine;
+
+		Result = m_Collision.IntersectAir(Pos0, Pos1, &aOut[0], &aOut[1]);
+		Expected = RefIntersectAir(m_Collision, Pos0, Pos1, &aOut[2], &aOut[3]);
+		ASSERT_EQ(Result, Expected) << aLine;
+		ASSERT_TRUE(SameBits(aOut[0], aOut[2]) && SameBits(aOut[1], aOut[3])) << aLine;
+
+		ASSERT_EQ(m_Collision.GetMapIndices(Pos0, Pos1), RefGetMapIndices(m_Collision, Pos0, Pos1, 0)) << aLine;
+		ASSERT_EQ(m_Collision.GetMapIndices(Pos0, Pos1, 2), RefGetMapIndices(m_Collision, Pos0, Pos1, 2)) << aLine;
+	}
+	g_Config.m_SvOldTeleportHook = OldTeleportHook;
+	g_Config.m_SvOldTeleportWeapons = OldTeleportWeapons;
+	// make sure the lines actually hit something
+	EXPECT_GT(Collisions, 1000);
+}
+
+// hook length lines, like the ones hooks and lasers test every tick
+static int64_t SumIntersectLine(const CCollision &Collision, const std::vector<std::pair<vec2, vec2>> &vLines, bool PerPixel)
+{
+	int64_t Sum = 0;
+	for(const auto &[Pos0, Pos1] : vLines)
+	{
+		vec2 Out, Before;
+		if(PerPixel)
+			Sum += RefIntersectLine(Collision, Pos0, Pos1, &Out, &Before) + round_to_int(Out.x);
+		else
+			Sum += Collision.IntersectLine(Pos0, Pos1, &Out, &Before) + round_to_int(Out.x);
+	}
+	return Sum;
+}
+
+TEST_F(CTestCollision, IntersectLineMatchesPerPixelMaps)
+{
+	static const char *const s_apMaps[] = {"coverage", "Tutorial", "Sunny Side Up"};
+	for(const char *pMap : s_apMaps)
+	{
+		LoadMap(pMap);
+		const std::vector<std::pair<vec2, vec2>> vLines = RandomLines(5000, 400.0f, 1);
+		EXPECT_EQ(SumIntersectLine(m_Collision, vLines, false), SumIntersectLine(m_Collision, vLines, true)) << pMap;
+		m_pMap->Unload();
+	}
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST_F(CTestCollision, DISABLED_IntersectLineBenchmark)
+{
+	static const char *const s_apMaps[] = {"coverage", "Tutorial", "Sunny Side Up"};
+	for(const char *pMap : s_apMaps)
+	{
+		LoadMap(pMap);
+		const std::vector<std::pair<vec2, vec2>> vLines = RandomLines(100000, 400.0f, 1);
+
+		std::chrono::nanoseconds Start = time_get_nanoseconds();
+		const int64_t ExpectedSum = SumIntersectLine(m_Collision, vLines, true);
+		const std::chrono::nanoseconds PerPixelTime = time_get_nanoseconds() - Start;
+
+		Start = time_get_nanoseconds();
+		const int64_t Sum = SumIntersectLine(m_Collision, vLines, false);
+		const std::chrono::nanoseconds TileWalkTime = time_get_nanoseconds() - Start;
+
+		EXPECT_EQ(Sum, ExpectedSum);
+		dbg_msg("collision_test", "%s: %d lines, per pixel %.3fms, tile walk %.3fms",
+			pMap, (int)vLines.size(), PerPixelTime.count() / 1e6, TileWalkTime.count() / 1e6);
+		m_pMap->Unload();
+	}
+}
+
+struct SMoveBoxResult
+{
+	vec2 m_Pos;
+	vec2 m_Vel;
+	bool m_Grounded;
+};
+
+static bool SameResult(const CCollision &Collision, vec2 Pos, vec2 Vel, vec2 Size, vec2 Elasticity, char *pDesc, int DescSize)
+{
+	SMoveBoxResult Result = {Pos, Vel, false};
+	SMoveBoxResult Expected = {Pos, Vel, false};
+	Collision.MoveBox(&Result.m_Pos, &Result.m_Vel, Size, Elasticity, &Result.m_Grounded);
+	RefMoveBox(Collision, &Expected.m_Pos, &Expected.m_Vel, Size, Elasticity, &Expected.m_Grounded);
+	str_format(pDesc, DescSize, "pos %.9g,%.9g vel %.9g,%.9g size %.9g elasticity %.9g,%.9g -> %.9g,%.9g %.9g,%.9g %d, expected %.9g,%.9g %.9g,%.9g %d",
+		Pos.x, Pos.y, Vel.x, Vel.y, Size.x, Elasticity.x, Elasticity.y,
+		Result.m_Pos.x, Result.m_Pos.y, Result.m_Vel.x, Result.m_Vel.y, Result.m_Grounded,
+		Expected.m_Pos.x, Expected.m_Pos.y, Expected.m_Vel.x, Expected.m_Vel.y, Expected.m_Grounded);
+	return SameBits(Result.m_Pos, Expected.m_Pos) && SameBits(Result.m_Vel, Expected.m_Vel) && Result.m_Grounded == Expected.m_Grounded;
+}
+
+TEST_F(CTestCollision, MoveBoxMatchesStepwise)
+{
+	LoadMap("coverage");
+	static const vec2 s_aElasticities[] = {vec2(0.0f, 0.0f), vec2(0.5f, 0.5f), vec2(1.0f, 0.0f), vec2(-1.0f, 2.0f)};
+	static const float s_aSizes[] = {28.0f, 14.0f, 0.0f};
+	std::mt19937 Rng(2);
+	std::uniform_int_distribution<int> DistElasticity(0, std::size(s_aElasticities) - 1);
+	std::uniform_int_distribution<int> DistSize(0, std::size(s_aSizes) - 1);
+	// from resting to the speed clamp of the character core
+	std::uniform_real_distribution<float> DistSpeed(0.0f, 1.0f);
+	int Bounces = 0;
+	for(const auto &[Pos0, Pos1] : RandomLines(10000, 1.0f, 3))
+	{
+		const vec2 Dir = normalize(Pos1 - Pos0);
+		const float Speed = DistSpeed(Rng);
+		const vec2 Vel = Dir * (Speed * Speed * Speed * 6000.0f);
+		const vec2 Elasticity = s_aElasticities[DistElasticity(Rng)];
+		const float Size = s_aSizes[DistSize(Rng)];
+		char aDesc[512];
+		ASSERT_TRUE(SameResult(m_Collision, Pos0, Vel, vec2(Size, Size), Elasticity, aDesc, sizeof(aDesc))) << aDesc;
+
+		vec2 Pos = Pos0;
+		vec2 NewVel = Vel;
+		RefMoveBox(m_Collision, &Pos, &NewVel, vec2(Size, Size), Elasticity, nullptr);
+		Bounces += NewVel != Vel;
+	}
+	// make sure the boxes actually hit something
+	EXPECT_GT(Bounces, 1000);
+}
+
+// Plays back inputs like the ones recorded in teehistorian files, changing
+// every few ticks, through the character core and checks every move it
+// makes against the stepwise MoveBox.
+TEST_F(CTestCollision, MoveBoxCharacterReplay)
+{
+	static const char *const s_apMaps[] = {"coverage", "Tutorial", "Sunny Side Up"};
+	for(const char *pMap : s_apMaps)
+	{
+		LoadMap(pMap);
+		CWorldCore World;
+		CTeamsCore Teams;
+		std::mt19937 Rng(4);
+		std::uniform_real_distribution<float> DistX(0.0f, m_Collision.GetWidth() * 32.0f);
+		std::uniform_real_distribution<float> DistY(0.0f, m_Collision.GetHeight() * 32.0f);
+		std::uniform_int_distribution<int> DistDirection(-1, 1);
+		std::uniform_int_distribution<int> DistTarget(-400, 400);
+		std::uniform_int_distribution<int> DistInputTicks(1, 25);
+		std::uniform_int_distribution<int> DistKick(0, 200);
+		std::uniform_real_distribution<float> DistAngle(0.0f, 2 * pi);
+
+		CCharacterCore aCores[8];
+		for(int i = 0; i < (int)std::size(aCores); i++)
+		{
+			aCores[i].Init(&World, &m_Collision, &Teams);
+			aCores[i].Reset();
+			aCores[i].m_Id = i;
+			do
+				aCores[i].m_Pos = vec2(DistX(Rng), DistY(Rng));
+			while(m_Collision.TestBox(aCores[i].m_Pos, CCharacterCore::PhysicalSizeVec2()));
+			World.m_apCharacters[i] = &aCores[i];
+		}
+
+		int aInputTicks[std::size(aCores)] = {0};
+		int Moves = 0;
+		for(int Tick = 0; Tick < 1000; Tick++)
+		{
+			for(int i = 0; i < (int)std::size(aCores); i++)
+			{
+				CCharacterCore &Core = aCores[i];
+				if(--aInputTicks[i] <= 0)
+				{
+					aInputTicks[i] = DistInputTicks(Rng);
+					Core.m_Input.m_Direction = DistDirection(Rng);
+					Core.m_Input.m_TargetX = DistTarget(Rng);
+					Core.m_Input.m_TargetY = DistTarget(Rng);
+					Core.m_Input.m_Jump = DistDirection(Rng) > 0;
+					Core.m_Input.m_Hook = DistDirection(Rng) > 0;
+				}
+				// explosions, speedups and the like
+				if(DistKick(Rng) == 0)
+					Core.m_Vel += direction(DistAngle(Rng)) * (float)DistTarget(Rng) * 5.0f;
+				Core.Tick(true);
+			}
+			for(CCharacterCore &Core : aCores)
+			{
+				// the move that CCharacterCore::Move is about to do
+				const float RampValue = VelocityRamp(length(Core.m_Vel) * 50, Core.m_Tuning.m_VelrampStart, Core.m_Tuning.m_VelrampRange, Core.m_Tuning.m_VelrampCurvature);
+				const vec2 Vel = vec2(Core.m_Vel.x * RampValue, Core.m_Vel.y);
+				const vec2 Elasticity = vec2(Core.m_Tuning.m_GroundElasticityX, Core.m_Tuning.m_GroundElasticityY);
+				char aDesc[512];
+				ASSERT_TRUE(SameResult(m_Collision, Core.m_Pos, Vel, CCharacterCore::PhysicalSizeVec2(), Elasticity, aDesc, sizeof(aDesc))) << pMap << " tick " << Tick << ": " << aDesc;
+				Moves += Vel != vec2(0, 0);
+
+				Core.Move();
+				Core.Quantize();
+			}
+		}
+		EXPECT_GT(Moves, 1000) << pMap;
+		m_pMap->Unload();
+	}
+}
+
+// about the speeds of fast characters, jetpacks and speedups
+static std::vector<std::pair<vec2, vec2>> RandomMoves(const std::vector<std::pair<vec2, vec2>> &vPositions)
+{
+	std::mt19937 Rng(5);
+	std::uniform_real_distribution<float> DistSpeed(0.0f, 100.0f);
+	std::uniform_real_distribution<float> DistAngle(0.0f, 2 * pi);
+	std::vector<std::pair<vec2, vec2>> vMoves;
+	for(const auto &[Pos0, Pos1] : vPositions)
+		vMoves.emplace_back(Pos0, direction(DistAngle(Rng)) * DistSpeed(Rng));
+	return vMoves;
+}
+
+static float SumMoveBox(const CCollision &Collision, const std::vector<std::pair<vec2, vec2>> &vMoves, bool Stepwise)
+{
+	float Sum = 0.0f;
+	for(const auto &[Pos, Vel] : vMoves)
+	{
+		vec2 OutPos = Pos, OutVel = Vel;
+		if(Stepwise)
+			RefMoveBox(Collision, &OutPos, &OutVel, CCharacterCore::PhysicalSizeVec2(), vec2(0.0f, 0.0f), nullptr);
+		else
+			Collision.MoveBox(&OutPos, &OutVel, CCharacterCore::PhysicalSizeVec2(), vec2(0.0f, 0.0f));
+		Sum += OutPos.x + OutVel.y;
+	}
+	return Sum;
+}
+
+TEST_F(CTestCollision, MoveBoxFastMatchesStepwise)
+{
+	LoadMap("Sunny Side Up");
+	const std::vector<std::pair<vec2, vec2>> vMoves = RandomMoves(RandomLines(10000, 1.0f, 6));
+	EXPECT_EQ(SumMoveBox(m_Collision, vMoves, false), SumMoveBox(m_Collision, vMoves, true));
+	m_pMap->Unload();
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST_F(CTestCollision, DISABLED_MoveBoxBenchmark)
+{
+	LoadMap("Sunny Side Up");
+	const std::vector<std::pair<vec2, vec2>> vMoves = RandomMoves(RandomLines(100000, 1.0f, 6));
+
+	std::chrono::nanoseconds Start = time_get_nanoseconds();
+	const float ExpectedSum = SumMoveBox(m_Collision, vMoves, true);
+	const std::chrono::nanoseconds StepwiseTime = time_get_nanoseconds() - Start;
+
+	Start = time_get_nanoseconds();
+	const float Sum = SumMoveBox(m_Collision, vMoves, false);
+	const std::chrono::nanoseconds SkippingTime = time_get_nanoseconds() - Start;
+
+	EXPECT_EQ(Sum, ExpectedSum);
+	dbg_msg("collision_test", "%d moves, stepwise %.3fms, skipping free tiles %.3fms",
+		(int)vMoves.size(), StepwiseTime.count() / 1e6, SkippingTime.count() / 1e6);
+	m_pMap->Unload();
+}
+
+struct SCoreState
+{
+	CNetObj_CharacterCore m_Core;
+	vec2 m_Pos;
+	vec2 m_Vel;
+};
+
+// `NumCharacters` characters in a few crowds and four teams, hooking and
+// jumping around randomly, returns the states after every tick and
+// optionally the time spent ticking the cores
+static std::vector<SCoreState> RunCores(CCollision *pCollision, int NumCharacters, int NumTicks, bool BroadPhase, int *pNumHooked, std::chrono::nanoseconds *pTickTime)
+{
+	std::mt19937 Rng(7);
+	const vec2 MapSize = vec2(pCollision->GetWidth() * 32.0f, pCollision->GetHeight() * 32.0f);
+	std::uniform_real_distribution<float> DistX(0.0f, MapSize.x);
+	std::uniform_real_distribution<float> DistY(0.0f, MapSize.y);
+	std::uniform_real_distribution<float> DistOffset(-100.0f, 100.0f);
+	std::uniform_int_distribution<int> DistDirection(-1, 1);
+	std::uniform_int_distribution<int> DistBool(0, 1);
+	std::uniform_int_distribution<int> DistTarget(-400, 400);
+
+	CWorldCore World;
+	CTeamsCore Teams;
+	std::vector<CCharacterCore> vCores(NumCharacters);
+	vec2 Crowd;
+	for(int i = 0; i < NumCharacters; i++)
+	{
+		if(i % 16 == 0)
+			Crowd = vec2(DistX(Rng), DistY(Rng));
+		vCores[i].Init(&World, pCollision, &Teams);
+		vCores[i].m_Id = i;
+		vCores[i].m_Pos = Crowd + vec2(DistOffset(Rng), DistOffset(Rng));
+		World.m_apCharacters[i] = &vCores[i];
+		Teams.Team(i, i % 4);
+	}
+
+	std::vector<SCoreState> vStates;
+	*pNumHooked = 0;
+	if(pTickTime)
+		*pTickTime = std::chrono::nanoseconds(0);
+	for(int Tick = 0; Tick < NumTicks; Tick++)
+	{
+		for(auto &Core : vCores)
+		{
+			Core.m_Input.m_Direction = DistDirection(Rng);
+			Core.m_Input.m_Jump = DistBool(Rng);
+			Core.m_Input.m_Hook = DistBool(Rng);
+			Core.m_Input.m_TargetX = DistTarget(Rng);
+			Core.m_Input.m_TargetY = DistTarget(Rng);
+		}
+
+		const std::chrono::nanoseconds Start = time_get_nanoseconds();
+		if(BroadPhase)
+			World.BuildBroadPhase();
+		for(int i = 0; i < NumCharacters; i++)
+		{
+			vCores[i].Tick(true);
+			World.UpdateBroadPhase(i);
+		}
+		World.ClearBroadPhase();
+		if(pTickTime)
+			*pTickTime += time_get_nanoseconds() - Start;
+
+		for(auto &Core : vCores)
+		{
+			Core.Move();
+			Core.Quantize();
+			*pNumHooked += Core.HookedPlayer() != -1;
+
+			SCoreState State;
+			Core.Write(&State.m_Core);
+			State.m_Pos = Core.m_Pos;
+			State.m_Vel = Core.m_Vel;
+			vStates.push_back(State);
+		}
+	}
+	return vStates;
+}
+
+TEST_F(CTestCollision, CharacterCoreBroadPhaseMatchesFullLoop)
+{
+	LoadMap("coverage");
+	// MAX_CLIENTS limits the number of characters of a world
+	for(int NumCharacters : {64, (int)MAX_CLIENTS})
+	{
+		const int NumTicks = 200;
+		int NumHooked, RefNumHooked;
+		const std::vector<SCoreState> vStates = RunCores(&m_Collision, NumCharacters, NumTicks, true, &NumHooked, nullptr);
+		const std::vector<SCoreState> vRefStates = RunCores(&m_Collision, NumCharacters, NumTicks, false, &RefNumHooked, nullptr);
+		ASSERT_EQ(vStates.size(), vRefStates.size());
+		for(size_t i = 0; i < vStates.size(); i++)
+		{
+			ASSERT_EQ(mem_comp(&vStates[i].m_Core, &vRefStates[i].m_Core, sizeof(CNetObj_CharacterCore)), 0) << "tick " << i / NumCharacters << ", character " << i % NumCharacters;
+			ASSERT_TRUE(SameBits(vStates[i].m_Pos, vRefStates[i].m_Pos) && SameBits(vStates[i].m_Vel, vRefStates[i].m_Vel)) << "tick " << i / NumCharacters << ", character " << i % NumCharacters;
+		}
+		// make sure the characters actually hook each other
+		EXPECT_EQ(NumHooked, RefNumHooked);
+		EXPECT_GT(NumHooked, 0);
+	}
+	m_pMap->Unload();
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST_F(CTestCollision, DISABLED_CharacterCoreBroadPhaseBenchmark)
+{
+	LoadMap("coverage");
+	for(int NumCharacters : {64, (int)MAX_CLIENTS})
+	{
+		const int NumTicks = 500;
+		int NumHooked;
+		std::chrono::nanoseconds TickTime, RefTickTime;
+		RunCores(&m_Collision, NumCharacters, NumTicks, true, &NumHooked, &TickTime);
+		RunCores(&m_Collision, NumCharacters, NumTicks, false, &NumHooked, &RefTickTime);
+		dbg_msg("collision_test", "%d characters, %d ticks, broad-phase %.3fms, full loop %.3fms",
+			NumCharacters, NumTicks, TickTime.count() / 1e6, RefTickTime.count() / 1e6);
+	}
+	m_pMap->Unload();
+}
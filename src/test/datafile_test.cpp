@@ -1,5 +1,8 @@
 #include "test.h"
 
+#include <base/system.h>
+
+#include <engine/engine.h>
 #include <engine/shared/datafile.h>
 #include <engine/storage.h>
 
@@ -8,6 +11,7 @@
 #include <gtest/gtest.h>
 
 #include <memory>
+#include <vector>
 
 TEST(Datafile, ExtendedType)
 {
@@ -112,3 +116,243 @@ TEST(Datafile, StringData)
 		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
 	}
 }
+
+TEST(Datafile, MemoryMapped)
+{
+	std::unique_ptr<IStorage> pStorage = CreateLocalStorage();
+	ASSERT_NE(pStorage, nullptr) << "Error creating local storage";
+
+	CTestInfo Info;
+
+	// one data item larger than an arena block to get its own allocation
+	std::vector<std::vector<int>> vvData;
+	for(int Size : {1, 100, 4096, 100000, 400000})
+	{
+		std::vector<int> &vData = vvData.emplace_back(Size);
+		for(int i = 0; i < Size; i++)
+			vData[i] = i * 2654435761u + Size;
+	}
+
+	{
+		CDataFileWriter Writer;
+		ASSERT_TRUE(Writer.Open(pStorage.get(), Info.m_aFilename));
+
+		for(int i = 0; i < (int)vvData.size(); i++)
+		{
+			int aItem[2] = {i, (int)vvData[i].size()};
+			Writer.AddItem(MAPITEMTYPE_TEST, i, sizeof(aItem), aItem);
+			Writer.AddData(vvData[i].size() * sizeof(int), vvData[i].data());
+		}
+
+		Writer.Finish();
+	}
+
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL));
+		CDataFileReader MappedReader;
+		ASSERT_TRUE(MappedReader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL, true));
+
+		EXPECT_EQ(MappedReader.Sha256(), Reader.Sha256());
+		EXPECT_EQ(MappedReader.Crc(), Reader.Crc());
+		EXPECT_EQ(MappedReader.MapSize(), Reader.MapSize());
+		ASSERT_EQ(MappedReader.NumItems(), Reader.NumItems());
+		ASSERT_EQ(MappedReader.NumData(), (int)vvData.size());
+
+		for(int i = 0; i < Reader.NumItems(); i++)
+		{
+			ASSERT_EQ(MappedReader.GetItemSize(i), Reader.GetItemSize(i));
+			EXPECT_EQ(mem_comp(MappedReader.GetItem(i), Reader.GetItem(i), Reader.GetItemSize(i)), 0);
+		}
+
+		for(int i = 0; i < (int)vvData.size(); i++)
+		{
+			const int Size = vvData[i].size() * sizeof(int);
+			ASSERT_EQ(MappedReader.GetDataSize(i), Size);
+			const void *pData = MappedReader.GetData(i);
+			ASSERT_NE(pData, nullptr);
+			EXPECT_EQ(mem_comp(pData, vvData[i].data(), Size), 0);
+			EXPECT_EQ(MappedReader.GetData(i), pData);
+		}
+
+		// replaced and unloaded data behaves the same in both modes
+		char *pReplacement = (char *)malloc(4);
+		mem_copy(pReplacement, "abc", 4);
+		MappedReader.ReplaceData(1, pReplacement, 4);
+		EXPECT_EQ(MappedReader.GetDataSize(1), 4);
+		EXPECT_STREQ(MappedReader.GetDataString(1), "abc");
+
+		MappedReader.UnloadData(3);
+		EXPECT_EQ(mem_comp(MappedReader.GetData(3), vvData[3].data(), vvData[3].size() * sizeof(int)), 0);
+
+		MappedReader.Close();
+		Reader.Close();
+	}
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
+
+TEST(Datafile, Parallel)
+{
+	std::unique_ptr<IStorage> pStorage = CreateLocalStorage();
+	ASSERT_NE(pStorage, nullptr) << "Error creating local storage";
+	std::unique_ptr<IEngine> pEngine = std::unique_ptr<IEngine>(CreateTestEngine("datafile_test"));
+
+	CTestInfo Info;
+	char aSerialFilename[IO_MAX_PATH_LENGTH];
+	char aParallelFilename[IO_MAX_PATH_LENGTH];
+	str_format(aSerialFilename, sizeof(aSerialFilename), "%s-serial", Info.m_aFilename);
+	str_format(aParallelFilename, sizeof(aParallelFilename), "%s-parallel", Info.m_aFilename);
+
+	std::vector<std::vector<int>> vvData;
+	for(int i = 0; i < 40; i++)
+	{
+		std::vector<int> &vData = vvData.emplace_back((i * 7919) % 50000 + 1);
+		for(size_t j = 0; j < vData.size(); j++)
+			vData[j] = (j * 2654435761u) >> (i % 24);
+	}
+
+	for(const char *pFilename : {aSerialFilename, aParallelFilename})
+	{
+		CDataFileWriter Writer;
+		ASSERT_TRUE(Writer.Open(pStorage.get(), pFilename));
+		for(int i = 0; i < (int)vvData.size(); i++)
+		{
+			Writer.AddItem(MAPITEMTYPE_TEST, i, sizeof(int), &i);
+			Writer.AddData(vvData[i].size() * sizeof(int), vvData[i].data(), i % 2 ? CDataFileWriter::COMPRESSION_BEST : CDataFileWriter::COMPRESSION_DEFAULT);
+		}
+		Writer.Finish(pFilename == aParallelFilename ? pEngine.get() : nullptr);
+	}
+
+	void *pSerial, *pParallel;
+	unsigned SerialSize, ParallelSize;
+	ASSERT_TRUE(pStorage->ReadFile(aSerialFilename, IStorage::TYPE_SAVE, &pSerial, &SerialSize));
+	ASSERT_TRUE(pStorage->ReadFile(aParallelFilename, IStorage::TYPE_SAVE, &pParallel, &ParallelSize));
+	ASSERT_EQ(SerialSize, ParallelSize);
+	EXPECT_EQ(mem_comp(pSerial, pParallel, SerialSize), 0);
+	free(pSerial);
+	free(pParallel);
+
+	for(bool MemoryMapped : {false, true})
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(pStorage.get(), aParallelFilename, IStorage::TYPE_ALL, MemoryMapped));
+		EXPECT_NE(Reader.GetData(3), nullptr);
+		Reader.PreloadData(pEngine.get());
+		for(int i = 0; i < (int)vvData.size(); i++)
+		{
+			ASSERT_EQ(Reader.GetDataSize(i), (int)(vvData[i].size() * sizeof(int)));
+			EXPECT_EQ(mem_comp(Reader.GetData(i), vvData[i].data(), Reader.GetDataSize(i)), 0);
+		}
+		Reader.Close();
+	}
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(aSerialFilename, IStorage::TYPE_SAVE);
+		pStorage->RemoveFile(aParallelFilename, IStorage::TYPE_SAVE);
+	}
+}
+
+TEST(Datafile, OpenMemory)
+{
+	std::unique_ptr<IStorage> pStorage = CreateLocalStorage();
+	ASSERT_NE(pStorage, nullptr) << "Error creating local storage";
+
+	CTestInfo Info;
+
+	{
+		CDataFileWriter Writer;
+		ASSERT_TRUE(Writer.Open(pStorage.get(), Info.m_aFilename));
+		int aItem[3] = {1, 2, 3};
+		Writer.AddItem(MAPITEMTYPE_TEST, 0, sizeof(aItem), aItem);
+		EXPECT_EQ(Writer.AddDataString("Abc"), 0);
+		EXPECT_EQ(Writer.AddDataString("DDNet"), 1);
+		Writer.Finish();
+	}
+
+	void *pContents;
+	unsigned ContentsSize;
+	ASSERT_TRUE(pStorage->ReadFile(Info.m_aFilename, IStorage::TYPE_SAVE, &pContents, &ContentsSize));
+	std::vector<char> vOriginal((char *)pContents, (char *)pContents + ContentsSize);
+
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL));
+		CDataFileReader MemoryReader;
+		ASSERT_TRUE(MemoryReader.OpenMemory(Info.m_aFilename, pContents, ContentsSize));
+
+		EXPECT_EQ(MemoryReader.File(), nullptr);
+		EXPECT_EQ(MemoryReader.Sha256(), Reader.Sha256());
+		EXPECT_EQ(MemoryReader.Crc(), Reader.Crc());
+		EXPECT_EQ(MemoryReader.MapSize(), Reader.MapSize());
+		ASSERT_EQ(MemoryReader.NumItems(), Reader.NumItems());
+		for(int i = 0; i < Reader.NumItems(); i++)
+		{
+			ASSERT_EQ(MemoryReader.GetItemSize(i), Reader.GetItemSize(i));
+			EXPECT_EQ(mem_comp(MemoryReader.GetItem(i), Reader.GetItem(i), Reader.GetItemSize(i)), 0);
+		}
+		EXPECT_STREQ(MemoryReader.GetDataString(0), "Abc");
+		EXPECT_STREQ(MemoryReader.GetDataString(1), "DDNet");
+
+		// data can be modified without affecting the contents
+		mem_copy(MemoryReader.GetData(1), "XXXXX", 5);
+		MemoryReader.Close();
+		Reader.Close();
+	}
+
+	EXPECT_EQ(mem_comp(pContents, vOriginal.data(), ContentsSize), 0);
+	free(pContents);
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
+
+TEST(Datafile, WriteMemory)
+{
+	std::unique_ptr<IStorage> pStorage = CreateLocalStorage();
+	ASSERT_NE(pStorage, nullptr) << "Error creating local storage";
+
+	CTestInfo Info;
+
+	void *pMemory = nullptr;
+	unsigned MemorySize = 0;
+	for(bool Memory : {false, true})
+	{
+		CDataFileWriter Writer;
+		if(Memory)
+			Writer.OpenMemory(&pMemory, &MemorySize);
+		else
+			ASSERT_TRUE(Writer.Open(pStorage.get(), Info.m_aFilename));
+		int aItem[3] = {1, 2, 3};
+		Writer.AddItem(MAPITEMTYPE_TEST, 0, sizeof(aItem), aItem);
+		Writer.AddDataString("Abc");
+		Writer.AddDataString("DDNet");
+		Writer.Finish();
+	}
+
+	// the same datafile as written to the file
+	void *pContents;
+	unsigned ContentsSize;
+	ASSERT_TRUE(pStorage->ReadFile(Info.m_aFilename, IStorage::TYPE_SAVE, &pContents, &ContentsSize));
+	ASSERT_NE(pMemory, nullptr);
+	ASSERT_EQ(MemorySize, ContentsSize);
+	EXPECT_EQ(mem_comp(pMemory, pContents, ContentsSize), 0);
+	free(pContents);
+
+	CDataFileReader Reader;
+	ASSERT_TRUE(Reader.OpenMemory("memory", pMemory, MemorySize));
+	EXPECT_STREQ(Reader.GetDataString(1), "DDNet");
+	Reader.Close();
+	free(pMemory);
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
@@ -16,7 +16,9 @@
 
 #include <generated/protocol.h>
 
+#include <game/collision.h>
 #include <game/server/entities/character.h>
+#include <game/server/entities/projectile.h>
 #include <game/server/gamecontext.h>
 #include <game/server/gamecontroller.h>
 #include <game/server/gameworld.h>
@@ -26,6 +28,7 @@
 #include <gtest/gtest.h>
 
 #include <memory>
+#include <random>
 #include <thread>
 
 bool IsInterrupted()
@@ -241,7 +244,7 @@ TEST_F(CTestGameWorld, IntersectEntity)
 
 	vec2 CloserToFromButTooFarFromLine = vec2(11, 11 + Radius + pChrLeft->GetProximityRadius());
 	pChrLeft->SetPosition(CloserToFromButTooFarFromLine);
-	pChrLeft->m_Pos = CloserToFromButTooFarFromLine;
+	pChrLeft->SetPos(CloserToFromButTooFarFromLine);
 
 	pIntersectedChar = (CCharacter *)GameServer()->m_World.IntersectEntity(
 		vec2(10, 10), // intersect from
@@ -310,3 +313,341 @@ TEST_F(CTestGameWorld, CharacterEmote)
 	pChr->Freeze(10);
 	ASSERT_EQ(pChr->DetermineEyeEmote(), EMOTE_ANGRY);
 }
+
+// reference implementations walking all entities of the type
+static int RefFindEntities(CGameWorld *pWorld, vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
+{
+	int Num = 0;
+	for(CEntity *pEnt = pWorld->FindFirst(Type); pEnt; pEnt = pEnt->TypeNext())
+	{
+		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->GetProximityRadius())
+		{
+			ppEnts[Num] = pEnt;
+			Num++;
+			if(Num == Max)
+				break;
+		}
+	}
+	return Num;
+}
+
+static CEntity *RefIntersectEntity(CGameWorld *pWorld, vec2 Pos0, vec2 Pos1, float Radius, int Type, vec2 &NewPos, const CEntity *pNotThis)
+{
+	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
+	CEntity *pClosest = nullptr;
+	for(CEntity *pEntity = pWorld->FindFirst(Type); pEntity; pEntity = pEntity->TypeNext())
+	{
+		if(pEntity == pNotThis)
+			continue;
+		vec2 IntersectPos;
+		if(closest_point_on_line(Pos0, Pos1, pEntity->m_Pos, IntersectPos))
+		{
+			float Len = distance(pEntity->m_Pos, IntersectPos);
+			if(Len < pEntity->GetProximityRadius() + Radius)
+			{
+				Len = distance(Pos0, IntersectPos);
+				if(Len < ClosestLen)
+				{
+					NewPos = IntersectPos;
+					ClosestLen = Len;
+					pClosest = pEntity;
+				}
+			}
+		}
+	}
+	return pClosest;
+}
+
+static CCharacter *RefClosestCharacter(CGameWorld *pWorld, vec2 Pos, float Radius, const CEntity *pNotThis)
+{
+	float ClosestRange = Radius * 2;
+	CCharacter *pClosest = nullptr;
+	for(CEntity *p = pWorld->FindFirst(CGameWorld::ENTTYPE_CHARACTER); p; p = p->TypeNext())
+	{
+		if(p == pNotThis)
+			continue;
+		float Len = distance(Pos, p->m_Pos);
+		if(Len < p->GetProximityRadius() + Radius && Len < ClosestRange)
+		{
+			ClosestRange = Len;
+			pClosest = (CCharacter *)p;
+		}
+	}
+	return pClosest;
+}
+
+static std::vector<CCharacter *> RefIntersectedCharacters(CGameWorld *pWorld, vec2 Pos0, vec2 Pos1, float Radius, const CEntity *pNotThis)
+{
+	std::vector<CCharacter *> vpCharacters;
+	for(CEntity *pChr = pWorld->FindFirst(CGameWorld::ENTTYPE_CHARACTER); pChr; pChr = pChr->TypeNext())
+	{
+		if(pChr == pNotThis)
+			continue;
+		vec2 IntersectPos;
+		if(closest_point_on_line(Pos0, Pos1, pChr->m_Pos, IntersectPos) && distance(pChr->m_Pos, IntersectPos) < pChr->GetProximityRadius() + Radius)
+			vpCharacters.push_back((CCharacter *)pChr);
+	}
+	return vpCharacters;
+}
+
+class CTestGameWorldCrowd : public CTestGameWorld
+{
+public:
+	static constexpr int NUM_CHARACTERS = 64;
+	std::mt19937 m_Rng{42};
+	vec2 m_MapSize;
+
+	// characters and `NumProjectiles` projectiles spread over the map
+	void Populate(int NumProjectiles)
+	{
+		m_MapSize = vec2(GameServer()->Collision()->GetWidth() * 32.0f, GameServer()->Collision()->GetHeight() * 32.0f);
+		for(int ClientId = 0; ClientId < NUM_CHARACTERS; ClientId++)
+		{
+			CPlayer *pPlayer = GameServer()->CreatePlayer(ClientId, TEAM_GAME, true, -1);
+			ASSERT_NE(pPlayer->ForceSpawn(RandomPos()), nullptr);
+		}
+		std::uniform_real_distribution<float> DistAngle(0.0f, 2 * pi);
+		for(int i = 0; i < NumProjectiles; i++)
+		{
+			const float Angle = DistAngle(m_Rng);
+			const vec2 Dir = direction(Angle);
+			new CProjectile(&GameServer()->m_World, WEAPON_GUN, i % NUM_CHARACTERS, RandomPos(), Dir, 10 * SERVER_TICK_SPEED, false, false, -1, Dir);
+		}
+	}
+
+	vec2 RandomPos()
+	{
+		// also cover positions a bit outside of the map
+		std::uniform_real_distribution<float> DistX(-500.0f, m_MapSize.x + 500.0f);
+		std::uniform_real_distribution<float> DistY(-500.0f, m_MapSize.y + 500.0f);
+		return vec2(DistX(m_Rng), DistY(m_Rng));
+	}
+
+	vec2 RandomLineEnd(vec2 Pos0)
+	{
+		std::uniform_real_distribution<float> DistAngle(0.0f, 2 * pi);
+		std::uniform_real_distribution<float> DistLength(0.0f, 1200.0f);
+		return Pos0 + direction(DistAngle(m_Rng)) * DistLength(m_Rng);
+	}
+
+	CCharacter *RandomCharacter()
+	{
+		std::uniform_int_distribution<int> DistId(-1, NUM_CHARACTERS - 1);
+		const int Id = DistId(m_Rng);
+		return Id < 0 ? nullptr : GameServer()->GetPlayerChar(Id);
+	}
+
+	void CheckQueries(int NumQueries)
+	{
+		CGameWorld *pWorld = &GameServer()->m_World;
+		std::uniform_real_distribution<float> DistRadius(0.0f, 600.0f);
+		std::uniform_int_distribution<int> DistMax(1, MAX_CLIENTS);
+		for(int i = 0; i < NumQueries; i++)
+		{
+			const vec2 Pos0 = RandomPos();
+			const vec2 Pos1 = RandomLineEnd(Pos0);
+			const float Radius = DistRadius(m_Rng);
+			const int Max = DistMax(m_Rng);
+			const CCharacter *pNotThis = RandomCharacter();
+
+			CEntity *apEnts[MAX_CLIENTS];
+			CEntity *apRefEnts[MAX_CLIENTS];
+			for(int Type : {(int)CGameWorld::ENTTYPE_CHARACTER, (int)CGameWorld::ENTTYPE_PROJECTILE})
+			{
+				const int Num = pWorld->FindEntities(Pos0, Radius, apEnts, Max, Type);
+				ASSERT_EQ(Num, RefFindEntities(pWorld, Pos0, Radius, apRefEnts, Max, Type));
+				for(int j = 0; j < Num; j++)
+					ASSERT_EQ(apEnts[j], apRefEnts[j]);
+			}
+
+			vec2 NewPos = vec2(0, 0);
+			vec2 RefNewPos = vec2(0, 0);
+			ASSERT_EQ(pWorld->IntersectEntity(Pos0, Pos1, Radius / 20.0f, CGameWorld::ENTTYPE_CHARACTER, NewPos, pNotThis), RefIntersectEntity(pWorld, Pos0, Pos1, Radius / 20.0f, CGameWorld::ENTTYPE_CHARACTER, RefNewPos, pNotThis));
+			ASSERT_EQ(NewPos, RefNewPos);
+			ASSERT_EQ(pWorld->ClosestCharacter(Pos0, Radius, pNotThis), RefClosestCharacter(pWorld, Pos0, Radius, pNotThis));
+			ASSERT_EQ(pWorld->IntersectedCharacters(Pos0, Pos1, Radius / 20.0f, pNotThis), RefIntersectedCharacters(pWorld, Pos0, Pos1, Radius / 20.0f, pNotThis));
+		}
+	}
+};
+
+TEST_F(CTestGameWorldCrowd, EntityQueriesMatchLinear)
+{
+	Populate(300);
+	CheckQueries(2000);
+
+	// positions changed by the simulation must be tracked
+	for(int Tick = 0; Tick < 50; Tick++)
+	{
+		GameServer()->OnTick();
+		CheckQueries(200);
+	}
+
+	// so must teleports and removed characters
+	for(int ClientId = 0; ClientId < NUM_CHARACTERS; ClientId += 2)
+	{
+		const vec2 Pos = RandomPos();
+		GameServer()->GetPlayerChar(ClientId)->SetPosition(Pos);
+		GameServer()->GetPlayerChar(ClientId)->SetPos(Pos);
+	}
+	for(int ClientId = 1; ClientId < NUM_CHARACTERS; ClientId += 4)
+		GameServer()->m_apPlayers[ClientId]->KillCharacter();
+	GameServer()->OnTick();
+	CheckQueries(2000);
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST_F(CTestGameWorldCrowd, DISABLED_EntityQueriesBenchmark)
+{
+	Populate(500);
+	CGameWorld *pWorld = &GameServer()->m_World;
+
+	const int NumQueries = 20000;
+	std::vector<vec2> vPositions;
+	std::vector<vec2> vLineEnds;
+	for(int i = 0; i < NumQueries; i++)
+	{
+		vPositions.push_back(RandomPos());
+		vLineEnds.push_back(RandomLineEnd(vPositions.back()));
+	}
+
+	// typical radii of explosions, hammer hits and weapon lines
+	int NumFound = 0;
+	std::chrono::nanoseconds Start = time_get_nanoseconds();
+	for(int i = 0; i < NumQueries; i++)
+	{
+		CEntity *apEnts[MAX_CLIENTS];
+		vec2 NewPos;
+		NumFound += pWorld->FindEntities(vPositions[i], 135.0f, apEnts, MAX_CLIENTS, CGameWorld::ENTTYPE_CHARACTER);
+		NumFound += pWorld->IntersectCharacter(vPositions[i], vLineEnds[i], 0.0f, NewPos) != nullptr;
+		NumFound += pWorld->ClosestCharacter(vPositions[i], 20.0f, nullptr) != nullptr;
+	}
+	const std::chrono::nanoseconds GridTime = time_get_nanoseconds() - Start;
+
+	int RefNumFound = 0;
+	Start = time_get_nanoseconds();
+	for(int i = 0; i < NumQueries; i++)
+	{
+		CEntity *apEnts[MAX_CLIENTS];
+		vec2 NewPos;
+		RefNumFound += RefFindEntities(pWorld, vPositions[i], 135.0f, apEnts, MAX_CLIENTS, CGameWorld::ENTTYPE_CHARACTER);
+		RefNumFound += RefIntersectEntity(pWorld, vPositions[i], vLineEnds[i], 0.0f, CGameWorld::ENTTYPE_CHARACTER, NewPos, nullptr) != nullptr;
+		RefNumFound += RefClosestCharacter(pWorld, vPositions[i], 20.0f, nullptr) != nullptr;
+	}
+	const std::chrono::nanoseconds LinearTime = time_get_nanoseconds() - Start;
+	EXPECT_EQ(NumFound, RefNumFound);
+
+	// whole ticks with all characters and projectiles querying the world
+	Start = time_get_nanoseconds();
+	for(int Tick = 0; Tick < 100; Tick++)
+		GameServer()->OnTick();
+	const std::chrono::nanoseconds TickTime = time_get_nanoseconds() - Start;
+
+	dbg_msg("gameworld_test", "%d queries x3, grid %.3fms, linear %.3fms, 100 ticks %.3fms",
+		NumQueries, GridTime.count() / 1e6, LinearTime.count() / 1e6, TickTime.count() / 1e6);
+}
+
+class CTestGameWorldTeams : public CTestGameWorldCrowd
+{
+public:
+	static constexpr int TEAM_SIZE = 4;
+
+	struct SState
+	{
+		bool m_Alive;
+		vec2 m_Pos;
+		vec2 m_Vel;
+		vec2 m_HookPos;
+		int m_HookState;
+	};
+
+	std::vector<vec2> m_vSpawnPositions;
+
+	// spawns the characters in teams of `TEAM_SIZE`, runs `NumTicks` ticks
+	// with random inputs and returns the states of all characters after
+	// every tick
+	std::vector<SState> Run(int NumTicks, int NumThreads)
+	{
+		GameServer()->Config()->m_SvWorldThreads = NumThreads;
+		CGameTeams &Teams = GameServer()->m_pController->Teams();
+		Teams.Reset();
+		for(int ClientId = 0; ClientId < NUM_CHARACTERS; ClientId++)
+		{
+			CPlayer *pPlayer = GameServer()->m_apPlayers[ClientId];
+			if(!pPlayer)
+				pPlayer = GameServer()->CreatePlayer(ClientId, TEAM_GAME, true, -1);
+			pPlayer->ForceSpawn(m_vSpawnPositions[ClientId]);
+			Teams.SetForceCharacterTeam(ClientId, ClientId / TEAM_SIZE + 1);
+		}
+
+		std::mt19937 InputRng(1337);
+		std::uniform_int_distribution<int> DistDirection(-1, 1);
+		std::uniform_int_distribution<int> DistBool(0, 1);
+		std::uniform_int_distribution<int> DistTarget(-300, 300);
+		std::vector<SState> vStates;
+		for(int Tick = 0; Tick < NumTicks; Tick++)
+		{
+			for(int ClientId = 0; ClientId < NUM_CHARACTERS; ClientId++)
+			{
+				CNetObj_PlayerInput Input = {};
+				Input.m_Direction = DistDirection(InputRng);
+				Input.m_Jump = DistBool(InputRng);
+				Input.m_Hook = DistBool(InputRng);
+				Input.m_TargetX = DistTarget(InputRng);
+				Input.m_TargetY = DistTarget(InputRng);
+				CCharacter *pChr = GameServer()->GetPlayerChar(ClientId);
+				if(pChr)
+				{
+					pChr->OnPredictedInput(&Input);
+					pChr->OnDirectInput(&Input);
+				}
+			}
+			GameServer()->OnTick();
+			for(int ClientId = 0; ClientId < NUM_CHARACTERS; ClientId++)
+			{
+				const CCharacter *pChr = GameServer()->GetPlayerChar(ClientId);
+				if(pChr)
+					vStates.push_back({true, pChr->Core()->m_Pos, pChr->Core()->m_Vel, pChr->Core()->m_HookPos, pChr->Core()->m_HookState});
+				else
+					vStates.push_back({false, vec2(0, 0), vec2(0, 0), vec2(0, 0), 0});
+			}
+		}
+
+		for(int ClientId = 0; ClientId < NUM_CHARACTERS; ClientId++)
+			GameServer()->m_apPlayers[ClientId]->KillCharacter(WEAPON_GAME, false);
+		GameServer()->OnTick();
+		return vStates;
+	}
+};
+
+TEST_F(CTestGameWorldTeams, ParallelTeamsMatchSerial)
+{
+	m_MapSize = vec2(GameServer()->Collision()->GetWidth() * 32.0f, GameServer()->Collision()->GetHeight() * 32.0f);
+	std::uniform_real_distribution<float> DistX(0.0f, m_MapSize.x);
+	std::uniform_real_distribution<float> DistY(0.0f, m_MapSize.y);
+	for(int ClientId = 0; ClientId < NUM_CHARACTERS; ClientId++)
+	{
+		// keep the members of a team close together so that they collide
+		if(ClientId % TEAM_SIZE == 0)
+			m_vSpawnPositions.emplace_back(DistX(m_Rng), DistY(m_Rng));
+		else
+			m_vSpawnPositions.push_back(m_vSpawnPositions.back() + vec2(20.0f, 0.0f));
+	}
+
+	// the first run creates the players, start both compared runs from
+	// players which just got killed
+	Run(1, 0);
+	const int NumTicks = 200;
+	const std::vector<SState> vSerial = Run(NumTicks, 0);
+	const std::vector<SState> vParallel = Run(NumTicks, 4);
+	ASSERT_EQ(vSerial.size(), vParallel.size());
+	for(size_t i = 0; i < vSerial.size(); i++)
+	{
+		SCOPED_TRACE(testing::Message() << "tick " << i / NUM_CHARACTERS << ", client " << i % NUM_CHARACTERS);
+		ASSERT_EQ(vSerial[i].m_Alive, vParallel[i].m_Alive);
+		ASSERT_EQ(vSerial[i].m_Pos, vParallel[i].m_Pos);
+		ASSERT_EQ(vSerial[i].m_Vel, vParallel[i].m_Vel);
+		ASSERT_EQ(vSerial[i].m_HookPos, vParallel[i].m_HookPos);
+		ASSERT_EQ(vSerial[i].m_HookState, vParallel[i].m_HookState);
+	}
+	GameServer()->Config()->m_SvWorldThreads = 0;
+}
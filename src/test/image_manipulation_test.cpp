@@ -0,0 +1,283 @@
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/gfx/image_manipulation.h>
+
+#include <game/prng.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <vector>
+
+// The previous per-pixel implementations, the optimized ones must match them exactly
+namespace Reference {
+
+static void Dilate(int w, int h, const uint8_t *pSrc, uint8_t *pDest)
+{
+	const int aDirX[] = {0, -1, 1, 0};
+	const int aDirY[] = {-1, 0, 0, 1};
+
+	int m = 0;
+	for(int y = 0; y < h; y++)
+	{
+		for(int x = 0; x < w; x++, m += 4)
+		{
+			for(int i = 0; i < 4; ++i)
+				pDest[m + i] = pSrc[m + i];
+			if(pSrc[m + 3] > 10)
+				continue;
+
+			for(int c = 0; c < 4; c++)
+			{
+				const int ClampedX = std::clamp(x + aDirX[c], 0, w - 1);
+				const int ClampedY = std::clamp(y + aDirY[c], 0, h - 1);
+				const int SrcIndex = ClampedY * w * 4 + ClampedX * 4;
+				if(pSrc[SrcIndex + 3] > 10)
+				{
+					for(int p = 0; p < 3; ++p)
+						pDest[m + p] = pSrc[SrcIndex + p];
+					pDest[m + 3] = 255;
+					break;
+				}
+			}
+		}
+	}
+}
+
+static void DilateImage(uint8_t *pImage, int w, int h)
+{
+	std::vector<uint8_t> vOriginal(pImage, pImage + (size_t)w * h * 4);
+	std::vector<uint8_t> vBuffer0(vOriginal.size());
+	std::vector<uint8_t> vBuffer1(vOriginal.size());
+
+	Dilate(w, h, vOriginal.data(), vBuffer0.data());
+	for(int i = 0; i < 5; i++)
+	{
+		Dilate(w, h, vBuffer0.data(), vBuffer1.data());
+		Dilate(w, h, vBuffer1.data(), vBuffer0.data());
+	}
+
+	for(int m = 0; m < w * h * 4; m += 4)
+		if(vOriginal[m + 3] == 0)
+			mem_copy(&vOriginal[m], &vBuffer0[m], 3);
+	mem_copy(pImage, vOriginal.data(), vOriginal.size());
+}
+
+static float CubicHermite(float A, float B, float C, float D, float t)
+{
+	float a = -A / 2.0f + (3.0f * B) / 2.0f - (3.0f * C) / 2.0f + D / 2.0f;
+	float b = A - (5.0f * B) / 2.0f + 2.0f * C - D / 2.0f;
+	float c = -A / 2.0f + C / 2.0f;
+	float d = B;
+
+	return (a * t * t * t) + (b * t * t) + (c * t) + d;
+}
+
+static void ResizeImage(const uint8_t *pSource, uint32_t SW, uint32_t SH, uint8_t *pDest, uint32_t W, uint32_t H, size_t BPP)
+{
+	for(int y = 0; y < (int)H; ++y)
+	{
+		float v = (float)y / (float)(H - 1);
+		for(int x = 0; x < (int)W; ++x)
+		{
+			float u = (float)x / (float)(W - 1);
+			float X = (u * SW) - 0.5f;
+			const int RoundedX = (int)X;
+			const float FractionX = X - std::floor(X);
+			float Y = (v * SH) - 0.5f;
+			const int RoundedY = (int)Y;
+			const float FractionY = Y - std::floor(Y);
+
+			uint8_t aaaSamples[4][4][4];
+			for(int sy = 0; sy < 4; ++sy)
+			{
+				for(int sx = 0; sx < 4; ++sx)
+				{
+					const int ClampedX = std::clamp<int>(RoundedX + sx - 1, 0, (int)SW - 1);
+					const int ClampedY = std::clamp<int>(RoundedY + sy - 1, 0, (int)SH - 1);
+					mem_copy(aaaSamples[sx][sy], &pSource[ClampedX * BPP + (SW * BPP * ClampedY)], BPP);
+				}
+			}
+
+			for(size_t i = 0; i < BPP; i++)
+			{
+				float aRows[4];
+				for(int sy = 0; sy < 4; ++sy)
+					aRows[sy] = CubicHermite(aaaSamples[0][sy][i], aaaSamples[1][sy][i], aaaSamples[2][sy][i], aaaSamples[3][sy][i], FractionX);
+				pDest[x * BPP + ((W * BPP) * y) + i] = (uint8_t)std::clamp<float>(CubicHermite(aRows[0], aRows[1], aRows[2], aRows[3], FractionY), 0.0f, 255.0f);
+			}
+		}
+	}
+}
+
+}
+
+class CImageManipulation : public ::testing::Test
+{
+protected:
+	CPrng m_Prng;
+
+	CImageManipulation()
+	{
+		uint64_t aSeed[2] = {1, 2};
+		m_Prng.Seed(aSeed);
+	}
+
+	// random colors with 1 in OpaqueRatio pixels opaque, like the sparse opaque areas of skins
+	std::vector<uint8_t> RandomImage(int Width, int Height, size_t BPP, int OpaqueRatio)
+	{
+		std::vector<uint8_t> vData((size_t)Width * Height * BPP);
+		for(size_t i = 0; i < vData.size(); i++)
+			vData[i] = m_Prng.RandomBits();
+		if(BPP == 4)
+			for(size_t i = 3; i < vData.size(); i += 4)
+				vData[i] = m_Prng.RandomBits() % OpaqueRatio == 0 ? 255 : m_Prng.RandomBits() % 11;
+		return vData;
+	}
+};
+
+TEST_F(CImageManipulation, Dilate)
+{
+	const int aaSizes[][2] = {{1, 1}, {1, 7}, {7, 1}, {3, 5}, {64, 64}, {256, 128}, {97, 31}};
+	for(const auto &aSize : aaSizes)
+	{
+		for(int OpaqueRatio : {1, 2, 50, 1000000})
+		{
+			std::vector<uint8_t> vImage = RandomImage(aSize[0], aSize[1], 4, OpaqueRatio);
+			std::vector<uint8_t> vExpected = vImage;
+			Reference::DilateImage(vExpected.data(), aSize[0], aSize[1]);
+			DilateImage(vImage.data(), aSize[0], aSize[1]);
+			EXPECT_EQ(vImage, vExpected) << aSize[0] << "x" << aSize[1] << " opaque 1/" << OpaqueRatio;
+		}
+	}
+}
+
+TEST_F(CImageManipulation, DilateSub)
+{
+	std::vector<uint8_t> vImage = RandomImage(128, 96, 4, 40);
+	std::vector<uint8_t> vExpected = vImage;
+
+	// dilating a sub image must not change the pixels around it
+	std::vector<uint8_t> vSub((size_t)40 * 30 * 4);
+	for(int y = 0; y < 30; y++)
+		mem_copy(&vSub[y * 40 * 4], &vExpected[((20 + y) * 128 + 10) * 4], 40 * 4);
+	Reference::DilateImage(vSub.data(), 40, 30);
+	for(int y = 0; y < 30; y++)
+		mem_copy(&vExpected[((20 + y) * 128 + 10) * 4], &vSub[y * 40 * 4], 40 * 4);
+
+	DilateImageSub(vImage.data(), 128, 96, 10, 20, 40, 30);
+	EXPECT_EQ(vImage, vExpected);
+}
+
+TEST_F(CImageManipulation, Resize)
+{
+	const int aaSizes[][4] = {{64, 64, 32, 32}, {64, 64, 128, 128}, {256, 128, 100, 37}, {5, 3, 17, 11}, {97, 31, 2, 2}};
+	for(const auto &aSize : aaSizes)
+	{
+		for(size_t BPP : {1, 3, 4})
+		{
+			std::vector<uint8_t> vImage = RandomImage(aSize[0], aSize[1], BPP, 3);
+			std::vector<uint8_t> vExpected((size_t)aSize[2] * aSize[3] * BPP);
+			Reference::ResizeImage(vImage.data(), aSize[0], aSize[1], vExpected.data(), aSize[2], aSize[3], BPP);
+			uint8_t *pResized = ResizeImage(vImage.data(), aSize[0], aSize[1], aSize[2], aSize[3], BPP);
+			EXPECT_EQ(std::vector<uint8_t>(pResized, pResized + vExpected.size()), vExpected) << aSize[0] << "x" << aSize[1] << " to " << aSize[2] << "x" << aSize[3] << " bpp " << BPP;
+			free(pResized);
+		}
+	}
+}
+
+TEST_F(CImageManipulation, ConvertToRgba)
+{
+	std::vector<uint8_t> vRgb = RandomImage(33, 17, 3, 1);
+	CImageInfo Image;
+	Image.m_Width = 33;
+	Image.m_Height = 17;
+	Image.m_Format = CImageInfo::FORMAT_RGB;
+	Image.m_pData = vRgb.data();
+	std::vector<uint8_t> vRgba(33 * 17 * 4);
+	EXPECT_FALSE(ConvertToRgba(vRgba.data(), Image));
+	for(size_t i = 0; i < 33 * 17; i++)
+	{
+		EXPECT_EQ(vRgba[i * 4 + 0], vRgb[i * 3 + 0]);
+		EXPECT_EQ(vRgba[i * 4 + 1], vRgb[i * 3 + 1]);
+		EXPECT_EQ(vRgba[i * 4 + 2], vRgb[i * 3 + 2]);
+		EXPECT_EQ(vRgba[i * 4 + 3], 255);
+	}
+
+	std::vector<uint8_t> vRa = RandomImage(33, 17, 2, 1);
+	Image.m_Format = CImageInfo::FORMAT_RA;
+	Image.m_pData = vRa.data();
+	EXPECT_FALSE(ConvertToRgba(vRgba.data(), Image));
+	for(size_t i = 0; i < 33 * 17; i++)
+	{
+		EXPECT_EQ(vRgba[i * 4 + 0], vRa[i * 2]);
+		EXPECT_EQ(vRgba[i * 4 + 1], vRa[i * 2]);
+		EXPECT_EQ(vRgba[i * 4 + 2], vRa[i * 2]);
+		EXPECT_EQ(vRgba[i * 4 + 3], vRa[i * 2 + 1]);
+	}
+
+	std::vector<uint8_t> vR = RandomImage(33, 17, 1, 1);
+	Image.m_Format = CImageInfo::FORMAT_R;
+	Image.m_pData = vR.data();
+	EXPECT_FALSE(ConvertToRgba(vRgba.data(), Image));
+	for(size_t i = 0; i < 33 * 17; i++)
+	{
+		EXPECT_EQ(vRgba[i * 4 + 0], 255);
+		EXPECT_EQ(vRgba[i * 4 + 1], 255);
+		EXPECT_EQ(vRgba[i * 4 + 2], 255);
+		EXPECT_EQ(vRgba[i * 4 + 3], vR[i]);
+	}
+}
+
+TEST_F(CImageManipulation, ConvertToGrayscale)
+{
+	std::vector<uint8_t> vRgba = RandomImage(33, 17, 4, 1);
+	std::vector<uint8_t> vExpected = vRgba;
+	for(size_t i = 0; i < vExpected.size(); i += 4)
+	{
+		const uint8_t Luma = (uint8_t)(0.2126f * vExpected[i] + 0.7152f * vExpected[i + 1] + 0.0722f * vExpected[i + 2]);
+		vExpected[i] = vExpected[i + 1] = vExpected[i + 2] = Luma;
+	}
+
+	CImageInfo Image;
+	Image.m_Width = 33;
+	Image.m_Height = 17;
+	Image.m_Format = CImageInfo::FORMAT_RGBA;
+	Image.m_pData = vRgba.data();
+	ConvertToGrayscale(Image);
+	EXPECT_EQ(vRgba, vExpected);
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST_F(CImageManipulation, DISABLED_Benchmark)
+{
+	// a skin sized and a map image sized texture
+	const int aaSizes[][2] = {{256, 128}, {1024, 1024}};
+	for(const auto &aSize : aaSizes)
+	{
+		const std::vector<uint8_t> vImage = RandomImage(aSize[0], aSize[1], 4, 20);
+
+		std::vector<uint8_t> vDilated = vImage;
+		std::chrono::nanoseconds Start = time_get_nanoseconds();
+		Reference::DilateImage(vDilated.data(), aSize[0], aSize[1]);
+		const std::chrono::nanoseconds ReferenceDilateTime = time_get_nanoseconds() - Start;
+
+		vDilated = vImage;
+		Start = time_get_nanoseconds();
+		DilateImage(vDilated.data(), aSize[0], aSize[1]);
+		const std::chrono::nanoseconds DilateTime = time_get_nanoseconds() - Start;
+
+		std::vector<uint8_t> vResized((size_t)aSize[0] / 2 * aSize[1] / 2 * 4);
+		Start = time_get_nanoseconds();
+		Reference::ResizeImage(vImage.data(), aSize[0], aSize[1], vResized.data(), aSize[0] / 2, aSize[1] / 2, 4);
+		const std::chrono::nanoseconds ReferenceResizeTime = time_get_nanoseconds() - Start;
+
+		Start = time_get_nanoseconds();
+		free(ResizeImage(vImage.data(), aSize[0], aSize[1], aSize[0] / 2, aSize[1] / 2, 4));
+		const std::chrono::nanoseconds ResizeTime = time_get_nanoseconds() - Start;
+
+		dbg_msg("image_manipulation_test", "%dx%d: dilate %.3fms, reference %.3fms, resize %.3fms, reference %.3fms",
+			aSize[0], aSize[1], DilateTime.count() / 1e6, ReferenceDilateTime.count() / 1e6, ResizeTime.count() / 1e6, ReferenceResizeTime.count() / 1e6);
+	}
+}
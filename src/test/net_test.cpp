@@ -52,3 +52,119 @@ TEST(Net, Ipv4AndIpv6Work)
 	net_udp_close(Socket1);
 	net_udp_close(Socket2);
 }
+
+TEST(Net, SendBatching)
+{
+	NETADDR Bindaddr = {};
+	NETSOCKET Socket1;
+	NETSOCKET Socket2;
+
+	Bindaddr.type = NETTYPE_IPV4;
+	Socket2 = net_udp_create(Bindaddr);
+	do
+	{
+		Bindaddr.port = secure_rand() % 64511 + 1024;
+	} while(!(Socket1 = net_udp_create(Bindaddr)));
+
+	NETADDR Target;
+	ASSERT_FALSE(net_addr_from_str(&Target, "127.0.0.1"));
+	Target.port = Bindaddr.port;
+
+	// more packets than fit into one batch
+	static const int NUM_PACKETS = 100;
+	net_udp_set_send_batching(Socket2, true);
+	NETSTATS StatsBefore;
+	net_stats(&StatsBefore);
+	for(int i = 0; i < NUM_PACKETS; i++)
+	{
+		EXPECT_EQ(net_udp_send(Socket2, &Target, &i, sizeof(i)), (int)sizeof(i));
+	}
+	const int Flushed = net_udp_flush(Socket2);
+	NETSTATS StatsAfter;
+	net_stats(&StatsAfter);
+	EXPECT_EQ(StatsAfter.sent_packets - StatsBefore.sent_packets, (uint64_t)NUM_PACKETS);
+#if defined(CONF_PLATFORM_LINUX)
+	EXPECT_GT(Flushed, 0);
+	EXPECT_LT(StatsAfter.send_syscalls - StatsBefore.send_syscalls, (uint64_t)NUM_PACKETS);
+#else
+	EXPECT_EQ(Flushed, 0);
+#endif
+	EXPECT_EQ(net_udp_flush(Socket2), 0);
+
+	// packets arrive in the order they were sent
+	for(int i = 0; i < NUM_PACKETS; i++)
+	{
+		NETADDR Addr;
+		unsigned char *pData;
+		int Bytes;
+		while((Bytes = net_udp_recv(Socket1, &Addr, &pData)) <= 0)
+		{
+			ASSERT_EQ(net_socket_read_wait(Socket1, 10s), 1);
+		}
+		ASSERT_EQ(Bytes, (int)sizeof(i));
+		EXPECT_EQ(mem_comp(pData, &i, sizeof(i)), 0);
+	}
+
+	net_udp_close(Socket1);
+	net_udp_close(Socket2);
+}
+
+TEST(Net, Reactor)
+{
+	NETADDR Bindaddr = {};
+	NETSOCKET Socket1;
+	NETSOCKET Socket2;
+
+	Bindaddr.type = NETTYPE_IPV4;
+	Socket2 = net_udp_create(Bindaddr);
+	do
+	{
+		Bindaddr.port = secure_rand() % 64511 + 1024;
+	} while(!(Socket1 = net_udp_create(Bindaddr)));
+
+	NETADDR Target;
+	ASSERT_FALSE(net_addr_from_str(&Target, "127.0.0.1"));
+	Target.port = Bindaddr.port;
+
+	NETADDR Addr;
+	unsigned char *pData;
+	NETREACTOR Reactor = net_reactor_create();
+
+	// waits until the deadline if nothing is received
+	const std::chrono::nanoseconds Start = time_get_nanoseconds();
+	net_reactor_add(Reactor, Socket1);
+	EXPECT_EQ(net_reactor_wait(Reactor, Start + 20ms), 0);
+	EXPECT_GE(time_get_nanoseconds(), Start + 20ms);
+
+	// only polls if the deadline has passed
+	net_reactor_add(Reactor, Socket1);
+	EXPECT_EQ(net_reactor_wait(Reactor, time_get_nanoseconds() - 1ms), 0);
+
+	// wakes up for received data
+	EXPECT_EQ(net_udp_send(Socket2, &Target, "abc", 3), 3);
+	net_reactor_add(Reactor, Socket2);
+	net_reactor_add(Reactor, Socket1);
+	EXPECT_EQ(net_reactor_wait(Reactor, time_get_nanoseconds() + 10s), 1);
+	EXPECT_EQ(net_udp_recv(Socket1, &Addr, &pData), 3);
+
+	// sockets that are not added again are not waited on
+	EXPECT_EQ(net_udp_send(Socket1, &Target, "def", 3), 3);
+	net_reactor_add(Reactor, Socket2);
+	EXPECT_EQ(net_reactor_wait(Reactor, time_get_nanoseconds() + 20ms), 0);
+	net_reactor_add(Reactor, Socket1);
+	EXPECT_EQ(net_reactor_wait(Reactor, time_get_nanoseconds() + 10s), 1);
+	EXPECT_EQ(net_udp_recv(Socket1, &Addr, &pData), 3);
+
+	// a socket reusing the file descriptor of a closed one is waited on
+	net_udp_close(Socket1);
+	Socket1 = net_udp_create(Bindaddr);
+	ASSERT_TRUE(Socket1);
+	EXPECT_EQ(net_udp_send(Socket2, &Target, "ghi", 3), 3);
+	net_reactor_add(Reactor, Socket1);
+	EXPECT_EQ(net_reactor_wait(Reactor, time_get_nanoseconds() + 10s), 1);
+	EXPECT_EQ(net_udp_recv(Socket1, &Addr, &pData), 3);
+
+	net_reactor_destroy(Reactor);
+	net_udp_close(Socket1);
+	net_udp_close(Socket2);
+}
@@ -1,15 +1,21 @@
+#include "test.h"
+
 #include <base/detect.h>
 
 #include <engine/server/databases/connection.h>
 #include <engine/server/databases/connection_pool.h>
 #include <engine/shared/config.h>
 
+#include <game/server/scorecache.h>
 #include <game/server/scoreworker.h>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <sqlite3.h>
 
+#include <chrono>
+#include <thread>
+
 #if defined(CONF_TEST_MYSQL)
 int DummyMysqlInit = (MysqlInit(), 1);
 #endif
@@ -74,7 +80,7 @@ struct Score : public testing::TestWithParam<IDbConnection *>
 		ASSERT_EQ(NumInserted, 1);
 	}
 
-	void InsertRank(float Time = 100.0, bool WithTimeCheckPoints = false)
+	void InsertRank(float Time = 100.0, bool WithTimeCheckPoints = false, std::shared_ptr<CScoreCache> pCache = nullptr)
 	{
 		str_copy(g_Config.m_SvSqlServerName, "USA", sizeof(g_Config.m_SvSqlServerName));
 		CSqlScoreData ScoreData(std::make_shared<CScorePlayerResult>());
@@ -87,7 +93,9 @@ struct Score : public testing::TestWithParam<IDbConnection *>
 		for(int i = 0; i < NUM_CHECKPOINTS; i++)
 			ScoreData.m_aCurrentTimeCp[i] = WithTimeCheckPoints ? i : 0;
 		str_copy(ScoreData.m_aRequestingPlayer, "deen", sizeof(ScoreData.m_aRequestingPlayer));
+		ScoreData.m_pCache = std::move(pCache);
 		ASSERT_TRUE(CScoreWorker::SaveScore(m_pConn, &ScoreData, Write::NORMAL, m_aError, sizeof(m_aError))) << m_aError;
+		ScoreData.OnCommitted();
 	}
 
 	void ExpectLines(const std::shared_ptr<CScorePlayerResult> &pPlayerResult, std::initializer_list<const char *> Lines, bool All = false)
@@ -199,6 +207,45 @@ TEST_P(SingleScore, RankServer)
 	ExpectLines(m_pPlayerResult, {"nameless tee - 01:40.00 - better than 100% - requested by brainless tee", "Global rank 1"}, true);
 }
 
+TEST_P(SingleScore, CachedTop)
+{
+	g_Config.m_SvRegionalRankings = false;
+	auto pCache = std::make_shared<CScoreCache>();
+	CSqlCachedPlayerRequest Request(m_pPlayerResult);
+	str_copy(Request.m_aMap, m_PlayerRequest.m_aMap);
+	str_copy(Request.m_aRequestingPlayer, m_PlayerRequest.m_aRequestingPlayer);
+	Request.m_Offset = 0;
+	str_copy(Request.m_aServer, m_PlayerRequest.m_aServer);
+	str_copy(Request.m_aName, "");
+	Request.m_pfnQuery = CScoreWorker::ShowTop;
+	Request.m_pCache = pCache;
+	Request.m_Key = "show top5";
+	str_copy(Request.m_aCacheMap, "Kobra 3");
+
+	auto pCachedResult = std::make_shared<CScorePlayerResult>();
+	ASSERT_FALSE(pCache->Find("show top5", 1000000000, pCachedResult.get(), &Request.m_Generation));
+	ASSERT_TRUE(CScoreCache::Query(m_pConn, &Request, m_aError, sizeof(m_aError))) << m_aError;
+	ASSERT_TRUE(pCache->Find("show top5", 1000000000, pCachedResult.get(), &Request.m_Generation));
+	ExpectLines(pCachedResult,
+		{"------------ Global Top ------------",
+			"1. nameless tee Time: 01:40.00",
+			"-----------------------------------------"});
+	EXPECT_FALSE(pCache->Find("show top5", -1, pCachedResult.get(), &Request.m_Generation));
+
+	// a finish on another map keeps the entry
+	pCache->Invalidate("Kobra 4");
+	ASSERT_TRUE(pCache->Find("show top5", 1000000000, pCachedResult.get(), &Request.m_Generation));
+	InsertRank(90.0, false, pCache);
+	ASSERT_FALSE(pCache->Find("show top5", 1000000000, pCachedResult.get(), &Request.m_Generation));
+
+	// a query that started before the finish doesn't add its result
+	pCache->Invalidate("Kobra 3");
+	ASSERT_TRUE(CScoreCache::Query(m_pConn, &Request, m_aError, sizeof(m_aError))) << m_aError;
+	EXPECT_FALSE(pCache->Find("show top5", 1000000000, pCachedResult.get(), &Request.m_Generation));
+	EXPECT_EQ(pCache->Hits(), 2u);
+	EXPECT_EQ(pCache->Misses(), 4u);
+}
+
 TEST_P(SingleScore, LoadPlayerData)
 {
 	InsertRank(120.0, true);
@@ -663,3 +710,214 @@ INSTANTIATE(MapInfo);
 INSTANTIATE(MapVote);
 INSTANTIATE(Points);
 INSTANTIATE(RandomMap);
+
+static std::atomic_bool gs_ReleaseSlowRead{false};
+
+TEST(ConnectionPool, SlowReadDoesntBlock)
+{
+	CTestInfo Info;
+	char aFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aFilename, sizeof(aFilename), ".sqlite");
+
+	CDbConnectionPool::FRead SlowRead = [](IDbConnection *, const ISqlData *, char *, int) {
+		while(!gs_ReleaseSlowRead.load())
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		return true;
+	};
+	CDbConnectionPool::FRead Read = [](IDbConnection *, const ISqlData *, char *, int) { return true; };
+	CDbConnectionPool::FWrite WriteFunc = [](IDbConnection *, const ISqlData *, Write, char *, int) { return true; };
+
+	std::vector<std::shared_ptr<ISqlResult>> vpResults;
+	for(int i = 0; i < 3; i++)
+		vpResults.push_back(std::make_shared<ISqlResult>());
+	const int OldReadWorkers = g_Config.m_SvSqlReadWorkers;
+	g_Config.m_SvSqlReadWorkers = 2;
+	{
+		CDbConnectionPool Pool;
+		Pool.RegisterSqliteDatabase(CDbConnectionPool::READ, aFilename);
+		Pool.RegisterSqliteDatabase(CDbConnectionPool::WRITE, aFilename);
+		Pool.Execute(SlowRead, std::make_unique<ISqlData>(vpResults[0]), "slow read");
+		Pool.ExecuteWrite(WriteFunc, std::make_unique<ISqlData>(vpResults[1]), "write");
+		Pool.Execute(Read, std::make_unique<ISqlData>(vpResults[2]), "read");
+
+		// the write and the second read don't wait for the slow read
+		for(int i = 0; i < 5000 && !(vpResults[1]->m_Completed && vpResults[2]->m_Completed); i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		EXPECT_TRUE(vpResults[1]->m_Completed);
+		EXPECT_TRUE(vpResults[1]->m_Success);
+		EXPECT_TRUE(vpResults[2]->m_Completed);
+		EXPECT_TRUE(vpResults[2]->m_Success);
+		EXPECT_FALSE(vpResults[0]->m_Completed);
+
+		gs_ReleaseSlowRead.store(true);
+		Pool.OnShutdown();
+		EXPECT_TRUE(vpResults[0]->m_Completed);
+		EXPECT_TRUE(vpResults[0]->m_Success);
+	}
+	g_Config.m_SvSqlReadWorkers = OldReadWorkers;
+
+	if(!HasFailure())
+	{
+		fs_remove(aFilename);
+		fs_remove((std::string(aFilename) + "-wal").c_str());
+		fs_remove((std::string(aFilename) + "-shm").c_str());
+	}
+}
+
+TEST(ConnectionPool, ReadAfterWrite)
+{
+	CTestInfo Info;
+	char aFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aFilename, sizeof(aFilename), ".sqlite");
+
+	CDbConnectionPool::FWrite SlowWrite = [](IDbConnection *pSqlServer, const ISqlData *, Write, char *pError, int ErrorSize) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		return pSqlServer->AddPoints("a", 1, pError, ErrorSize);
+	};
+	// succeeds only if the write is visible
+	CDbConnectionPool::FRead Read = [](IDbConnection *pSqlServer, const ISqlData *, char *pError, int ErrorSize) {
+		if(!pSqlServer->PrepareStatement("SELECT Points FROM record_points WHERE Name = 'a'", pError, ErrorSize))
+			return false;
+		bool End;
+		return pSqlServer->Step(&End, pError, ErrorSize) && !End;
+	};
+
+	auto pWriteResult = std::make_shared<ISqlResult>();
+	auto pReadResult = std::make_shared<ISqlResult>();
+	{
+		CDbConnectionPool Pool;
+		Pool.RegisterSqliteDatabase(CDbConnectionPool::READ, aFilename);
+		Pool.RegisterSqliteDatabase(CDbConnectionPool::WRITE, aFilename);
+		Pool.ExecuteWrite(SlowWrite, std::make_unique<ISqlData>(pWriteResult), "slow write");
+		Pool.Execute(Read, std::make_unique<ISqlData>(pReadResult), "read");
+		// reads are dismissed during shutdown, wait for the read itself
+		for(int i = 0; i < 5000 && !pReadResult->m_Completed; i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		Pool.OnShutdown();
+	}
+	EXPECT_TRUE(pWriteResult->m_Success);
+	EXPECT_TRUE(pReadResult->m_Completed);
+	EXPECT_TRUE(pReadResult->m_Success);
+
+	if(!HasFailure())
+	{
+		fs_remove(aFilename);
+		fs_remove((std::string(aFilename) + "-wal").c_str());
+		fs_remove((std::string(aFilename) + "-shm").c_str());
+	}
+}
+
+struct CBatchTestData : ISqlData
+{
+	CBatchTestData(std::shared_ptr<ISqlResult> pResult, const char *pName, std::atomic_int *pNumCommitted) :
+		ISqlData(std::move(pResult)), m_pNumCommitted(pNumCommitted)
+	{
+		str_copy(m_aName, pName);
+	}
+	void OnCommitted() const override { (*m_pNumCommitted)++; }
+
+	char m_aName[MAX_NAME_LENGTH];
+	std::atomic_int *m_pNumCommitted;
+};
+
+// adds a point for the name, fails after writing it for "fail"
+static bool BatchTestWrite(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
+{
+	const auto *pData = dynamic_cast<const CBatchTestData *>(pGameData);
+	if(!pSqlServer->AddPoints(pData->m_aName, 1, pError, ErrorSize))
+		return false;
+	return str_comp(pData->m_aName, "fail") != 0;
+}
+
+TEST(ConnectionPool, SingleFailedWrite)
+{
+	CTestInfo Info;
+	char aFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aFilename, sizeof(aFilename), ".sqlite");
+
+	std::atomic_int NumCommitted{0};
+	auto pResult = std::make_shared<ISqlResult>();
+	{
+		CDbConnectionPool Pool;
+		Pool.RegisterSqliteDatabase(CDbConnectionPool::WRITE, aFilename);
+		Pool.ExecuteWrite(BatchTestWrite, std::make_unique<CBatchTestData>(pResult, "fail", &NumCommitted), "single write");
+		Pool.OnShutdown();
+	}
+	EXPECT_TRUE(pResult->m_Completed);
+	EXPECT_FALSE(pResult->m_Success);
+	EXPECT_EQ(NumCommitted, 0);
+
+	// a write that is alone in its transaction is rolled back as well
+	auto pConn = CreateSqliteConnection(aFilename, true);
+	char aError[256] = {};
+	ASSERT_TRUE(pConn->Connect(aError, sizeof(aError))) << aError;
+	ASSERT_TRUE(pConn->PrepareStatement("SELECT Name FROM record_points", aError, sizeof(aError))) << aError;
+	bool End;
+	ASSERT_TRUE(pConn->Step(&End, aError, sizeof(aError))) << aError;
+	EXPECT_TRUE(End);
+	pConn->Disconnect();
+
+	if(!HasFailure())
+	{
+		fs_remove(aFilename);
+		fs_remove((std::string(aFilename) + "-wal").c_str());
+		fs_remove((std::string(aFilename) + "-shm").c_str());
+	}
+}
+
+TEST(ConnectionPool, BatchedWrites)
+{
+	CTestInfo Info;
+	char aFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aFilename, sizeof(aFilename), ".sqlite");
+
+	std::atomic_int NumCommitted{0};
+	const char *apNames[] = {"a", "b", "fail", "c", "b"};
+	std::vector<std::shared_ptr<ISqlResult>> vpResults;
+	const int OldWindow = g_Config.m_SvSqlWriteBatchWindow;
+	g_Config.m_SvSqlWriteBatchWindow = 200;
+	{
+		CDbConnectionPool Pool;
+		Pool.RegisterSqliteDatabase(CDbConnectionPool::WRITE, aFilename);
+		for(const char *pName : apNames)
+		{
+			vpResults.push_back(std::make_shared<ISqlResult>());
+			Pool.ExecuteWrite(BatchTestWrite, std::make_unique<CBatchTestData>(vpResults.back(), pName, &NumCommitted), "batch write");
+		}
+		// how the writes are grouped into transactions depends on when the
+		// worker picks them up, the results must be the same either way.
+		// OnShutdown returns once all of them are processed.
+		Pool.OnShutdown();
+	}
+	g_Config.m_SvSqlWriteBatchWindow = OldWindow;
+
+	for(int i = 0; i < (int)vpResults.size(); i++)
+	{
+		EXPECT_TRUE(vpResults[i]->m_Completed);
+		EXPECT_EQ(vpResults[i]->m_Success, str_comp(apNames[i], "fail") != 0) << apNames[i];
+	}
+	EXPECT_EQ(NumCommitted, 4);
+
+	// the point of the failed write got rolled back with its savepoint
+	auto pConn = CreateSqliteConnection(aFilename, true);
+	char aError[256] = {};
+	ASSERT_TRUE(pConn->Connect(aError, sizeof(aError))) << aError;
+	ASSERT_TRUE(pConn->PrepareStatement("SELECT Name, Points FROM record_points ORDER BY Name", aError, sizeof(aError))) << aError;
+	std::vector<std::pair<std::string, int>> vPoints;
+	bool End;
+	while(pConn->Step(&End, aError, sizeof(aError)) && !End)
+	{
+		char aName[MAX_NAME_LENGTH];
+		pConn->GetString(1, aName, sizeof(aName));
+		vPoints.emplace_back(aName, pConn->GetInt(2));
+	}
+	pConn->Disconnect();
+	EXPECT_THAT(vPoints, testing::ElementsAre(std::pair<std::string, int>("a", 1), std::pair<std::string, int>("b", 2), std::pair<std::string, int>("c", 1)));
+
+	if(!HasFailure())
+	{
+		fs_remove(aFilename);
+		fs_remove((std::string(aFilename) + "-wal").c_str());
+		fs_remove((std::string(aFilename) + "-shm").c_str());
+	}
+}
@@ -1,7 +1,13 @@
 #include <engine/server/server.h>
+#include <engine/server/snapshot_delta_cache.h>
+#include <engine/server/snapshot_workers.h>
+
+#include <game/prng.h>
 
 #include <gtest/gtest.h>
 
+#include <memory>
+
 TEST(Server, StrHideIps)
 {
 	char aLine[512];
@@ -59,3 +65,111 @@ TEST(Server, StrHideIps)
 	EXPECT_STREQ(aLine, "<{<{a}>}>");
 	EXPECT_STREQ(aLineWithoutIps, "XXX}>}>");
 }
+
+static int BuildTestSnapshot(CPrng *pPrng, int ClientId, int Tick, CSnapshot *pSnapshot)
+{
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	for(int Id = 0; Id < 64; Id++)
+	{
+		// let some characters disappear and reappear
+		if((Id + Tick) % 7 == ClientId % 7)
+			continue;
+		CNetObj_Character *pCharacter = static_cast<CNetObj_Character *>(Builder.NewItem(NETOBJTYPE_CHARACTER, Id, sizeof(CNetObj_Character)));
+		pCharacter->m_Tick = Tick;
+		pCharacter->m_X = Id * 32 + Tick;
+		pCharacter->m_Y = ClientId * 32;
+		pCharacter->m_VelX = pPrng->RandomBits() % 4 == 0 ? pPrng->RandomBits() : 0;
+	}
+	CNetEvent_Explosion *pExplosion = static_cast<CNetEvent_Explosion *>(Builder.NewItem(NETEVENTTYPE_EXPLOSION, Tick % 16, sizeof(CNetEvent_Explosion)));
+	pExplosion->m_X = pPrng->RandomBits();
+	return Builder.Finish(pSnapshot);
+}
+
+TEST(Server, SnapshotWorkersAndDeltaCacheMatchSerialEncoding)
+{
+	static const int NUM_CLIENTS = 16;
+	static const int TICK_SPEED = 50;
+
+	CSnapshotDelta SerialDelta;
+	SerialDelta.SetStaticsize(NETOBJTYPE_CHARACTER, sizeof(CNetObj_Character));
+	CSnapshotWorkers Workers;
+	Workers.Init(4, SerialDelta);
+	CSnapshotDeltaCache DeltaCache;
+	CSnapshotDeltaCache SerialDeltaCache;
+	SerialDelta.SetStaticsize(NETEVENTTYPE_EXPLOSION, sizeof(CNetEvent_Explosion));
+	Workers.SetStaticsize(NETEVENTTYPE_EXPLOSION, sizeof(CNetEvent_Explosion));
+
+	std::vector<std::unique_ptr<CServer::CClient>> vpSerialClients;
+	std::vector<std::unique_ptr<CServer::CClient>> vpParallelClients;
+	std::vector<std::unique_ptr<CServer::CClient>> vpCachedClients;
+	for(int i = 0; i < NUM_CLIENTS; i++)
+	{
+		for(auto *pvpClients : {&vpSerialClients, &vpParallelClients, &vpCachedClients})
+		{
+			pvpClients->push_back(std::make_unique<CServer::CClient>());
+			pvpClients->back()->Reset();
+			pvpClients->back()->m_Sixup = i % 3 == 0;
+			pvpClients->back()->m_SnapRate = CServer::CClient::SNAPRATE_FULL;
+		}
+	}
+
+	uint64_t aSeed[2] = {0x0123456789abcdef, 0xfedcba9876543210};
+	CPrng Prng;
+	Prng.Seed(aSeed);
+
+	std::vector<std::unique_ptr<char[]>> vpSnapshots;
+	std::vector<int> vSnapshotSizes(NUM_CLIENTS);
+	for(int i = 0; i < NUM_CLIENTS; i++)
+		vpSnapshots.push_back(std::make_unique<char[]>(CSnapshot::MAX_SIZE));
+	auto pSerialPacket = std::make_unique<CSnapshotPacket>();
+	std::vector<std::unique_ptr<CSnapshotPacket>> vpParallelPackets;
+	for(int i = 0; i < NUM_CLIENTS; i++)
+		vpParallelPackets.push_back(std::make_unique<CSnapshotPacket>());
+
+	for(int Tick = 1; Tick <= 4 * TICK_SPEED; Tick++)
+	{
+		for(int i = 0; i < NUM_CLIENTS; i++)
+		{
+			// pairs of clients see the same, like spectators of the same player
+			if(i % 2 == 0)
+				vSnapshotSizes[i] = BuildTestSnapshot(&Prng, i, Tick, (CSnapshot *)vpSnapshots[i].get());
+			else
+			{
+				vSnapshotSizes[i] = vSnapshotSizes[i - 1];
+				mem_copy(vpSnapshots[i].get(), vpSnapshots[i - 1].get(), vSnapshotSizes[i]);
+			}
+
+			// clients acknowledge with different latencies, some never
+			const int AckedTick = i == NUM_CLIENTS - 1 ? -1 : Tick - 1 - (i / 2 + Tick / 10) % 5;
+			vpSerialClients[i]->m_LastAckedSnapshot = AckedTick;
+			vpParallelClients[i]->m_LastAckedSnapshot = AckedTick;
+			vpCachedClients[i]->m_LastAckedSnapshot = AckedTick;
+		}
+
+		DeltaCache.Clear();
+		SerialDeltaCache.Clear();
+		Workers.Run(NUM_CLIENTS, [&](int Task, CSnapshotDelta *pDelta) {
+			CServer::EncodeClientSnapshot(vpParallelClients[Task].get(), Tick, TICK_SPEED, (const CSnapshot *)vpSnapshots[Task].get(), vSnapshotSizes[Task], pDelta, &DeltaCache, vpParallelPackets[Task].get());
+		});
+
+		for(int i = 0; i < NUM_CLIENTS; i++)
+		{
+			CServer::EncodeClientSnapshot(vpSerialClients[i].get(), Tick, TICK_SPEED, (const CSnapshot *)vpSnapshots[i].get(), vSnapshotSizes[i], &SerialDelta, nullptr, pSerialPacket.get());
+			const CSnapshotPacket *pParallelPacket = vpParallelPackets[i].get();
+			ASSERT_EQ(pSerialPacket->m_Crc, pParallelPacket->m_Crc);
+			ASSERT_EQ(pSerialPacket->m_DeltaTick, pParallelPacket->m_DeltaTick);
+			ASSERT_EQ(pSerialPacket->m_DataSize, pParallelPacket->m_DataSize);
+			ASSERT_EQ(mem_comp(pSerialPacket->m_aData, pParallelPacket->m_aData, pSerialPacket->m_DataSize), 0);
+			ASSERT_EQ(vpSerialClients[i]->m_SnapRate, vpParallelClients[i]->m_SnapRate);
+
+			CServer::EncodeClientSnapshot(vpCachedClients[i].get(), Tick, TICK_SPEED, (const CSnapshot *)vpSnapshots[i].get(), vSnapshotSizes[i], &SerialDelta, &SerialDeltaCache, vpParallelPackets[i].get());
+			ASSERT_EQ(pSerialPacket->m_DataSize, vpParallelPackets[i]->m_DataSize);
+			ASSERT_EQ(mem_comp(pSerialPacket->m_aData, vpParallelPackets[i]->m_aData, pSerialPacket->m_DataSize), 0);
+		}
+	}
+
+	// the odd clients of all pairs which acked the same snapshot reuse the delta
+	EXPECT_GT(SerialDeltaCache.Hits(), 0u);
+	EXPECT_GT(SerialDeltaCache.Misses(), 0u);
+}
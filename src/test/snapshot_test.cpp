@@ -85,3 +85,98 @@ TEST(Snapshot, CrcOverflow)
 
 	ASSERT_EQ(pSnapshot->Crc(), 1);
 }
+
+static int BuildFullSnapshot(CSnapshot *pSnapshot)
+{
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	for(int ClientId = 0; ClientId < 64; ClientId++)
+	{
+		CNetObj_PlayerInfo *pPlayerInfo = static_cast<CNetObj_PlayerInfo *>(Builder.NewItem(NETOBJTYPE_PLAYERINFO, ClientId, sizeof(CNetObj_PlayerInfo)));
+		pPlayerInfo->m_ClientId = ClientId;
+		CNetObj_Character *pCharacter = static_cast<CNetObj_Character *>(Builder.NewItem(NETOBJTYPE_CHARACTER, ClientId, sizeof(CNetObj_Character)));
+		pCharacter->m_X = ClientId * 32;
+		CNetObj_DDNetCharacter *pDDNetCharacter = static_cast<CNetObj_DDNetCharacter *>(Builder.NewItem(NETOBJTYPE_DDNETCHARACTER, ClientId, sizeof(CNetObj_DDNetCharacter)));
+		pDDNetCharacter->m_Flags = ClientId;
+		CNetObj_DDNetPlayer *pDDNetPlayer = static_cast<CNetObj_DDNetPlayer *>(Builder.NewItem(NETOBJTYPE_DDNETPLAYER, ClientId, sizeof(CNetObj_DDNetPlayer)));
+		pDDNetPlayer->m_AuthLevel = ClientId;
+		for(int i = 0; i < 4; i++)
+		{
+			CNetObj_Projectile *pProjectile = static_cast<CNetObj_Projectile *>(Builder.NewItem(NETOBJTYPE_PROJECTILE, 256 + ClientId * 4 + i, sizeof(CNetObj_Projectile)));
+			pProjectile->m_X = i;
+		}
+	}
+	return Builder.Finish(pSnapshot);
+}
+
+TEST(Snapshot, IndexMatchesLinearSearch)
+{
+	char aData[CSnapshot::MAX_SIZE];
+	CSnapshot *pSnapshot = (CSnapshot *)aData;
+	BuildFullSnapshot(pSnapshot);
+	CSnapshotIndex Index;
+	Index.Build(pSnapshot);
+
+	for(int i = 0; i < pSnapshot->NumItems(); i++)
+	{
+		const CSnapshotItem *pItem = pSnapshot->GetItem(i);
+		EXPECT_EQ(Index.GetItemIndex(pItem->Key()), pSnapshot->GetItemIndex(pItem->Key()));
+		EXPECT_EQ(Index.GetItemType(i), pSnapshot->GetItemType(i));
+	}
+	EXPECT_EQ(Index.GetItemIndex((NETOBJTYPE_FLAG << 16) | 0), -1);
+
+	for(int Type : {(int)NETOBJTYPE_PLAYERINFO, (int)NETOBJTYPE_CHARACTER, (int)NETOBJTYPE_DDNETCHARACTER, (int)NETOBJTYPE_DDNETPLAYER, (int)NETOBJTYPE_DDNETPROJECTILE, (int)NETOBJTYPE_FLAG})
+	{
+		for(int Id = 0; Id < 65; Id++)
+		{
+			EXPECT_EQ(Index.FindItem(Type, Id), pSnapshot->FindItem(Type, Id));
+		}
+	}
+	for(int Id = 0; Id < 64; Id++)
+	{
+		EXPECT_NE(Index.FindItem(NETOBJTYPE_CHARACTER, Id), nullptr);
+		EXPECT_NE(Index.FindItem(NETOBJTYPE_DDNETCHARACTER, Id), nullptr);
+	}
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(Snapshot, DISABLED_IndexBenchmark)
+{
+	static const int NUM_ROUNDS = 200;
+
+	char aData[CSnapshot::MAX_SIZE];
+	CSnapshot *pSnapshot = (CSnapshot *)aData;
+	BuildFullSnapshot(pSnapshot);
+
+	// look up every item once per round, like the client does when processing a snapshot
+	int64_t Start = time_get();
+	int64_t LinearFound = 0;
+	for(int Round = 0; Round < NUM_ROUNDS; Round++)
+	{
+		for(int Id = 0; Id < 64; Id++)
+		{
+			LinearFound += pSnapshot->FindItem(NETOBJTYPE_CHARACTER, Id) != nullptr;
+			LinearFound += pSnapshot->FindItem(NETOBJTYPE_DDNETCHARACTER, Id) != nullptr;
+		}
+	}
+	const int64_t LinearTime = time_get() - Start;
+
+	Start = time_get();
+	int64_t IndexedFound = 0;
+	for(int Round = 0; Round < NUM_ROUNDS; Round++)
+	{
+		CSnapshotIndex Index;
+		Index.Build(pSnapshot);
+		for(int Id = 0; Id < 64; Id++)
+		{
+			IndexedFound += Index.FindItem(NETOBJTYPE_CHARACTER, Id) != nullptr;
+			IndexedFound += Index.FindItem(NETOBJTYPE_DDNETCHARACTER, Id) != nullptr;
+		}
+	}
+	const int64_t IndexedTime = time_get() - Start;
+
+	EXPECT_EQ(LinearFound, NUM_ROUNDS * 64 * 2);
+	EXPECT_EQ(IndexedFound, LinearFound);
+	dbg_msg("snapshot_test", "%d items, %d rounds: linear search %.3fms, index (including build) %.3fms",
+		pSnapshot->NumItems(), NUM_ROUNDS, LinearTime * 1000.0 / time_freq(), IndexedTime * 1000.0 / time_freq());
+}
@@ -1,3 +1,5 @@
+#include "test.h"
+
 #include <base/detect.h>
 
 #include <engine/external/json-parser/json.h>
@@ -104,6 +106,29 @@ protected:
 		m_State = STATE_NONE;
 	}
 
+	class CBlockOutput
+	{
+	public:
+		std::vector<unsigned char> m_vPlain;
+		std::vector<unsigned char> m_vBlocks;
+		std::vector<unsigned char> m_vIndex;
+		CTeeHistorianBlockWriter m_Writer;
+	};
+
+	// records the teehistorian output both as is and through a block writer
+	void ResetBlocks(CBlockOutput *pOutput)
+	{
+		pOutput->m_Writer.Reset([](const void *pData, int DataSize, void *pUser) { WriteBuffer(((CBlockOutput *)pUser)->m_vBlocks, pData, DataSize); },
+			[](const void *pData, int DataSize, void *pUser) { WriteBuffer(((CBlockOutput *)pUser)->m_vIndex, pData, DataSize); },
+			pOutput);
+		m_TH.Reset(
+			&m_GameInfo, [](const void *pData, int DataSize, void *pUser) {
+				WriteBuffer(((CBlockOutput *)pUser)->m_vPlain, pData, DataSize);
+				((CBlockOutput *)pUser)->m_Writer.Write(pData, DataSize);
+			},
+			pOutput);
+	}
+
 	void Expect(const unsigned char *pOutput, size_t OutputSize)
 	{
 		static CUuid TEEHISTORIAN_UUID = CalculateUuid("teehistorian@ddnet.tw");
@@ -179,7 +204,7 @@ protected:
 		ASSERT_TRUE(mem_comp(m_vBuffer.data(), pOutput, OutputSize) == 0);
 	}
 
-	void Tick(int Tick)
+	void Tick(int Tick, CTeeHistorianBlockWriter *pBlocks = nullptr)
 	{
 		if(m_State == STATE_PLAYERS)
 		{
@@ -190,7 +215,8 @@ protected:
 			m_TH.EndInputs();
 			m_TH.EndTick();
 		}
-		m_TH.BeginTick(Tick);
+		const bool NewBlock = pBlocks && pBlocks->BeginTick(Tick, m_TH.LastWrittenTick());
+		m_TH.BeginTick(Tick, NewBlock);
 		m_TH.BeginPlayers();
 		m_State = STATE_PLAYERS;
 	}
@@ -251,6 +277,28 @@ TEST_F(TeeHistorian, TickImplicitOneTick)
 	Expect(EXPECTED, sizeof(EXPECTED));
 }
 
+TEST_F(TeeHistorian, TickExplicit)
+{
+	const unsigned char EXPECTED[] = {
+		0x42, 0x00, 0x01, 0x02, // PLAYER_NEW cid=0 x=1 y=2
+		0x41, 0x00, // TICK_SKIP dt=0
+		0x00, 0x01, 0x40, // PLAYER cid=0 dx=1 dy=-1
+		0x40, // FINISH
+	};
+	Tick(1);
+	Player(0, 1, 2);
+	m_TH.EndPlayers();
+	m_TH.BeginInputs();
+	m_TH.EndInputs();
+	m_TH.EndTick();
+	m_TH.BeginTick(2, true);
+	m_TH.BeginPlayers();
+	m_State = STATE_PLAYERS;
+	Player(0, 2, 1);
+	Finish();
+	Expect(EXPECTED, sizeof(EXPECTED));
+}
+
 TEST_F(TeeHistorian, TickImplicitTwoTicks)
 {
 	const unsigned char EXPECTED[] = {
@@ -906,3 +954,169 @@ TEST_F(TeeHistorian, PrevGameUuid)
 	EXPECT_STREQ(JsonPrevGameUuid, "fe19c218-f555-4002-a273-126c59ccc17a");
 	json_value_free(pJson);
 }
+
+TEST_F(TeeHistorian, CompressedBlocks)
+{
+	CBlockOutput Output;
+	ResetBlocks(&Output);
+
+	const int NumTicks = CTeeHistorianBlockWriter::MAX_BLOCK_TICKS * 2 + 10;
+	for(int i = 1; i <= NumTicks; i++)
+	{
+		Tick(i, &Output.m_Writer);
+		Player(0, i, -i);
+	}
+	Finish();
+	Output.m_Writer.Flush();
+	EXPECT_EQ(Output.m_Writer.UncompressedSize(), (int64_t)Output.m_vPlain.size());
+	EXPECT_EQ(Output.m_Writer.CompressedSize(), (int64_t)Output.m_vBlocks.size());
+
+	CTestInfo Info;
+	char aIndexFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aIndexFilename, sizeof(aIndexFilename), ".index");
+	IOHANDLE File = io_open(Info.m_aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	io_write(File, Output.m_vBlocks.data(), Output.m_vBlocks.size());
+	io_close(File);
+	File = io_open(aIndexFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	io_write(File, Output.m_vIndex.data(), Output.m_vIndex.size());
+	io_close(File);
+
+	std::vector<CTeeHistorianBlockReader::CIndexEntry> vIndex;
+	File = io_open(aIndexFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	EXPECT_TRUE(CTeeHistorianBlockReader::ReadIndex(File, vIndex));
+	io_close(File);
+	ASSERT_EQ(vIndex.size(), 3u);
+	EXPECT_EQ(vIndex[0].m_FirstTick, 1);
+	EXPECT_EQ(vIndex[0].m_Offset, 0);
+	EXPECT_EQ(vIndex[1].m_FirstTick, 1 + CTeeHistorianBlockWriter::MAX_BLOCK_TICKS);
+	EXPECT_EQ(vIndex[2].m_FirstTick, 1 + 2 * CTeeHistorianBlockWriter::MAX_BLOCK_TICKS);
+	EXPECT_EQ(CTeeHistorianBlockReader::FindTick(vIndex, 0), -1);
+	EXPECT_EQ(CTeeHistorianBlockReader::FindTick(vIndex, 1), vIndex[0].m_Offset);
+	EXPECT_EQ(CTeeHistorianBlockReader::FindTick(vIndex, vIndex[2].m_FirstTick - 1), vIndex[1].m_Offset);
+	EXPECT_EQ(CTeeHistorianBlockReader::FindTick(vIndex, NumTicks + 100), vIndex[2].m_Offset);
+
+	File = io_open(Info.m_aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	std::vector<unsigned char> vDecompressed;
+	std::vector<unsigned char> vBlock;
+	CTeeHistorianBlockReader::CBlockHeader Header;
+	while(CTeeHistorianBlockReader::ReadBlock(File, &Header, vBlock))
+	{
+		vDecompressed.insert(vDecompressed.end(), vBlock.begin(), vBlock.end());
+	}
+	EXPECT_TRUE(vDecompressed == Output.m_vPlain);
+
+	// a block in the middle starts with an explicit tick
+	io_seek(File, CTeeHistorianBlockReader::FindTick(vIndex, vIndex[1].m_FirstTick + 10), IOSEEK_START);
+	ASSERT_TRUE(CTeeHistorianBlockReader::ReadBlock(File, &Header, vBlock));
+	EXPECT_EQ(Header.m_FirstTick, vIndex[1].m_FirstTick);
+	EXPECT_EQ(Header.m_PrevTick, vIndex[1].m_FirstTick - 1);
+	ASSERT_GE(vBlock.size(), 2u);
+	EXPECT_EQ(vBlock[0], 0x41); // TICK_SKIP
+	EXPECT_EQ(vBlock[1], 0x00); // dt=0
+	io_close(File);
+
+	if(!HasFailure())
+	{
+		fs_remove(Info.m_aFilename);
+		fs_remove(aIndexFilename);
+	}
+}
+
+TEST_F(TeeHistorian, Reader)
+{
+	CBlockOutput Output;
+	ResetBlocks(&Output);
+
+	CNetObj_PlayerInput Input = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+	m_TH.RecordPlayerJoin(3, CTeeHistorian::PROTOCOL_6);
+	const int NumTicks = CTeeHistorianBlockWriter::MAX_BLOCK_TICKS + 10;
+	for(int i = 1; i <= NumTicks; i++)
+	{
+		// leave out some ticks
+		if(i % 7 == 0)
+			continue;
+		Tick(i, &Output.m_Writer);
+		Player(1, i, -i);
+		if(i % 3)
+			Player(3, 2 * i, 5);
+		else
+			DeadPlayer(3);
+		Inputs();
+		Input.m_Direction = i % 3 - 1;
+		m_TH.RecordPlayerInput(3, 1, &Input);
+	}
+	m_TH.RecordPlayerDrop(3, "bye");
+	Finish();
+	Output.m_Writer.Flush();
+
+	for(const std::vector<unsigned char> *pFile : {&Output.m_vPlain, &Output.m_vBlocks})
+	{
+		CTestInfo Info;
+		IOHANDLE File = io_open(Info.m_aFilename, IOFLAG_WRITE);
+		ASSERT_TRUE(File);
+		io_write(File, pFile->data(), pFile->size());
+		io_close(File);
+
+		CTeeHistorianReader Reader;
+		File = io_open(Info.m_aFilename, IOFLAG_READ);
+		ASSERT_TRUE(File);
+		ASSERT_TRUE(Reader.Load(File));
+		io_close(File);
+		EXPECT_TRUE(str_startswith(Reader.HeaderJson(), "{\"comment\":\"teehistorian@ddnet.tw\""));
+
+		CTeeHistorianReader::CChunk Chunk;
+		ASSERT_TRUE(Reader.ReadChunk(&Chunk));
+		EXPECT_EQ(Chunk.m_Type, CTeeHistorianReader::CHUNK_EX);
+		ASSERT_TRUE(Reader.ReadChunk(&Chunk));
+		EXPECT_EQ(Chunk.m_Type, CTeeHistorianReader::CHUNK_JOIN);
+		EXPECT_EQ(Chunk.m_ClientId, 3);
+
+		int NumPlayers = 0;
+		int NumDead = 0;
+		int NumInputs = 0;
+		while(Reader.ReadChunk(&Chunk) && Chunk.m_Type != CTeeHistorianReader::CHUNK_DROP)
+		{
+			ASSERT_NE(Chunk.m_Tick % 7, 0);
+			switch(Chunk.m_Type)
+			{
+			case CTeeHistorianReader::CHUNK_PLAYER:
+				EXPECT_EQ(Chunk.m_X, Chunk.m_ClientId == 1 ? Chunk.m_Tick : 2 * Chunk.m_Tick);
+				EXPECT_EQ(Chunk.m_Y, Chunk.m_ClientId == 1 ? -Chunk.m_Tick : 5);
+				NumPlayers++;
+				break;
+			case CTeeHistorianReader::CHUNK_PLAYER_OLD:
+				EXPECT_EQ(Chunk.m_ClientId, 3);
+				EXPECT_EQ(Chunk.m_Tick % 3, 0);
+				NumDead++;
+				break;
+			case CTeeHistorianReader::CHUNK_INPUT:
+				EXPECT_EQ(Chunk.m_ClientId, 3);
+				EXPECT_EQ(Chunk.m_Input.m_Direction, Chunk.m_Tick % 3 - 1);
+				EXPECT_EQ(Chunk.m_Input.m_TargetX, 2);
+				NumInputs++;
+				break;
+			default:
+				ADD_FAILURE() << "unexpected chunk " << Chunk.m_Type;
+			}
+		}
+		EXPECT_EQ(Chunk.m_Type, CTeeHistorianReader::CHUNK_DROP);
+		EXPECT_STREQ(Chunk.m_pString, "bye");
+		EXPECT_EQ(Chunk.m_Tick, NumTicks);
+		ASSERT_TRUE(Reader.ReadChunk(&Chunk));
+		EXPECT_EQ(Chunk.m_Type, CTeeHistorianReader::CHUNK_FINISH);
+		EXPECT_FALSE(Reader.ReadChunk(&Chunk));
+		EXPECT_FALSE(Reader.Error());
+
+		const int NumRecordedTicks = NumTicks - NumTicks / 7;
+		EXPECT_EQ(NumPlayers, NumRecordedTicks + NumRecordedTicks - NumDead);
+		EXPECT_GT(NumDead, 0);
+		EXPECT_EQ(NumInputs, NumRecordedTicks);
+
+		if(!HasFailure())
+			fs_remove(Info.m_aFilename);
+	}
+}
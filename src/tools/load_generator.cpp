@@ -0,0 +1,869 @@
+#include <base/logger.h>
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/message.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/config.h>
+#include <engine/shared/linereader.h>
+#include <engine/shared/network.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/protocol_ex.h>
+#include <engine/shared/snapshot.h>
+
+#include <game/version.h>
+
+#include <generated/protocol.h>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Connects a number of simulated clients to a server, lets them download the
+// map, enter the game, send inputs and acknowledge snapshots like the real
+// client does, and reports what the server sent them.
+
+static const char *TOOL_NAME = "load_generator";
+
+class CInputStep
+{
+public:
+	int m_Ticks;
+	int m_Direction;
+	int m_Jump;
+	int m_Hook;
+	int m_Fire;
+	int m_TargetX;
+	int m_TargetY;
+};
+
+class CLoadConfig
+{
+public:
+	int m_NumClients = 16;
+	int m_Duration = 30;
+	int m_ConnectRate = 10;
+	bool m_DownloadMap = true;
+	bool m_SpreadAddresses = false;
+	bool m_RandomInput = true;
+	const char *m_pPassword = "";
+	std::vector<CInputStep> m_vScript;
+};
+
+// statistics of one client, collected while it is in game
+class CClientStats
+{
+public:
+	int64_t m_ConnectTime = 0;
+	int64_t m_MapDownloadTime = 0;
+	int64_t m_EnterGameTime = 0;
+	int m_MapSize = 0;
+
+	uint64_t m_BytesReceived = 0;
+	uint64_t m_BytesSent = 0;
+
+	int m_NumSnapshots = 0;
+	int m_NumEmptySnapshots = 0;
+	uint64_t m_SnapshotBytes = 0;
+	int m_MaxSnapshotBytes = 0;
+	uint64_t m_SnapshotSizes = 0;
+	int m_MaxSnapshotSize = 0;
+	int m_CrcErrors = 0;
+	int m_DeltaMisses = 0;
+
+	// wall clock time between two snapshots divided by their tick distance
+	int64_t m_TickTimeSum = 0;
+	int m_NumTickTimes = 0;
+	int64_t m_MaxTickTime = 0;
+
+	int m_NumInputTimings = 0;
+	int m_LateInputs = 0;
+};
+
+class CLoadClient
+{
+public:
+	enum EState
+	{
+		STATE_OFFLINE,
+		STATE_CONNECTING,
+		STATE_LOADING,
+		STATE_READY,
+		STATE_INGAME,
+		STATE_FAILED,
+	};
+
+private:
+	int m_Id;
+	const CLoadConfig *m_pConfig;
+	CSnapshotDelta *m_pSnapshotDelta;
+
+	CNetClient m_NetClient;
+	EState m_State = STATE_OFFLINE;
+	CUuid m_ConnectionId;
+	int64_t m_StartTime = 0;
+
+	int m_MapCrc = 0;
+	int m_MapSize = 0;
+	int m_MapChunk = 0;
+	int m_MapAmount = 0;
+	int64_t m_MapDownloadStart = 0;
+
+	CSnapshotStorage m_SnapshotStorage;
+	char m_aSnapshotIncomingData[CSnapshot::MAX_SIZE];
+	int m_SnapshotIncomingDataSize = 0;
+	uint64_t m_SnapshotParts = 0;
+	int m_CurrentRecvTick = 0;
+	int m_AckGameTick = -1;
+	int m_LastSnapTick = -1;
+	int64_t m_LastSnapTime = 0;
+
+	CNetObj_PlayerInput m_Input = {};
+	int m_InputStep = 0;
+	int m_InputStepTicks = 0;
+
+	CClientStats m_Stats;
+
+	void SendMsg(CMsgPacker *pMsg, int Flags)
+	{
+		CPacker Packer;
+		Packer.Reset();
+		if(pMsg->m_MsgId < OFFSET_UUID)
+		{
+			Packer.AddInt((pMsg->m_MsgId << 1) | (pMsg->m_System ? 1 : 0));
+		}
+		else
+		{
+			Packer.AddInt(pMsg->m_System ? 1 : 0);
+			g_UuidManager.PackUuid(pMsg->m_MsgId, &Packer);
+		}
+		Packer.AddRaw(pMsg->Data(), pMsg->Size());
+
+		CNetChunk Packet;
+		mem_zero(&Packet, sizeof(Packet));
+		Packet.m_ClientId = 0;
+		Packet.m_pData = Packer.Data();
+		Packet.m_DataSize = Packer.Size();
+		if(Flags & MSGFLAG_VITAL)
+			Packet.m_Flags |= NETSENDFLAG_VITAL;
+		if(Flags & MSGFLAG_FLUSH)
+			Packet.m_Flags |= NETSENDFLAG_FLUSH;
+		m_NetClient.Send(&Packet);
+
+		if(m_State == STATE_INGAME)
+			m_Stats.m_BytesSent += Packet.m_DataSize;
+	}
+
+	void SendInfo()
+	{
+		CMsgPacker MsgVer(NETMSG_CLIENTVER, true);
+		MsgVer.AddRaw(&m_ConnectionId, sizeof(m_ConnectionId));
+		MsgVer.AddInt(DDNET_VERSION_NUMBER);
+		MsgVer.AddString(GAME_NAME " " GAME_RELEASE_VERSION);
+		SendMsg(&MsgVer, MSGFLAG_VITAL);
+
+		CMsgPacker Msg(NETMSG_INFO, true);
+		Msg.AddString(GAME_NETVERSION);
+		Msg.AddString(m_pConfig->m_pPassword);
+		SendMsg(&Msg, MSGFLAG_VITAL | MSGFLAG_FLUSH);
+	}
+
+	void SendReady()
+	{
+		m_Stats.m_MapDownloadTime = time_get() - m_MapDownloadStart;
+		m_State = STATE_READY;
+		CMsgPacker Msg(NETMSG_READY, true);
+		SendMsg(&Msg, MSGFLAG_VITAL | MSGFLAG_FLUSH);
+	}
+
+	void SendMapRequest()
+	{
+		CMsgPacker Msg(NETMSG_REQUEST_MAP_DATA, true);
+		Msg.AddInt(m_MapChunk);
+		SendMsg(&Msg, MSGFLAG_VITAL | MSGFLAG_FLUSH);
+	}
+
+	void SendEnterGame()
+	{
+		char aName[16];
+		str_format(aName, sizeof(aName), "load %d", m_Id);
+
+		CNetMsg_Cl_StartInfo StartInfo;
+		StartInfo.m_pName = aName;
+		StartInfo.m_pClan = "";
+		StartInfo.m_Country = -1;
+		StartInfo.m_pSkin = "default";
+		StartInfo.m_UseCustomColor = 0;
+		StartInfo.m_ColorBody = 0;
+		StartInfo.m_ColorFeet = 0;
+		CMsgPacker Packer(&StartInfo);
+		StartInfo.Pack(&Packer);
+		SendMsg(&Packer, MSGFLAG_VITAL);
+
+		CMsgPacker Msg(NETMSG_ENTERGAME, true);
+		SendMsg(&Msg, MSGFLAG_VITAL | MSGFLAG_FLUSH);
+	}
+
+	void ResetSnapshots()
+	{
+		m_SnapshotStorage.PurgeAll();
+		m_SnapshotParts = 0;
+		m_CurrentRecvTick = 0;
+		m_AckGameTick = -1;
+		m_LastSnapTick = -1;
+	}
+
+	void OnMapChange(CUnpacker *pUnpacker)
+	{
+		pUnpacker->GetString(CUnpacker::SANITIZE_CC | CUnpacker::SKIP_START_WHITESPACES);
+		const int MapCrc = pUnpacker->GetInt();
+		const int MapSize = pUnpacker->GetInt();
+		if(pUnpacker->Error() || MapSize < 0)
+			return;
+
+		ResetSnapshots();
+		m_State = STATE_LOADING;
+		m_MapCrc = MapCrc;
+		m_MapSize = MapSize;
+		m_MapChunk = 0;
+		m_MapAmount = 0;
+		m_MapDownloadStart = time_get();
+		m_Stats.m_MapSize = MapSize;
+
+		if(m_pConfig->m_DownloadMap)
+			SendMapRequest();
+		else
+			SendReady();
+	}
+
+	void OnMapData(CUnpacker *pUnpacker)
+	{
+		if(m_State != STATE_LOADING)
+			return;
+
+		const int Last = pUnpacker->GetInt();
+		const int MapCrc = pUnpacker->GetInt();
+		const int Chunk = pUnpacker->GetInt();
+		const int Size = pUnpacker->GetInt();
+		pUnpacker->GetRaw(Size);
+		if(pUnpacker->Error() || Size <= 0 || MapCrc != m_MapCrc || Chunk != m_MapChunk)
+			return;
+
+		m_MapAmount += Size;
+		if(Last)
+		{
+			if(m_MapAmount != m_MapSize)
+				log_error(TOOL_NAME, "client %d: downloaded %d bytes of a map with %d bytes", m_Id, m_MapAmount, m_MapSize);
+			SendReady();
+		}
+		else
+		{
+			m_MapChunk++;
+			SendMapRequest();
+		}
+	}
+
+	void OnSnapshot(int Msg, CUnpacker *pUnpacker, int64_t Now)
+	{
+		if(m_State < STATE_READY)
+			return;
+
+		const int GameTick = pUnpacker->GetInt();
+		const int DeltaTick = GameTick - pUnpacker->GetInt();
+
+		int NumParts = 1;
+		int Part = 0;
+		if(Msg == NETMSG_SNAP)
+		{
+			NumParts = pUnpacker->GetInt();
+			Part = pUnpacker->GetInt();
+		}
+
+		unsigned int Crc = 0;
+		int PartSize = 0;
+		if(Msg != NETMSG_SNAPEMPTY)
+		{
+			Crc = pUnpacker->GetInt();
+			PartSize = pUnpacker->GetInt();
+		}
+
+		const char *pData = (const char *)pUnpacker->GetRaw(PartSize);
+		if(pUnpacker->Error() || NumParts < 1 || NumParts > CSnapshot::MAX_PARTS || Part < 0 || Part >= NumParts || PartSize < 0 || PartSize > MAX_SNAPSHOT_PACKSIZE)
+			return;
+
+		if(GameTick < m_CurrentRecvTick || GameTick <= m_AckGameTick)
+			return;
+
+		if(GameTick != m_CurrentRecvTick)
+		{
+			m_SnapshotParts = 0;
+			m_CurrentRecvTick = GameTick;
+			m_SnapshotIncomingDataSize = 0;
+		}
+
+		mem_copy(m_aSnapshotIncomingData + Part * MAX_SNAPSHOT_PACKSIZE, pData, std::clamp(PartSize, 0, (int)sizeof(m_aSnapshotIncomingData) - Part * MAX_SNAPSHOT_PACKSIZE));
+		m_SnapshotParts |= (uint64_t)1 << Part;
+		if(Part == NumParts - 1)
+			m_SnapshotIncomingDataSize = (NumParts - 1) * MAX_SNAPSHOT_PACKSIZE + PartSize;
+
+		if(!((NumParts < CSnapshot::MAX_PARTS && m_SnapshotParts == (((uint64_t)1 << NumParts) - 1)) ||
+			   (NumParts == CSnapshot::MAX_PARTS && m_SnapshotParts == std::numeric_limits<uint64_t>::max())))
+			return;
+
+		m_SnapshotParts = 0;
+
+		const CSnapshot *pDeltaShot = CSnapshot::EmptySnapshot();
+		if(DeltaTick >= 0 && m_SnapshotStorage.Get(DeltaTick, nullptr, &pDeltaShot, nullptr) < 0)
+		{
+			// the delta snapshot is gone, force the server to resync
+			m_Stats.m_DeltaMisses++;
+			m_AckGameTick = -1;
+			return;
+		}
+
+		unsigned char aDeltaData[CSnapshot::MAX_SIZE];
+		const void *pDeltaData = m_pSnapshotDelta->EmptyDelta();
+		int DeltaSize = sizeof(int) * 3;
+		if(m_SnapshotIncomingDataSize)
+		{
+			DeltaSize = CVariableInt::Decompress(m_aSnapshotIncomingData, m_SnapshotIncomingDataSize, aDeltaData, sizeof(aDeltaData));
+			if(DeltaSize < 0)
+				return;
+			pDeltaData = aDeltaData;
+		}
+
+		unsigned char aSnapshot[CSnapshot::MAX_SIZE];
+		CSnapshot *pSnapshot = (CSnapshot *)aSnapshot;
+		const int SnapSize = m_pSnapshotDelta->UnpackDelta(pDeltaShot, pSnapshot, pDeltaData, DeltaSize, false);
+		if(SnapSize < 0 || !pSnapshot->IsValid(SnapSize))
+			return;
+
+		if(Msg != NETMSG_SNAPEMPTY && pSnapshot->Crc() != Crc)
+		{
+			m_Stats.m_CrcErrors++;
+			m_AckGameTick = -1;
+			return;
+		}
+
+		m_SnapshotStorage.PurgeUntil(minimum(DeltaTick, m_AckGameTick));
+		m_SnapshotStorage.Add(GameTick, Now, SnapSize, pSnapshot, 0, nullptr);
+		m_AckGameTick = GameTick;
+
+		if(m_State == STATE_INGAME)
+		{
+			m_Stats.m_NumSnapshots++;
+			if(Msg == NETMSG_SNAPEMPTY)
+				m_Stats.m_NumEmptySnapshots++;
+			m_Stats.m_SnapshotBytes += m_SnapshotIncomingDataSize;
+			m_Stats.m_MaxSnapshotBytes = maximum(m_Stats.m_MaxSnapshotBytes, m_SnapshotIncomingDataSize);
+			m_Stats.m_SnapshotSizes += SnapSize;
+			m_Stats.m_MaxSnapshotSize = maximum(m_Stats.m_MaxSnapshotSize, SnapSize);
+
+			if(m_LastSnapTick >= 0 && GameTick > m_LastSnapTick)
+			{
+				const int64_t TickTime = (Now - m_LastSnapTime) / (GameTick - m_LastSnapTick);
+				m_Stats.m_TickTimeSum += TickTime;
+				m_Stats.m_NumTickTimes++;
+				m_Stats.m_MaxTickTime = maximum(m_Stats.m_MaxTickTime, TickTime);
+			}
+		}
+		m_LastSnapTick = GameTick;
+		m_LastSnapTime = Now;
+	}
+
+	void ProcessPacket(CNetChunk *pPacket, int64_t Now)
+	{
+		CUnpacker Unpacker;
+		Unpacker.Reset(pPacket->m_pData, pPacket->m_DataSize);
+		CMsgPacker Packer(NETMSG_EX, true);
+
+		int Msg;
+		bool Sys;
+		CUuid Uuid;
+		const int Result = UnpackMessageId(&Msg, &Sys, &Uuid, &Unpacker, &Packer);
+		if(Result == UNPACKMESSAGE_ERROR)
+			return;
+		else if(Result == UNPACKMESSAGE_ANSWER)
+			SendMsg(&Packer, MSGFLAG_VITAL);
+
+		if(!Sys)
+		{
+			// the game messages are not interesting here, only the server's
+			// notice that we can enter the game is
+			return;
+		}
+
+		const bool Vital = (pPacket->m_Flags & NET_CHUNKFLAG_VITAL) != 0;
+		if(Vital && Msg == NETMSG_MAP_CHANGE)
+		{
+			OnMapChange(&Unpacker);
+		}
+		else if(Msg == NETMSG_MAP_DATA)
+		{
+			OnMapData(&Unpacker);
+		}
+		else if(Vital && Msg == NETMSG_CON_READY)
+		{
+			if(m_State == STATE_READY)
+			{
+				SendEnterGame();
+				m_State = STATE_INGAME;
+				m_Stats.m_EnterGameTime = Now;
+			}
+		}
+		else if(Msg == NETMSG_PING)
+		{
+			CMsgPacker MsgP(NETMSG_PING_REPLY, true);
+			SendMsg(&MsgP, MSGFLAG_FLUSH | (Vital ? MSGFLAG_VITAL : 0));
+		}
+		else if(Msg == NETMSG_PINGEX)
+		{
+			CUuid *pId = (CUuid *)Unpacker.GetRaw(sizeof(*pId));
+			if(Unpacker.Error())
+				return;
+			CMsgPacker MsgP(NETMSG_PONGEX, true);
+			MsgP.AddRaw(pId, sizeof(*pId));
+			SendMsg(&MsgP, MSGFLAG_FLUSH | (Vital ? MSGFLAG_VITAL : 0));
+		}
+		else if(Msg == NETMSG_INPUTTIMING)
+		{
+			Unpacker.GetInt();
+			const int TimeLeft = Unpacker.GetInt();
+			if(Unpacker.Error() || m_State != STATE_INGAME)
+				return;
+			m_Stats.m_NumInputTimings++;
+			if(TimeLeft < 0)
+				m_Stats.m_LateInputs++;
+		}
+		else if(Msg == NETMSG_SNAP || Msg == NETMSG_SNAPSINGLE || Msg == NETMSG_SNAPEMPTY)
+		{
+			OnSnapshot(Msg, &Unpacker, Now);
+		}
+	}
+
+	void NextInput()
+	{
+		if(m_pConfig->m_RandomInput)
+		{
+			if(m_InputStepTicks-- > 0)
+			{
+				m_Input.m_Jump = 0;
+				return;
+			}
+			m_InputStepTicks = 5 + rand() % 50;
+			m_Input.m_Direction = rand() % 3 - 1;
+			m_Input.m_Jump = rand() % 4 == 0;
+			m_Input.m_Hook = rand() % 3 == 0;
+			if(rand() % 4 == 0)
+				m_Input.m_Fire++;
+			m_Input.m_TargetX = rand() % 513 - 256;
+			m_Input.m_TargetY = rand() % 513 - 256;
+			return;
+		}
+
+		if(m_pConfig->m_vScript.empty())
+			return;
+		if(m_InputStepTicks-- > 0)
+			return;
+		const CInputStep &Step = m_pConfig->m_vScript[m_InputStep];
+		m_InputStep = (m_InputStep + 1) % m_pConfig->m_vScript.size();
+		m_InputStepTicks = Step.m_Ticks - 1;
+		m_Input.m_Direction = Step.m_Direction;
+		m_Input.m_Jump = Step.m_Jump;
+		m_Input.m_Hook = Step.m_Hook;
+		// the fire count is odd while fire is held
+		if((m_Input.m_Fire & 1) != Step.m_Fire)
+			m_Input.m_Fire++;
+		m_Input.m_TargetX = Step.m_TargetX;
+		m_Input.m_TargetY = Step.m_TargetY;
+	}
+
+public:
+	CLoadClient(int Id, const CLoadConfig *pConfig, CSnapshotDelta *pSnapshotDelta) :
+		m_Id(Id), m_pConfig(pConfig), m_pSnapshotDelta(pSnapshotDelta)
+	{
+		m_Input.m_PlayerFlags = PLAYERFLAG_PLAYING;
+		m_Input.m_TargetX = 1;
+		// don't let all clients run the script in lockstep
+		if(!pConfig->m_vScript.empty())
+			m_InputStep = Id % pConfig->m_vScript.size();
+	}
+
+	EState State() const { return m_State; }
+	const CClientStats &Stats() const { return m_Stats; }
+
+	bool Connect(const NETADDR &ServerAddr)
+	{
+		NETADDR BindAddr;
+		mem_zero(&BindAddr, sizeof(BindAddr));
+		BindAddr.type = NETTYPE_ALL;
+		if(m_pConfig->m_SpreadAddresses)
+		{
+			// every client gets its own loopback address so that the server's
+			// per address limits don't apply
+			BindAddr.type = NETTYPE_IPV4;
+			BindAddr.ip[0] = 127;
+			BindAddr.ip[1] = 1;
+			BindAddr.ip[2] = (m_Id >> 8) & 0xff;
+			BindAddr.ip[3] = m_Id & 0xff;
+		}
+		if(!m_NetClient.Open(BindAddr))
+		{
+			log_error(TOOL_NAME, "client %d: could not open socket", m_Id);
+			m_State = STATE_FAILED;
+			return false;
+		}
+		m_ConnectionId = RandomUuid();
+		m_StartTime = time_get();
+		m_NetClient.Connect(&ServerAddr, 1);
+		m_State = STATE_CONNECTING;
+		return true;
+	}
+
+	void Disconnect(const char *pReason)
+	{
+		if(m_State != STATE_OFFLINE && m_State != STATE_FAILED)
+		{
+			m_NetClient.Disconnect(pReason);
+			m_State = STATE_OFFLINE;
+		}
+		m_NetClient.Close();
+	}
+
+	void Update(int64_t Now)
+	{
+		if(m_State == STATE_OFFLINE || m_State == STATE_FAILED)
+			return;
+
+		m_NetClient.Update();
+		if(m_NetClient.State() == NETSTATE_OFFLINE)
+		{
+			log_error(TOOL_NAME, "client %d: offline error='%s'", m_Id, m_NetClient.ErrorString());
+			m_State = STATE_FAILED;
+			return;
+		}
+		if(m_State == STATE_CONNECTING && m_NetClient.State() == NETSTATE_ONLINE)
+		{
+			m_Stats.m_ConnectTime = Now - m_StartTime;
+			m_State = STATE_LOADING;
+			SendInfo();
+		}
+
+		CNetChunk Packet;
+		SECURITY_TOKEN ResponseToken;
+		while(m_NetClient.Recv(&Packet, &ResponseToken, false))
+		{
+			if(Packet.m_ClientId == -1)
+				continue;
+			if(m_State == STATE_INGAME)
+				m_Stats.m_BytesReceived += Packet.m_DataSize;
+			ProcessPacket(&Packet, Now);
+		}
+	}
+
+	void SendInput(int64_t Now, int TickSpeed)
+	{
+		if(m_State != STATE_INGAME || m_LastSnapTick < 0)
+			return;
+
+		NextInput();
+
+		// aim a few ticks ahead of the tick the server is at now
+		const int PredTick = m_LastSnapTick + (int)((Now - m_LastSnapTime) * TickSpeed / time_freq()) + 2;
+		CMsgPacker Msg(NETMSG_INPUT, true);
+		Msg.AddInt(m_AckGameTick);
+		Msg.AddInt(PredTick);
+		Msg.AddInt(sizeof(m_Input));
+		const int *pData = (const int *)&m_Input;
+		for(size_t i = 0; i < sizeof(m_Input) / sizeof(int); i++)
+			Msg.AddInt(pData[i]);
+		SendMsg(&Msg, MSGFLAG_FLUSH);
+	}
+};
+
+static bool LoadScript(const char *pFilename, std::vector<CInputStep> &vScript)
+{
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	if(!File)
+	{
+		log_error(TOOL_NAME, "failed to open input script '%s'", pFilename);
+		return false;
+	}
+	CLineReader LineReader;
+	if(!LineReader.OpenFile(File))
+	{
+		log_error(TOOL_NAME, "failed to read input script '%s'", pFilename);
+		return false;
+	}
+
+	int LineNumber = 0;
+	while(const char *pLine = LineReader.Get())
+	{
+		LineNumber++;
+		pLine = str_skip_whitespaces_const(pLine);
+		if(pLine[0] == '\0' || pLine[0] == '#')
+			continue;
+
+		// ticks direction jump hook fire target_x target_y
+		CInputStep Step;
+		if(sscanf(pLine, "%d %d %d %d %d %d %d", &Step.m_Ticks, &Step.m_Direction, &Step.m_Jump, &Step.m_Hook, &Step.m_Fire, &Step.m_TargetX, &Step.m_TargetY) != 7 ||
+			Step.m_Ticks <= 0 || Step.m_Direction < -1 || Step.m_Direction > 1)
+		{
+			log_error(TOOL_NAME, "%s:%d: expected 'ticks direction jump hook fire target_x target_y'", pFilename, LineNumber);
+			return false;
+		}
+		Step.m_Fire = Step.m_Fire ? 1 : 0;
+		vScript.push_back(Step);
+	}
+	if(vScript.empty())
+	{
+		log_error(TOOL_NAME, "input script '%s' is empty", pFilename);
+		return false;
+	}
+	return true;
+}
+
+static void Usage(const char *pProgram)
+{
+	log_info(TOOL_NAME, "usage: %s [options] server[:port]", pProgram);
+	log_info(TOOL_NAME, "  -n <clients>    number of simulated clients (default 16)");
+	log_info(TOOL_NAME, "  -d <seconds>    how long to measure once all clients are connected (default 30)");
+	log_info(TOOL_NAME, "  -r <rate>       clients to connect per second (default 10)");
+	log_info(TOOL_NAME, "  -i <script>     play inputs from a script instead of random ones, one");
+	log_info(TOOL_NAME, "                  'ticks direction jump hook fire target_x target_y' step per line");
+	log_info(TOOL_NAME, "  -p <password>   server password");
+	log_info(TOOL_NAME, "  --idle          don't move");
+	log_info(TOOL_NAME, "  --no-download   skip the map download like the dummy does");
+	log_info(TOOL_NAME, "  --spread        connect from 127.1.x.y so that sv_max_clients_per_ip and");
+	log_info(TOOL_NAME, "                  sv_connlimit don't apply, the server must be on loopback");
+}
+
+static double Ms(int64_t Time)
+{
+	return (double)Time * 1000.0 / time_freq();
+}
+
+static void PrintReport(const CLoadConfig &Config, const std::vector<std::unique_ptr<CLoadClient>> &vpClients, int64_t Now, const NETSTATS &NetStats)
+{
+	int NumInGame = 0;
+	int NumFailed = 0;
+	int64_t MaxConnectTime = 0;
+	int64_t ConnectTimeSum = 0;
+	int64_t MaxDownloadTime = 0;
+	int64_t DownloadTimeSum = 0;
+	double MinRate = std::numeric_limits<double>::max();
+	double MaxRate = 0.0;
+	double RateSum = 0.0;
+	double SentRateSum = 0.0;
+	CClientStats Total;
+	for(const auto &pClient : vpClients)
+	{
+		if(pClient->State() == CLoadClient::STATE_FAILED)
+			NumFailed++;
+		const CClientStats &Stats = pClient->Stats();
+		if(!Stats.m_EnterGameTime)
+			continue;
+		NumInGame++;
+
+		ConnectTimeSum += Stats.m_ConnectTime;
+		MaxConnectTime = maximum(MaxConnectTime, Stats.m_ConnectTime);
+		DownloadTimeSum += Stats.m_MapDownloadTime;
+		MaxDownloadTime = maximum(MaxDownloadTime, Stats.m_MapDownloadTime);
+		Total.m_MapSize = Stats.m_MapSize;
+
+		const double Seconds = maximum((double)(Now - Stats.m_EnterGameTime) / time_freq(), 0.001);
+		const double Rate = Stats.m_BytesReceived / Seconds;
+		MinRate = minimum(MinRate, Rate);
+		MaxRate = maximum(MaxRate, Rate);
+		RateSum += Rate;
+		SentRateSum += Stats.m_BytesSent / Seconds;
+
+		Total.m_NumSnapshots += Stats.m_NumSnapshots;
+		Total.m_NumEmptySnapshots += Stats.m_NumEmptySnapshots;
+		Total.m_SnapshotBytes += Stats.m_SnapshotBytes;
+		Total.m_MaxSnapshotBytes = maximum(Total.m_MaxSnapshotBytes, Stats.m_MaxSnapshotBytes);
+		Total.m_SnapshotSizes += Stats.m_SnapshotSizes;
+		Total.m_MaxSnapshotSize = maximum(Total.m_MaxSnapshotSize, Stats.m_MaxSnapshotSize);
+		Total.m_CrcErrors += Stats.m_CrcErrors;
+		Total.m_DeltaMisses += Stats.m_DeltaMisses;
+		Total.m_TickTimeSum += Stats.m_TickTimeSum;
+		Total.m_NumTickTimes += Stats.m_NumTickTimes;
+		Total.m_MaxTickTime = maximum(Total.m_MaxTickTime, Stats.m_MaxTickTime);
+		Total.m_NumInputTimings += Stats.m_NumInputTimings;
+		Total.m_LateInputs += Stats.m_LateInputs;
+	}
+
+	log_info(TOOL_NAME, "clients: %d in game, %d failed, %d total", NumInGame, NumFailed, (int)vpClients.size());
+	if(!NumInGame)
+		return;
+	log_info(TOOL_NAME, "connect: avg %.2fms, max %.2fms", Ms(ConnectTimeSum / NumInGame), Ms(MaxConnectTime));
+	if(Config.m_DownloadMap)
+		log_info(TOOL_NAME, "map download: %d bytes, avg %.2fms, max %.2fms", Total.m_MapSize, Ms(DownloadTimeSum / NumInGame), Ms(MaxDownloadTime));
+	log_info(TOOL_NAME, "server tick time (seen from snapshots): avg %.2fms, max %.2fms",
+		Total.m_NumTickTimes ? Ms(Total.m_TickTimeSum / Total.m_NumTickTimes) : 0.0, Ms(Total.m_MaxTickTime));
+	log_info(TOOL_NAME, "bytes sent by the server per client: avg %.0f B/s, min %.0f B/s, max %.0f B/s (payload, inputs: avg %.0f B/s)",
+		RateSum / NumInGame, MinRate, MaxRate, SentRateSum / NumInGame);
+	log_info(TOOL_NAME, "bytes on the wire: %" PRIu64 " received in %" PRIu64 " packets, %" PRIu64 " sent in %" PRIu64 " packets",
+		NetStats.recv_bytes, NetStats.recv_packets, NetStats.sent_bytes, NetStats.sent_packets);
+	if(Total.m_NumSnapshots)
+	{
+		log_info(TOOL_NAME, "snapshots: %d (%d empty), compressed avg %.0f bytes, max %d bytes, unpacked avg %.0f bytes, max %d bytes",
+			Total.m_NumSnapshots, Total.m_NumEmptySnapshots,
+			(double)Total.m_SnapshotBytes / Total.m_NumSnapshots, Total.m_MaxSnapshotBytes,
+			(double)Total.m_SnapshotSizes / Total.m_NumSnapshots, Total.m_MaxSnapshotSize);
+	}
+	log_info(TOOL_NAME, "snapshot errors: %d crc, %d missing delta", Total.m_CrcErrors, Total.m_DeltaMisses);
+	log_info(TOOL_NAME, "inputs: %d of %d arrived late", Total.m_LateInputs, Total.m_NumInputTimings);
+}
+
+int main(int argc, const char **argv)
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+	log_set_global_logger_default();
+
+	CLoadConfig Config;
+	const char *pServer = nullptr;
+	for(int i = 1; i < argc; i++)
+	{
+		const bool HasValue = i + 1 < argc;
+		if(str_comp(argv[i], "-n") == 0 && HasValue)
+			Config.m_NumClients = str_toint(argv[++i]);
+		else if(str_comp(argv[i], "-d") == 0 && HasValue)
+			Config.m_Duration = str_toint(argv[++i]);
+		else if(str_comp(argv[i], "-r") == 0 && HasValue)
+			Config.m_ConnectRate = str_toint(argv[++i]);
+		else if(str_comp(argv[i], "-p") == 0 && HasValue)
+			Config.m_pPassword = argv[++i];
+		else if(str_comp(argv[i], "-i") == 0 && HasValue)
+		{
+			if(!LoadScript(argv[++i], Config.m_vScript))
+				return -1;
+			Config.m_RandomInput = false;
+		}
+		else if(str_comp(argv[i], "--idle") == 0)
+			Config.m_RandomInput = false;
+		else if(str_comp(argv[i], "--no-download") == 0)
+			Config.m_DownloadMap = false;
+		else if(str_comp(argv[i], "--spread") == 0)
+			Config.m_SpreadAddresses = true;
+		else if(argv[i][0] != '-' && !pServer)
+			pServer = argv[i];
+		else
+		{
+			Usage(argv[0]);
+			return -1;
+		}
+	}
+	if(!pServer || Config.m_NumClients <= 0 || Config.m_Duration <= 0 || Config.m_ConnectRate <= 0)
+	{
+		Usage(argv[0]);
+		return -1;
+	}
+
+	// the connections time out based on these, the config is not loaded here
+	g_Config.m_ConnTimeout = CConfig::ms_ConnTimeout;
+	g_Config.m_ConnTimeoutProtection = CConfig::ms_ConnTimeoutProtection;
+
+	net_init();
+	CNetBase::Init();
+
+	NETADDR ServerAddr;
+	if(net_host_lookup(pServer, &ServerAddr, Config.m_SpreadAddresses ? NETTYPE_IPV4 : NETTYPE_ALL))
+	{
+		log_error(TOOL_NAME, "host lookup failed");
+		return -1;
+	}
+	if(ServerAddr.port == 0)
+		ServerAddr.port = 8303;
+
+	// same item sizes as the client uses, the server leaves them out of the delta
+	CNetObjHandler NetObjHandler;
+	CSnapshotDelta SnapshotDelta;
+	for(int i = 0; i < NUM_NETOBJTYPES; i++)
+		SnapshotDelta.SetStaticsize(i, NetObjHandler.GetObjSize(i));
+	std::vector<std::unique_ptr<CLoadClient>> vpClients;
+	vpClients.reserve(Config.m_NumClients);
+
+	const int TickSpeed = SERVER_TICK_SPEED;
+	const int64_t Freq = time_freq();
+	const int64_t StartTime = time_get();
+	int64_t NextInputTime = StartTime;
+	int64_t NextReportTime = StartTime + 5 * Freq;
+	int64_t MeasureStart = 0;
+	NETSTATS NetStatsStart = {};
+
+	while(true)
+	{
+		const int64_t Now = time_get();
+
+		// connect new clients at the configured rate
+		const int WantedClients = minimum(Config.m_NumClients, 1 + (int)((Now - StartTime) * Config.m_ConnectRate / Freq));
+		while((int)vpClients.size() < WantedClients)
+		{
+			vpClients.push_back(std::make_unique<CLoadClient>(vpClients.size(), &Config, &SnapshotDelta));
+			vpClients.back()->Connect(ServerAddr);
+		}
+
+		int NumPending = 0;
+		int NumFailed = 0;
+		for(auto &pClient : vpClients)
+		{
+			pClient->Update(Now);
+			if(pClient->State() == CLoadClient::STATE_FAILED)
+				NumFailed++;
+			else if(pClient->State() != CLoadClient::STATE_INGAME)
+				NumPending++;
+		}
+		if(NumFailed == Config.m_NumClients)
+		{
+			log_error(TOOL_NAME, "all clients failed to connect");
+			return 1;
+		}
+
+		if(Now >= NextInputTime)
+		{
+			for(auto &pClient : vpClients)
+				pClient->SendInput(Now, TickSpeed);
+			NextInputTime += Freq / TickSpeed;
+			if(NextInputTime < Now)
+				NextInputTime = Now;
+		}
+
+		if(!MeasureStart && (int)vpClients.size() == Config.m_NumClients && NumPending == 0)
+		{
+			MeasureStart = Now;
+			net_stats(&NetStatsStart);
+			log_info(TOOL_NAME, "all clients connected after %.2fs, measuring for %ds", (double)(Now - StartTime) / Freq, Config.m_Duration);
+		}
+		if(MeasureStart && Now - MeasureStart >= Config.m_Duration * Freq)
+			break;
+
+		if(Now >= NextReportTime)
+		{
+			int aNumStates[CLoadClient::STATE_FAILED + 1] = {0};
+			for(auto &pClient : vpClients)
+				aNumStates[pClient->State()]++;
+			log_info(TOOL_NAME, "%d connecting, %d loading, %d in game, %d failed",
+				aNumStates[CLoadClient::STATE_CONNECTING], aNumStates[CLoadClient::STATE_LOADING] + aNumStates[CLoadClient::STATE_READY],
+				aNumStates[CLoadClient::STATE_INGAME], aNumStates[CLoadClient::STATE_FAILED]);
+			NextReportTime += 5 * Freq;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	NETSTATS NetStats;
+	net_stats(&NetStats);
+	NetStats.recv_bytes -= NetStatsStart.recv_bytes;
+	NetStats.recv_packets -= NetStatsStart.recv_packets;
+	NetStats.sent_bytes -= NetStatsStart.sent_bytes;
+	NetStats.sent_packets -= NetStatsStart.sent_packets;
+	PrintReport(Config, vpClients, time_get(), NetStats);
+
+	for(auto &pClient : vpClients)
+		pClient->Disconnect("load test finished");
+	return 0;
+}
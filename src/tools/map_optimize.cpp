@@ -1,6 +1,7 @@
 #include <base/logger.h>
 #include <base/system.h>
 
+#include <engine/engine.h>
 #include <engine/gfx/image_manipulation.h>
 #include <engine/shared/datafile.h>
 #include <engine/storage.h>
@@ -9,6 +10,7 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 static void ClearTransparentPixels(uint8_t *pImg, int Width, int Height)
@@ -108,6 +110,8 @@ int main(int argc, const char **argv)
 		str_format(aFilename, sizeof(aFilename), "out/%s.map", aBuff);
 	}
 
+	std::unique_ptr<IEngine> pEngine = std::unique_ptr<IEngine>(CreateEngine("map_optimize", nullptr));
+
 	CDataFileReader Reader;
 	if(!Reader.Open(pStorage.get(), argv[1], IStorage::TYPE_ABSOLUTE))
 	{
@@ -121,6 +125,7 @@ int main(int argc, const char **argv)
 		dbg_msg("map_optimize", "Failed to open target file.");
 		return -1;
 	}
+	Reader.PreloadData(pEngine.get());
 
 	int aImageFlags[MAX_MAPIMAGES] = {
 		0,
@@ -322,7 +327,7 @@ int main(int argc, const char **argv)
 	}
 
 	Reader.Close();
-	Writer.Finish();
+	Writer.Finish(pEngine.get());
 
 	return 0;
 }
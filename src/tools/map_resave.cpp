@@ -4,12 +4,15 @@
 #include <base/logger.h>
 #include <base/system.h>
 
+#include <engine/engine.h>
 #include <engine/shared/datafile.h>
 #include <engine/storage.h>
 
+#include <memory>
+
 static const char *TOOL_NAME = "map_resave";
 
-static int ResaveMap(const char *pSourceMap, const char *pDestinationMap, IStorage *pStorage)
+static int ResaveMap(const char *pSourceMap, const char *pDestinationMap, IStorage *pStorage, IEngine *pEngine)
 {
 	CDataFileReader Reader;
 	if(!Reader.Open(pStorage, pSourceMap, IStorage::TYPE_ABSOLUTE))
@@ -44,6 +47,7 @@ static int ResaveMap(const char *pSourceMap, const char *pDestinationMap, IStora
 	}
 
 	// add all data
+	Reader.PreloadData(pEngine);
 	for(int Index = 0; Index < Reader.NumData(); Index++)
 	{
 		const void *pPtr = Reader.GetData(Index);
@@ -52,7 +56,7 @@ static int ResaveMap(const char *pSourceMap, const char *pDestinationMap, IStora
 	}
 
 	Reader.Close();
-	Writer.Finish();
+	Writer.Finish(pEngine);
 	log_info(TOOL_NAME, "Resaved '%s' to '%s'", pSourceMap, pDestinationMap);
 	return 0;
 }
@@ -75,5 +79,6 @@ int main(int argc, const char **argv)
 		return -1;
 	}
 
-	return ResaveMap(argv[1], argv[2], pStorage.get());
+	std::unique_ptr<IEngine> pEngine = std::unique_ptr<IEngine>(CreateEngine(TOOL_NAME, nullptr));
+	return ResaveMap(argv[1], argv[2], pStorage.get(), pEngine.get());
 }
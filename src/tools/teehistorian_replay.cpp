@@ -0,0 +1,184 @@
+#include <base/logger.h>
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/engine.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/server/databases/connection_pool.h>
+#include <engine/server/server.h>
+#include <engine/shared/config.h>
+#include <engine/storage.h>
+
+#include <game/server/gamecontext.h>
+#include <game/server/teehistorian.h>
+#include <game/server/teehistorian_replay.h>
+#include <game/version.h>
+
+#include <memory>
+
+// Runs the game server on a recorded teehistorian file without network and
+// as fast as possible, to check that the simulation still produces the
+// recorded positions and to measure how long the ticks take.
+
+static const char *TOOL_NAME = "teehistorian_replay";
+
+bool IsInterrupted()
+{
+	return false;
+}
+
+std::vector<std::string> FetchAndroidServerCommandQueue()
+{
+	return {};
+}
+
+static void Usage(const char *pProgram)
+{
+	log_error(TOOL_NAME, "usage: %s [-m <map>] <teehistorian file>", pProgram);
+	log_error(TOOL_NAME, "  -m <map>  map to load from the maps folder, without .map (default: the map of the recording)");
+}
+
+int main(int argc, const char **argv)
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+	log_set_global_logger_default();
+
+	const char *pFilename = nullptr;
+	const char *pMapName = nullptr;
+	for(int i = 1; i < argc; i++)
+	{
+		if(str_comp(argv[i], "-m") == 0 && i + 1 < argc)
+			pMapName = argv[++i];
+		else if(argv[i][0] != '-' && !pFilename)
+			pFilename = argv[i];
+		else
+		{
+			Usage(argv[0]);
+			return -1;
+		}
+	}
+	if(!pFilename)
+	{
+		Usage(argv[0]);
+		return -1;
+	}
+
+	CTeeHistorianReader Reader;
+	{
+		IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+		if(!File)
+		{
+			log_error(TOOL_NAME, "failed to open '%s'", pFilename);
+			return -1;
+		}
+		const bool Loaded = Reader.Load(File);
+		io_close(File);
+		if(!Loaded)
+		{
+			log_error(TOOL_NAME, "'%s' is not a teehistorian file", pFilename);
+			return -1;
+		}
+	}
+
+	CServer *pServer = CreateServer();
+	std::unique_ptr<IKernel> pKernel = std::unique_ptr<IKernel>(IKernel::Create());
+	pKernel->RegisterInterface(pServer);
+
+	IEngine *pEngine = CreateEngine(GAME_NAME, nullptr);
+	pKernel->RegisterInterface(pEngine);
+
+	IStorage *pStorage = CreateStorage(IStorage::EInitializationType::SERVER, argc, argv);
+	if(!pStorage)
+	{
+		log_error(TOOL_NAME, "failed to initialize storage");
+		return -1;
+	}
+	pKernel->RegisterInterface(pStorage);
+
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER | CFGFLAG_ECON).release();
+	pKernel->RegisterInterface(pConsole);
+
+	IConfigManager *pConfigManager = CreateConfigManager();
+	pKernel->RegisterInterface(pConfigManager);
+
+	IEngineMap *pEngineMap = CreateEngineMap();
+	pKernel->RegisterInterface(pEngineMap);
+	pKernel->RegisterInterface(static_cast<IMap *>(pEngineMap), false);
+
+	IEngineAntibot *pEngineAntibot = CreateEngineAntibot();
+	pKernel->RegisterInterface(pEngineAntibot);
+	pKernel->RegisterInterface(static_cast<IAntibot *>(pEngineAntibot), false);
+
+	IGameServer *pGameServer = CreateGameServer();
+	pKernel->RegisterInterface(pGameServer);
+
+	pEngine->Init();
+	pConsole->Init();
+	pConfigManager->Init();
+	pServer->RegisterCommands();
+
+	CTeeHistorianReplay Replay(pServer, &Reader);
+	if(!Replay.ParseHeader())
+	{
+		log_error(TOOL_NAME, "invalid teehistorian header");
+		return -1;
+	}
+	Replay.ApplyConfig(pConsole);
+
+	if(!pMapName)
+		pMapName = Replay.MapName();
+	if(!pServer->LoadMap(pMapName))
+	{
+		log_error(TOOL_NAME, "failed to load map '%s'", pMapName);
+		return -1;
+	}
+	char aLoadedMapName[IO_MAX_PATH_LENGTH];
+	int MapSize, MapCrc;
+	SHA256_DIGEST MapSha256;
+	pServer->GetMapInfo(aLoadedMapName, sizeof(aLoadedMapName), &MapSize, &MapSha256, &MapCrc);
+	if(MapSha256 != Replay.MapSha256())
+		log_warn(TOOL_NAME, "map '%s' differs from the recorded one, the positions won't match", pMapName);
+
+	pServer->m_RunServer = CServer::RUNNING;
+	pServer->m_AuthManager.Init();
+	const int PersistentClientDataSize = static_cast<CGameContext *>(pGameServer)->PersistentClientDataSize();
+	for(auto &Client : pServer->m_aClients)
+	{
+		Client.m_HasPersistentData = false;
+		Client.m_pPersistentData = malloc(PersistentClientDataSize);
+	}
+	pServer->m_pPersistentData = malloc(static_cast<CGameContext *>(pGameServer)->PersistentDataSize());
+	// kicks of the simulation drop the clients right away
+	pServer->m_NetServer.SetCallbacks(
+		CServer::NewClientCallback,
+		CServer::NewClientNoAuthCallback,
+		CServer::ClientRejoinCallback,
+		CServer::DelClientCallback, pServer);
+	pServer->Antibot()->Init();
+	pGameServer->OnInit(nullptr);
+
+	const bool Success = Replay.Run();
+	if(!Success)
+		log_error(TOOL_NAME, "file is corrupt after tick %d", Reader.Tick());
+
+	const CTeeHistorianReplay::CStats &Stats = Replay.Stats();
+	log_info(TOOL_NAME, "ticks: %d in %.2fms, %.0f ticks/s", Stats.m_Ticks, Stats.m_TickTime / 1e6,
+		Stats.m_TickTime > 0 ? Stats.m_Ticks / (Stats.m_TickTime / 1e9) : 0.0);
+	log_info(TOOL_NAME, "player ticks: %" PRId64 ", %" PRId64 " mismatched, %d players diverged",
+		Stats.m_PlayerTicks, Stats.m_MismatchedPlayerTicks, Stats.m_MismatchedPlayers);
+	log_info(TOOL_NAME, "team corrections: %d, skipped server commands: %d, unsupported chunks: %d",
+		Stats.m_TeamCorrections, Stats.m_SkippedCommands, Stats.m_UnsupportedChunks);
+	for(const CTeeHistorianReplay::CMismatch &Mismatch : Replay.Mismatches())
+	{
+		log_info(TOOL_NAME, "tick %d cid=%d recorded %s (%d, %d), replayed %s (%d, %d)",
+			Mismatch.m_Tick, Mismatch.m_ClientId,
+			Mismatch.m_RecordedAlive ? "alive" : "dead", Mismatch.m_RecordedX, Mismatch.m_RecordedY,
+			Mismatch.m_Alive ? "alive" : "dead", Mismatch.m_X, Mismatch.m_Y);
+	}
+
+	pGameServer->OnShutdown(nullptr);
+	pServer->m_pMap->Unload();
+	pServer->DbPool()->OnShutdown();
+	return Success && Stats.m_MismatchedPlayers == 0 ? 0 : 1;
+}